@@ -0,0 +1,25 @@
+#!/bin/sh
+# Build every preset in this directory into build/<preset>, each with its own
+# sdkconfig. With --bench, build each for the linux target with
+# sdkconfig.bench added instead and run it: one JSON line per preset.
+#   configs/build.sh [--bench]
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p build
+
+for preset in configs/sdkconfig.*; do
+    name=${preset#configs/sdkconfig.}
+    if [ "$name" = bench ]; then
+        continue
+    fi
+    if [ "$1" = --bench ]; then
+        dir=build/$name-bench
+        idf.py -B "$dir" -D SDKCONFIG="$dir/sdkconfig" \
+            -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;$preset;configs/sdkconfig.bench" \
+            --preview set-target linux build > "build/$name-bench.log"
+        "$dir"/*.elf | grep '^{'
+    else
+        idf.py -B "build/$name" -D SDKCONFIG="build/$name/sdkconfig" \
+            -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;$preset" build
+    fi
+done
@@ -0,0 +1,143 @@
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "audio_base64.h"
+
+// Defining BASE64_HAVE_SSSE3=0 builds the table path alone, for comparison
+#ifndef BASE64_HAVE_SSSE3
+#if CONFIG_IDF_TARGET_LINUX && defined(__x86_64__)
+#define BASE64_HAVE_SSSE3 1
+#else
+#define BASE64_HAVE_SSSE3 0
+#endif
+#endif
+
+#if BASE64_HAVE_SSSE3
+#include <immintrin.h>
+#endif
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Two output characters for every 12-bit value, stored in output byte order,
+// so each 3-byte group costs two loads and two 16-bit stores
+static uint16_t base64_pairs[4096];
+static volatile bool base64_pairs_ready;
+
+static void base64_build_pairs(void) {
+    for (int i = 0; i < 4096; ++i) {
+        char pair[2] = {base64_alphabet[i >> 6], base64_alphabet[i & 0x3F]};
+        memcpy(&base64_pairs[i], pair, sizeof(pair));
+    }
+    base64_pairs_ready = true;
+}
+
+static inline void base64_encode_group(const uint8_t *in, char *out) {
+    uint32_t v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+    memcpy(out, &base64_pairs[v >> 12], 2);
+    memcpy(out + 2, &base64_pairs[v & 0xFFF], 2);
+}
+
+#if BASE64_HAVE_SSSE3
+
+// 12 input bytes -> 16 characters per iteration (Mula's pshufb method).
+// Needs 16 readable input bytes, so the caller leaves a tail for scalar code.
+__attribute__((target("ssse3")))
+static size_t base64_encode_ssse3(const uint8_t *in, size_t groups, char *out) {
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+
+    while (groups - done >= 6) { // 4 groups used + 16 readable bytes
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), shuffle);
+        __m128i hi = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i lo = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(hi, lo);
+
+        __m128i shift = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        __m128i below_26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        shift = _mm_or_si128(shift, _mm_and_si128(below_26, _mm_set1_epi8(13)));
+        _mm_storeu_si128((__m128i *)out, _mm_add_epi8(_mm_shuffle_epi8(shift_lut, shift), idx));
+
+        in += 12;
+        out += 16;
+        done += 4;
+    }
+    return done;
+}
+
+#endif
+
+static size_t base64_encode_groups(const uint8_t *in, size_t groups, char *out) {
+    size_t i = 0;
+
+#if BASE64_HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3")) {
+        i = base64_encode_ssse3(in, groups, out);
+    }
+#endif
+    // Four groups (12 bytes -> 16 chars) per iteration
+    for (; i + 4 <= groups; i += 4) {
+        base64_encode_group(in + i * 3, out + i * 4);
+        base64_encode_group(in + i * 3 + 3, out + i * 4 + 4);
+        base64_encode_group(in + i * 3 + 6, out + i * 4 + 8);
+        base64_encode_group(in + i * 3 + 9, out + i * 4 + 12);
+    }
+    for (; i < groups; ++i) {
+        base64_encode_group(in + i * 3, out + i * 4);
+    }
+    return groups * 4;
+}
+
+void audio_base64_init(audio_base64_t *b64) {
+    if (!base64_pairs_ready) {
+        base64_build_pairs(); // Idempotent, so a race only repeats the work
+    }
+    b64->carry_len = 0;
+}
+
+size_t audio_base64_update(audio_base64_t *b64, const uint8_t *in, size_t len, char *out) {
+    size_t written = 0;
+
+    // Complete a group started by the previous call
+    if (b64->carry_len > 0) {
+        uint8_t group[3];
+        size_t need = 3 - b64->carry_len;
+        if (len < need) {
+            memcpy(b64->carry + b64->carry_len, in, len);
+            b64->carry_len += len;
+            return 0;
+        }
+        memcpy(group, b64->carry, b64->carry_len);
+        memcpy(group + b64->carry_len, in, need);
+        base64_encode_group(group, out);
+        in += need;
+        len -= need;
+        out += 4;
+        written = 4;
+        b64->carry_len = 0;
+    }
+
+    size_t groups = len / 3;
+    written += base64_encode_groups(in, groups, out);
+
+    b64->carry_len = len - groups * 3;
+    memcpy(b64->carry, in + groups * 3, b64->carry_len);
+    return written;
+}
+
+size_t audio_base64_finish(audio_base64_t *b64, char *out) {
+    if (b64->carry_len == 0) {
+        return 0;
+    }
+    uint8_t b0 = b64->carry[0];
+    uint8_t b1 = b64->carry_len > 1 ? b64->carry[1] : 0;
+
+    out[0] = base64_alphabet[b0 >> 2];
+    out[1] = base64_alphabet[((b0 & 0x03) << 4) | (b1 >> 4)];
+    out[2] = b64->carry_len > 1 ? base64_alphabet[(b1 & 0x0F) << 2] : '=';
+    out[3] = '=';
+    b64->carry_len = 0;
+    return 4;
+}
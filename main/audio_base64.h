@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming base64 encoder. Input can arrive in pieces of any size; up to
+// two bytes are carried between calls so the output matches a one-shot
+// encode of the concatenated input.
+typedef struct {
+    uint8_t carry[2];
+    uint8_t carry_len;
+} audio_base64_t;
+
+// Largest output audio_base64_update can produce for `len` input bytes
+#define AUDIO_BASE64_UPDATE_MAX(len) (((len) + 2) / 3 * 4)
+
+void audio_base64_init(audio_base64_t *b64);
+
+// Encode all whole 3-byte groups available. Returns characters written
+// (no terminator).
+size_t audio_base64_update(audio_base64_t *b64, const uint8_t *in, size_t len, char *out);
+
+// Flush the carried bytes with '=' padding. Writes at most 4 characters.
+size_t audio_base64_finish(audio_base64_t *b64, char *out);
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_base64.h"
+#include "audio_bench.h"
+#include "audio_capture.h"
+#include "audio_clip_store.h"
+#include "audio_index.h"
+#include "audio_ring.h"
+#include "audio_vad.h"
+
+#define BENCH_BLOCK_FRAMES 4            // Captured and recorded between timer reads (64 ms at 16kHz)
+#define BENCH_TONE_HZ 500
+#define BENCH_TONE_LEVEL 600            // Triangle amplitude, ADC LSB
+#define BENCH_STORE_BYTES (64 * 1024)   // Clip store: the smallest the firmware is configured with
+
+static const char *TAG = "AudioBench";
+
+// Buffers and state of one run
+typedef struct {
+    const audio_bench_config_t *config;
+    size_t channels;
+    uint32_t adc_rate;          // Scans per second
+    uint32_t scan;              // Synthetic readings generated, per channel
+    uint32_t noise;
+    size_t raw_samples;         // Readings per frame, all channels
+    size_t frame_samples;       // Samples per captured frame, all channels
+    audio_capture_filter_t filter;
+    int16_t *raw;               // BENCH_BLOCK_FRAMES frames of each, sized for the configuration
+    int16_t *frames;
+    int16_t pcm[AUDIO_UPLOAD_FRAME_SAMPLES];
+    uint8_t levels[AUDIO_BENCH_FRAME_SAMPLES];
+    uint8_t encoded[AUDIO_UPLOAD_FRAME_SAMPLES * sizeof(int16_t)];
+    char text[AUDIO_BASE64_UPDATE_MAX(AUDIO_UPLOAD_FRAME_SAMPLES * sizeof(int16_t)) + 4];
+    audio_ring_t ring;
+    audio_index_t index;
+    audio_vad_t vad;
+    audio_codec_state_t codec_state;
+    audio_clip_store_t store;
+} bench_t;
+
+// Synthetic readings: a triangle tone in half-second bursts over a little
+// noise, so the VAD and the codecs see something like speech
+static void bench_generate(bench_t *b, int16_t *raw, size_t scans) {
+    uint32_t period = b->adc_rate / BENCH_TONE_HZ;
+
+    for (size_t i = 0; i < scans; ++i, ++b->scan) {
+        bool burst = b->scan / (b->adc_rate / 2) % 2 == 0;
+        for (size_t c = 0; c < b->channels; ++c) {
+            b->noise = b->noise * 1664525 + 1013904223;
+            int32_t level = 2048 + (int32_t)(b->noise >> 27) - 16;
+            if (burst) {
+                int32_t pos = (b->scan + c * period / 4) % period;
+                int32_t distance = 2 * pos - (int32_t)period;
+                level += (distance < 0 ? -distance : distance) * 2 * BENCH_TONE_LEVEL / (int32_t)period -
+                         BENCH_TONE_LEVEL;
+            }
+            raw[i * b->channels + c] = level;
+        }
+    }
+}
+
+// Capture and record `seconds` of audio into the ring, timing each stage
+// a block of frames at a time
+static void bench_record(bench_t *b, uint32_t frames, int64_t *capture_us, int64_t *record_us) {
+    size_t scans = AUDIO_BENCH_FRAME_SAMPLES * b->config->oversample;
+
+    audio_vad_begin(&b->vad);
+    for (uint32_t done = 0; done < frames;) {
+        uint32_t n = frames - done < BENCH_BLOCK_FRAMES ? frames - done : BENCH_BLOCK_FRAMES;
+        for (uint32_t i = 0; i < n; ++i) {
+            bench_generate(b, b->raw + i * b->raw_samples, scans);
+        }
+
+        // What capture's read() does with each frame of readings
+        int64_t start = esp_timer_get_time();
+        for (uint32_t i = 0; i < n; ++i) {
+            audio_capture_filter(&b->filter, b->raw + i * b->raw_samples, scans, b->frames + i * b->frame_samples);
+        }
+        int64_t captured = esp_timer_get_time();
+        for (uint32_t i = 0; i < n; ++i) {
+            const int16_t *frame = b->frames + i * b->frame_samples;
+            audio_ring_write(&b->ring, frame, b->frame_samples);
+            audio_index_append(&b->index, frame, b->frame_samples);
+            audio_vad_process(&b->vad, frame, b->frame_samples);
+        }
+        *capture_us += captured - start;
+        *record_us += esp_timer_get_time() - captured;
+        done += n;
+    }
+}
+
+// What playback does with each DMA buffer: the first channel through a
+// view, scaled to 8-bit DAC levels
+static int64_t bench_playback(bench_t *b, uint32_t samples) {
+    audio_ring_view_t view = {.ring = &b->ring, .channels = b->channels, .channel = 0};
+    audio_ring_cursor_t cursor = audio_ring_cursor_last(&b->ring, samples);
+
+    int64_t start = esp_timer_get_time();
+    size_t got;
+    while ((got = audio_ring_view_read(&view, &cursor, b->frames, AUDIO_BENCH_FRAME_SAMPLES)) > 0) {
+        for (size_t i = 0; i < got; ++i) {
+            b->levels[i] = b->frames[i] >> 4;
+        }
+    }
+    return esp_timer_get_time() - start;
+}
+
+// Encode one upload frame of readings as audio_upload does. Returns body bytes.
+static size_t bench_encode(bench_t *b, audio_base64_t *b64, int16_t *frame, size_t count) {
+    const uint8_t *raw = (const uint8_t *)frame;
+    size_t raw_len = count * sizeof(int16_t);
+
+    if (b->config->codec != AUDIO_CODEC_PCM16) {
+        audio_codec_adc_to_pcm(frame, count);
+        raw_len = audio_codec_encode(b->config->codec, &b->codec_state, frame, count, b->encoded);
+        raw = b->encoded;
+    }
+    if (b->config->format == AUDIO_UPLOAD_JSON_BASE64) {
+        return audio_base64_update(b64, raw, raw_len, b->text);
+    }
+    return raw_len;
+}
+
+// What the uploader does with a clip: snapshot it from the ring into the
+// clip store, then read it back frame by frame and encode the body. Clips
+// are cut to what the store holds.
+static int64_t bench_upload(bench_t *b, uint32_t samples, size_t *body_bytes) {
+    uint32_t store_samples = b->store.slab_count * AUDIO_CLIP_STORE_SLAB_SAMPLES;
+    audio_ring_cursor_t cursor = audio_ring_cursor_last(&b->ring, samples);
+    audio_base64_t b64;
+
+    audio_base64_init(&b64);
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < samples;) {
+        uint32_t clip = samples - done < store_samples ? samples - done : store_samples;
+        uint32_t id;
+        if (audio_clip_store_alloc(&b->store, clip, NULL, 0, &id) != ESP_OK) {
+            break;
+        }
+        for (size_t offset = 0; offset < clip;) {
+            size_t want = clip - offset < AUDIO_UPLOAD_FRAME_SAMPLES ? clip - offset : AUDIO_UPLOAD_FRAME_SAMPLES;
+            size_t got = audio_ring_read(&b->ring, &cursor, b->pcm, want);
+            if (got == 0 || audio_clip_store_write(&b->store, id, offset, b->pcm, got) != got) {
+                break;
+            }
+            offset += got;
+        }
+        for (size_t offset = 0; offset < clip;) {
+            size_t want = clip - offset < AUDIO_UPLOAD_FRAME_SAMPLES ? clip - offset : AUDIO_UPLOAD_FRAME_SAMPLES;
+            size_t got = audio_clip_store_read(&b->store, id, offset, b->pcm, want);
+            if (got == 0) {
+                break;
+            }
+            *body_bytes += bench_encode(b, &b64, b->pcm, got);
+            offset += got;
+        }
+        audio_clip_store_free(&b->store, id);
+        done += clip;
+    }
+    *body_bytes += audio_base64_finish(&b64, b->text);
+    return esp_timer_get_time() - start;
+}
+
+static esp_err_t bench_init(bench_t *b, const audio_bench_config_t *config, uint32_t samples) {
+    size_t store_bytes = BENCH_STORE_BYTES;
+    uint32_t capacity = 2 * AUDIO_INDEX_BLOCK_SAMPLES;
+    while (capacity < samples) {
+        capacity <<= 1;
+    }
+
+    b->config = config;
+    b->channels = config->channels;
+    b->adc_rate = config->sample_rate * config->oversample;
+    b->noise = 1;
+    b->raw_samples = AUDIO_BENCH_FRAME_SAMPLES * config->oversample * b->channels;
+    b->frame_samples = AUDIO_BENCH_FRAME_SAMPLES * b->channels;
+    // Capture's DC blocking is on in every firmware configuration
+    if (audio_capture_filter_init(&b->filter, b->channels, config->oversample, true) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    audio_vad_init(&b->vad, b->channels);
+
+    // Frames in internal RAM, where capture keeps its frame slots
+    b->raw = heap_caps_calloc(BENCH_BLOCK_FRAMES * b->raw_samples, sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    b->frames = heap_caps_calloc(BENCH_BLOCK_FRAMES * b->frame_samples, sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (b->raw == NULL || b->frames == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t *storage = heap_caps_calloc(1, AUDIO_RING_STORAGE_BYTES(capacity), config->buffer_caps);
+    uint8_t *index_storage = heap_caps_calloc(1, AUDIO_INDEX_STORAGE_BYTES(capacity), MALLOC_CAP_INTERNAL);
+    void *arena = heap_caps_malloc(store_bytes, config->buffer_caps);
+    if (storage == NULL || index_storage == NULL || arena == NULL) {
+        heap_caps_free(storage);
+        heap_caps_free(index_storage);
+        heap_caps_free(arena);
+        ESP_LOGE(TAG, "No room for a ring of %lu samples", (unsigned long)capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_ERROR_CHECK(audio_ring_init(&b->ring, storage, capacity));
+    ESP_ERROR_CHECK(audio_index_init(&b->index, &b->ring, index_storage, config->sample_rate * b->channels));
+    return audio_clip_store_init(&b->store, arena, store_bytes);
+}
+
+static void bench_free(bench_t *b) {
+    void *arena = b->store.clips;
+
+    audio_clip_store_deinit(&b->store);
+    heap_caps_free(arena);
+    heap_caps_free(b->index.blocks);
+    heap_caps_free(b->ring.storage);
+    heap_caps_free(b->frames);
+    heap_caps_free(b->raw);
+}
+
+esp_err_t audio_bench_run(const audio_bench_config_t *config, audio_bench_result_t *result) {
+    size_t channels = config->channels;
+
+    if ((channels != 1 && channels != 2 && channels != 4) || config->sample_rate == 0 || config->seconds == 0 ||
+        AUDIO_BENCH_FRAME_SAMPLES * config->oversample > AUDIO_CAPTURE_MAX_FRAME_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->codec == AUDIO_CODEC_IMA_ADPCM && channels > 1) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Filter state and encode buffers, a few KB: too much for the caller's stack
+    bench_t *b = heap_caps_calloc(1, sizeof(bench_t), MALLOC_CAP_INTERNAL);
+    if (b == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t frames = config->seconds * config->sample_rate / AUDIO_BENCH_FRAME_SAMPLES;
+    uint32_t samples = frames * AUDIO_BENCH_FRAME_SAMPLES * channels;
+    esp_err_t err = bench_init(b, config, samples);
+    if (err != ESP_OK) {
+        heap_caps_free(b->frames);
+        heap_caps_free(b->raw);
+        heap_caps_free(b);
+        return err;
+    }
+
+    int64_t capture_us = 0;
+    int64_t record_us = 0;
+    size_t body_bytes = 0;
+    bench_record(b, frames, &capture_us, &record_us);
+    int64_t playback_us = bench_playback(b, samples);
+    int64_t upload_us = bench_upload(b, samples, &body_bytes);
+
+    *result = (audio_bench_result_t){
+        .capture_us = capture_us / config->seconds,
+        .record_us = record_us / config->seconds,
+        .playback_us = playback_us / config->seconds,
+        .upload_us = upload_us / config->seconds,
+        .ring_bytes = AUDIO_RING_STORAGE_BYTES(b->ring.capacity),
+        .upload_bytes = body_bytes / config->seconds,
+    };
+    ESP_LOGI(TAG, "VAD kept %lu of %lu frames", (unsigned long)b->vad.speech_frames, (unsigned long)b->vad.frames);
+    bench_free(b);
+    heap_caps_free(b);
+    return ESP_OK;
+}
+
+void audio_bench_print(const audio_bench_config_t *config, const audio_bench_result_t *result) {
+    uint32_t total = result->capture_us + result->record_us + result->playback_us + result->upload_us;
+
+    printf("{\"sample_rate\":%lu,\"channels\":%u,\"oversample\":%u,\"ring_bits\":%d,\"buffer\":\"%s\","
+           "\"codec\":\"%s\",\"format\":\"%s\",\"seconds\":%lu,"
+           "\"us_per_s\":{\"capture\":%lu,\"record\":%lu,\"playback\":%lu,\"upload\":%lu,\"total\":%lu},"
+           "\"ring_bytes\":%u,\"upload_bytes_per_s\":%u}\n",
+           (unsigned long)config->sample_rate, (unsigned)config->channels, (unsigned)config->oversample,
+           CONFIG_AUDIO_RING_BITS, (config->buffer_caps & MALLOC_CAP_SPIRAM) ? "psram" : "dram",
+           audio_codec_name(config->codec), config->format == AUDIO_UPLOAD_WAV ? "wav" : "json",
+           (unsigned long)config->seconds, (unsigned long)result->capture_us, (unsigned long)result->record_us,
+           (unsigned long)result->playback_us, (unsigned long)result->upload_us, (unsigned long)total,
+           (unsigned)result->ring_bytes, (unsigned)result->upload_bytes);
+    fflush(stdout);
+}
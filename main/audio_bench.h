@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_codec.h"
+#include "audio_upload.h"
+
+// CPU cost of each pipeline stage for one build configuration, so
+// configurations can be compared on the device or on the host. Synthetic
+// speech-like readings (a tone in bursts over noise) go through the same
+// calls the firmware makes, with no drivers, tasks or network; the ring
+// depth is the one compiled in (CONFIG_AUDIO_RING_BITS).
+
+#define AUDIO_BENCH_FRAME_SAMPLES 256   // Per channel, as captured
+
+typedef struct {
+    uint32_t sample_rate;
+    size_t channels;            // 1, 2 or 4, interleaved in the ring
+    size_t oversample;          // 1, 2 or 4
+    audio_codec_t codec;
+    audio_upload_format_t format;
+    uint32_t seconds;           // Audio pushed through each stage; also sizes the ring
+    uint32_t buffer_caps;       // heap_caps for the ring and clip store, e.g. MALLOC_CAP_SPIRAM
+} audio_bench_config_t;
+
+// CPU time per second of audio, in microseconds, for each stage
+typedef struct {
+    uint32_t capture_us;        // Anti-alias decimation and DC blocking
+    uint32_t record_us;         // Ring write, index and VAD
+    uint32_t playback_us;       // First channel out of the ring to DAC levels
+    uint32_t upload_us;         // Ring snapshot into the clip store, read back, encoded as the body
+    size_t ring_bytes;          // Ring storage for `seconds` of audio
+    size_t upload_bytes;        // Body bytes per second of audio
+} audio_bench_result_t;
+
+// Run every stage once over config->seconds of audio. ESP_ERR_NO_MEM if
+// the buffers do not fit in buffer_caps memory.
+esp_err_t audio_bench_run(const audio_bench_config_t *config, audio_bench_result_t *result);
+
+// One JSON object on stdout: the configuration and the result
+void audio_bench_print(const audio_bench_config_t *config, const audio_bench_result_t *result);
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "audio_hal.h"
+#include "audio_capture.h"
+#include "audio_metrics.h"
+#include "audio_dsp.h"
+
+typedef struct {
+    int16_t *samples;       // s_raw_samples, interleaved
+    int64_t completed_us;   // When the last sample arrived
+    uint32_t overruns;      // s_overruns then: frames dropped before this one
+} capture_frame_t;
+
+static audio_capture_config_t s_config;
+static size_t s_scans;              // ADC scans per frame
+static size_t s_raw_samples;        // ADC readings per frame, all channels
+static audio_capture_filter_t s_filter;    // Reader-side filter state
+static capture_frame_t *s_frames;   // queue_depth + 2 slots: queued, being filled, being read
+static size_t s_slot_count;
+static size_t s_fill_slot;
+static size_t s_fill_pos;
+static QueueHandle_t s_frame_queue; // Slot indices of completed frames
+static volatile uint32_t s_overruns;
+static volatile bool s_running;
+static int64_t s_start_us;
+static uint32_t s_start_overruns;
+static audio_capture_latency_t s_latency;  // Owned by the reader
+static uint32_t s_period_q8;        // Sample period in 1/256 us
+static int64_t s_frame_period_q8;   // Scans per frame times s_period_q8
+static capture_frame_t s_last_frame;  // Previous frame read, completed_us 0 before the first
+static uint64_t s_latency_sum_us;
+
+// Hand the slot being filled to the reader, or drop it if the queue is full
+static void IRAM_ATTR capture_complete_frame(BaseType_t *woken) {
+    uint16_t slot = s_fill_slot;
+    s_fill_pos = 0;
+    s_frames[slot].completed_us = audio_hal_time_us();
+    s_frames[slot].overruns = s_overruns;
+    if (xQueueSendFromISR(s_frame_queue, &slot, woken) != pdTRUE) {
+        s_overruns++;
+        audio_metrics_add(AUDIO_METRIC_CAPTURE_OVERRUNS, 1);
+        return; // Refill the same slot
+    }
+    s_fill_slot = (s_fill_slot + 1) % s_slot_count;
+}
+
+static void capture_reset(void) {
+    xQueueReset(s_frame_queue);
+    s_fill_slot = 0;
+    s_fill_pos = 0;
+    audio_capture_filter_init(&s_filter, s_config.channels, s_config.oversample, s_config.dc_block);
+}
+
+esp_err_t audio_capture_filter_init(audio_capture_filter_t *filter, size_t channels, size_t oversample,
+                                    bool dc_block) {
+    if (channels == 0 || channels > AUDIO_CAPTURE_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    filter->channels = channels;
+    filter->dc_block = dc_block;
+    for (size_t c = 0; c < channels; ++c) {
+        esp_err_t err = audio_dsp_decimator_init(&filter->decimator[c], oversample);
+        if (err != ESP_OK) {
+            return err;
+        }
+        audio_dsp_dc_blocker_init(&filter->dc_blocker[c]);
+    }
+    return ESP_OK;
+}
+
+// Oversampled readings -> low-passed, decimated, DC-free readings, one
+// channel at a time
+size_t audio_capture_filter(audio_capture_filter_t *filter, const int16_t *raw, size_t scans, int16_t *frame) {
+    size_t channels = filter->channels;
+    size_t count = 0;
+
+    for (size_t c = 0; c < channels; ++c) {
+        for (size_t i = 0; i < scans; ++i) {
+            filter->work[i] = raw[i * channels + c] - 2048;
+        }
+        count = audio_dsp_decimate(&filter->decimator[c], filter->work, scans, filter->work);
+        if (filter->dc_block) {
+            audio_dsp_dc_block(&filter->dc_blocker[c], filter->work, count);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            int32_t level = filter->work[i] + 2048;
+            frame[i * channels + c] = level < 0 ? 0 : level > 4095 ? 4095 : level;
+        }
+    }
+    return count * channels;
+}
+
+// Readings from the HAL: the sample timer ISR on target, whole frames on the host
+static bool IRAM_ATTR capture_on_samples(const int16_t *samples, size_t count, void *ctx) {
+    BaseType_t woken = pdFALSE;
+
+    for (size_t i = 0; i < count; ++i) {
+        s_frames[s_fill_slot].samples[s_fill_pos++] = samples[i];
+        if (s_fill_pos == s_raw_samples) {
+            capture_complete_frame(&woken);
+        }
+    }
+    return woken == pdTRUE;
+}
+
+esp_err_t audio_capture_init(const audio_capture_config_t *config) {
+    size_t oversample = config->oversample;
+    if (oversample != 1 && oversample != 2 && oversample != 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t channels = config->channels;
+    if (channels != 1 && channels != 2 && channels != 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->frame_samples == 0 || config->frame_samples * oversample > AUDIO_CAPTURE_MAX_FRAME_SAMPLES ||
+        config->sample_rate == 0 || AUDIO_HAL_ADC_TIMER_HZ % (config->sample_rate * oversample) != 0 ||
+        config->queue_depth == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    s_scans = config->frame_samples * oversample;
+    s_raw_samples = s_scans * channels;
+    s_period_q8 = (256ULL * 1000000) / (config->sample_rate * oversample);
+    s_frame_period_q8 = (int64_t)s_scans * s_period_q8;
+
+    s_slot_count = config->queue_depth + 2;
+    s_frames = calloc(s_slot_count, sizeof(capture_frame_t));
+    int16_t *samples = calloc(s_slot_count * s_raw_samples, sizeof(int16_t));
+    s_frame_queue = xQueueCreate(config->queue_depth, sizeof(uint16_t));
+    if (s_frames == NULL || samples == NULL || s_frame_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < s_slot_count; ++i) {
+        s_frames[i].samples = samples + i * s_raw_samples;
+    }
+    capture_reset();
+
+    audio_hal_adc_config_t adc_config = {
+        .sample_rate = config->sample_rate * oversample,
+        .channel_count = channels,
+        .frame_samples = s_scans,
+        .on_samples = capture_on_samples,
+    };
+    memcpy(adc_config.channels, config->adc_channels, channels * sizeof(int));
+    return audio_hal_adc_init(&adc_config);
+}
+
+// The queue is already empty: init and stop both reset it
+esp_err_t IRAM_ATTR audio_capture_start_from_isr(int64_t start_us) {
+    if (s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_running = true;
+    s_start_us = start_us;
+    s_last_frame.completed_us = 0;
+    s_start_overruns = s_overruns;
+    return audio_hal_adc_start();
+}
+
+esp_err_t audio_capture_start(void) {
+    return audio_capture_start_from_isr(audio_hal_time_us());
+}
+
+esp_err_t audio_capture_stop(void) {
+    if (!s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_running = false;
+    esp_err_t err = audio_hal_adc_stop();
+    capture_reset();
+    return err;
+}
+
+size_t audio_capture_read(int16_t *frame, TickType_t timeout) {
+    uint16_t slot;
+    if (xQueueReceive(s_frame_queue, &slot, timeout) != pdTRUE) {
+        return 0;
+    }
+    if (s_config.oversample == 1 && !s_config.dc_block) {
+        memcpy(frame, s_frames[slot].samples, s_raw_samples * sizeof(int16_t));
+    } else {
+        audio_capture_filter(&s_filter, s_frames[slot].samples, s_scans, frame);
+    }
+
+    // Timing jitter against the nominal frame period, in whole us: taken
+    // here once a frame rather than on every ISR call, from the completion
+    // times the ISR stamps anyway. Frames dropped in between each add a period.
+    capture_frame_t *done = &s_frames[slot];
+    if (s_last_frame.completed_us != 0) {
+        int64_t periods = 1 + (uint32_t)(done->overruns - s_last_frame.overruns);
+        int64_t deviation_q8 = (done->completed_us - s_last_frame.completed_us) * 256 - periods * s_frame_period_q8;
+        audio_metrics_record(AUDIO_METRIC_SAMPLE_JITTER_US, (deviation_q8 < 0 ? -deviation_q8 : deviation_q8) >> 8);
+    }
+    s_last_frame = *done;
+
+    int64_t latency_us = audio_hal_time_us() - done->completed_us;
+    if (latency_us > s_latency.worst_us) {
+        s_latency.worst_us = latency_us;
+    }
+    s_latency_sum_us += latency_us;
+    s_latency.frames++;
+    audio_metrics_add(AUDIO_METRIC_CAPTURE_FRAMES, 1);
+    audio_metrics_record(AUDIO_METRIC_FRAME_LATENCY_US, latency_us);
+    return s_config.frame_samples * s_config.channels;
+}
+
+void audio_capture_latency(audio_capture_latency_t *latency, bool reset) {
+    *latency = s_latency;
+    latency->mean_us = s_latency.frames ? s_latency_sum_us / s_latency.frames : 0;
+    if (reset) {
+        s_latency = (audio_capture_latency_t){0};
+        s_latency_sum_us = 0;
+    }
+}
+
+uint32_t audio_capture_samples_until(int64_t timestamp_us) {
+    if (timestamp_us <= s_start_us) {
+        return 0;
+    }
+    uint64_t samples = (uint64_t)(timestamp_us - s_start_us) * s_config.sample_rate / 1000000 * s_config.channels;
+    uint64_t dropped = (uint64_t)(s_overruns - s_start_overruns) * s_config.frame_samples * s_config.channels;
+    return samples > dropped ? samples - dropped : 0;
+}
+
+uint32_t audio_capture_overruns(void) {
+    return s_overruns;
+}
+
+uint32_t audio_capture_dropped_samples(void) {
+    return s_overruns * s_config.frame_samples * s_config.channels;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "audio_dsp.h"
+
+#define AUDIO_CAPTURE_MAX_FRAME_SAMPLES 512 // ADC readings per channel per frame, before decimation
+#define AUDIO_CAPTURE_MAX_CHANNELS 4
+
+// Capture settings
+typedef struct {
+    uint32_t sample_rate;   // Output samples per second
+    size_t frame_samples;   // Samples per channel per delivered frame
+    size_t queue_depth;     // Completed frames held before an overrun is counted
+    int adc_channels[AUDIO_CAPTURE_MAX_CHANNELS];   // ADC1 channels scanned each sample period, in order
+    size_t channels;        // 1, 2 or 4. Frames are interleaved: one sample of each channel per period.
+    size_t oversample;      // 1, 2 or 4: the ADC runs this much faster and read() low-passes and
+                            // decimates (see audio_dsp.h). sample_rate * oversample must divide
+                            // AUDIO_HAL_ADC_TIMER_HZ.
+    bool dc_block;          // Remove the mic bias so silence sits at mid-scale (2048)
+} audio_capture_config_t;
+
+// The filter read() runs each frame of readings through: per channel,
+// low-pass and decimate, remove DC and clamp back to the ADC range.
+// Exposed so the benchmark (audio_bench) times exactly this.
+typedef struct {
+    size_t channels;
+    bool dc_block;
+    audio_dsp_decimator_t decimator[AUDIO_CAPTURE_MAX_CHANNELS];
+    audio_dsp_dc_blocker_t dc_blocker[AUDIO_CAPTURE_MAX_CHANNELS];
+    int16_t work[AUDIO_CAPTURE_MAX_FRAME_SAMPLES];
+} audio_capture_filter_t;
+
+// Start from empty filter state. Channels 1 to AUDIO_CAPTURE_MAX_CHANNELS,
+// oversample 1, 2 or 4.
+esp_err_t audio_capture_filter_init(audio_capture_filter_t *filter, size_t channels, size_t oversample,
+                                    bool dc_block);
+
+// Filter `scans` interleaved scans of raw readings (at most
+// AUDIO_CAPTURE_MAX_FRAME_SAMPLES, a multiple of the oversample) into
+// `frame`. Returns the samples written, all channels.
+size_t audio_capture_filter(audio_capture_filter_t *filter, const int16_t *raw, size_t scans, int16_t *frame);
+
+// Set up the frame queue and the HAL sampler. Call once before start.
+esp_err_t audio_capture_init(const audio_capture_config_t *config);
+
+// Start and stop sampling. Stop discards any frames not yet read.
+esp_err_t audio_capture_start(void);
+esp_err_t audio_capture_stop(void);
+
+// Start from an ISR, e.g. the button edge at `start_us` (audio_hal_time_us),
+// so the recording begins on the sample after the edge.
+// ESP_ERR_INVALID_STATE if already running.
+esp_err_t audio_capture_start_from_isr(int64_t start_us);
+
+// Samples (of all channels) read() delivers for audio up to `timestamp_us`
+// since the start, less any dropped in overruns
+uint32_t audio_capture_samples_until(int64_t timestamp_us);
+
+// Block until a full frame is ready and run each channel through the
+// filters. Returns the number of samples copied (frame_samples * channels,
+// interleaved), 0 on timeout.
+size_t audio_capture_read(int16_t *frame, TickType_t timeout);
+
+// Frame delivery latency: from a frame's last sample to read() returning it
+typedef struct {
+    uint32_t frames;
+    uint32_t worst_us;
+    uint32_t mean_us;
+} audio_capture_latency_t;
+
+// Latency over the frames read since the last reset
+void audio_capture_latency(audio_capture_latency_t *latency, bool reset);
+
+// Frames dropped because the reader fell behind
+uint32_t audio_capture_overruns(void);
+
+// Same, in samples
+uint32_t audio_capture_dropped_samples(void);
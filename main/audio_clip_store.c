@@ -0,0 +1,228 @@
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "audio_clip_store.h"
+
+// The clip with this id, or NULL if it is gone. Call with the lock held.
+static audio_clip_store_clip_t *store_find(audio_clip_store_t *store, uint32_t id) {
+    audio_clip_store_clip_t *clip = &store->clips[id % AUDIO_CLIP_STORE_MAX_CLIPS];
+    return id != 0 && clip->id == id ? clip : NULL;
+}
+
+// Splice the clip's chain onto the free list
+static void store_release(audio_clip_store_t *store, audio_clip_store_clip_t *clip) {
+    store->links[clip->last_slab] = store->free_head;
+    store->free_head = clip->first_slab;
+    store->free_count += clip->slab_count;
+    clip->id = 0;
+}
+
+// Drop the oldest clip still stored. False if there is none.
+static bool store_evict_oldest(audio_clip_store_t *store) {
+    while (store->oldest_id != store->next_id) {
+        audio_clip_store_clip_t *clip = store_find(store, store->oldest_id++);
+        if (clip != NULL) {
+            store_release(store, clip);
+            store->evictions++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Slab holding chain position `index`, walking on from the cached position
+// when it is at or before it
+static uint16_t store_slab(audio_clip_store_t *store, audio_clip_store_clip_t *clip, uint16_t index) {
+    uint16_t slab = clip->first_slab;
+    uint16_t at = 0;
+
+    if (clip->cached_index <= index) {
+        slab = clip->cached_slab;
+        at = clip->cached_index;
+    }
+    for (; at < index; ++at) {
+        slab = store->links[slab];
+    }
+    clip->cached_slab = slab;
+    clip->cached_index = index;
+    return slab;
+}
+
+esp_err_t audio_clip_store_init(audio_clip_store_t *store, void *arena, size_t arena_bytes) {
+    size_t table_bytes = AUDIO_CLIP_STORE_MAX_CLIPS * sizeof(audio_clip_store_clip_t);
+
+    if (arena == NULL || arena_bytes < table_bytes + AUDIO_CLIP_STORE_SLAB_BYTES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t slabs = (arena_bytes - table_bytes) / AUDIO_CLIP_STORE_SLAB_BYTES;
+    if (slabs > AUDIO_CLIP_STORE_NO_SLAB) {
+        slabs = AUDIO_CLIP_STORE_NO_SLAB;
+    }
+
+    *store = (audio_clip_store_t){
+        .clips = arena,
+        .slabs = (uint8_t *)arena + table_bytes,
+        .slab_count = slabs,
+        .free_head = 0,
+        .free_count = slabs,
+        .next_id = 1,
+        .oldest_id = 1,
+    };
+    store->links = heap_caps_malloc(slabs * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+    store->lock = xSemaphoreCreateMutex();
+    if (store->links == NULL || store->lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(store->clips, 0, table_bytes);
+    for (size_t i = 0; i < slabs; ++i) {
+        store->links[i] = i + 1 < slabs ? i + 1 : AUDIO_CLIP_STORE_NO_SLAB;
+    }
+    return ESP_OK;
+}
+
+void audio_clip_store_deinit(audio_clip_store_t *store) {
+    heap_caps_free(store->links);
+    if (store->lock != NULL) {
+        vSemaphoreDelete(store->lock);
+    }
+    store->links = NULL;
+    store->lock = NULL;
+}
+
+esp_err_t audio_clip_store_alloc(audio_clip_store_t *store, uint32_t samples, const audio_upload_range_t *ranges,
+                                 size_t range_count, uint32_t *id) {
+    uint32_t need = (samples + AUDIO_CLIP_STORE_SLAB_SAMPLES - 1) / AUDIO_CLIP_STORE_SLAB_SAMPLES;
+
+    if (samples == 0 || range_count > AUDIO_UPLOAD_MAX_RANGES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (need > store->slab_count) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    uint32_t new_id = store->next_id++;
+    if (store->next_id == 0) {
+        store->next_id = 1; // 0 marks a free slot
+    }
+
+    // The slot's previous clip is the oldest one left
+    audio_clip_store_clip_t *clip = &store->clips[new_id % AUDIO_CLIP_STORE_MAX_CLIPS];
+    if (clip->id != 0) {
+        store_release(store, clip);
+        store->evictions++;
+    }
+    while (store->free_count < need) {
+        store_evict_oldest(store);
+    }
+
+    // Unlink the first `need` slabs of the free list
+    uint16_t first = store->free_head;
+    uint16_t last = first;
+    for (uint32_t i = 1; i < need; ++i) {
+        last = store->links[last];
+    }
+    store->free_head = store->links[last];
+    store->links[last] = AUDIO_CLIP_STORE_NO_SLAB;
+    store->free_count -= need;
+
+    *clip = (audio_clip_store_clip_t){
+        .id = new_id,
+        .samples = samples,
+        .first_slab = first,
+        .last_slab = last,
+        .slab_count = need,
+        .cached_slab = first,
+        .cached_index = 0,
+        .range_count = range_count,
+    };
+    memcpy(clip->ranges, ranges, range_count * sizeof(ranges[0]));
+    xSemaphoreGive(store->lock);
+
+    *id = new_id;
+    return ESP_OK;
+}
+
+size_t audio_clip_store_write(audio_clip_store_t *store, uint32_t id, size_t offset, const int16_t *in,
+                              size_t count) {
+    size_t done = 0;
+
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    audio_clip_store_clip_t *clip = store_find(store, id);
+    if (clip != NULL && offset + count <= clip->samples) {
+        while (done < count) {
+            size_t pos = offset + done;
+            size_t in_slab = pos % AUDIO_CLIP_STORE_SLAB_SAMPLES;
+            size_t n = AUDIO_CLIP_STORE_SLAB_SAMPLES - in_slab;
+            if (n > count - done) {
+                n = count - done;
+            }
+            uint16_t slab = store_slab(store, clip, pos / AUDIO_CLIP_STORE_SLAB_SAMPLES);
+            audio_pack12(store->slabs + (size_t)slab * AUDIO_CLIP_STORE_SLAB_BYTES, in_slab, in + done, n);
+            done += n;
+        }
+    }
+    xSemaphoreGive(store->lock);
+    return done;
+}
+
+size_t audio_clip_store_read(audio_clip_store_t *store, uint32_t id, size_t offset, int16_t *out, size_t count) {
+    size_t done = 0;
+
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    audio_clip_store_clip_t *clip = store_find(store, id);
+    if (clip != NULL && offset + count <= clip->samples) {
+        while (done < count) {
+            size_t pos = offset + done;
+            size_t in_slab = pos % AUDIO_CLIP_STORE_SLAB_SAMPLES;
+            size_t n = AUDIO_CLIP_STORE_SLAB_SAMPLES - in_slab;
+            if (n > count - done) {
+                n = count - done;
+            }
+            uint16_t slab = store_slab(store, clip, pos / AUDIO_CLIP_STORE_SLAB_SAMPLES);
+            audio_unpack12(store->slabs + (size_t)slab * AUDIO_CLIP_STORE_SLAB_BYTES, in_slab, out + done, n);
+            done += n;
+        }
+    }
+    xSemaphoreGive(store->lock);
+    return done;
+}
+
+bool audio_clip_store_get(audio_clip_store_t *store, uint32_t id, audio_clip_store_clip_t *clip) {
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    audio_clip_store_clip_t *found = store_find(store, id);
+    if (found != NULL) {
+        *clip = *found;
+    }
+    xSemaphoreGive(store->lock);
+    return found != NULL;
+}
+
+void audio_clip_store_free(audio_clip_store_t *store, uint32_t id) {
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    audio_clip_store_clip_t *clip = store_find(store, id);
+    if (clip != NULL) {
+        store_release(store, clip);
+    }
+    xSemaphoreGive(store->lock);
+}
+
+void audio_clip_store_stats(audio_clip_store_t *store, audio_clip_store_stats_t *stats) {
+    xSemaphoreTake(store->lock, portMAX_DELAY);
+    *stats = (audio_clip_store_stats_t){
+        .slabs_used = store->slab_count - store->free_count,
+        .slabs_total = store->slab_count,
+        .evictions = store->evictions,
+    };
+    for (size_t i = 0; i < AUDIO_CLIP_STORE_MAX_CLIPS; ++i) {
+        if (store->clips[i].id != 0) {
+            stats->clips++;
+            stats->samples += store->clips[i].samples;
+        }
+    }
+    xSemaphoreGive(store->lock);
+}
+
+size_t audio_clip_store_read_source(void *ctx, size_t offset, int16_t *out, size_t count) {
+    const audio_clip_store_reader_t *reader = ctx;
+    return audio_clip_store_read(reader->store, reader->id, offset, out, count);
+}
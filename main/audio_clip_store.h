@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "audio_pack12.h"
+#include "audio_upload.h"
+
+// Clips held in one fixed arena (PSRAM) cut into equal slabs, so storing a
+// clip never calls malloc and freeing one cannot fragment anything. A clip
+// is a chain of slabs of packed 12-bit samples; free slabs form a list, so
+// each slab is taken or returned in O(1) and a whole clip is freed by
+// splicing its chain back. When the arena or the clip table is full the
+// oldest clip is evicted. All calls are thread safe.
+
+#define AUDIO_CLIP_STORE_SLAB_SAMPLES 2048  // 128 ms at 16kHz
+#define AUDIO_CLIP_STORE_SLAB_BYTES AUDIO_PACK12_BYTES(AUDIO_CLIP_STORE_SLAB_SAMPLES)
+#define AUDIO_CLIP_STORE_MAX_CLIPS 32       // Clips held at once
+#define AUDIO_CLIP_STORE_NO_SLAB UINT16_MAX
+
+// A stored clip. `id` is 0 for a free slot.
+typedef struct {
+    uint32_t id;
+    uint32_t samples;
+    uint16_t first_slab;
+    uint16_t last_slab;
+    uint16_t slab_count;
+    uint16_t cached_slab;       // Last slab accessed and its place in the chain, so
+    uint16_t cached_index;      // sequential reads and writes do not walk it
+    size_t range_count;
+    audio_upload_range_t ranges[AUDIO_UPLOAD_MAX_RANGES];
+} audio_clip_store_clip_t;
+
+typedef struct {
+    uint8_t *slabs;                     // slab_count * AUDIO_CLIP_STORE_SLAB_BYTES
+    uint16_t *links;                    // Per slab: next in its clip or in the free list
+    audio_clip_store_clip_t *clips;     // AUDIO_CLIP_STORE_MAX_CLIPS slots; clip id n is in slot n % MAX
+    uint16_t slab_count;
+    uint16_t free_head;
+    uint16_t free_count;
+    uint32_t next_id;                   // Ids only grow, so the smallest live one is the oldest
+    uint32_t oldest_id;
+    uint32_t evictions;
+    SemaphoreHandle_t lock;
+} audio_clip_store_t;
+
+// Occupancy. Slabs are all the same size, so the only waste is the unused
+// tail of each clip's last slab.
+typedef struct {
+    uint32_t clips;
+    uint32_t slabs_used;
+    uint32_t slabs_total;
+    uint32_t samples;           // Held in the used slabs
+    uint32_t evictions;         // Clips dropped to make room, ever
+} audio_clip_store_stats_t;
+
+// Take `arena` (arena_bytes, e.g. PSRAM) for slabs and clip slots. The small
+// slab link table is allocated from internal RAM.
+esp_err_t audio_clip_store_init(audio_clip_store_t *store, void *arena, size_t arena_bytes);
+
+// Free the link table and lock. The arena is the caller's.
+void audio_clip_store_deinit(audio_clip_store_t *store);
+
+// Reserve room for `samples` samples in the given stream ranges, evicting
+// the oldest clips if needed. ESP_ERR_NO_MEM if the clip is larger than
+// the whole arena.
+esp_err_t audio_clip_store_alloc(audio_clip_store_t *store, uint32_t samples, const audio_upload_range_t *ranges,
+                                 size_t range_count, uint32_t *id);
+
+// Write or read samples [offset, offset + count) of a clip. Return the
+// samples copied: 0 if the clip has been evicted or freed.
+size_t audio_clip_store_write(audio_clip_store_t *store, uint32_t id, size_t offset, const int16_t *in,
+                              size_t count);
+size_t audio_clip_store_read(audio_clip_store_t *store, uint32_t id, size_t offset, int16_t *out, size_t count);
+
+// Copy of the clip's descriptor. False if it is no longer stored.
+bool audio_clip_store_get(audio_clip_store_t *store, uint32_t id, audio_clip_store_clip_t *clip);
+
+// Return the clip's slabs. Freeing an evicted clip does nothing.
+void audio_clip_store_free(audio_clip_store_t *store, uint32_t id);
+
+void audio_clip_store_stats(audio_clip_store_t *store, audio_clip_store_stats_t *stats);
+
+// audio_upload_source_t reader; ctx is an audio_clip_store_reader_t
+typedef struct {
+    audio_clip_store_t *store;
+    uint32_t id;
+} audio_clip_store_reader_t;
+
+size_t audio_clip_store_read_source(void *ctx, size_t offset, int16_t *out, size_t count);
@@ -0,0 +1,217 @@
+#include <string.h>
+#include "audio_codec.h"
+
+#define ULAW_BIAS 0x84
+#define ULAW_CLIP 32635
+
+// mu-law byte -> PCM, so decoding is one load per sample
+static const int16_t ulaw_decode_table[256] = {
+    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+    -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+    -15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+    -11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316,
+    -7932, -7676, -7420, -7164, -6908, -6652, -6396, -6140,
+    -5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092,
+    -3900, -3772, -3644, -3516, -3388, -3260, -3132, -3004,
+    -2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980,
+    -1884, -1820, -1756, -1692, -1628, -1564, -1500, -1436,
+    -1372, -1308, -1244, -1180, -1116, -1052, -988, -924,
+    -876, -844, -812, -780, -748, -716, -684, -652,
+    -620, -588, -556, -524, -492, -460, -428, -396,
+    -372, -356, -340, -324, -308, -292, -276, -260,
+    -244, -228, -212, -196, -180, -164, -148, -132,
+    -120, -112, -104, -96, -88, -80, -72, -64,
+    -56, -48, -40, -32, -24, -16, -8, 0,
+    32124, 31100, 30076, 29052, 28028, 27004, 25980, 24956,
+    23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764,
+    15996, 15484, 14972, 14460, 13948, 13436, 12924, 12412,
+    11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316,
+    7932, 7676, 7420, 7164, 6908, 6652, 6396, 6140,
+    5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092,
+    3900, 3772, 3644, 3516, 3388, 3260, 3132, 3004,
+    2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980,
+    1884, 1820, 1756, 1692, 1628, 1564, 1500, 1436,
+    1372, 1308, 1244, 1180, 1116, 1052, 988, 924,
+    876, 844, 812, 780, 748, 716, 684, 652,
+    620, 588, 556, 524, 492, 460, 428, 396,
+    372, 356, 340, 324, 308, 292, 276, 260,
+    244, 228, 212, 196, 180, 164, 148, 132,
+    120, 112, 104, 96, 88, 80, 72, 64,
+    56, 48, 40, 32, 24, 16, 8, 0,
+};
+
+static const int8_t ima_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t ima_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static inline uint8_t ulaw_encode_sample(int16_t pcm) {
+    int sign = (pcm < 0) ? 0x80 : 0;
+    int mag = sign ? -(int)pcm : pcm;
+    if (mag > ULAW_CLIP) {
+        mag = ULAW_CLIP;
+    }
+    mag += ULAW_BIAS;
+
+    // Segment = position of the top bit above bit 7
+    int exponent = (31 - __builtin_clz(mag)) - 7;
+    int mantissa = (mag >> (exponent + 3)) & 0x0F;
+    return ~(sign | (exponent << 4) | mantissa);
+}
+
+static inline int clamp_index(int index) {
+    return index < 0 ? 0 : (index > 88 ? 88 : index);
+}
+
+static inline int clamp_pcm(int value) {
+    return value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+}
+
+// Reconstruct the predictor the same way on both sides
+static inline int ima_apply(int predictor, int step, uint8_t nibble) {
+    int diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    return clamp_pcm((nibble & 8) ? predictor - diff : predictor + diff);
+}
+
+static inline uint8_t ima_encode_sample(int *predictor, int *index, int16_t pcm) {
+    int step = ima_step_table[*index];
+    int diff = pcm - *predictor;
+    uint8_t nibble = 0;
+
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        nibble |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        nibble |= 1;
+    }
+
+    *predictor = ima_apply(*predictor, step, nibble);
+    *index = clamp_index(*index + ima_index_table[nibble]);
+    return nibble;
+}
+
+size_t audio_codec_frame_bytes(audio_codec_t codec, size_t samples) {
+    switch (codec) {
+    case AUDIO_CODEC_ULAW:
+        return samples;
+    case AUDIO_CODEC_IMA_ADPCM:
+        // First sample travels in the header, the rest two per byte
+        return AUDIO_CODEC_ADPCM_HEADER_BYTES + samples / 2;
+    case AUDIO_CODEC_PCM16:
+    default:
+        return samples * sizeof(int16_t);
+    }
+}
+
+size_t audio_codec_encode(audio_codec_t codec, audio_codec_state_t *state, const int16_t *pcm, size_t samples,
+                          uint8_t *out) {
+    if (codec == AUDIO_CODEC_ULAW) {
+        for (size_t i = 0; i < samples; ++i) {
+            out[i] = ulaw_encode_sample(pcm[i]);
+        }
+        return samples;
+    }
+
+    if (codec == AUDIO_CODEC_IMA_ADPCM) {
+        if (samples == 0) {
+            return 0;
+        }
+        int predictor = pcm[0];
+        int index = clamp_index(state->step_index);
+        out[0] = (uint8_t)(predictor & 0xFF);
+        out[1] = (uint8_t)((predictor >> 8) & 0xFF);
+        out[2] = (uint8_t)index;
+        out[3] = 0;
+
+        uint8_t *packed = out + AUDIO_CODEC_ADPCM_HEADER_BYTES;
+        size_t i = 1;
+        for (; i + 1 < samples; i += 2) {
+            uint8_t lo = ima_encode_sample(&predictor, &index, pcm[i]);
+            uint8_t hi = ima_encode_sample(&predictor, &index, pcm[i + 1]);
+            *packed++ = lo | (hi << 4);
+        }
+        if (i < samples) {
+            *packed++ = ima_encode_sample(&predictor, &index, pcm[i]);
+        }
+        state->step_index = (uint8_t)index;
+        return packed - out;
+    }
+
+    memcpy(out, pcm, samples * sizeof(int16_t));
+    return samples * sizeof(int16_t);
+}
+
+size_t audio_codec_decode(audio_codec_t codec, const uint8_t *in, size_t samples, int16_t *pcm) {
+    if (codec == AUDIO_CODEC_ULAW) {
+        for (size_t i = 0; i < samples; ++i) {
+            pcm[i] = ulaw_decode_table[in[i]];
+        }
+        return samples;
+    }
+
+    if (codec == AUDIO_CODEC_IMA_ADPCM) {
+        if (samples == 0) {
+            return 0;
+        }
+        int predictor = (int16_t)(in[0] | (in[1] << 8));
+        int index = clamp_index(in[2]);
+        const uint8_t *packed = in + AUDIO_CODEC_ADPCM_HEADER_BYTES;
+
+        pcm[0] = (int16_t)predictor;
+        for (size_t i = 1; i < samples; ++i) {
+            uint8_t nibble = ((i - 1) & 1) ? (*packed++ >> 4) : (*packed & 0x0F);
+            predictor = ima_apply(predictor, ima_step_table[index], nibble);
+            index = clamp_index(index + ima_index_table[nibble]);
+            pcm[i] = (int16_t)predictor;
+        }
+        return samples;
+    }
+
+    memcpy(pcm, in, samples * sizeof(int16_t));
+    return samples;
+}
+
+const char *audio_codec_name(audio_codec_t codec) {
+    switch (codec) {
+    case AUDIO_CODEC_ULAW:
+        return "ulaw";
+    case AUDIO_CODEC_IMA_ADPCM:
+        return "ima-adpcm";
+    case AUDIO_CODEC_PCM16:
+    default:
+        return "pcm16";
+    }
+}
+
+void audio_codec_adc_to_pcm(int16_t *samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = (int16_t)((samples[i] - 2048) * 16);
+    }
+}
+
+void audio_codec_pcm_to_adc(int16_t *samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = (int16_t)((samples[i] >> 4) + 2048);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compression applied to frames before storage or upload
+typedef enum {
+    AUDIO_CODEC_PCM16,      // Raw samples, 2 bytes each
+    AUDIO_CODEC_ULAW,       // G.711 mu-law, 1 byte per sample
+    AUDIO_CODEC_IMA_ADPCM,  // 4 bits per sample plus a 4-byte header per frame
+} audio_codec_t;
+
+#define AUDIO_CODEC_ADPCM_HEADER_BYTES 4
+
+// Encoder state carried from frame to frame (ADPCM step size)
+typedef struct {
+    uint8_t step_index;
+} audio_codec_state_t;
+
+// Bytes needed to encode one frame of `samples` samples
+size_t audio_codec_frame_bytes(audio_codec_t codec, size_t samples);
+
+// Encode one frame of signed 16-bit PCM. Each frame is self-contained
+// (ADPCM frames carry their starting predictor and step), so frames can be
+// decoded in any order. Returns bytes written.
+size_t audio_codec_encode(audio_codec_t codec, audio_codec_state_t *state, const int16_t *pcm, size_t samples,
+                          uint8_t *out);
+
+// Decode one frame produced by audio_codec_encode. Returns samples written.
+size_t audio_codec_decode(audio_codec_t codec, const uint8_t *in, size_t samples, int16_t *pcm);
+
+const char *audio_codec_name(audio_codec_t codec);
+
+// 12-bit unsigned ADC readings <-> signed 16-bit PCM, in place
+void audio_codec_adc_to_pcm(int16_t *samples, size_t count);
+void audio_codec_pcm_to_adc(int16_t *samples, size_t count);
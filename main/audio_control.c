@@ -0,0 +1,36 @@
+#include "audio_control.h"
+
+void audio_control_init(audio_control_t *control) {
+    *control = (audio_control_t){0};
+}
+
+uint32_t audio_control_handle(audio_control_t *control, const audio_event_t *event) {
+    switch (event->type) {
+    case AUDIO_EVENT_PRESS:
+        if (event->button == AUDIO_HAL_BUTTON_RECORD && !control->recording) {
+            control->recording = true;
+            control->record_start_us = event->timestamp_us;
+            return AUDIO_CONTROL_START_RECORDING;
+        }
+        // One playback at a time; presses while playing are ignored
+        if (event->button == AUDIO_HAL_BUTTON_PLAYBACK && !control->playing) {
+            control->playing = true;
+            return AUDIO_CONTROL_START_PLAYBACK;
+        }
+        return 0;
+
+    case AUDIO_EVENT_RELEASE:
+        // Record is hold-to-talk; playback runs to the end of the clip
+        if (event->button == AUDIO_HAL_BUTTON_RECORD && control->recording) {
+            control->recording = false;
+            control->record_stop_us = event->timestamp_us;
+            return AUDIO_CONTROL_STOP_RECORDING;
+        }
+        return 0;
+
+    case AUDIO_EVENT_PLAYBACK_DONE:
+        control->playing = false;
+        return 0;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "audio_events.h"
+
+// Record/playback state driven by button events. Pure logic with no RTOS or
+// hardware calls: the control task carries out the returned actions, and a
+// host program can feed it scripted events.
+typedef struct {
+    bool recording;
+    bool playing;
+    int64_t record_start_us;    // Press that started the current recording
+    int64_t record_stop_us;     // Release that ended the last recording
+} audio_control_t;
+
+// Actions for the caller, OR-ed together
+#define AUDIO_CONTROL_START_RECORDING (1u << 0)
+#define AUDIO_CONTROL_STOP_RECORDING  (1u << 1)
+#define AUDIO_CONTROL_START_PLAYBACK  (1u << 2)
+
+void audio_control_init(audio_control_t *control);
+
+// Apply one event; returns the actions it calls for. LEDs follow
+// `recording` and `playing`.
+uint32_t audio_control_handle(audio_control_t *control, const audio_event_t *event);
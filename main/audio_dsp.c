@@ -0,0 +1,225 @@
+#include <string.h>
+#include <math.h>
+#include "sdkconfig.h"
+#include "audio_dsp.h"
+
+// Defining DSP_HAVE_SSE2=0 builds the target's kernels on the host, for testing
+#ifndef DSP_HAVE_SSE2
+#if CONFIG_IDF_TARGET_LINUX && defined(__x86_64__)
+#define DSP_HAVE_SSE2 1
+#else
+#define DSP_HAVE_SSE2 0
+#endif
+#endif
+#if DSP_HAVE_SSE2
+#include <immintrin.h>
+#endif
+
+// Kaiser-windowed sinc (beta 6), cutoff at half the output rate, rounded to
+// Q15 with the DC gain trimmed to exactly 1. Only the first half is stored.
+static const int16_t s_taps_x2[48 / 2] = {
+    -5, -9, 16, 25, -37, -52, 71, 95, -125, -161, 205, 257,
+    -320, -396, 488, 600, -739, -917, 1152, 1481, -1983, -2860, 4863, 14735,
+};
+
+static const int16_t s_taps_x4[96 / 2] = {
+    -1, -4, -6, -3, 4, 13, 16, 8, -10, -28, -33, -16, 19, 52, 60, 29,
+    -33, -90, -102, -47, 53, 145, 162, 75, -83, -224, -249, -114, 127, 339, 375, 172,
+    -191, -512, -570, -263, 295, 802, 908, 430, -497, -1408, -1689, -866, 1124, 3826, 6408, 7981,
+};
+
+#if DSP_HAVE_SSE2
+
+// Host: pmaddwd does eight 16x16 multiplies and pairwise adds at a time, so
+// the full kernel beats folding the symmetric halves. n is a multiple of 8.
+static int32_t dsp_dot(const int16_t *x, const int16_t *taps, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i xs = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i hs = _mm_loadu_si128((const __m128i *)(taps + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(xs, hs));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+static int32_t dsp_fir(const int16_t *x, const int16_t *taps, size_t n) {
+    return dsp_dot(x, taps, n);
+}
+
+#else
+
+static int32_t dsp_dot(const int16_t *x, const int16_t *taps, size_t n) {
+    int32_t acc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += x[i] * taps[i];
+    }
+    return acc;
+}
+
+// Target: the two samples sharing each coefficient are added first
+// (centred 12-bit values cannot overflow int16), halving the MUL16S count.
+static int32_t dsp_fir(const int16_t *x, const int16_t *taps, size_t n) {
+    int32_t acc = 0;
+    for (size_t i = 0; i < n / 2; ++i) {
+        int16_t pair = x[i] + x[n - 1 - i];
+        acc += pair * taps[i];
+    }
+    return acc;
+}
+
+#endif
+
+esp_err_t audio_dsp_decimator_init(audio_dsp_decimator_t *decimator, size_t factor) {
+    const int16_t *half;
+
+    memset(decimator, 0, sizeof(*decimator));
+    decimator->factor = factor;
+    switch (factor) {
+    case 1:
+        return ESP_OK;
+    case 2:
+        half = s_taps_x2;
+        decimator->tap_count = 2 * sizeof(s_taps_x2) / sizeof(s_taps_x2[0]);
+        break;
+    case 4:
+        half = s_taps_x4;
+        decimator->tap_count = 2 * sizeof(s_taps_x4) / sizeof(s_taps_x4[0]);
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < decimator->tap_count / 2; ++i) {
+        decimator->taps[i] = half[i];
+        decimator->taps[decimator->tap_count - 1 - i] = half[i];
+    }
+    return ESP_OK;
+}
+
+size_t audio_dsp_decimate(audio_dsp_decimator_t *decimator, const int16_t *in, size_t count, int16_t *out) {
+    if (decimator->factor == 1) {
+        memmove(out, in, count * sizeof(int16_t));
+        return count;
+    }
+
+    // history: the last tap_count - 1 inputs, then this block
+    size_t keep = decimator->tap_count - 1;
+    memcpy(decimator->history + keep, in, count * sizeof(int16_t));
+
+    size_t outputs = count / decimator->factor;
+    for (size_t i = 0; i < outputs; ++i) {
+        // Window ending on the last input of this output's period
+        const int16_t *window = decimator->history + (i + 1) * decimator->factor - 1;
+        int32_t acc = dsp_fir(window, decimator->taps, decimator->tap_count);
+        out[i] = (int16_t)((acc + (1 << 14)) >> 15);
+    }
+
+    memmove(decimator->history, decimator->history + count, keep * sizeof(int16_t));
+    return outputs;
+}
+
+void audio_dsp_dc_blocker_init(audio_dsp_dc_blocker_t *blocker) {
+    blocker->acc = 0;
+    blocker->primed = false;
+}
+
+void audio_dsp_dc_block(audio_dsp_dc_blocker_t *blocker, int16_t *samples, size_t count) {
+    if (count > 0 && !blocker->primed) {
+        // Start from the first reading so the bias does not ring in as a step
+        blocker->prev = samples[0];
+        blocker->primed = true;
+    }
+
+    int32_t acc = blocker->acc;
+    int16_t prev = blocker->prev;
+    for (size_t i = 0; i < count; ++i) {
+        int16_t x = samples[i];
+        acc += ((int32_t)(x - prev) << 8) - ((acc + 128) >> 8);
+        prev = x;
+        samples[i] = (int16_t)((acc + 128) >> 8);
+    }
+    blocker->acc = acc;
+    blocker->prev = prev;
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static float dsp_bessel_i0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; ++k) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+esp_err_t audio_dsp_resampler_init(audio_dsp_resampler_t *resampler, uint32_t step) {
+    const int half = AUDIO_DSP_RESAMPLE_TAPS / 2;
+    const float beta = 6.0f;
+
+    if (step < AUDIO_DSP_RESAMPLE_ONE / 2 || step > 2 * AUDIO_DSP_RESAMPLE_ONE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(resampler, 0, sizeof(*resampler));
+    resampler->step = step;
+    resampler->pos = (uint32_t)(AUDIO_DSP_RESAMPLE_TAPS - 1) << 16; // First output on the first input
+
+    // Cutoff in cycles per input sample; speeding up lowers it so the
+    // octave folded down by skipping samples is removed first
+    float cutoff = 0.45f * (step > AUDIO_DSP_RESAMPLE_ONE ? (float)AUDIO_DSP_RESAMPLE_ONE / step : 1.0f);
+    float window_scale = 1.0f / dsp_bessel_i0(beta);
+
+    // Phase p: output p / PHASES of a sample after input `half - 1` of the window
+    for (int p = 0; p < AUDIO_DSP_RESAMPLE_PHASES; ++p) {
+        float h[AUDIO_DSP_RESAMPLE_TAPS];
+        float sum = 0.0f;
+        for (int k = 0; k < AUDIO_DSP_RESAMPLE_TAPS; ++k) {
+            float d = k - (half - 1) - (float)p / AUDIO_DSP_RESAMPLE_PHASES;
+            float x = 2.0f * cutoff * d;
+            float sinc = d == 0.0f ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+            float r = d / half;
+            float window = r * r < 1.0f ? dsp_bessel_i0(beta * sqrtf(1.0f - r * r)) * window_scale : 0.0f;
+            h[k] = sinc * window;
+            sum += h[k];
+        }
+
+        // Q15, with the rounding error put on the largest tap
+        int32_t total = 0;
+        int centre = 0;
+        for (int k = 0; k < AUDIO_DSP_RESAMPLE_TAPS; ++k) {
+            resampler->taps[p][k] = (int16_t)lrintf(h[k] / sum * 32768.0f);
+            total += resampler->taps[p][k];
+            if (resampler->taps[p][k] > resampler->taps[p][centre]) {
+                centre = k;
+            }
+        }
+        resampler->taps[p][centre] += 32768 - total;
+    }
+    return ESP_OK;
+}
+
+size_t audio_dsp_resample(audio_dsp_resampler_t *resampler, const int16_t *in, size_t count, int16_t *out) {
+    const uint32_t keep = AUDIO_DSP_RESAMPLE_TAPS - 1;
+    const uint32_t half = AUDIO_DSP_RESAMPLE_TAPS / 2;
+    uint32_t pos = resampler->pos;
+    uint32_t end = keep + count;
+    size_t outputs = 0;
+
+    // history: the last TAPS - 1 inputs, then this block. An output at index
+    // i needs inputs i - half + 1 .. i + half.
+    memcpy(resampler->history + keep, in, count * sizeof(int16_t));
+    while ((pos >> 16) + half < end) {
+        const int16_t *window = resampler->history + (pos >> 16) - (half - 1);
+        const int16_t *taps = resampler->taps[(pos & 0xFFFF) / (0x10000 / AUDIO_DSP_RESAMPLE_PHASES)];
+        int32_t acc = dsp_dot(window, taps, AUDIO_DSP_RESAMPLE_TAPS);
+        acc = (acc + (1 << 14)) >> 15;
+        out[outputs++] = (int16_t)(acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc);
+        pos += resampler->step;
+    }
+
+    memmove(resampler->history, resampler->history + count, keep * sizeof(int16_t));
+    resampler->pos = pos - ((uint32_t)count << 16);
+    return outputs;
+}
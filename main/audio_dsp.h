@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Fixed-point conditioning for ADC readings. Samples are centred 12-bit
+// values (reading - 2048); coefficients are Q15.
+
+#define AUDIO_DSP_MAX_TAPS 96
+#define AUDIO_DSP_MAX_BLOCK 512     // Input samples per decimate call
+
+// Anti-alias low-pass and decimation for an oversampled ADC. Factor 2 (e.g.
+// 32 -> 16 kHz) uses 48 taps, factor 4 (32 -> 8 kHz) 96 taps: passband flat
+// to 0.4 of the output rate, at least 64 dB down from where aliases would
+// land in it. Only every factor-th output is computed.
+typedef struct {
+    int16_t taps[AUDIO_DSP_MAX_TAPS];   // Symmetric (linear phase)
+    size_t tap_count;
+    size_t factor;
+    int16_t history[AUDIO_DSP_MAX_TAPS - 1 + AUDIO_DSP_MAX_BLOCK];
+} audio_dsp_decimator_t;
+
+// Factor 1, 2 or 4. Factor 1 passes samples through.
+esp_err_t audio_dsp_decimator_init(audio_dsp_decimator_t *decimator, size_t factor);
+
+// Filter `count` inputs (a multiple of the factor, at most
+// AUDIO_DSP_MAX_BLOCK) into count / factor outputs. `out` may alias `in`.
+size_t audio_dsp_decimate(audio_dsp_decimator_t *decimator, const int16_t *in, size_t count, int16_t *out);
+
+// Variable-rate polyphase resampler, e.g. for playing audio faster or
+// slower at a fixed DAC rate. Output n is the input interpolated at
+// n * step / AUDIO_DSP_RESAMPLE_ONE input samples. Each of the phases is a
+// Kaiser-windowed sinc (beta 6) cut off at 0.45 of the lower of the input
+// and output rates, designed at init and trimmed to unity DC gain. Output
+// lags input by half the taps, so feed AUDIO_DSP_RESAMPLE_TAPS / 2 zeros
+// after the last sample to flush it.
+#define AUDIO_DSP_RESAMPLE_ONE 0x10000      // step for the input rate (Q16)
+#define AUDIO_DSP_RESAMPLE_TAPS 16
+#define AUDIO_DSP_RESAMPLE_PHASES 128       // Timing resolution 1/128 input sample
+
+typedef struct {
+    int16_t taps[AUDIO_DSP_RESAMPLE_PHASES][AUDIO_DSP_RESAMPLE_TAPS];
+    uint32_t step;      // Input samples per output, Q16
+    uint32_t pos;       // Next output, Q16 index into history
+    int16_t history[AUDIO_DSP_RESAMPLE_TAPS - 1 + AUDIO_DSP_MAX_BLOCK];
+} audio_dsp_resampler_t;
+
+// step from AUDIO_DSP_RESAMPLE_ONE / 2 (half speed) to 2 * ONE (double)
+esp_err_t audio_dsp_resampler_init(audio_dsp_resampler_t *resampler, uint32_t step);
+
+// Consume `count` inputs (at most AUDIO_DSP_MAX_BLOCK) and return the
+// outputs now due: at most count * ONE / step + 1. `out` must not alias `in`.
+size_t audio_dsp_resample(audio_dsp_resampler_t *resampler, const int16_t *in, size_t count, int16_t *out);
+
+// One-pole DC-blocking high-pass, y[n] = x[n] - x[n-1] + (1 - 2^-8) y[n-1]:
+// about 10 Hz corner at 16 kHz. The fraction of y is carried so the output
+// settles at zero rather than a rounding offset.
+typedef struct {
+    int32_t acc;        // y in Q8
+    int16_t prev;       // x[n-1]
+    bool primed;        // prev holds a real reading
+} audio_dsp_dc_blocker_t;
+
+void audio_dsp_dc_blocker_init(audio_dsp_dc_blocker_t *blocker);
+
+// In place
+void audio_dsp_dc_block(audio_dsp_dc_blocker_t *blocker, int16_t *samples, size_t count);
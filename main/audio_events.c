@@ -0,0 +1,155 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "audio_events.h"
+
+// Debounce state of one button. The first edge after a quiet period is
+// taken at once, so a press costs no latency; edges inside the window after
+// it are bounce. If bouncing left the contact at the other level, that level
+// is picked up once the button has been quiet for a whole window.
+typedef struct {
+    bool pressed;           // Last level reported as an event
+    int64_t accepted_us;    // Time of that event
+    int64_t last_edge_us;   // Time of the latest raw edge
+    bool settle;            // An edge was rejected; recheck the level when quiet
+} events_button_t;
+
+// Queued when an edge is rejected, so a task waiting with no timeout wakes to
+// schedule the settle check; never handed out
+#define EVENTS_WAKE ((audio_event_type_t)(AUDIO_EVENT_PLAYBACK_DONE + 1))
+
+static events_button_t s_buttons[AUDIO_HAL_BUTTON_COUNT];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t s_queue;
+static audio_events_hook_t s_hook;
+static void *s_hook_ctx;
+
+static void IRAM_ATTR events_on_edge(audio_hal_button_t button, bool pressed, int64_t timestamp_us, void *ctx) {
+    events_button_t *state = &s_buttons[button];
+    bool accepted = false;
+    bool wake = false;
+
+    portENTER_CRITICAL_ISR(&s_lock);
+    state->last_edge_us = timestamp_us;
+    if (pressed != state->pressed && timestamp_us - state->accepted_us >= AUDIO_EVENTS_DEBOUNCE_US) {
+        state->pressed = pressed;
+        state->accepted_us = timestamp_us;
+        state->settle = false;
+        accepted = true;
+    } else {
+        wake = !state->settle;
+        state->settle = true;
+    }
+    portEXIT_CRITICAL_ISR(&s_lock);
+
+    BaseType_t woken = pdFALSE;
+    if (accepted) {
+        audio_event_t event = {
+            .type = pressed ? AUDIO_EVENT_PRESS : AUDIO_EVENT_RELEASE,
+            .button = button,
+            .timestamp_us = timestamp_us,
+        };
+        if (s_hook != NULL) {
+            s_hook(&event, s_hook_ctx);
+        }
+        xQueueSendFromISR(s_queue, &event, &woken);
+    } else if (wake) {
+        audio_event_t event = {.type = EVENTS_WAKE};
+        xQueueSendFromISR(s_queue, &event, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// Re-read buttons that have been quiet for a window since a rejected edge.
+// Returns the ticks until the next of these checks is due.
+static TickType_t events_settle(void) {
+    TickType_t next = portMAX_DELAY;
+    int64_t now = audio_hal_time_us();
+
+    for (int button = 0; button < AUDIO_HAL_BUTTON_COUNT; ++button) {
+        events_button_t *state = &s_buttons[button];
+        audio_event_t event;
+        bool changed = false;
+
+        portENTER_CRITICAL(&s_lock);
+        if (state->settle) {
+            int64_t quiet_us = now - state->last_edge_us;
+            if (quiet_us < AUDIO_EVENTS_DEBOUNCE_US) {
+                TickType_t ticks = pdMS_TO_TICKS((AUDIO_EVENTS_DEBOUNCE_US - quiet_us) / 1000) + 1;
+                if (ticks < next) {
+                    next = ticks;
+                }
+            } else {
+                state->settle = false;
+                bool pressed = audio_hal_button_pressed(button);
+                if (pressed != state->pressed) {
+                    // The contact last moved at the final edge
+                    state->pressed = pressed;
+                    state->accepted_us = state->last_edge_us;
+                    event = (audio_event_t){
+                        .type = pressed ? AUDIO_EVENT_PRESS : AUDIO_EVENT_RELEASE,
+                        .button = button,
+                        .timestamp_us = state->last_edge_us,
+                    };
+                    changed = true;
+                }
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (changed) {
+            if (s_hook != NULL) {
+                s_hook(&event, s_hook_ctx);
+            }
+            xQueueSend(s_queue, &event, 0);
+        }
+    }
+    return next;
+}
+
+esp_err_t audio_events_init(audio_events_hook_t hook, void *ctx) {
+    s_queue = xQueueCreate(AUDIO_EVENTS_QUEUE_DEPTH, sizeof(audio_event_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_hook = hook;
+    s_hook_ctx = ctx;
+
+    // Buttons start released; one held at boot reports nothing until it is
+    // let go and pressed again
+    for (int button = 0; button < AUDIO_HAL_BUTTON_COUNT; ++button) {
+        s_buttons[button] = (events_button_t){.accepted_us = -AUDIO_EVENTS_DEBOUNCE_US};
+    }
+    return audio_hal_gpio_init(events_on_edge, NULL);
+}
+
+bool audio_events_wait(audio_event_t *event, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    while (1) {
+        TickType_t settle = events_settle();
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t remaining = 0;
+        if (timeout == portMAX_DELAY) {
+            remaining = portMAX_DELAY;
+        } else if (elapsed < timeout) {
+            remaining = timeout - elapsed;
+        }
+
+        TickType_t wait = settle < remaining ? settle : remaining;
+        if (xQueueReceive(s_queue, event, wait) == pdTRUE) {
+            if (event->type == EVENTS_WAKE) {
+                continue; // Settle check now due
+            }
+            return true;
+        }
+        if (wait == remaining) {
+            return false;
+        }
+    }
+}
+
+esp_err_t audio_events_post(const audio_event_t *event) {
+    return xQueueSend(s_queue, event, portMAX_DELAY) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
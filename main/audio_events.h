@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "audio_hal.h"
+
+#define AUDIO_EVENTS_QUEUE_DEPTH 16
+#define AUDIO_EVENTS_DEBOUNCE_US 20000  // Edges this close to an accepted one are contact bounce
+
+typedef enum {
+    AUDIO_EVENT_PRESS,
+    AUDIO_EVENT_RELEASE,
+    AUDIO_EVENT_PLAYBACK_DONE,
+} audio_event_type_t;
+
+typedef struct {
+    audio_event_type_t type;
+    audio_hal_button_t button;  // PRESS and RELEASE only
+    int64_t timestamp_us;       // audio_hal_time_us() of the edge
+} audio_event_t;
+
+// Runs for every accepted button event before it is queued: in the GPIO ISR,
+// or in audio_events_wait for a level recovered after bouncing. Keep it to
+// ISR-safe calls.
+typedef void (*audio_events_hook_t)(const audio_event_t *event, void *ctx);
+
+// Hook the button edges and create the event queue. `hook` may be NULL.
+esp_err_t audio_events_init(audio_events_hook_t hook, void *ctx);
+
+// Next event, blocking up to `timeout`. Debounced: presses and releases of a
+// button strictly alternate. Returns false on timeout.
+bool audio_events_wait(audio_event_t *event, TickType_t timeout);
+
+// Queue an event from a task (e.g. PLAYBACK_DONE)
+esp_err_t audio_events_post(const audio_event_t *event);
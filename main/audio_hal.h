@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Board access for the audio pipeline. audio_hal_esp32.c drives the real
+// ADC, DAC and GPIOs; audio_hal_linux.c simulates them for host runs:
+//
+//   AUDIO_SIM_WAV_IN    16-bit WAV fed to the ADC (silence without it); ADC
+//                       channel n reads WAV channel n, wrapping round
+//   AUDIO_SIM_WAV_OUT   16-bit WAV written with everything sent to the DAC
+//   AUDIO_SIM_TIMELINE  Button presses in simulated ms, e.g.
+//                       "record:1000-21000,playback:22000-43000,end:45000"
+//   AUDIO_SIM_SPEED     Simulated seconds per real second (default 4)
+
+#define AUDIO_HAL_ADC_TIMER_HZ 8000000 // Sample clock resolution (APB / 10)
+#define AUDIO_HAL_ADC_MAX_CHANNELS 4    // Scanned per sample period
+
+typedef enum {
+    AUDIO_HAL_BUTTON_RECORD,
+    AUDIO_HAL_BUTTON_PLAYBACK,
+    AUDIO_HAL_BUTTON_COUNT,
+} audio_hal_button_t;
+
+typedef enum {
+    AUDIO_HAL_LED_RECORD,
+    AUDIO_HAL_LED_PLAYBACK,
+    AUDIO_HAL_LED_COUNT,
+} audio_hal_led_t;
+
+// A button changed level (raw, not debounced). Runs in the GPIO ISR on target.
+typedef void (*audio_hal_edge_cb_t)(audio_hal_button_t button, bool pressed, int64_t timestamp_us, void *ctx);
+
+// New ADC readings: one scan of every channel at a time from the sample
+// timer ISR on target, a whole frame at a time on the host. With several
+// channels the readings are interleaved in pattern order. Returns true if a
+// higher-priority task was woken.
+typedef bool (*audio_hal_adc_cb_t)(const int16_t *samples, size_t count, void *ctx);
+
+typedef struct {
+    uint32_t sample_rate;       // Scans per second; must divide AUDIO_HAL_ADC_TIMER_HZ
+    int channels[AUDIO_HAL_ADC_MAX_CHANNELS];  // Scan pattern of ADC1 channels
+    size_t channel_count;
+    size_t frame_samples;       // Host: scans per callback
+    audio_hal_adc_cb_t on_samples;
+    void *ctx;
+} audio_hal_adc_config_t;
+
+// Buttons (inputs, `on_edge` for every edge) and LEDs (outputs, initially off)
+esp_err_t audio_hal_gpio_init(audio_hal_edge_cb_t on_edge, void *ctx);
+bool audio_hal_button_pressed(audio_hal_button_t button);
+
+// Clock for edge timestamps and sample timing (simulated time on the host).
+// Callable from ISRs.
+int64_t audio_hal_time_us(void);
+void audio_hal_led_set(audio_hal_led_t led, bool on);
+
+// Paced ADC sampling into `config->on_samples`. Start is callable from an
+// ISR; the first reading is one sample period after it.
+esp_err_t audio_hal_adc_init(const audio_hal_adc_config_t *config);
+esp_err_t audio_hal_adc_start(void);
+esp_err_t audio_hal_adc_stop(void);
+
+// 8-bit DAC output at exactly `sample_rate`, fed by DMA from two buffers of
+// `frame_samples` each. Write blocks only until a buffer is free, so the
+// caller refills one while the other plays.
+esp_err_t audio_hal_dac_init(uint32_t sample_rate, size_t frame_samples);
+esp_err_t audio_hal_dac_write(const uint8_t *samples, size_t count);
+
+// End of a stream: wait until everything written has played. Running dry
+// before this is an underrun.
+esp_err_t audio_hal_dac_drain(void);
+
+// Times the DAC ran out of samples mid-stream
+uint32_t audio_hal_dac_underruns(void);
@@ -0,0 +1,202 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "driver/dac_continuous.h"
+#include "driver/gptimer.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_hal.h"
+
+// Pin Definitions
+#define RECORD_BUTTON_PIN GPIO_NUM_13
+#define PLAYBACK_BUTTON_PIN GPIO_NUM_33
+#define RECORD_LED_PIN GPIO_NUM_2
+#define PLAYBACK_LED_PIN GPIO_NUM_4
+#define DAC_CHANNEL_MASK DAC_CHANNEL_MASK_CH0 // DAC_OUT1 on GPIO25
+#define DAC_DMA_BUFFERS 2
+#define DAC_WRITE_TIMEOUT_MS 1000
+
+static const char *TAG = "AudioHal";
+
+static const gpio_num_t s_button_pins[AUDIO_HAL_BUTTON_COUNT] = {RECORD_BUTTON_PIN, PLAYBACK_BUTTON_PIN};
+static const gpio_num_t s_led_pins[AUDIO_HAL_LED_COUNT] = {RECORD_LED_PIN, PLAYBACK_LED_PIN};
+
+static audio_hal_edge_cb_t s_on_edge;
+static void *s_edge_ctx;
+static audio_hal_adc_config_t s_adc_config;
+static gptimer_handle_t s_timer;
+static adc_oneshot_unit_handle_t s_adc;
+static dac_continuous_handle_t s_dac;
+static SemaphoreHandle_t s_dac_drained;
+static volatile bool s_dac_streaming;
+static volatile uint32_t s_dac_underruns;
+
+static void IRAM_ATTR hal_button_isr(void *arg) {
+    audio_hal_button_t button = (audio_hal_button_t)(intptr_t)arg;
+    s_on_edge(button, gpio_get_level(s_button_pins[button]) == 0, esp_timer_get_time(), s_edge_ctx);
+}
+
+esp_err_t audio_hal_gpio_init(audio_hal_edge_cb_t on_edge, void *ctx) {
+    s_on_edge = on_edge;
+    s_edge_ctx = ctx;
+
+    gpio_config_t button_conf = {
+        .pin_bit_mask = (1ULL << RECORD_BUTTON_PIN) | (1ULL << PLAYBACK_BUTTON_PIN),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&button_conf), TAG, "buttons");
+
+    gpio_config_t led_conf = {
+        .pin_bit_mask = (1ULL << RECORD_LED_PIN) | (1ULL << PLAYBACK_LED_PIN),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&led_conf), TAG, "leds");
+
+    // Initialize LEDs as OFF
+    for (int led = 0; led < AUDIO_HAL_LED_COUNT; ++led) {
+        gpio_set_level(s_led_pins[led], 0);
+    }
+
+    ESP_RETURN_ON_ERROR(gpio_install_isr_service(ESP_INTR_FLAG_IRAM), TAG, "isr service");
+    for (int button = 0; button < AUDIO_HAL_BUTTON_COUNT; ++button) {
+        ESP_RETURN_ON_ERROR(gpio_isr_handler_add(s_button_pins[button], hal_button_isr, (void *)(intptr_t)button),
+                            TAG, "button isr");
+    }
+    return ESP_OK;
+}
+
+bool audio_hal_button_pressed(audio_hal_button_t button) {
+    return gpio_get_level(s_button_pins[button]) == 0; // Active low
+}
+
+int64_t IRAM_ATTR audio_hal_time_us(void) {
+    return esp_timer_get_time();
+}
+
+void audio_hal_led_set(audio_hal_led_t led, bool on) {
+    gpio_set_level(s_led_pins[led], on ? 1 : 0);
+}
+
+// A hardware timer fires once per sample period and the ISR scans the
+// pattern. The continuous ADC driver would run the pattern table by DMA, but
+// on the ESP32 it needs I2S0, which the DAC holds; back-to-back conversions
+// here keep the channels of one scan a few us apart.
+static bool IRAM_ATTR hal_adc_on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *ctx) {
+    int16_t scan[AUDIO_HAL_ADC_MAX_CHANNELS];
+
+    for (size_t i = 0; i < s_adc_config.channel_count; ++i) {
+        int raw = 0;
+        adc_oneshot_read_isr(s_adc, (adc_channel_t)s_adc_config.channels[i], &raw);
+        scan[i] = (int16_t)raw;
+    }
+    return s_adc_config.on_samples(scan, s_adc_config.channel_count, s_adc_config.ctx);
+}
+
+esp_err_t audio_hal_adc_init(const audio_hal_adc_config_t *config) {
+    if (config->channel_count == 0 || config->channel_count > AUDIO_HAL_ADC_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_adc_config = *config;
+
+    adc_oneshot_unit_init_cfg_t adc_cfg = {.unit_id = ADC_UNIT_1};
+    ESP_RETURN_ON_ERROR(adc_oneshot_new_unit(&adc_cfg, &s_adc), TAG, "adc unit");
+
+    adc_oneshot_chan_cfg_t adc_channel_cfg = {
+        .bitwidth = ADC_BITWIDTH_12,
+        .atten = ADC_ATTEN_DB_12,
+    };
+    for (size_t i = 0; i < config->channel_count; ++i) {
+        ESP_RETURN_ON_ERROR(adc_oneshot_config_channel(s_adc, (adc_channel_t)config->channels[i], &adc_channel_cfg),
+                            TAG, "adc channel %d", config->channels[i]);
+    }
+
+    gptimer_config_t timer_cfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = AUDIO_HAL_ADC_TIMER_HZ,
+    };
+    ESP_RETURN_ON_ERROR(gptimer_new_timer(&timer_cfg, &s_timer), TAG, "timer");
+
+    gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count = AUDIO_HAL_ADC_TIMER_HZ / config->sample_rate,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ESP_RETURN_ON_ERROR(gptimer_set_alarm_action(s_timer, &alarm_cfg), TAG, "alarm");
+
+    gptimer_event_callbacks_t cbs = {.on_alarm = hal_adc_on_alarm};
+    ESP_RETURN_ON_ERROR(gptimer_register_event_callbacks(s_timer, &cbs, NULL), TAG, "callbacks");
+    return gptimer_enable(s_timer);
+}
+
+// gptimer control functions are ISR safe with CONFIG_GPTIMER_CTRL_FUNC_IN_IRAM
+esp_err_t IRAM_ATTR audio_hal_adc_start(void) {
+    gptimer_set_raw_count(s_timer, 0);
+    return gptimer_start(s_timer);
+}
+
+esp_err_t audio_hal_adc_stop(void) {
+    return gptimer_stop(s_timer);
+}
+
+// The DMA ran out of data: the end of a stream, or an underrun inside one
+static bool IRAM_ATTR hal_dac_on_stop(dac_continuous_handle_t handle, const dac_event_data_t *event, void *ctx) {
+    BaseType_t woken = pdFALSE;
+
+    if (s_dac_streaming) {
+        s_dac_underruns++;
+    }
+    xSemaphoreGiveFromISR(s_dac_drained, &woken);
+    return woken == pdTRUE;
+}
+
+// Continuous DAC on the I2S0 DMA (capture uses the oneshot ADC, so I2S0 is
+// free). The APLL gives the exact sample rate rather than the nearest divider.
+esp_err_t audio_hal_dac_init(uint32_t sample_rate, size_t frame_samples) {
+    s_dac_drained = xSemaphoreCreateBinary();
+    if (s_dac_drained == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    dac_continuous_config_t dac_cfg = {
+        .chan_mask = DAC_CHANNEL_MASK,
+        .desc_num = DAC_DMA_BUFFERS,
+        .buf_size = frame_samples,
+        .freq_hz = sample_rate,
+        .offset = 0,
+        .clk_src = DAC_DIGI_CLK_SRC_APLL,
+        .chan_mode = DAC_CHANNEL_MODE_SIMUL,
+    };
+    ESP_RETURN_ON_ERROR(dac_continuous_new_channels(&dac_cfg, &s_dac), TAG, "dac channels");
+
+    dac_event_callbacks_t cbs = {.on_stop = hal_dac_on_stop};
+    ESP_RETURN_ON_ERROR(dac_continuous_register_event_callback(s_dac, &cbs, NULL), TAG, "dac callbacks");
+    return dac_continuous_enable(s_dac);
+}
+
+esp_err_t audio_hal_dac_write(const uint8_t *samples, size_t count) {
+    s_dac_streaming = true;
+    xSemaphoreTake(s_dac_drained, 0); // Any earlier stop is stale once more data is queued
+    return dac_continuous_write(s_dac, (uint8_t *)samples, count, NULL, DAC_WRITE_TIMEOUT_MS);
+}
+
+esp_err_t audio_hal_dac_drain(void) {
+    s_dac_streaming = false;
+    // At most DAC_DMA_BUFFERS frames are still queued
+    return xSemaphoreTake(s_dac_drained, pdMS_TO_TICKS(DAC_WRITE_TIMEOUT_MS)) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+uint32_t audio_hal_dac_underruns(void) {
+    return s_dac_underruns;
+}
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_codec.h"
+#include "audio_wav.h"
+#include "audio_hal.h"
+
+// Host simulation of the board. Time runs AUDIO_SIM_SPEED times faster than
+// the FreeRTOS tick; the button timeline, ADC and DAC all use that clock.
+// ADC readings come from the input WAV in order, so a clip always holds a
+// contiguous run of it; press and release land on frame boundaries.
+#define HAL_SIM_MAX_PRESSES 32
+#define HAL_SIM_DEFAULT_SPEED 4
+#define HAL_SIM_MAX_FRAME 512         // Scans per callback
+#define HAL_SIM_MAX_WAV_CHANNELS 8
+
+typedef struct {
+    audio_hal_button_t button;
+    uint32_t press_ms;
+    uint32_t release_ms;
+} hal_sim_press_t;
+
+static const char *TAG = "AudioHalSim";
+
+static bool s_sim_ready;
+static uint32_t s_speed = HAL_SIM_DEFAULT_SPEED;
+static TickType_t s_start_tick;
+static hal_sim_press_t s_presses[HAL_SIM_MAX_PRESSES];
+static size_t s_press_count;
+static uint32_t s_end_ms;           // 0: run forever
+static bool s_leds[AUDIO_HAL_LED_COUNT];
+static audio_hal_edge_cb_t s_on_edge;
+static void *s_edge_ctx;
+
+static audio_hal_adc_config_t s_adc_config;
+static FILE *s_wav_in;
+static uint32_t s_wav_in_rate;
+static uint16_t s_wav_in_channels;
+static int16_t s_wav_in_held[HAL_SIM_MAX_WAV_CHANNELS]; // Input frame being repeated when the ADC runs faster
+static uint32_t s_wav_in_repeats;
+static TaskHandle_t s_adc_task;
+static atomic_bool s_adc_running;
+static uint64_t s_adc_samples;
+
+static uint32_t s_dac_rate;
+static FILE *s_wav_out;
+static SemaphoreHandle_t s_dac_lock;
+static uint32_t s_dac_bytes;
+static size_t s_dac_frame_samples;
+static uint64_t s_dac_due;          // When queued output runs out, in sample-ticks
+static bool s_dac_streaming;
+static uint32_t s_dac_underruns;
+
+static uint32_t hal_sim_now_ms(void) {
+    return (uint64_t)(xTaskGetTickCount() - s_start_tick) * 1000 * s_speed / configTICK_RATE_HZ;
+}
+
+int64_t audio_hal_time_us(void) {
+    return (int64_t)(xTaskGetTickCount() - s_start_tick) * 1000000 * s_speed / configTICK_RATE_HZ;
+}
+
+// "record:1000-21000,playback:22000-43000,end:45000"
+static void hal_sim_parse_timeline(const char *timeline) {
+    char name[16];
+    unsigned press;
+    unsigned release;
+    int used;
+
+    while (*timeline != '\0') {
+        if (sscanf(timeline, " %15[a-z]:%u-%u%n", name, &press, &release, &used) == 3) {
+            audio_hal_button_t button = strcmp(name, "record") == 0 ? AUDIO_HAL_BUTTON_RECORD
+                                        : strcmp(name, "playback") == 0 ? AUDIO_HAL_BUTTON_PLAYBACK
+                                        : AUDIO_HAL_BUTTON_COUNT;
+            if (button == AUDIO_HAL_BUTTON_COUNT || s_press_count == HAL_SIM_MAX_PRESSES) {
+                ESP_LOGW(TAG, "Ignoring timeline entry '%s'", name);
+            } else {
+                s_presses[s_press_count++] = (hal_sim_press_t){button, press, release};
+            }
+        } else if (sscanf(timeline, " end:%u%n", &press, &used) == 1) {
+            s_end_ms = press;
+        } else {
+            ESP_LOGE(TAG, "Bad timeline at '%s'", timeline);
+            return;
+        }
+        timeline += used;
+        if (*timeline == ',') {
+            timeline++;
+        }
+    }
+}
+
+static void hal_sim_open_wav_in(const char *path) {
+    uint8_t chunk[8];
+    uint8_t riff[12];
+
+    s_wav_in = fopen(path, "rb");
+    if (s_wav_in == NULL || fread(riff, 1, sizeof(riff), s_wav_in) != sizeof(riff) ||
+        memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "%s is not a WAV file", path);
+        goto fail;
+    }
+    while (fread(chunk, 1, sizeof(chunk), s_wav_in) == sizeof(chunk)) {
+        uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (s_wav_in_channels == 0) {
+                ESP_LOGE(TAG, "%s has its data chunk before the fmt chunk", path);
+                goto fail;
+            }
+            return; // Positioned at the first sample
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), s_wav_in) != sizeof(fmt)) {
+                break;
+            }
+            s_wav_in_channels = fmt[2] | fmt[3] << 8;
+            if ((fmt[0] | fmt[1] << 8) != 1 || s_wav_in_channels == 0 ||
+                s_wav_in_channels > HAL_SIM_MAX_WAV_CHANNELS || (fmt[14] | fmt[15] << 8) != 16) {
+                ESP_LOGE(TAG, "%s must be 16-bit PCM with 1 to %d channels", path, HAL_SIM_MAX_WAV_CHANNELS);
+                goto fail;
+            }
+            s_wav_in_rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            size -= sizeof(fmt);
+        }
+        fseek(s_wav_in, size + (size & 1), SEEK_CUR);
+    }
+    ESP_LOGE(TAG, "%s has no data chunk", path);
+fail:
+    if (s_wav_in != NULL) {
+        fclose(s_wav_in);
+        s_wav_in = NULL;
+    }
+}
+
+static void hal_sim_finish_wav_out(void) {
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+
+    if (s_wav_out == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_dac_lock, portMAX_DELAY);
+    size_t header_len = audio_wav_header(header, AUDIO_CODEC_PCM16, s_dac_rate, 1, s_dac_bytes);
+    fseek(s_wav_out, 0, SEEK_SET);
+    fwrite(header, 1, header_len, s_wav_out);
+    fclose(s_wav_out);
+    s_wav_out = NULL;
+    xSemaphoreGive(s_dac_lock);
+}
+
+// Ends the run once the timeline is over
+static void hal_sim_end_task(void *arg) {
+    while (hal_sim_now_ms() < s_end_ms) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    hal_sim_finish_wav_out();
+    ESP_LOGI(TAG, "Simulation ended at %lu ms: %llu samples captured, %lu played",
+             (unsigned long)s_end_ms, (unsigned long long)s_adc_samples,
+             (unsigned long)(s_dac_bytes / sizeof(int16_t)));
+    exit(0);
+}
+
+static void hal_sim_init(void) {
+    if (s_sim_ready) {
+        return;
+    }
+    s_sim_ready = true;
+    s_start_tick = xTaskGetTickCount();
+
+    const char *value = getenv("AUDIO_SIM_SPEED");
+    if (value != NULL && atoi(value) > 0) {
+        s_speed = atoi(value);
+    }
+    value = getenv("AUDIO_SIM_TIMELINE");
+    if (value != NULL) {
+        hal_sim_parse_timeline(value);
+    }
+    value = getenv("AUDIO_SIM_WAV_IN");
+    if (value != NULL) {
+        hal_sim_open_wav_in(value);
+    }
+    ESP_LOGI(TAG, "Simulating at %lux, %u button presses, input %s", (unsigned long)s_speed,
+             (unsigned)s_press_count, s_wav_in ? value : "silence");
+
+    if (s_end_ms > 0) {
+        xTaskCreate(hal_sim_end_task, "sim_end", 4096, NULL, 1, NULL);
+    }
+}
+
+static bool hal_sim_pressed_at(audio_hal_button_t button, uint32_t ms) {
+    for (size_t i = 0; i < s_press_count; ++i) {
+        if (s_presses[i].button == button && ms >= s_presses[i].press_ms && ms < s_presses[i].release_ms) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Stands in for the GPIO ISR: reports each timeline edge when simulated
+// time reaches it, stamped with the exact edge time
+static void hal_sim_edge_task(void *arg) {
+    bool level[AUDIO_HAL_BUTTON_COUNT] = {false};
+    uint32_t done = 0; // Edges before this time have been reported
+
+    while (1) {
+        // Next edge of any button
+        uint32_t next = UINT32_MAX;
+        for (size_t i = 0; i < s_press_count; ++i) {
+            uint32_t edge = level[s_presses[i].button] ? s_presses[i].release_ms : s_presses[i].press_ms;
+            if (edge >= done && edge < next) {
+                next = edge;
+            }
+        }
+        if (next == UINT32_MAX) {
+            break;
+        }
+        while (hal_sim_now_ms() < next) {
+            vTaskDelay(1);
+        }
+        for (int button = 0; button < AUDIO_HAL_BUTTON_COUNT; ++button) {
+            bool pressed = hal_sim_pressed_at(button, next);
+            if (pressed != level[button]) {
+                level[button] = pressed;
+                s_on_edge(button, pressed, (int64_t)next * 1000, s_edge_ctx);
+            }
+        }
+        done = next + 1;
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t audio_hal_gpio_init(audio_hal_edge_cb_t on_edge, void *ctx) {
+    hal_sim_init();
+    memset(s_leds, 0, sizeof(s_leds));
+    s_on_edge = on_edge;
+    s_edge_ctx = ctx;
+    if (xTaskCreate(hal_sim_edge_task, "sim_edges", 4096, NULL, 20, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool audio_hal_button_pressed(audio_hal_button_t button) {
+    return hal_sim_pressed_at(button, hal_sim_now_ms());
+}
+
+void audio_hal_led_set(audio_hal_led_t led, bool on) {
+    if (s_leds[led] != on) {
+        s_leds[led] = on;
+        ESP_LOGI(TAG, "%lu ms: %s LED %s", (unsigned long)hal_sim_now_ms(),
+                 led == AUDIO_HAL_LED_RECORD ? "record" : "playback", on ? "on" : "off");
+    }
+}
+// Input scans at the ADC rate, interleaved. An oversampling ADC (a whole
+// multiple of the WAV rate) sees each input frame held for the extra periods.
+// Returns the scans read.
+static size_t hal_sim_read_wav_in(int16_t *out, size_t scans) {
+    size_t channels = s_adc_config.channel_count;
+    uint32_t ratio = 1;
+    if (s_wav_in_rate != 0 && s_adc_config.sample_rate % s_wav_in_rate == 0) {
+        ratio = s_adc_config.sample_rate / s_wav_in_rate;
+    }
+
+    for (size_t i = 0; i < scans; ++i) {
+        if (s_wav_in_repeats == 0) {
+            if (s_wav_in == NULL ||
+                fread(s_wav_in_held, sizeof(int16_t), s_wav_in_channels, s_wav_in) != s_wav_in_channels) {
+                return i;
+            }
+            s_wav_in_repeats = ratio;
+        }
+        for (size_t c = 0; c < channels; ++c) {
+            out[i * channels + c] = s_wav_in_held[c % s_wav_in_channels];
+        }
+        s_wav_in_repeats--;
+    }
+    return scans;
+}
+
+// Frames from the input WAV on the schedule the sample timer would keep
+static void hal_sim_adc_task(void *arg) {
+    static int16_t frame[HAL_SIM_MAX_FRAME * AUDIO_HAL_ADC_MAX_CHANNELS];
+    size_t scans = s_adc_config.frame_samples;
+    size_t samples = scans * s_adc_config.channel_count;
+    TickType_t start = xTaskGetTickCount();
+    uint64_t frames = 0;
+
+    while (1) {
+        // A frame is delivered once its last sample period has passed.
+        // Scheduled from the start time so rounding never accumulates.
+        frames++;
+        TickType_t due = start + (TickType_t)(frames * scans * configTICK_RATE_HZ /
+                                              ((uint64_t)s_adc_config.sample_rate * s_speed));
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(due - now) > 0) {
+            vTaskDelay(due - now);
+        }
+        if (!atomic_load(&s_adc_running)) {
+            break;
+        }
+
+        size_t got = hal_sim_read_wav_in(frame, scans) * s_adc_config.channel_count;
+        memset(frame + got, 0, (samples - got) * sizeof(int16_t)); // Silence after the end
+        audio_codec_pcm_to_adc(frame, samples);
+        s_adc_config.on_samples(frame, samples, s_adc_config.ctx);
+        s_adc_samples += samples;
+    }
+    s_adc_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t audio_hal_adc_init(const audio_hal_adc_config_t *config) {
+    if (config->frame_samples == 0 || config->frame_samples > HAL_SIM_MAX_FRAME || config->channel_count == 0 ||
+        config->channel_count > AUDIO_HAL_ADC_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hal_sim_init();
+    s_adc_config = *config;
+    if (s_wav_in_rate != 0 && config->sample_rate % s_wav_in_rate != 0) {
+        ESP_LOGW(TAG, "ADC rate %lu Hz is not a multiple of the %lu Hz input; fed 1:1",
+                 (unsigned long)config->sample_rate, (unsigned long)s_wav_in_rate);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_hal_adc_start(void) {
+    atomic_store(&s_adc_running, true);
+    if (xTaskCreate(hal_sim_adc_task, "sim_adc", 4096, NULL, 10, &s_adc_task) != pdPASS) {
+        atomic_store(&s_adc_running, false);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_hal_adc_stop(void) {
+    atomic_store(&s_adc_running, false);
+    while (s_adc_task != NULL) {
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+// Simulated time in sample-ticks: one sample lasts configTICK_RATE_HZ of
+// them and one tick lasts sample_rate * speed, so both stay integers
+static uint64_t hal_sim_dac_now(void) {
+    return (uint64_t)(xTaskGetTickCount() - s_start_tick) * s_dac_rate * s_speed;
+}
+
+// Sleep until at most `queued` sample-ticks of output remain
+static void hal_sim_dac_wait(uint64_t queued) {
+    uint64_t per_tick = (uint64_t)s_dac_rate * s_speed;
+    uint64_t now = hal_sim_dac_now();
+    if (s_dac_due > now + queued) {
+        vTaskDelay((s_dac_due - now - queued) / per_tick); // Rounds down: wake early rather than late
+    }
+}
+
+esp_err_t audio_hal_dac_init(uint32_t sample_rate, size_t frame_samples) {
+    hal_sim_init();
+    s_dac_rate = sample_rate;
+    s_dac_frame_samples = frame_samples;
+    s_dac_lock = xSemaphoreCreateMutex();
+    if (s_dac_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const char *path = getenv("AUDIO_SIM_WAV_OUT");
+    if (path != NULL) {
+        uint8_t header[AUDIO_WAV_HEADER_MAX];
+        size_t header_len = audio_wav_header(header, AUDIO_CODEC_PCM16, sample_rate, 1, 0);
+        s_wav_out = fopen(path, "wb");
+        if (s_wav_out == NULL || fwrite(header, 1, header_len, s_wav_out) != header_len) {
+            ESP_LOGE(TAG, "Cannot write %s", path);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_hal_dac_write(const uint8_t *samples, size_t count) {
+    int16_t pcm[64];
+
+    xSemaphoreTake(s_dac_lock, portMAX_DELAY);
+    for (size_t done = 0; s_wav_out != NULL && done < count;) {
+        size_t n = count - done < 64 ? count - done : 64;
+        for (size_t i = 0; i < n; ++i) {
+            pcm[i] = (int16_t)((samples[done + i] - 128) * 256);
+        }
+        fwrite(pcm, sizeof(int16_t), n, s_wav_out);
+        s_dac_bytes += n * sizeof(int16_t);
+        done += n;
+    }
+    xSemaphoreGive(s_dac_lock);
+
+    // Queue behind what is still playing; running dry mid-stream (allowing
+    // a tick of rounding) is an underrun
+    uint64_t now = hal_sim_dac_now();
+    if (s_dac_due + (uint64_t)s_dac_rate * s_speed < now && s_dac_streaming) {
+        s_dac_underruns++;
+    }
+    if (s_dac_due < now) {
+        s_dac_due = now;
+    }
+    s_dac_due += (uint64_t)count * configTICK_RATE_HZ;
+    s_dac_streaming = true;
+
+    // Like the DMA: return once only one buffer is left queued
+    hal_sim_dac_wait((uint64_t)s_dac_frame_samples * configTICK_RATE_HZ);
+    return ESP_OK;
+}
+
+esp_err_t audio_hal_dac_drain(void) {
+    s_dac_streaming = false;
+    hal_sim_dac_wait(0);
+
+    // The output WAV holds every clip played out so far
+    xSemaphoreTake(s_dac_lock, portMAX_DELAY);
+    if (s_wav_out != NULL) {
+        fflush(s_wav_out);
+    }
+    xSemaphoreGive(s_dac_lock);
+    return ESP_OK;
+}
+
+uint32_t audio_hal_dac_underruns(void) {
+    return s_dac_underruns;
+}
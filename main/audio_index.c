@@ -0,0 +1,253 @@
+#include "audio_index.h"
+
+#define BLOCK_MASK (AUDIO_INDEX_BLOCK_SAMPLES - 1)
+
+// Floor of the square root, bit by bit
+static uint32_t index_isqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static uint8_t index_level(uint32_t amplitude) {
+    amplitude >>= AUDIO_INDEX_LEVEL_SHIFT;
+    return amplitude > UINT8_MAX ? UINT8_MAX : amplitude;
+}
+
+// Block starting at ring position `start`, or NULL if it is not complete yet
+// or its slot may be being reused for the block after `head`. Follows the
+// ring in taking positions below the capacity as never written.
+static const audio_index_block_t *index_get(const audio_index_t *index, uint32_t head, uint32_t start) {
+    uint32_t capacity = index->ring->capacity;
+    uint32_t age = head - start;
+    uint32_t limit = head < capacity ? head : capacity - 1;
+
+    if (age < AUDIO_INDEX_BLOCK_SAMPLES || age > limit) {
+        return NULL;
+    }
+    return &index->blocks[(start / AUDIO_INDEX_BLOCK_SAMPLES) & index->block_mask];
+}
+
+static bool index_pending(uint32_t head, uint32_t start) {
+    return (int32_t)(head - start) < AUDIO_INDEX_BLOCK_SAMPLES;
+}
+
+// First sample of the ring that has not been overwritten
+static uint32_t index_oldest(const audio_index_t *index) {
+    uint32_t head = audio_ring_head(index->ring);
+    return head < index->ring->capacity ? 0 : head - index->ring->capacity;
+}
+
+esp_err_t audio_index_init(audio_index_t *index, const audio_ring_t *ring, uint8_t *storage,
+                           uint32_t sample_rate) {
+    if (storage == NULL || sample_rate == 0 || ring->capacity < 2 * AUDIO_INDEX_BLOCK_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (audio_ring_head(ring) != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *index = (audio_index_t){
+        .ring = ring,
+        .blocks = (audio_index_block_t *)storage,
+        .block_mask = ring->capacity / AUDIO_INDEX_BLOCK_SAMPLES - 1,
+        .sample_rate = sample_rate,
+    };
+    atomic_init(&index->run_count, 0);
+    atomic_init(&index->head, 0);
+    return ESP_OK;
+}
+
+void audio_index_mark(audio_index_t *index, int64_t time_us) {
+    uint32_t count = atomic_load_explicit(&index->run_count, memory_order_relaxed);
+
+    index->runs[count % AUDIO_INDEX_MAX_RUNS] = (audio_index_run_t){.pos = index->pos, .time_us = time_us};
+    atomic_store_explicit(&index->run_count, count + 1, memory_order_release);
+}
+
+void audio_index_append(audio_index_t *index, const int16_t *samples, size_t count) {
+    while (count > 0) {
+        size_t n = AUDIO_INDEX_BLOCK_SAMPLES - (index->pos & BLOCK_MASK);
+        if (n > count) {
+            n = count;
+        }
+
+        uint32_t peak = index->peak;
+        uint64_t sum = index->sum_squares;
+        for (size_t i = 0; i < n; ++i) {
+            int32_t x = samples[i] - 2048;
+            uint32_t amplitude = x < 0 ? -x : x;
+            peak = amplitude > peak ? amplitude : peak;
+            sum += (uint32_t)(x * x);
+        }
+        index->pos += n;
+        samples += n;
+        count -= n;
+
+        if ((index->pos & BLOCK_MASK) == 0) {
+            uint32_t start = index->pos - AUDIO_INDEX_BLOCK_SAMPLES;
+            index->blocks[(start / AUDIO_INDEX_BLOCK_SAMPLES) & index->block_mask] = (audio_index_block_t){
+                .peak = index_level(peak),
+                .rms = index_level(index_isqrt(sum / AUDIO_INDEX_BLOCK_SAMPLES)),
+            };
+            atomic_store_explicit(&index->head, index->pos, memory_order_release);
+            peak = 0;
+            sum = 0;
+        }
+        index->peak = peak;
+        index->sum_squares = sum;
+    }
+}
+
+bool audio_index_block(const audio_index_t *index, uint32_t pos, audio_index_block_t *block) {
+    uint32_t head = atomic_load_explicit(&index->head, memory_order_acquire);
+    const audio_index_block_t *entry = index_get(index, head, pos & ~BLOCK_MASK);
+
+    if (entry == NULL) {
+        return false;
+    }
+    *block = *entry;
+    return true;
+}
+
+bool audio_index_time(const audio_index_t *index, uint32_t pos, int64_t *time_us) {
+    uint32_t count = atomic_load_explicit(&index->run_count, memory_order_acquire);
+    uint32_t oldest = count > AUDIO_INDEX_MAX_RUNS ? count - AUDIO_INDEX_MAX_RUNS : 0;
+
+    // Newest run that started at or before pos
+    for (uint32_t i = count; i-- > oldest;) {
+        const audio_index_run_t *run = &index->runs[i % AUDIO_INDEX_MAX_RUNS];
+        if ((int32_t)(pos - run->pos) >= 0) {
+            *time_us = run->time_us + (int64_t)(pos - run->pos) * 1000000 / index->sample_rate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool audio_index_seek(const audio_index_t *index, int64_t time_us, audio_ring_cursor_t *cursor) {
+    uint32_t count = atomic_load_explicit(&index->run_count, memory_order_acquire);
+    uint32_t oldest = count > AUDIO_INDEX_MAX_RUNS ? count - AUDIO_INDEX_MAX_RUNS : 0;
+    uint32_t head = audio_ring_head(index->ring);
+    uint32_t end = head;
+
+    // Newest run that started at or before time_us; a time between two
+    // recordings seeks to the start of the later one
+    for (uint32_t i = count; i-- > oldest;) {
+        const audio_index_run_t *run = &index->runs[i % AUDIO_INDEX_MAX_RUNS];
+        if (time_us >= run->time_us) {
+            int64_t offset = (time_us - run->time_us) * index->sample_rate / 1000000;
+            uint32_t pos = offset < (int64_t)(end - run->pos) ? run->pos + (uint32_t)offset : end;
+            if (pos == head || (int32_t)(pos - index_oldest(index)) < 0) {
+                return false;
+            }
+            cursor->pos = pos;
+            return true;
+        }
+        end = run->pos;
+    }
+    return false;
+}
+
+bool audio_index_last_loud(const audio_index_t *index, uint8_t min_rms, uint32_t samples,
+                           audio_ring_cursor_t *cursor) {
+    uint32_t head = atomic_load_explicit(&index->head, memory_order_acquire);
+
+    for (uint32_t start = head - AUDIO_INDEX_BLOCK_SAMPLES;; start -= AUDIO_INDEX_BLOCK_SAMPLES) {
+        const audio_index_block_t *block = index_get(index, head, start);
+        if (block == NULL) {
+            return false;
+        }
+        if (block->rms >= min_rms) {
+            uint32_t end = start + AUDIO_INDEX_BLOCK_SAMPLES;
+            uint32_t oldest = index_oldest(index);
+            cursor->pos = end - oldest < samples ? oldest : end - samples;
+            return true;
+        }
+    }
+}
+
+void audio_index_trim(const audio_index_t *index, uint8_t min_peak, audio_ring_cursor_t *cursor,
+                      uint32_t *samples) {
+    uint32_t head = atomic_load_explicit(&index->head, memory_order_acquire);
+    uint32_t start = cursor->pos;
+    uint32_t end = start + *samples;
+    uint32_t first = start & ~BLOCK_MASK;
+    uint32_t last = (end - 1) & ~BLOCK_MASK;
+
+    if (*samples == 0) {
+        return;
+    }
+
+    // Overwritten blocks count as quiet, blocks still being written as loud
+    while (1) {
+        const audio_index_block_t *block = index_get(index, head, first);
+        if (index_pending(head, first) || (block != NULL && block->peak >= min_peak)) {
+            break;
+        }
+        if (first == last) {
+            *samples = 0;
+            return;
+        }
+        first += AUDIO_INDEX_BLOCK_SAMPLES;
+    }
+    while (last != first) {
+        const audio_index_block_t *block = index_get(index, head, last);
+        if (index_pending(head, last) || (block != NULL && block->peak >= min_peak)) {
+            break;
+        }
+        last -= AUDIO_INDEX_BLOCK_SAMPLES;
+    }
+
+    if ((int32_t)(first - start) > 0) {
+        start = first;
+    }
+    if ((int32_t)(end - (last + AUDIO_INDEX_BLOCK_SAMPLES)) > 0) {
+        end = last + AUDIO_INDEX_BLOCK_SAMPLES;
+    }
+    cursor->pos = start;
+    *samples = end - start;
+}
+
+size_t audio_index_preview(const audio_index_t *index, audio_ring_cursor_t cursor, uint32_t samples,
+                           audio_index_block_t *points, size_t max) {
+    uint32_t head = atomic_load_explicit(&index->head, memory_order_acquire);
+    uint32_t first = cursor.pos & ~BLOCK_MASK;
+    uint32_t blocks = (cursor.pos + samples - first + BLOCK_MASK) / AUDIO_INDEX_BLOCK_SAMPLES;
+    size_t count = blocks < max ? blocks : max;
+
+    if (samples == 0) {
+        return 0;
+    }
+
+    // Point i covers blocks [i * blocks / count, (i + 1) * blocks / count).
+    // Blocks missing from the index read as silence.
+    uint32_t block = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t stop = (uint64_t)(i + 1) * blocks / count;
+        uint32_t peak = 0;
+        uint32_t sum = 0;
+        uint32_t n = stop - block;
+        for (; block < stop; ++block) {
+            const audio_index_block_t *entry = index_get(index, head, first + block * AUDIO_INDEX_BLOCK_SAMPLES);
+            if (entry != NULL) {
+                peak = entry->peak > peak ? entry->peak : peak;
+                sum += (uint32_t)entry->rms * entry->rms;
+            }
+        }
+        points[i] = (audio_index_block_t){.peak = peak, .rms = index_isqrt(sum / n)};
+    }
+    return count;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "audio_ring.h"
+
+// Summary of the ring in blocks of AUDIO_INDEX_BLOCK_SAMPLES: peak and RMS
+// of each block, and the time its first sample was taken. The producer feeds
+// it the same samples it writes to the ring, so it is never rebuilt from
+// PSRAM; queries walk blocks instead of samples. Blocks are indexed once
+// complete, so the last partial block is not yet visible.
+//
+// Levels are distances from mid-scale (2048) in steps of 8 LSB, so 0..255
+// covers the full 12-bit swing. Two bytes per block of 384 packed bytes is
+// 0.5% on top of the ring.
+
+#define AUDIO_INDEX_BLOCK_SAMPLES 256   // Power of two, at most the ring capacity
+#define AUDIO_INDEX_LEVEL_SHIFT 3       // Sample amplitude to level
+#define AUDIO_INDEX_MAX_RUNS 32         // Recordings whose start times are kept
+
+// Bytes of block storage for a ring of `capacity` samples
+#define AUDIO_INDEX_STORAGE_BYTES(capacity) \
+    ((capacity) / AUDIO_INDEX_BLOCK_SAMPLES * sizeof(audio_index_block_t))
+
+typedef struct {
+    uint8_t peak;
+    uint8_t rms;
+} audio_index_block_t;
+
+// Samples from `pos` on were taken continuously from `time_us`
+typedef struct {
+    uint32_t pos;
+    int64_t time_us;
+} audio_index_run_t;
+
+typedef struct {
+    const audio_ring_t *ring;
+    audio_index_block_t *blocks;    // One per block of the ring
+    uint32_t block_mask;
+    uint32_t sample_rate;
+    uint32_t pos;                   // Producer: samples seen
+    uint32_t peak;                  // Producer: block in progress
+    uint64_t sum_squares;
+    audio_index_run_t runs[AUDIO_INDEX_MAX_RUNS];
+    _Atomic uint32_t run_count;     // Free running; the oldest runs are replaced
+    _Atomic uint32_t head;          // Samples in complete, published blocks
+} audio_index_t;
+
+// Index `ring`, which must be empty. `storage` holds
+// AUDIO_INDEX_STORAGE_BYTES(ring->capacity); internal RAM keeps queries fast.
+esp_err_t audio_index_init(audio_index_t *index, const audio_ring_t *ring, uint8_t *storage,
+                           uint32_t sample_rate);
+
+// Producer: the next sample appended was taken at `time_us`
+// (audio_hal_time_us), e.g. at the start of each recording
+void audio_index_mark(audio_index_t *index, int64_t time_us);
+
+// Producer: account for samples just passed to audio_ring_write
+void audio_index_append(audio_index_t *index, const int16_t *samples, size_t count);
+
+// Block holding ring position `pos`. False if it is not indexed yet or has
+// been overwritten.
+bool audio_index_block(const audio_index_t *index, uint32_t pos, audio_index_block_t *block);
+
+// Time ring position `pos` was sampled. False if no recording start covering
+// it is known.
+bool audio_index_time(const audio_index_t *index, uint32_t pos, int64_t *time_us);
+
+// Cursor at the sample taken at `time_us`. False if it is not in the ring.
+bool audio_index_seek(const audio_index_t *index, int64_t time_us, audio_ring_cursor_t *cursor);
+
+// Cursor `samples` before the end of the last block with an RMS of at least
+// `min_rms` (e.g. "the last loud 5 seconds"). False if there is none.
+bool audio_index_last_loud(const audio_index_t *index, uint8_t min_rms, uint32_t samples,
+                           audio_ring_cursor_t *cursor);
+
+// Narrow [cursor, cursor + *samples) to whole blocks, dropping those at
+// either end whose peak is below `min_peak`. Blocks not indexed yet are kept.
+// Sets *samples to 0 if every block is quiet.
+void audio_index_trim(const audio_index_t *index, uint8_t min_peak, audio_ring_cursor_t *cursor,
+                      uint32_t *samples);
+
+// Waveform of [cursor, cursor + samples) in at most `max` points, each the
+// peak and RMS of a run of blocks. Returns the number of points.
+size_t audio_index_preview(const audio_index_t *index, audio_ring_cursor_t cursor, uint32_t samples,
+                           audio_index_block_t *points, size_t max);
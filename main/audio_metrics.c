@@ -0,0 +1,131 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_metrics.h"
+
+typedef struct {
+    _Atomic uint32_t buckets[AUDIO_METRICS_BUCKETS];
+    _Atomic uint32_t max;
+} metrics_histogram_t;
+
+// Bounded JSON writer; `len` keeps counting past the end so overflow shows
+typedef struct {
+    char *out;
+    size_t size;
+    size_t len;
+} metrics_writer_t;
+
+static const char *TAG = "AudioMetrics";
+
+static const char *const s_counter_names[AUDIO_METRIC_COUNTER_COUNT] = {
+    "capture_frames", "capture_overruns", "clip_samples", "clip_kept_samples", "playback_clips", "playback_underruns",
+    "upload_clips", "upload_failures", "upload_connections", "upload_bytes", "upload_evictions",
+    "upload_drops", "stream_rebuffers",
+};
+static const char *const s_histogram_names[AUDIO_METRIC_HISTOGRAM_COUNT] = {
+    "sample_jitter_us", "frame_latency_us", "encode_us", "http_connect_us", "http_transfer_us", "http_response_us",
+    "stream_start_us",
+};
+
+static _Atomic uint32_t s_counters[AUDIO_METRIC_COUNTER_COUNT];
+static metrics_histogram_t s_histograms[AUDIO_METRIC_HISTOGRAM_COUNT];
+static uint32_t s_period_ms;
+
+void IRAM_ATTR audio_metrics_add(audio_metric_counter_t counter, uint32_t delta) {
+    atomic_fetch_add_explicit(&s_counters[counter], delta, memory_order_relaxed);
+}
+
+void IRAM_ATTR audio_metrics_record(audio_metric_histogram_t histogram, uint32_t value) {
+    metrics_histogram_t *h = &s_histograms[histogram];
+    size_t bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+    if (bucket >= AUDIO_METRICS_BUCKETS) {
+        bucket = AUDIO_METRICS_BUCKETS - 1;
+    }
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max, &max, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void metrics_printf(metrics_writer_t *w, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->len < w->size ? w->out + w->len : NULL, w->len < w->size ? w->size - w->len : 0, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        w->len += n;
+    }
+}
+
+static void metrics_write_histogram(metrics_writer_t *w, const metrics_histogram_t *h) {
+    uint32_t buckets[AUDIO_METRICS_BUCKETS];
+    uint32_t count = 0;
+    size_t used = 0;
+
+    for (size_t i = 0; i < AUDIO_METRICS_BUCKETS; ++i) {
+        buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        count += buckets[i];
+        if (buckets[i] != 0) {
+            used = i + 1;
+        }
+    }
+    metrics_printf(w, "{\"n\":%lu,\"max\":%lu,\"b\":[", (unsigned long)count,
+                   (unsigned long)atomic_load_explicit(&h->max, memory_order_relaxed));
+    for (size_t i = 0; i < used; ++i) {
+        metrics_printf(w, i ? ",%lu" : "%lu", (unsigned long)buckets[i]);
+    }
+    metrics_printf(w, "]}");
+}
+
+size_t audio_metrics_json(char *out, size_t size) {
+    metrics_writer_t w = {.out = out, .size = size};
+
+    metrics_printf(&w, "{\"uptime_ms\":%lld,\"counters\":{", (long long)(esp_timer_get_time() / 1000));
+    for (size_t i = 0; i < AUDIO_METRIC_COUNTER_COUNT; ++i) {
+        metrics_printf(&w, "%s\"%s\":%lu", i ? "," : "", s_counter_names[i],
+                       (unsigned long)atomic_load_explicit(&s_counters[i], memory_order_relaxed));
+    }
+    metrics_printf(&w, "},\"histograms\":{");
+    for (size_t i = 0; i < AUDIO_METRIC_HISTOGRAM_COUNT; ++i) {
+        metrics_printf(&w, "%s\"%s\":", i ? "," : "", s_histogram_names[i]);
+        metrics_write_histogram(&w, &s_histograms[i]);
+    }
+    metrics_printf(&w, "},\"heap_min_free\":{\"internal\":%u,\"spiram\":%u},\"stack_min_free\":{",
+                   (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+                   (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    const char *name;
+    uint32_t min_free;
+    for (size_t i = 0; audio_tasks_stack_info(i, &name, &min_free); ++i) {
+        metrics_printf(&w, "%s\"%s\":%lu", i ? "," : "", name, (unsigned long)min_free);
+    }
+    metrics_printf(&w, "}}");
+
+    return w.len < size ? w.len : 0;
+}
+
+static void metrics_task(void *arg) {
+    static char json[AUDIO_METRICS_JSON_BYTES];
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(s_period_ms));
+        if (audio_metrics_json(json, sizeof(json)) == 0) {
+            ESP_LOGW(TAG, "Metrics exceed %d bytes", AUDIO_METRICS_JSON_BYTES);
+            continue;
+        }
+        ESP_LOGI(TAG, "%s", json);
+    }
+}
+
+esp_err_t audio_metrics_start(const audio_task_config_t *task, uint32_t period_ms) {
+    s_period_ms = period_ms;
+    return audio_tasks_create(task, metrics_task, NULL, NULL);
+}
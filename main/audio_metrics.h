@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_tasks.h"
+
+// Lock-free counters and histograms for the audio hot paths. Updates are a
+// relaxed atomic add, safe from ISRs and any core; readers may see a dump
+// that is a few updates out of step between metrics. Counters wrap at 2^32.
+//
+// Histograms have log2 buckets: bucket 0 counts zeros, bucket i values in
+// [2^(i-1), 2^i). Times are in microseconds.
+
+#define AUDIO_METRICS_BUCKETS 32
+#define AUDIO_METRICS_JSON_BYTES 2048
+
+typedef enum {
+    AUDIO_METRIC_CAPTURE_FRAMES,        // Frames delivered to the reader
+    AUDIO_METRIC_CAPTURE_OVERRUNS,      // Frames dropped because the reader fell behind
+    AUDIO_METRIC_CLIP_SAMPLES,          // Recorded
+    AUDIO_METRIC_CLIP_KEPT_SAMPLES,     // Left for storage and upload after silence trimming
+    AUDIO_METRIC_PLAYBACK_CLIPS,
+    AUDIO_METRIC_PLAYBACK_UNDERRUNS,    // DAC ran dry mid-clip
+    AUDIO_METRIC_UPLOAD_CLIPS,          // Uploaded successfully
+    AUDIO_METRIC_UPLOAD_FAILURES,       // Upload attempts that failed
+    AUDIO_METRIC_UPLOAD_CONNECTIONS,    // New connections (not kept-alive reuse)
+    AUDIO_METRIC_UPLOAD_BYTES,          // HTTP body bytes sent
+    AUDIO_METRIC_UPLOAD_EVICTIONS,      // Queued clips dropped from the clip store for newer ones
+    AUDIO_METRIC_UPLOAD_DROPS,          // Clips dropped at submit: larger than the clip store, or the queue full
+    AUDIO_METRIC_STREAM_REBUFFERS,      // Streamed playback paused because the jitter buffer ran dry
+    AUDIO_METRIC_COUNTER_COUNT,
+} audio_metric_counter_t;
+
+typedef enum {
+    AUDIO_METRIC_SAMPLE_JITTER_US,      // |frame interval - nominal frame period|, per frame read
+    AUDIO_METRIC_FRAME_LATENCY_US,      // Last sample of a frame to read() returning it
+    AUDIO_METRIC_ENCODE_US,             // Codec and base64 work per upload
+    AUDIO_METRIC_HTTP_CONNECT_US,       // DNS, TCP and TLS handshake per new connection
+    AUDIO_METRIC_HTTP_TRANSFER_US,      // Writing the body per upload
+    AUDIO_METRIC_HTTP_RESPONSE_US,      // Waiting for the response per upload
+    AUDIO_METRIC_STREAM_START_US,       // Streamed playback: request to first sample out
+    AUDIO_METRIC_HISTOGRAM_COUNT,
+} audio_metric_histogram_t;
+
+void audio_metrics_add(audio_metric_counter_t counter, uint32_t delta);
+void audio_metrics_record(audio_metric_histogram_t histogram, uint32_t value);
+
+// Snapshot as one line of JSON: counters, histograms (buckets up to the last
+// non-empty one, plus count and max), heap low-water marks and the least
+// free stack of each task created through audio_tasks. Returns the length,
+// or 0 if `size` was too small.
+size_t audio_metrics_json(char *out, size_t size);
+
+// Log the JSON every `period_ms` from a low-priority task
+esp_err_t audio_metrics_start(const audio_task_config_t *task, uint32_t period_ms);
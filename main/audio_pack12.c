@@ -0,0 +1,104 @@
+#include "audio_pack12.h"
+
+// Odd samples at the edges of a range share a byte with their neighbour
+static void pack12_set(uint8_t *packed, size_t index, int16_t value) {
+    uint8_t *p = packed + index / 2 * 3;
+    uint16_t v = (uint16_t)value & 0xFFF;
+
+    if (index & 1) {
+        p[1] = (p[1] & 0x0F) | (uint8_t)(v << 4);
+        p[2] = (uint8_t)(v >> 4);
+    } else {
+        p[0] = (uint8_t)v;
+        p[1] = (p[1] & 0xF0) | (uint8_t)(v >> 8);
+    }
+}
+
+static int16_t pack12_get(const uint8_t *packed, size_t index) {
+    const uint8_t *p = packed + index / 2 * 3;
+
+    if (index & 1) {
+        return (int16_t)(p[1] >> 4 | p[2] << 4);
+    }
+    return (int16_t)(p[0] | (p[1] & 0x0F) << 8);
+}
+
+void audio_pack12(uint8_t *packed, size_t offset, const int16_t *in, size_t count) {
+    if (count > 0 && (offset & 1)) {
+        pack12_set(packed, offset++, *in++);
+        count--;
+    }
+
+    uint8_t *p = packed + offset / 2 * 3;
+    size_t pairs = count / 2;
+    // Two pairs per pass: one 6-byte group, fewer loop branches
+    for (; pairs >= 2; pairs -= 2, in += 4, p += 6) {
+        uint32_t a = in[0] & 0xFFF, b = in[1] & 0xFFF, c = in[2] & 0xFFF, d = in[3] & 0xFFF;
+        p[0] = (uint8_t)a;
+        p[1] = (uint8_t)(a >> 8 | b << 4);
+        p[2] = (uint8_t)(b >> 4);
+        p[3] = (uint8_t)c;
+        p[4] = (uint8_t)(c >> 8 | d << 4);
+        p[5] = (uint8_t)(d >> 4);
+    }
+    if (pairs > 0) {
+        uint32_t a = in[0] & 0xFFF, b = in[1] & 0xFFF;
+        p[0] = (uint8_t)a;
+        p[1] = (uint8_t)(a >> 8 | b << 4);
+        p[2] = (uint8_t)(b >> 4);
+        in += 2;
+    }
+    if (count & 1) {
+        pack12_set(packed, offset + count - 1, *in);
+    }
+}
+
+void audio_unpack12(const uint8_t *packed, size_t offset, int16_t *out, size_t count) {
+    if (count > 0 && (offset & 1)) {
+        *out++ = pack12_get(packed, offset++);
+        count--;
+    }
+
+    const uint8_t *p = packed + offset / 2 * 3;
+    size_t pairs = count / 2;
+    for (; pairs >= 2; pairs -= 2, out += 4, p += 6) {
+        out[0] = (int16_t)(p[0] | (p[1] & 0x0F) << 8);
+        out[1] = (int16_t)(p[1] >> 4 | p[2] << 4);
+        out[2] = (int16_t)(p[3] | (p[4] & 0x0F) << 8);
+        out[3] = (int16_t)(p[4] >> 4 | p[5] << 4);
+    }
+    if (pairs > 0) {
+        out[0] = (int16_t)(p[0] | (p[1] & 0x0F) << 8);
+        out[1] = (int16_t)(p[1] >> 4 | p[2] << 4);
+        out += 2;
+    }
+    if (count & 1) {
+        *out = pack12_get(packed, offset + count - 1);
+    }
+}
+
+void audio_unpack12_stride(const uint8_t *packed, size_t offset, size_t stride, int16_t *out, size_t count) {
+    if (stride == 1) {
+        audio_unpack12(packed, offset, out, count);
+        return;
+    }
+    if (stride & 1) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = pack12_get(packed, offset + i * stride);
+        }
+        return;
+    }
+
+    // An even stride keeps every sample in the same half of its pair
+    const uint8_t *p = packed + offset / 2 * 3;
+    size_t step = stride / 2 * 3;
+    if (offset & 1) {
+        for (size_t i = 0; i < count; ++i, p += step) {
+            out[i] = (int16_t)(p[1] >> 4 | p[2] << 4);
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i, p += step) {
+            out[i] = (int16_t)(p[0] | (p[1] & 0x0F) << 8);
+        }
+    }
+}
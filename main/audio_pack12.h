@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 12-bit ADC readings stored two to three bytes. For a pair (a, b):
+//   byte 0 = a[7:0]
+//   byte 1 = a[11:8] | b[3:0] << 4
+//   byte 2 = b[11:4]
+// Sample i lives in bytes (i / 2) * 3 .. + 2 whatever else is stored, so a
+// packed buffer can be addressed by sample index like an int16_t array.
+
+// Bytes holding samples [0, samples)
+#define AUDIO_PACK12_BYTES(samples) (((size_t)(samples) * 3 + 1) / 2)
+
+// Bulk kernels over samples [offset, offset + count). Values are masked to
+// 12 bits. Writing touches only the nibbles of the samples written.
+void audio_pack12(uint8_t *packed, size_t offset, const int16_t *in, size_t count);
+void audio_unpack12(const uint8_t *packed, size_t offset, int16_t *out, size_t count);
+
+// `count` samples from `offset` on, `stride` apart: one channel of
+// interleaved frames, straight out of the packed buffer
+void audio_unpack12_stride(const uint8_t *packed, size_t offset, size_t stride, int16_t *out, size_t count);
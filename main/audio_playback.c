@@ -0,0 +1,155 @@
+#include "audio_hal.h"
+#include "audio_playback.h"
+#include "audio_metrics.h"
+
+static uint32_t s_sample_rate;
+static size_t s_frame_samples;
+static size_t s_channels;
+static int16_t s_frame[AUDIO_PLAYBACK_MAX_FRAME_SAMPLES];
+static int16_t s_resampled[AUDIO_PLAYBACK_MAX_FRAME_SAMPLES];
+static uint8_t s_levels[AUDIO_PLAYBACK_MAX_FRAME_SAMPLES];
+static audio_dsp_resampler_t s_resampler;
+
+esp_err_t audio_playback_init(const audio_playback_config_t *config) {
+    if (config->frame_samples == 0 || config->frame_samples > AUDIO_PLAYBACK_MAX_FRAME_SAMPLES ||
+        config->sample_rate == 0 || config->channels == 0 || config->channels > 8 ||
+        (config->channels & (config->channels - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_sample_rate = config->sample_rate;
+    s_frame_samples = config->frame_samples;
+    s_channels = config->channels;
+    return audio_hal_dac_init(config->sample_rate, config->frame_samples);
+}
+
+// Read exactly `count` samples of the played channel on from the cursor, or
+// fail if they were overwritten or not yet recorded
+static esp_err_t playback_read(const audio_ring_t *ring, audio_ring_cursor_t *cursor, size_t count) {
+    audio_ring_view_t view = {.ring = ring, .channels = s_channels, .channel = 0};
+    uint32_t expected = cursor->pos;
+    size_t got = audio_ring_view_read(&view, cursor, s_frame, count);
+    return got == count && cursor->pos - got * s_channels == expected ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+static esp_err_t playback_play_resampled(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples,
+                                         uint32_t speed) {
+    esp_err_t err = audio_dsp_resampler_init(&s_resampler, speed);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Enough input for just under a DMA buffer of output
+    size_t chunk = (uint64_t)(s_frame_samples - 2) * speed / AUDIO_PLAYBACK_SPEED_ONE;
+    chunk = chunk < 1 ? 1 : chunk > AUDIO_DSP_MAX_BLOCK ? AUDIO_DSP_MAX_BLOCK : chunk;
+
+    bool flushed = false;
+    while (!flushed) {
+        size_t count;
+        if (samples > 0) {
+            count = samples < chunk ? samples : chunk;
+            err = playback_read(ring, &cursor, count);
+            if (err != ESP_OK) {
+                return err;
+            }
+            // The resampler works on signed samples, so zeros are silence
+            for (size_t i = 0; i < count; ++i) {
+                s_frame[i] -= 2048;
+            }
+            samples -= count;
+        } else {
+            // Push out the filter's last outputs
+            count = AUDIO_DSP_RESAMPLE_TAPS / 2;
+            for (size_t i = 0; i < count; ++i) {
+                s_frame[i] = 0;
+            }
+            flushed = true;
+        }
+
+        size_t outputs = audio_dsp_resample(&s_resampler, s_frame, count, s_resampled);
+        for (size_t i = 0; i < outputs; ++i) {
+            int32_t level = s_resampled[i] + 2048;
+            level = level < 0 ? 0 : level > 4095 ? 4095 : level;
+            s_levels[i] = level >> 4;
+        }
+        if (outputs > 0) {
+            err = audio_hal_dac_write(s_levels, outputs);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t playback_play_direct(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples) {
+    while (samples > 0) {
+        size_t count = samples < s_frame_samples ? samples : s_frame_samples;
+        esp_err_t err = playback_read(ring, &cursor, count);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        // 12-bit ADC readings to 8-bit DAC levels
+        for (size_t i = 0; i < count; ++i) {
+            s_levels[i] = s_frame[i] >> 4;
+        }
+        // Returns as soon as a DMA buffer is free
+        err = audio_hal_dac_write(s_levels, count);
+        if (err != ESP_OK) {
+            return err;
+        }
+        samples -= count;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_play(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples) {
+    return audio_playback_play_speed(ring, cursor, samples, AUDIO_PLAYBACK_SPEED_ONE);
+}
+
+esp_err_t audio_playback_play_speed(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples,
+                                    uint32_t speed) {
+    if (speed < AUDIO_PLAYBACK_SPEED_MIN || speed > AUDIO_PLAYBACK_SPEED_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t underruns = audio_hal_dac_underruns();
+
+    size_t frames = samples / s_channels;
+    esp_err_t err = speed == AUDIO_PLAYBACK_SPEED_ONE ? playback_play_direct(ring, cursor, frames)
+                                                      : playback_play_resampled(ring, cursor, frames, speed);
+
+    esp_err_t drained = audio_hal_dac_drain();
+    audio_metrics_add(AUDIO_METRIC_PLAYBACK_CLIPS, 1);
+    audio_metrics_add(AUDIO_METRIC_PLAYBACK_UNDERRUNS, audio_hal_dac_underruns() - underruns);
+    return err != ESP_OK ? err : drained;
+}
+
+void audio_playback_locate(const audio_ring_t *ring, const audio_playback_request_t *request,
+                           audio_ring_cursor_t *cursor, uint32_t *samples) {
+    audio_ring_cursor_t oldest = audio_ring_cursor_last(ring, ring->capacity);
+    uint32_t kept = audio_ring_available(ring, &oldest);
+    uint32_t offset = (uint64_t)(request->offset_ms < 0 ? -(int64_t)request->offset_ms : request->offset_ms) *
+                      s_sample_rate / 1000 * s_channels;
+    uint32_t duration = (uint64_t)request->duration_ms * s_sample_rate / 1000 * s_channels;
+
+    if (offset > kept) {
+        offset = kept;
+    }
+    uint32_t start = request->offset_ms < 0 ? kept - offset : offset;
+    uint32_t available = kept - start;
+
+    cursor->pos = oldest.pos + start;
+    *samples = duration == 0 || duration > available ? available : duration;
+}
+
+esp_err_t audio_playback_play_request(const audio_ring_t *ring, const audio_playback_request_t *request) {
+    audio_ring_cursor_t cursor;
+    uint32_t samples;
+
+    audio_playback_locate(ring, request, &cursor, &samples);
+    return audio_playback_play_speed(ring, cursor, samples, request->speed);
+}
+
+uint32_t audio_playback_underruns(void) {
+    return audio_hal_dac_underruns();
+}
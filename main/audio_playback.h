@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_ring.h"
+#include "audio_dsp.h"
+
+#define AUDIO_PLAYBACK_MAX_FRAME_SAMPLES 1024
+#define AUDIO_PLAYBACK_SPEED_ONE AUDIO_DSP_RESAMPLE_ONE         // As recorded (Q16)
+#define AUDIO_PLAYBACK_SPEED_MIN (AUDIO_PLAYBACK_SPEED_ONE / 2)
+#define AUDIO_PLAYBACK_SPEED_MAX (AUDIO_PLAYBACK_SPEED_ONE * 2)
+
+// Playback settings
+typedef struct {
+    uint32_t sample_rate;   // Exact DAC output rate
+    size_t frame_samples;   // Samples per DMA buffer; two are in flight
+    size_t channels;        // Interleaved in the ring (1, 2, 4 or 8); the first is played
+} audio_playback_config_t;
+
+// Part of the ring to play, and how fast
+typedef struct {
+    int32_t offset_ms;      // Start after the oldest audio kept, or before the newest if negative
+    uint32_t duration_ms;   // Recorded audio to play; 0 plays up to the newest sample
+    uint32_t speed;         // SPEED_MIN to SPEED_MAX; at 2x, 40 s of audio plays in 20 s
+} audio_playback_request_t;
+
+// Set up the DAC and its DMA buffers. Call once before play.
+esp_err_t audio_playback_init(const audio_playback_config_t *config);
+
+// Play `samples` from the ring starting at `cursor`, refilling one DMA
+// buffer while the other plays. Blocks until the last sample is out; the CPU
+// is idle apart from the refills. ESP_ERR_INVALID_STATE if the recording
+// overwrote the audio before it was played. Positions and `samples` count
+// every channel; the played one is read through a view (see audio_ring.h).
+esp_err_t audio_playback_play(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples);
+
+// Same at `speed`, resampled a frame at a time (see audio_dsp.h) so the DAC
+// stays at the configured rate; pitch follows speed. ESP_ERR_INVALID_ARG if
+// speed is out of range.
+esp_err_t audio_playback_play_speed(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples,
+                                    uint32_t speed);
+
+// The samples `request` covers out of what the ring holds now, clamped to it.
+// *samples is 0 if the offset is past the newest audio.
+void audio_playback_locate(const audio_ring_t *ring, const audio_playback_request_t *request,
+                           audio_ring_cursor_t *cursor, uint32_t *samples);
+
+// Locate and play_speed in one
+esp_err_t audio_playback_play_request(const audio_ring_t *ring, const audio_playback_request_t *request);
+
+// Times the DAC ran dry mid-clip because a refill was late
+uint32_t audio_playback_underruns(void);
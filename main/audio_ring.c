@@ -0,0 +1,242 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "audio_ring.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_memory_utils.h"
+#endif
+
+#define STAGE_MASK (AUDIO_RING_STAGE_ALIGN - 1)
+
+// Whether storage is reached through the external RAM cache (never on the host)
+static bool ring_external(const void *storage) {
+#if CONFIG_IDF_TARGET_LINUX
+    return false;
+#else
+    return esp_ptr_external_ram(storage);
+#endif
+}
+
+// Store `count` samples at slot `offset` of storage, and load every
+// `stride`th from slot `offset`, at the depth the ring was built with
+#if CONFIG_AUDIO_RING_BITS == 16
+static inline void ring_pack(uint8_t *storage, size_t offset, const int16_t *in, size_t count) {
+    memcpy(storage + offset * sizeof(int16_t), in, count * sizeof(int16_t));
+}
+
+static inline void ring_unpack(const uint8_t *storage, size_t offset, size_t stride, int16_t *out, size_t count) {
+    const int16_t *from = (const int16_t *)storage + offset;
+
+    if (stride == 1) {
+        memcpy(out, from, count * sizeof(int16_t));
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = from[i * stride];
+    }
+}
+#elif CONFIG_AUDIO_RING_BITS == 8
+static inline void ring_pack(uint8_t *storage, size_t offset, const int16_t *in, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        storage[offset + i] = (uint16_t)in[i] >> 4;
+    }
+}
+
+static inline void ring_unpack(const uint8_t *storage, size_t offset, size_t stride, int16_t *out, size_t count) {
+    const uint8_t *from = storage + offset;
+
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = (int16_t)(from[i * stride] << 4);
+    }
+}
+#else
+static inline void ring_pack(uint8_t *storage, size_t offset, const int16_t *in, size_t count) {
+    audio_pack12(storage, offset, in, count);
+}
+
+static inline void ring_unpack(const uint8_t *storage, size_t offset, size_t stride, int16_t *out, size_t count) {
+    audio_unpack12_stride(storage, offset, stride, out, count);
+}
+#endif
+
+// Split [start, start + count) into unaligned edges and a middle of whole
+// staging groups, which start on a word boundary of storage
+static void ring_span(size_t start, size_t count, size_t *head, size_t *middle) {
+    size_t first = (start + STAGE_MASK) & ~(size_t)STAGE_MASK;
+    size_t last = (start + count) & ~(size_t)STAGE_MASK;
+
+    if (first >= last) {
+        *head = count;
+        *middle = 0;
+        return;
+    }
+    *head = first - start;
+    *middle = last - first;
+}
+
+// Pack into storage slots [start, start + count), which do not wrap
+static void ring_store(const audio_ring_t *ring, size_t start, const int16_t *in, size_t count) {
+    uint32_t stage[AUDIO_RING_STORAGE_BYTES(AUDIO_RING_STAGE_SAMPLES) / sizeof(uint32_t)];
+    size_t head, middle;
+
+    if (!ring->staged) {
+        ring_pack(ring->storage, start, in, count);
+        return;
+    }
+    // Edges may share bytes with their neighbours, so they are packed in place
+    ring_span(start, count, &head, &middle);
+    ring_pack(ring->storage, start, in, head);
+    for (size_t done = head; done < head + middle;) {
+        size_t n = head + middle - done;
+        if (n > AUDIO_RING_STAGE_SAMPLES) {
+            n = AUDIO_RING_STAGE_SAMPLES;
+        }
+        ring_pack((uint8_t *)stage, 0, in + done, n);
+        memcpy(ring->storage + AUDIO_RING_STORAGE_BYTES(start + done), stage, AUDIO_RING_STORAGE_BYTES(n));
+        done += n;
+    }
+    ring_pack(ring->storage, start + head + middle, in + head + middle, count - head - middle);
+}
+
+// Unpack one channel of the frames in storage slots [start, start +
+// frames * channels), which do not wrap. `start` is a frame boundary and
+// channels divides AUDIO_RING_STAGE_ALIGN, so every piece is whole frames.
+static void ring_load(const audio_ring_t *ring, size_t start, size_t channels, size_t channel, int16_t *out,
+                      size_t frames) {
+    uint32_t stage[AUDIO_RING_STORAGE_BYTES(AUDIO_RING_STAGE_SAMPLES) / sizeof(uint32_t)];
+    size_t count = frames * channels;
+    size_t head, middle;
+
+    if (!ring->staged) {
+        ring_unpack(ring->storage, start + channel, channels, out, frames);
+        return;
+    }
+    ring_span(start, count, &head, &middle);
+    ring_unpack(ring->storage, start + channel, channels, out, head / channels);
+    for (size_t done = head; done < head + middle;) {
+        size_t n = head + middle - done;
+        if (n > AUDIO_RING_STAGE_SAMPLES) {
+            n = AUDIO_RING_STAGE_SAMPLES;
+        }
+        memcpy(stage, ring->storage + AUDIO_RING_STORAGE_BYTES(start + done), AUDIO_RING_STORAGE_BYTES(n));
+        ring_unpack((const uint8_t *)stage, channel, channels, out + done / channels, n / channels);
+        done += n;
+    }
+    ring_unpack(ring->storage, start + head + middle + channel, channels, out + (head + middle) / channels,
+                (count - head - middle) / channels);
+}
+
+// Copy in at most two pieces around the end of storage. The capacity is
+// even, so the wrap never splits a packed 12-bit pair, and a multiple of the
+// channel count, so it never splits a frame.
+static void ring_copy_out(const audio_ring_t *ring, uint32_t pos, size_t channels, size_t channel, int16_t *out,
+                          size_t frames) {
+    uint32_t start = pos & ring->mask;
+    size_t first = (ring->capacity - start) / channels;
+    if (first > frames) {
+        first = frames;
+    }
+    ring_load(ring, start, channels, channel, out, first);
+    ring_load(ring, 0, channels, channel, out + first, frames - first);
+}
+
+// Read whole frames, keeping one channel of each
+static size_t ring_read_frames(const audio_ring_t *ring, audio_ring_cursor_t *cursor, size_t channels,
+                               size_t channel, int16_t *out, size_t max) {
+    uint32_t frame_mask = channels - 1;
+
+    while (1) {
+        uint32_t head = audio_ring_head(ring);
+        uint32_t reserve = atomic_load_explicit(&ring->reserve, memory_order_relaxed);
+
+        // Skip whatever the producer has already overwritten or is overwriting
+        if (reserve - cursor->pos > ring->capacity) {
+            cursor->pos = (reserve - ring->capacity + frame_mask) & ~frame_mask;
+        }
+
+        size_t frames = (head - cursor->pos) / channels;
+        if (frames > max) {
+            frames = max;
+        }
+        if (frames == 0) {
+            return 0;
+        }
+        ring_copy_out(ring, cursor->pos, channels, channel, out, frames);
+
+        // Valid only if the producer has not started overwriting our range
+        atomic_thread_fence(memory_order_acquire);
+        reserve = atomic_load_explicit(&ring->reserve, memory_order_relaxed);
+        if (reserve - cursor->pos <= ring->capacity) {
+            cursor->pos += frames * channels;
+            return frames;
+        }
+    }
+}
+
+esp_err_t audio_ring_init(audio_ring_t *ring, uint8_t *storage, uint32_t capacity) {
+    if (storage == NULL || capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ring->storage = storage;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->staged = ring_external(storage) && capacity >= AUDIO_RING_STAGE_ALIGN;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->reserve, 0);
+    return ESP_OK;
+}
+
+void audio_ring_write(audio_ring_t *ring, const int16_t *samples, size_t count) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (count > ring->capacity) {
+        samples += count - ring->capacity;
+        head += count - ring->capacity;
+        count = ring->capacity;
+    }
+
+    // Announce the overwrite before touching storage so readers can tell
+    // which of the samples they copied may be torn
+    atomic_store_explicit(&ring->reserve, head + count, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    uint32_t start = head & ring->mask;
+    size_t first = ring->capacity - start;
+    if (first > count) {
+        first = count;
+    }
+    ring_store(ring, start, samples, first);
+    ring_store(ring, 0, samples + first, count - first);
+
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+}
+
+uint32_t audio_ring_head(const audio_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+audio_ring_cursor_t audio_ring_cursor_last(const audio_ring_t *ring, uint32_t samples) {
+    uint32_t head = audio_ring_head(ring);
+    uint32_t kept = head < ring->capacity ? head : ring->capacity;
+    if (samples > kept) {
+        samples = kept;
+    }
+    return (audio_ring_cursor_t){.pos = head - samples};
+}
+
+audio_ring_cursor_t audio_ring_cursor_live(const audio_ring_t *ring) {
+    return (audio_ring_cursor_t){.pos = audio_ring_head(ring)};
+}
+
+uint32_t audio_ring_available(const audio_ring_t *ring, const audio_ring_cursor_t *cursor) {
+    uint32_t available = audio_ring_head(ring) - cursor->pos;
+    return available < ring->capacity ? available : ring->capacity;
+}
+
+size_t audio_ring_read(const audio_ring_t *ring, audio_ring_cursor_t *cursor, int16_t *out, size_t max) {
+    return ring_read_frames(ring, cursor, 1, 0, out, max);
+}
+
+size_t audio_ring_view_read(const audio_ring_view_t *view, audio_ring_cursor_t *cursor, int16_t *out, size_t max) {
+    return ring_read_frames(view->ring, cursor, view->channels, view->channel, out, max);
+}
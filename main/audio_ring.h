@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "audio_pack12.h"
+
+// Single-producer ring of samples that overwrites the oldest audio.
+// Positions are free-running sample counters; the slot is pos & mask.
+// Readers never block the producer and detect when they were overrun.
+// Samples are 12-bit ADC readings. They are stored at the depth chosen in
+// CONFIG_AUDIO_RING_BITS: 12 keeps them packed (see audio_pack12.h), 16 as
+// plain words, and 8 keeps only the top 8 bits the DAC plays. The depth is
+// fixed at build time, so the copy loops have no branch on it.
+//
+// Storage in PSRAM is only reached through the SPI RAM cache, where the
+// packer's scattered byte stores and loads are slow and uneven. For such
+// storage samples are packed into (or unpacked from) a small staging buffer
+// on the caller's stack in internal RAM, and moved to and from the ring in
+// aligned word copies of AUDIO_RING_STAGE_SAMPLES at most. Callers see the
+// same interface either way.
+//
+// A ring can hold several channels as interleaved frames (one sample of
+// each channel per sample period). Positions and capacity still count
+// samples; a view reads one channel of it without an interleaved copy.
+
+#define AUDIO_RING_STAGE_SAMPLES 256    // Multiple of 8: up to 512 bytes of stack per write or read
+#define AUDIO_RING_STAGE_ALIGN 8        // Samples in a whole number of 32-bit words at any depth
+
+typedef struct {
+    uint8_t *storage;           // AUDIO_RING_STORAGE_BYTES(capacity)
+    uint32_t capacity;          // Power of two
+    uint32_t mask;
+    bool staged;                // Storage is external RAM, copy through internal RAM
+    _Atomic uint32_t head;      // Samples published
+    _Atomic uint32_t reserve;   // Samples the producer may be writing
+} audio_ring_t;
+
+// Reader position. Each consumer owns its own cursor.
+typedef struct {
+    uint32_t pos;
+} audio_ring_cursor_t;
+
+// One channel of a ring of interleaved frames. `channels` is 1, 2, 4 or 8,
+// and the producer writes whole frames.
+typedef struct {
+    const audio_ring_t *ring;
+    uint8_t channels;
+    uint8_t channel;            // 0 .. channels - 1
+} audio_ring_view_t;
+
+#if CONFIG_AUDIO_RING_BITS == 16
+#define AUDIO_RING_STORAGE_BYTES(capacity) ((size_t)(capacity) * 2)
+#elif CONFIG_AUDIO_RING_BITS == 8
+#define AUDIO_RING_STORAGE_BYTES(capacity) ((size_t)(capacity))
+#else
+#define AUDIO_RING_STORAGE_BYTES(capacity) AUDIO_PACK12_BYTES(capacity)
+#endif
+
+// capacity (in samples) must be a power of two. Staging is used when
+// `storage` is in external RAM.
+esp_err_t audio_ring_init(audio_ring_t *ring, uint8_t *storage, uint32_t capacity);
+
+// Producer: append samples, overwriting the oldest when full
+void audio_ring_write(audio_ring_t *ring, const int16_t *samples, size_t count);
+
+// Total samples written so far
+uint32_t audio_ring_head(const audio_ring_t *ring);
+
+// Cursor at the start of the most recent `samples` samples (or the oldest kept)
+audio_ring_cursor_t audio_ring_cursor_last(const audio_ring_t *ring, uint32_t samples);
+
+// Cursor at the write position; only samples written from now on are read
+audio_ring_cursor_t audio_ring_cursor_live(const audio_ring_t *ring);
+
+// Samples ready for this cursor
+uint32_t audio_ring_available(const audio_ring_t *ring, const audio_ring_cursor_t *cursor);
+
+// Copy up to max samples and advance the cursor. If the producer lapped the
+// cursor, it skips ahead to the oldest intact sample first.
+size_t audio_ring_read(const audio_ring_t *ring, audio_ring_cursor_t *cursor, int16_t *out, size_t max);
+
+// Same, for the view's channel alone: up to max samples of it are unpacked
+// straight from the ring into `out`. The cursor is at a frame boundary and
+// moves on by whole frames, channels * the count returned.
+size_t audio_ring_view_read(const audio_ring_view_t *view, audio_ring_cursor_t *cursor, int16_t *out, size_t max);
@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "audio_hal.h"
+#include "audio_dsp.h"
+#include "audio_wav.h"
+#include "audio_metrics.h"
+#include "audio_stream.h"
+
+#define STREAM_READ_BYTES AUDIO_DSP_MAX_BLOCK       // Body bytes per read, so at most one resampler block
+#define STREAM_HEADER_MAX 512                       // The WAV header must end within this many bytes
+#define STREAM_MAX_CHANNELS 2                       // Mixed down to mono
+#define STREAM_MAX_OUTPUTS (AUDIO_DSP_MAX_BLOCK * 2 + 1)
+#define STREAM_POLL_MS 10
+#define STREAM_UNKNOWN UINT64_MAX
+
+// Fetch task working set, for one stream at a time
+typedef struct {
+    const char *url;
+    audio_stream_stats_t *stats;
+    esp_http_client_handle_t client;
+    uint64_t offset;            // File bytes received
+    uint64_t total;             // File size, from Content-Range or Content-Length
+    uint64_t data_end;          // Offset past the last sample
+    uint32_t chunk_bytes;       // Asked for per GET
+    bool ranged;                // Response is a 206 for the range asked
+    bool server_close;          // Response carried "Connection: close"
+    uint8_t header[STREAM_HEADER_MAX];
+    bool have_format;
+    audio_wav_info_t wav;
+    uint8_t carry[STREAM_MAX_CHANNELS * 2];     // Sample frame split between reads
+    size_t carry_len;
+    bool resample;
+    audio_dsp_resampler_t resampler;
+    uint8_t read[STREAM_READ_BYTES];
+    int16_t pcm[STREAM_READ_BYTES];
+    int16_t resampled[STREAM_MAX_OUTPUTS];
+    uint8_t levels[STREAM_MAX_OUTPUTS];
+} stream_fetch_t;
+
+static const char *TAG = "AudioStream";
+
+static audio_stream_config_t s_config;
+static TaskHandle_t s_fetch_task;
+static stream_fetch_t s_fetch;
+static StreamBufferHandle_t s_buffer;       // Jitter buffer: DAC levels, fetch task to player
+static StaticStreamBuffer_t s_buffer_struct;
+static uint8_t s_buffer_storage[AUDIO_STREAM_BUFFER_SAMPLES + 1];
+static uint8_t s_out[AUDIO_PLAYBACK_MAX_FRAME_SAMPLES];
+static _Atomic bool s_stop;                 // Player: stop fetching
+static _Atomic bool s_done;                 // Fetch task: nothing more will be added
+static _Atomic uint32_t s_min_prefetch;     // Fetch task: samples that ride out the slowest response
+static esp_err_t s_result;                  // Fetch task: outcome, once s_done
+
+static esp_err_t stream_on_event(esp_http_client_event_t *evt) {
+    stream_fetch_t *f = evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Connection") == 0) {
+        f->server_close = strcasecmp(evt->header_value, "close") == 0;
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Range") == 0) {
+        // "bytes first-last/total", total may be "*"
+        const char *slash = strchr(evt->header_value, '/');
+        if (slash != NULL && slash[1] != '*') {
+            f->total = strtoull(slash + 1, NULL, 10);
+        }
+    }
+    return ESP_OK;
+}
+
+// Hand levels to the player, waiting while the jitter buffer is full
+static esp_err_t stream_push(const uint8_t *levels, size_t count) {
+    while (count > 0) {
+        if (atomic_load_explicit(&s_stop, memory_order_relaxed)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        size_t sent = xStreamBufferSend(s_buffer, levels, count, pdMS_TO_TICKS(STREAM_POLL_MS));
+        levels += sent;
+        count -= sent;
+    }
+    return ESP_OK;
+}
+
+// Signed 12-bit samples in f->pcm to DAC levels, at the DAC rate
+static esp_err_t stream_output(stream_fetch_t *f, size_t count) {
+    const int16_t *samples = f->pcm;
+
+    if (f->resample) {
+        count = audio_dsp_resample(&f->resampler, f->pcm, count, f->resampled);
+        samples = f->resampled;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int32_t level = samples[i] + 2048;
+        level = level < 0 ? 0 : level > 4095 ? 4095 : level;
+        f->levels[i] = level >> 4;
+    }
+    return stream_push(f->levels, count);
+}
+
+// Decode whole sample frames (at most STREAM_READ_BYTES), mixing channels
+// down to mono
+static esp_err_t stream_decode_frames(stream_fetch_t *f, const uint8_t *in, size_t frames) {
+    uint16_t channels = f->wav.channels;
+
+    for (size_t i = 0; i < frames; ++i) {
+        int32_t sum = 0;
+        for (uint16_t c = 0; c < channels; ++c) {
+            int16_t pcm;
+            if (f->wav.codec == AUDIO_CODEC_PCM16) {
+                pcm = (int16_t)(in[0] | in[1] << 8);
+                in += 2;
+            } else {
+                audio_codec_decode(AUDIO_CODEC_ULAW, in++, 1, &pcm);
+            }
+            sum += pcm;
+        }
+        f->pcm[i] = (sum / channels) >> 4;
+    }
+    return stream_output(f, frames);
+}
+
+// Samples of the data chunk, in any split
+static esp_err_t stream_decode(stream_fetch_t *f, const uint8_t *data, size_t len) {
+    size_t align = f->wav.block_align;
+    esp_err_t err = ESP_OK;
+
+    if (f->carry_len > 0) {
+        size_t take = align - f->carry_len < len ? align - f->carry_len : len;
+        memcpy(f->carry + f->carry_len, data, take);
+        f->carry_len += take;
+        data += take;
+        len -= take;
+        if (f->carry_len < align) {
+            return ESP_OK;
+        }
+        f->carry_len = 0;
+        err = stream_decode_frames(f, f->carry, 1);
+    }
+    while (err == ESP_OK && len >= align) {
+        size_t frames = len / align;
+        if (frames > STREAM_READ_BYTES) {
+            frames = STREAM_READ_BYTES;
+        }
+        err = stream_decode_frames(f, data, frames);
+        data += frames * align;
+        len -= frames * align;
+    }
+    memcpy(f->carry, data, len);
+    f->carry_len = len;
+    return err;
+}
+
+// Set up decoding once the header has been parsed
+static esp_err_t stream_start_format(stream_fetch_t *f) {
+    uint32_t rate = s_config.playback.sample_rate;
+
+    if (f->wav.channels > STREAM_MAX_CHANNELS) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    f->resample = f->wav.sample_rate != rate;
+    if (f->resample) {
+        uint32_t step = (uint64_t)f->wav.sample_rate * AUDIO_DSP_RESAMPLE_ONE / rate;
+        if (audio_dsp_resampler_init(&f->resampler, step) != ESP_OK) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    bool open_ended = f->wav.data_bytes == 0 || f->wav.data_bytes == UINT32_MAX;
+    f->data_end = open_ended ? STREAM_UNKNOWN : (uint64_t)f->wav.data_offset + f->wav.data_bytes;
+    f->stats->source_rate = f->wav.sample_rate;
+    f->have_format = true;
+    ESP_LOGI(TAG, "%s, %u channel(s) at %lu Hz", audio_codec_name(f->wav.codec), (unsigned)f->wav.channels,
+             (unsigned long)f->wav.sample_rate);
+    return ESP_OK;
+}
+
+// Body bytes from file offset f->offset on
+static esp_err_t stream_receive(stream_fetch_t *f, const uint8_t *data, size_t len) {
+    if (!f->have_format) {
+        // The header is gathered first; the samples after it in the
+        // same bytes are decoded from the copy
+        size_t have = f->offset;
+        size_t take = STREAM_HEADER_MAX - have < len ? STREAM_HEADER_MAX - have : len;
+        memcpy(f->header + have, data, take);
+        f->offset += take;
+        data += take;
+        len -= take;
+
+        esp_err_t err = audio_wav_parse(f->header, have + take, &f->wav);
+        if (err == ESP_ERR_INVALID_SIZE && have + take < STREAM_HEADER_MAX) {
+            return ESP_OK;
+        }
+        if (err != ESP_OK) {
+            return err == ESP_ERR_INVALID_SIZE ? ESP_ERR_NOT_SUPPORTED : err;
+        }
+        err = stream_start_format(f);
+        size_t body = have + take - f->wav.data_offset;
+        if (err == ESP_OK && body > 0) {
+            f->offset -= body;
+            err = stream_receive(f, f->header + f->wav.data_offset, body);
+        }
+        if (err != ESP_OK || len == 0) {
+            return err;
+        }
+    }
+
+    // Anything after the data chunk is not audio
+    size_t use = 0;
+    if (f->offset < f->data_end) {
+        use = f->data_end - f->offset < len ? f->data_end - f->offset : len;
+    }
+    f->offset += len;
+    return use > 0 ? stream_decode(f, data, use) : ESP_OK;
+}
+
+// One GET of the next chunk, read to the end of the response. ESP_FAIL if
+// the connection broke, so the caller can resume from f->offset.
+static esp_err_t stream_request(stream_fetch_t *f) {
+    char range[48];
+    snprintf(range, sizeof(range), "bytes=%llu-%llu", (unsigned long long)f->offset,
+             (unsigned long long)(f->offset + f->chunk_bytes - 1));
+    esp_http_client_set_header(f->client, "Range", range);
+    f->stats->requests++;
+    f->ranged = false;
+    f->server_close = false;
+
+    int64_t start = esp_timer_get_time();
+    if (esp_http_client_open(f->client, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    int64_t length = esp_http_client_fetch_headers(f->client);
+    if (length < 0) {
+        return ESP_FAIL;
+    }
+
+    // Keep enough buffered to ride out twice the slowest response so far,
+    // and ask for enough per GET that waiting for responses takes at most a
+    // quarter of the playing time
+    int64_t response_us = esp_timer_get_time() - start;
+    if (response_us > f->stats->max_response_us) {
+        f->stats->max_response_us = response_us;
+        uint64_t samples = (uint64_t)response_us * 2 * s_config.playback.sample_rate / 1000000;
+        atomic_store_explicit(&s_min_prefetch, samples > UINT32_MAX ? UINT32_MAX : samples, memory_order_relaxed);
+    }
+    // The first response usually comes before the header is parsed, so
+    // this is checked on every one rather than only on a new slowest
+    if (f->have_format) {
+        uint64_t bytes = (uint64_t)f->stats->max_response_us * 4 * f->wav.sample_rate * f->wav.block_align / 1000000;
+        while (f->chunk_bytes < bytes && f->chunk_bytes < AUDIO_STREAM_CHUNK_MAX_BYTES) {
+            f->chunk_bytes *= 2;
+        }
+    }
+
+    uint64_t skip = 0;
+    int status = esp_http_client_get_status_code(f->client);
+    if (status == 206) {
+        f->ranged = true;
+    } else if (status == 200) {
+        // Range ignored: the whole file, so skip what we already have
+        skip = f->offset;
+        f->total = length > 0 ? (uint64_t)length : STREAM_UNKNOWN;
+    } else if (status == 416) {
+        f->total = f->offset; // Asked past the end
+        esp_http_client_close(f->client);
+        return ESP_OK;
+    } else {
+        ESP_LOGE(TAG, "HTTP %d for %s", status, range);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    while (f->offset < f->data_end) {
+        int n = esp_http_client_read(f->client, (char *)f->read, sizeof(f->read));
+        if (n < 0) {
+            return ESP_FAIL;
+        }
+        if (n == 0) {
+            break;
+        }
+        f->stats->bytes += n;
+
+        size_t dropped = skip < (uint64_t)n ? skip : (size_t)n;
+        skip -= dropped;
+        esp_err_t err = stream_receive(f, f->read + dropped, n - dropped);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (f->offset < f->data_end && !esp_http_client_is_complete_data_received(f->client)) {
+        return ESP_FAIL;
+    }
+    // Close rather than drain what is left after the last sample
+    if (f->server_close || !esp_http_client_is_complete_data_received(f->client)) {
+        esp_http_client_close(f->client);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t stream_fetch(stream_fetch_t *f) {
+    int attempts = 0;
+
+    f->offset = 0;
+    f->total = STREAM_UNKNOWN;
+    f->data_end = STREAM_UNKNOWN;
+    f->chunk_bytes = AUDIO_STREAM_CHUNK_BYTES;
+    f->have_format = false;
+    f->carry_len = 0;
+
+    while (f->offset < f->total && f->offset < f->data_end) {
+        uint64_t before = f->offset;
+        esp_err_t err = stream_request(f);
+        if (err == ESP_OK) {
+            if (!f->ranged || f->offset == before) {
+                break; // Whole file read, or nothing more to come
+            }
+            attempts = 0;
+            continue;
+        }
+        esp_http_client_close(f->client);
+        if (err != ESP_FAIL) {
+            return err;
+        }
+        attempts = f->offset > before ? 1 : attempts + 1;
+        if (attempts >= AUDIO_STREAM_RETRIES) {
+            return ESP_ERR_TIMEOUT;
+        }
+        ESP_LOGW(TAG, "Connection broke, resuming at byte %llu", (unsigned long long)f->offset);
+    }
+    if (!f->have_format) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Push out the resampler's last outputs
+    if (f->resample) {
+        memset(f->pcm, 0, AUDIO_DSP_RESAMPLE_TAPS / 2 * sizeof(f->pcm[0]));
+        return stream_output(f, AUDIO_DSP_RESAMPLE_TAPS / 2);
+    }
+    return ESP_OK;
+}
+
+static void stream_fetch_task(void *arg) {
+    stream_fetch_t *f = &s_fetch;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        esp_http_client_config_t http_config = {
+            .url = f->url,
+            .method = HTTP_METHOD_GET,
+            .event_handler = stream_on_event,
+            .user_data = f,
+            .keep_alive_enable = true,
+        };
+        f->client = esp_http_client_init(&http_config);
+        if (f->client == NULL) {
+            s_result = ESP_ERR_NO_MEM;
+        } else {
+            s_result = stream_fetch(f);
+            esp_http_client_close(f->client);
+            esp_http_client_cleanup(f->client);
+        }
+        atomic_store_explicit(&s_done, true, memory_order_release);
+    }
+}
+
+esp_err_t audio_stream_init(const audio_stream_config_t *config) {
+    if (config->playback.frame_samples == 0 || config->playback.frame_samples > AUDIO_PLAYBACK_MAX_FRAME_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+
+    // The player takes a whole DMA buffer at a time unless the stream ends
+    s_buffer = xStreamBufferCreateStatic(sizeof(s_buffer_storage) - 1, s_config.playback.frame_samples,
+                                         s_buffer_storage, &s_buffer_struct);
+    if (s_buffer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return audio_tasks_create(&s_config.task, stream_fetch_task, NULL, &s_fetch_task);
+}
+
+esp_err_t audio_stream_play(const char *url, audio_stream_stats_t *stats) {
+    audio_stream_stats_t local_stats;
+    uint32_t rate = s_config.playback.sample_rate;
+    size_t frame = s_config.playback.frame_samples;
+    uint32_t max_prefetch = AUDIO_STREAM_BUFFER_SAMPLES * 3 / 4;   // Room left for the fetch task to add to
+    uint32_t prefetch = rate * AUDIO_STREAM_START_MS / 1000;
+    TickType_t frame_ticks = pdMS_TO_TICKS(frame * 1000 / rate);
+    esp_err_t err = ESP_OK;
+
+    if (stats == NULL) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    xStreamBufferReset(s_buffer);
+    s_fetch.url = url;
+    s_fetch.stats = stats;
+    atomic_store(&s_stop, false);
+    atomic_store(&s_done, false);
+    atomic_store(&s_min_prefetch, 0);
+
+    int64_t start = esp_timer_get_time();
+    uint32_t underruns = audio_hal_dac_underruns();
+    xTaskNotifyGive(s_fetch_task);
+
+    bool buffering = true;
+    bool started = false;
+    while (1) {
+        if (buffering) {
+            // The first start only waits for AUDIO_STREAM_START_MS
+            uint32_t target = started ? atomic_load_explicit(&s_min_prefetch, memory_order_relaxed) : 0;
+            target = target > prefetch ? target : prefetch;
+            target = target < max_prefetch ? target : max_prefetch;
+            if (xStreamBufferBytesAvailable(s_buffer) < target &&
+                !atomic_load_explicit(&s_done, memory_order_acquire)) {
+                vTaskDelay(pdMS_TO_TICKS(STREAM_POLL_MS));
+                continue;
+            }
+            prefetch = target;
+            buffering = false;
+            if (!started) {
+                started = true;
+                stats->start_us = esp_timer_get_time() - start;
+            }
+        }
+
+        // Waits up to a frame's time for a whole frame; one more is queued in DMA
+        size_t count = xStreamBufferReceive(s_buffer, s_out, frame, frame_ticks > 0 ? frame_ticks : 1);
+        if (count > 0) {
+            err = audio_hal_dac_write(s_out, count);
+            if (err != ESP_OK) {
+                break;
+            }
+            stats->samples += count;
+            continue;
+        }
+        if (atomic_load_explicit(&s_done, memory_order_acquire) && xStreamBufferIsEmpty(s_buffer)) {
+            break;
+        }
+
+        // Ran dry mid-stream: pause until a deeper buffer has built up
+        stats->rebuffers++;
+        prefetch = prefetch * 2 < max_prefetch ? prefetch * 2 : max_prefetch;
+        buffering = true;
+        ESP_LOGW(TAG, "Jitter buffer ran dry after %lu samples, refilling to %lu", (unsigned long)stats->samples,
+                 (unsigned long)prefetch);
+    }
+
+    atomic_store(&s_stop, true);
+    while (!atomic_load_explicit(&s_done, memory_order_acquire)) {
+        vTaskDelay(pdMS_TO_TICKS(STREAM_POLL_MS));
+    }
+    esp_err_t drained = audio_hal_dac_drain();
+
+    stats->underruns = audio_hal_dac_underruns() - underruns;
+    stats->prefetch_samples = prefetch;
+    audio_metrics_add(AUDIO_METRIC_PLAYBACK_CLIPS, 1);
+    audio_metrics_add(AUDIO_METRIC_PLAYBACK_UNDERRUNS, stats->underruns);
+    audio_metrics_add(AUDIO_METRIC_STREAM_REBUFFERS, stats->rebuffers);
+    if (started) {
+        audio_metrics_record(AUDIO_METRIC_STREAM_START_US, stats->start_us);
+    }
+    ESP_LOGI(TAG, "Streamed %lu samples in %lu requests (%llu bytes): started in %lld ms, %lu rebuffers, "
+             "%lu underruns, slowest response %lld ms", (unsigned long)stats->samples, (unsigned long)stats->requests,
+             (unsigned long long)stats->bytes, (long long)(stats->start_us / 1000), (unsigned long)stats->rebuffers,
+             (unsigned long)stats->underruns, (long long)(stats->max_response_us / 1000));
+
+    if (err == ESP_OK) {
+        err = s_result;
+    }
+    return err != ESP_OK ? err : drained;
+}
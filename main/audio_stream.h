@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_playback.h"
+#include "audio_tasks.h"
+
+// Playback of a WAV file (PCM16 or mu-law, mono or stereo) from an HTTP
+// server, for audio that is not in the ring. A fetch task pulls the file in
+// ranged GETs over one kept-alive connection, decodes it as it arrives and
+// fills a fixed jitter buffer of DAC levels, which the caller's task drains
+// into the DAC. Memory use is the same whatever the length of the file.
+//
+// Output starts once the buffer holds AUDIO_STREAM_START_MS, so it begins
+// after the first response rather than the whole download. If the buffer
+// runs dry, output pauses until it holds the prefetch depth again; that
+// depth doubles on every pause and is kept above twice the slowest response
+// time seen. Chunks start small for a quick first response and grow until
+// waiting for responses takes at most a quarter of the playing time. A
+// dropped connection is resumed at the byte where it broke, and a server
+// that ignores Range is read as one response.
+
+#define AUDIO_STREAM_CHUNK_BYTES 8192       // First ranged GET; later ones grow with the response time
+#define AUDIO_STREAM_CHUNK_MAX_BYTES 65536
+#define AUDIO_STREAM_BUFFER_SAMPLES 16384   // Jitter buffer, one byte per sample: ~1 s at 16kHz
+#define AUDIO_STREAM_START_MS 200           // Prefetched before the first sample plays
+#define AUDIO_STREAM_RETRIES 3              // Reconnects per chunk before giving up
+
+typedef struct {
+    audio_playback_config_t playback;   // As passed to audio_playback_init
+    audio_task_config_t task;           // Fetch task; network work, so core 0
+} audio_stream_config_t;
+
+typedef struct {
+    uint32_t samples;           // Played, at the DAC rate
+    uint32_t source_rate;       // Of the file; resampled to the DAC rate if different
+    uint32_t requests;          // GETs sent, retries included
+    uint64_t bytes;             // Body bytes received
+    int64_t start_us;           // From the call to the first sample handed to the DAC
+    int64_t max_response_us;    // Slowest request to response headers
+    uint32_t rebuffers;         // Times the buffer ran dry and output paused to refill it
+    uint32_t underruns;         // Times the DAC ran dry (each rebuffer is usually one)
+    uint32_t prefetch_samples;  // Prefetch depth at the end
+} audio_stream_stats_t;
+
+// Create the fetch task and the jitter buffer. Call after audio_playback_init.
+esp_err_t audio_stream_init(const audio_stream_config_t *config);
+
+// Fetch and play `url`, blocking until it has played out. Call from the
+// playback task, never while audio_playback_play is running. `stats` may be
+// NULL. ESP_ERR_NOT_SUPPORTED for a format or sample rate the player cannot
+// convert (rates from half to twice the DAC rate are resampled).
+esp_err_t audio_stream_play(const char *url, audio_stream_stats_t *stats);
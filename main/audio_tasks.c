@@ -0,0 +1,52 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "audio_tasks.h"
+
+typedef struct {
+    const audio_task_config_t *config;
+    TaskHandle_t handle;
+} tasks_entry_t;
+
+static const char *TAG = "AudioTasks";
+
+static tasks_entry_t s_tasks[AUDIO_TASKS_MAX];
+static size_t s_task_count;
+
+esp_err_t audio_tasks_create(const audio_task_config_t *config, TaskFunction_t fn, void *arg, TaskHandle_t *handle) {
+    TaskHandle_t task;
+
+    BaseType_t created = xTaskCreatePinnedToCore(fn, config->name, config->stack, arg, config->priority, &task,
+                                                 config->core);
+    if (created != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (s_task_count < AUDIO_TASKS_MAX) {
+        s_tasks[s_task_count++] = (tasks_entry_t){.config = config, .handle = task};
+    }
+    if (handle != NULL) {
+        *handle = task;
+    }
+    return ESP_OK;
+}
+
+bool audio_tasks_stack_info(size_t index, const char **name, uint32_t *min_free) {
+    if (index >= s_task_count) {
+        return false;
+    }
+    *name = s_tasks[index].config->name;
+    // High-water mark is in bytes on ESP-IDF
+    *min_free = uxTaskGetStackHighWaterMark(s_tasks[index].handle);
+    return true;
+}
+
+void audio_tasks_report(void) {
+    for (size_t i = 0; i < s_task_count; ++i) {
+        const audio_task_config_t *config = s_tasks[i].config;
+        const char *name;
+        uint32_t min_free;
+        audio_tasks_stack_info(i, &name, &min_free);
+        ESP_LOGI(TAG, "%s: core %d, priority %u, stack %lu, min free %lu", name, (int)config->core,
+                 (unsigned)config->priority, (unsigned long)config->stack, (unsigned long)min_free);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+// Task topology. Core 1 runs the real-time audio path: the sample timer and
+// DMA interrupts, the frame reader and the DMA refill. Core 0 keeps Wi-Fi,
+// lwIP, TLS, uploads and flash writes, so a TLS handshake or a sector erase
+// never delays a frame. Pin the Wi-Fi and lwIP tasks to core 0 in sdkconfig
+// to match. Interrupts are allocated on the core that installs them, so the
+// audio drivers must be initialised from a core 1 task.
+#define AUDIO_TASKS_CORE_AUDIO 1
+#define AUDIO_TASKS_CORE_NETWORK 0
+#define AUDIO_TASKS_MAX 8   // Tasks tracked for the stack report
+
+typedef struct {
+    const char *name;
+    uint32_t stack;         // Bytes; size from the audio_tasks_report() margins
+    UBaseType_t priority;
+    BaseType_t core;        // AUDIO_TASKS_CORE_*, or tskNO_AFFINITY
+} audio_task_config_t;
+
+// Create a task as configured and track it for the report. `config` is
+// kept, so it must outlive the task.
+esp_err_t audio_tasks_create(const audio_task_config_t *config, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+// Name and least free stack (bytes) of the `index`th tracked task. Returns
+// false past the last one.
+bool audio_tasks_stack_info(size_t index, const char **name, uint32_t *min_free);
+
+// Log each tracked task's stack size and the least free stack it has had
+void audio_tasks_report(void);
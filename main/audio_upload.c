@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_http_client.h"
+#include "audio_base64.h"
+#include "audio_pack12.h"
+#include "audio_wav.h"
+#include "audio_upload.h"
+
+#define UPLOAD_RAW_BYTES (AUDIO_UPLOAD_FRAME_SAMPLES * sizeof(int16_t))
+#define UPLOAD_STR(x) #x
+#define UPLOAD_XSTR(x) UPLOAD_STR(x)
+#define AUDIO_UPLOAD_FRAME_SAMPLES_STR UPLOAD_XSTR(AUDIO_UPLOAD_FRAME_SAMPLES)
+#define UPLOAD_ENCODED_BYTES (AUDIO_BASE64_UPDATE_MAX(UPLOAD_RAW_BYTES) + 4)
+#define UPLOAD_SEQUENCE_BYTES (AUDIO_UPLOAD_MAX_RANGES * 42)   // "first-last," with 20-digit numbers
+
+static const char *TAG = "AudioUpload";
+
+// Session working set; everything the stream needs lives here and is reused
+// by every upload on the session
+typedef struct audio_upload_session {
+    audio_upload_config_t config;
+    esp_http_client_handle_t client;
+    audio_upload_stats_t *stats;                // Of the upload in progress
+    bool new_connection;                        // Set by HTTP_EVENT_ON_CONNECTED
+    bool server_close;                          // Response carried "Connection: close"
+    int16_t frame[AUDIO_UPLOAD_FRAME_SAMPLES];
+    uint8_t raw[UPLOAD_RAW_BYTES];
+    audio_base64_t base64;                      // Carries partial groups between frames
+    char encoded[UPLOAD_ENCODED_BYTES];
+    audio_codec_t codec;
+    audio_codec_state_t codec_state;
+    uint64_t bytes_sent;
+    char sequence[UPLOAD_SEQUENCE_BYTES];       // Ranges of the clip in progress; empty if unknown
+
+    // WAV only
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+    size_t header_len;
+    uint64_t total_bytes;
+    uint64_t acked;                             // From the last "Range: bytes=0-N" response
+    bool have_range;
+} upload_stream_t;
+
+// Open a request, reusing the kept-alive connection when there is one
+static esp_err_t upload_open(upload_stream_t *up, int64_t content_length) {
+    up->new_connection = false;
+    up->server_close = false;
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_http_client_open(up->client, content_length);
+    if (up->new_connection) {
+        up->stats->connections++;
+        up->stats->connect_us += esp_timer_get_time() - start;
+    }
+    return err;
+}
+
+// Wait for the response headers; the time the server took is recorded
+static esp_err_t upload_fetch_response(upload_stream_t *up) {
+    int64_t start = esp_timer_get_time();
+    int64_t length = esp_http_client_fetch_headers(up->client);
+    up->stats->response_us += esp_timer_get_time() - start;
+    return length < 0 ? ESP_FAIL : ESP_OK;
+}
+
+// Drain the response so the connection can carry the next request, or close
+// it when the server asked to
+static void upload_end_response(upload_stream_t *up) {
+    if (up->server_close || esp_http_client_flush_response(up->client, NULL) != ESP_OK ||
+        !esp_http_client_is_complete_data_received(up->client)) {
+        esp_http_client_close(up->client);
+    }
+}
+
+// Write one HTTP/1.1 chunk: "<hex len>\r\n<data>\r\n"
+static esp_err_t upload_write_chunk(upload_stream_t *up, const void *data, size_t len) {
+    char header[12];
+    int header_len = snprintf(header, sizeof(header), "%x\r\n", (unsigned)len);
+
+    if (len == 0) {
+        return ESP_OK; // A zero-length chunk would end the body
+    }
+    if (esp_http_client_write(up->client, header, header_len) != header_len ||
+        esp_http_client_write(up->client, data, len) != (int)len ||
+        esp_http_client_write(up->client, "\r\n", 2) != 2) {
+        return ESP_FAIL;
+    }
+    up->bytes_sent += len;
+    return ESP_OK;
+}
+
+static esp_err_t upload_write_raw(upload_stream_t *up, const void *data, size_t len) {
+    if (len > 0 && esp_http_client_write(up->client, data, len) != (int)len) {
+        return ESP_FAIL;
+    }
+    up->bytes_sent += len;
+    return ESP_OK;
+}
+
+// Base64 one frame; the encoder keeps any partial group for the next one
+static esp_err_t upload_encode_frame(upload_stream_t *up, const uint8_t *raw, size_t raw_len, bool last) {
+    int64_t start = esp_timer_get_time();
+    size_t out_len = audio_base64_update(&up->base64, raw, raw_len, up->encoded);
+    if (last) {
+        out_len += audio_base64_finish(&up->base64, up->encoded + out_len);
+    }
+    up->stats->encode_us += esp_timer_get_time() - start;
+    return upload_write_chunk(up, up->encoded, out_len);
+}
+
+// Format the source's ranges as "first-last,first-last" into up->sequence
+static void upload_format_sequence(upload_stream_t *up, const audio_upload_source_t *source) {
+    size_t len = 0;
+
+    up->sequence[0] = '\0';
+    for (size_t i = 0; i < source->range_count && i < AUDIO_UPLOAD_MAX_RANGES; ++i) {
+        const audio_upload_range_t *range = &source->ranges[i];
+        if (range->count == 0) {
+            continue;
+        }
+        len += snprintf(up->sequence + len, sizeof(up->sequence) - len, "%s%llu-%llu", len > 0 ? "," : "",
+                        (unsigned long long)range->first, (unsigned long long)(range->first + range->count - 1));
+    }
+}
+
+static esp_err_t upload_send_body(upload_stream_t *up, const audio_upload_source_t *source) {
+    static const char sequence_prefix[] = "{\"sequence\":\"";
+    static const char sequence_suffix[] = "\",\"audio\":\"";
+    static const char prefix[] = "{\"audio\":\"";
+    static const char suffix[] = "\"}";
+    esp_err_t err;
+
+    if (up->sequence[0] != '\0') {
+        err = upload_write_chunk(up, sequence_prefix, sizeof(sequence_prefix) - 1);
+        if (err == ESP_OK) {
+            err = upload_write_chunk(up, up->sequence, strlen(up->sequence));
+        }
+        if (err == ESP_OK) {
+            err = upload_write_chunk(up, sequence_suffix, sizeof(sequence_suffix) - 1);
+        }
+    } else {
+        err = upload_write_chunk(up, prefix, sizeof(prefix) - 1);
+    }
+
+    for (size_t offset = 0; err == ESP_OK && offset < source->samples;) {
+        size_t want = source->samples - offset;
+        if (want > AUDIO_UPLOAD_FRAME_SAMPLES) {
+            want = AUDIO_UPLOAD_FRAME_SAMPLES;
+        }
+        if (source->read(source->ctx, offset, up->frame, want) != want) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        offset += want;
+
+        bool last = offset == source->samples;
+        if (up->codec == AUDIO_CODEC_PCM16) {
+            err = upload_encode_frame(up, (const uint8_t *)up->frame, want * sizeof(int16_t), last);
+        } else {
+            int64_t start = esp_timer_get_time();
+            audio_codec_adc_to_pcm(up->frame, want);
+            size_t raw_len = audio_codec_encode(up->codec, &up->codec_state, up->frame, want, up->raw);
+            up->stats->encode_us += esp_timer_get_time() - start;
+            err = upload_encode_frame(up, up->raw, raw_len, last);
+        }
+    }
+    if (err == ESP_OK) {
+        err = upload_write_chunk(up, suffix, sizeof(suffix) - 1);
+    }
+    if (err == ESP_OK && esp_http_client_write(up->client, "0\r\n\r\n", 5) != 5) {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+static esp_err_t upload_json(upload_stream_t *up, const audio_upload_source_t *source, audio_upload_stats_t *stats) {
+    esp_http_client_set_header(up->client, "Content-Type", "application/json");
+    if (up->codec == AUDIO_CODEC_IMA_ADPCM) {
+        esp_http_client_set_header(up->client, "X-Audio-Frame-Samples", AUDIO_UPLOAD_FRAME_SAMPLES_STR);
+    }
+
+    // A kept-alive connection may have been dropped by the server while idle;
+    // that shows up as a failed write or response and gets one fresh retry
+    esp_err_t err = ESP_FAIL;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        stats->attempts++;
+        audio_base64_init(&up->base64);
+        memset(&up->codec_state, 0, sizeof(up->codec_state));
+
+        err = upload_open(up, -1); // -1: chunked transfer encoding
+        bool reused = !up->new_connection;
+        if (err == ESP_OK) {
+            int64_t start = esp_timer_get_time();
+            err = upload_send_body(up, source);
+            stats->transfer_us += esp_timer_get_time() - start;
+        }
+        if (err == ESP_OK) {
+            err = upload_fetch_response(up);
+        }
+        if (err == ESP_OK || err == ESP_ERR_INVALID_STATE || !reused) {
+            break;
+        }
+        ESP_LOGW(TAG, "Kept-alive connection was closed, reconnecting");
+        esp_http_client_close(up->client);
+    }
+
+    int status = esp_http_client_get_status_code(up->client);
+    if (err == ESP_OK && (status < 200 || status >= 400)) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    stats->status_code = status;
+    return err;
+}
+
+// The server reports how much it holds with "Range: bytes=0-N"
+static esp_err_t upload_on_event(esp_http_client_event_t *evt) {
+    upload_stream_t *up = evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED) {
+        up->new_connection = true;
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Connection") == 0) {
+        up->server_close = strcasecmp(evt->header_value, "close") == 0;
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Range") == 0) {
+        const char *dash = strchr(evt->header_value, '-');
+        if (dash != NULL) {
+            up->acked = strtoull(dash + 1, NULL, 10) + 1;
+            up->have_range = true;
+        }
+    }
+    return ESP_OK;
+}
+
+// PUT bytes [offset, total) of the WAV file, re-reading the clip from the source
+static esp_err_t upload_wav_send_from(upload_stream_t *up, const audio_upload_source_t *source, uint64_t offset) {
+    char range[64];
+    snprintf(range, sizeof(range), "bytes %llu-%llu/%llu", (unsigned long long)offset,
+             (unsigned long long)(up->total_bytes - 1), (unsigned long long)up->total_bytes);
+    esp_http_client_set_header(up->client, "Content-Range", range);
+
+    esp_err_t err = upload_open(up, up->total_bytes - offset);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int64_t start = esp_timer_get_time();
+
+    if (offset < up->header_len) {
+        err = upload_write_raw(up, up->header + offset, up->header_len - offset);
+        offset = up->header_len;
+    }
+
+    size_t bytes_per_sample = audio_codec_frame_bytes(up->codec, 1);
+    uint64_t data_offset = offset - up->header_len;
+    size_t sample = data_offset / bytes_per_sample;
+    size_t skip = data_offset % bytes_per_sample;
+
+    while (err == ESP_OK && sample < source->samples) {
+        size_t want = source->samples - sample;
+        if (want > AUDIO_UPLOAD_FRAME_SAMPLES) {
+            want = AUDIO_UPLOAD_FRAME_SAMPLES;
+        }
+        if (source->read(source->ctx, sample, up->frame, want) != want) {
+            return ESP_ERR_INVALID_STATE; // Clip is gone
+        }
+
+        int64_t encode_start = esp_timer_get_time();
+        audio_codec_adc_to_pcm(up->frame, want);
+        size_t raw_len = audio_codec_encode(up->codec, &up->codec_state, up->frame, want, up->raw);
+        up->stats->encode_us += esp_timer_get_time() - encode_start;
+        err = upload_write_raw(up, up->raw + skip, raw_len - skip);
+        skip = 0;
+        sample += want;
+    }
+    up->stats->transfer_us += esp_timer_get_time() - start;
+    return err;
+}
+
+// After a broken transfer, ask how much arrived. Returns ESP_OK when the
+// server already has everything.
+static esp_err_t upload_wav_query(upload_stream_t *up, uint64_t *offset) {
+    char range[48];
+    snprintf(range, sizeof(range), "bytes */%llu", (unsigned long long)up->total_bytes);
+    esp_http_client_set_header(up->client, "Content-Range", range);
+
+    up->have_range = false;
+    if (upload_open(up, 0) != ESP_OK || upload_fetch_response(up) != ESP_OK) {
+        esp_http_client_close(up->client);
+        return ESP_FAIL; // Keep the last known offset
+    }
+    int status = esp_http_client_get_status_code(up->client);
+    if (status == 200 || status == 201) {
+        return ESP_OK;
+    }
+    if (status == 308) {
+        *offset = up->have_range ? up->acked : 0;
+        upload_end_response(up);
+    } else {
+        esp_http_client_close(up->client);
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+static esp_err_t upload_wav(upload_stream_t *up, const audio_upload_config_t *config,
+                            const audio_upload_source_t *source, audio_upload_stats_t *stats) {
+    uint32_t data_bytes = audio_codec_frame_bytes(up->codec, source->samples);
+    up->header_len = audio_wav_header(up->header, up->codec, config->sample_rate, config->channels, data_bytes);
+    if (up->header_len == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    up->total_bytes = up->header_len + data_bytes;
+
+    char upload_id[12];
+    snprintf(upload_id, sizeof(upload_id), "%08lx", (unsigned long)esp_random());
+    esp_http_client_set_method(up->client, HTTP_METHOD_PUT);
+    esp_http_client_set_header(up->client, "Content-Type", "application/octet-stream");
+    esp_http_client_set_header(up->client, "X-Upload-Id", upload_id);
+
+    uint64_t offset = 0;
+    esp_err_t err = ESP_FAIL;
+    while (stats->attempts < AUDIO_UPLOAD_MAX_ATTEMPTS) {
+        stats->attempts++;
+        up->have_range = false;
+        err = upload_wav_send_from(up, source, offset);
+        bool reused = !up->new_connection;
+        if (err == ESP_ERR_INVALID_STATE) {
+            return err;
+        }
+        if (err == ESP_OK && upload_fetch_response(up) == ESP_OK) {
+            int status = esp_http_client_get_status_code(up->client);
+            stats->status_code = status;
+            if (status == 200 || status == 201) {
+                return ESP_OK;
+            }
+            if (status != 308) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            // Server kept part of the body; continue after what it has
+            offset = up->have_range ? up->acked : 0;
+            upload_end_response(up);
+            continue;
+        }
+
+        esp_http_client_close(up->client);
+        if (reused && stats->attempts == 1) {
+            // The connection kept from the last upload was closed by the
+            // server while idle. Nothing has been acknowledged yet, so start
+            // over on a fresh connection rather than query (as for JSON).
+            ESP_LOGW(TAG, "Kept-alive connection was closed, reconnecting");
+            continue;
+        }
+        ESP_LOGW(TAG, "Transfer broke on attempt %lu, querying server", (unsigned long)stats->attempts);
+        err = upload_wav_query(up, &offset);
+        if (err == ESP_OK) {
+            stats->status_code = esp_http_client_get_status_code(up->client);
+            return ESP_OK;
+        }
+        ESP_LOGI(TAG, "Resuming at byte %llu of %llu", (unsigned long long)offset,
+                 (unsigned long long)up->total_bytes);
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t audio_upload_session_open(const audio_upload_config_t *config, audio_upload_session_t *session) {
+    // Frames hold whole sample periods, so each one is a run of all channels
+    if (config->channels == 0 || AUDIO_UPLOAD_FRAME_SAMPLES % config->channels != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->channels > 1 && config->codec == AUDIO_CODEC_IMA_ADPCM) {
+        return ESP_ERR_NOT_SUPPORTED; // One predictor per frame would straddle the channels
+    }
+    upload_stream_t *up = calloc(1, sizeof(upload_stream_t));
+    if (up == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    up->config = *config;
+    up->codec = config->codec;
+
+    esp_http_client_config_t http_config = {
+        .url = config->url,
+        .method = HTTP_METHOD_POST,
+        .event_handler = upload_on_event,
+        .user_data = up,
+        .keep_alive_enable = true,  // TCP keep-alive probes notice a dead idle connection
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,    // Reconnects resume the TLS session instead of a full handshake
+#endif
+    };
+    up->client = esp_http_client_init(&http_config);
+    if (up->client == NULL) {
+        free(up);
+        return ESP_FAIL;
+    }
+    esp_http_client_set_header(up->client, "X-Audio-Codec", audio_codec_name(up->codec));
+    if (config->channels > 1) {
+        char channels[8];
+        snprintf(channels, sizeof(channels), "%u", (unsigned)config->channels);
+        esp_http_client_set_header(up->client, "X-Audio-Channels", channels);
+    }
+    *session = up;
+    return ESP_OK;
+}
+
+esp_err_t audio_upload_session_send(audio_upload_session_t session, const audio_upload_source_t *source,
+                                    audio_upload_stats_t *stats) {
+    upload_stream_t *up = session;
+    audio_upload_stats_t local_stats;
+    if (stats == NULL) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    up->stats = stats;
+    up->bytes_sent = 0;
+    audio_base64_init(&up->base64);
+    memset(&up->codec_state, 0, sizeof(up->codec_state));
+
+    upload_format_sequence(up, source);
+    if (up->sequence[0] != '\0') {
+        esp_http_client_set_header(up->client, "X-Audio-Sequence", up->sequence);
+    } else {
+        esp_http_client_delete_header(up->client, "X-Audio-Sequence");
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err;
+    if (up->config.format == AUDIO_UPLOAD_WAV) {
+        err = upload_wav(up, &up->config, source, stats);
+    } else {
+        err = upload_json(up, source, stats);
+    }
+    stats->bytes_sent = up->bytes_sent;
+    stats->elapsed_us = esp_timer_get_time() - start;
+
+    if (err == ESP_OK) {
+        upload_end_response(up);
+    } else {
+        esp_http_client_close(up->client);
+        ESP_LOGE(TAG, "Upload failed after %llu bytes: %s (HTTP %d)",
+                 (unsigned long long)up->bytes_sent, esp_err_to_name(err), stats->status_code);
+    }
+    ESP_LOGD(TAG, "connections %lu, connect %lld us, transfer %lld us, response %lld us",
+             (unsigned long)stats->connections, (long long)stats->connect_us, (long long)stats->transfer_us,
+             (long long)stats->response_us);
+    up->stats = NULL;
+    return err;
+}
+
+void audio_upload_session_close(audio_upload_session_t session) {
+    if (session == NULL) {
+        return;
+    }
+    esp_http_client_close(session->client);
+    esp_http_client_cleanup(session->client);
+    free(session);
+}
+
+esp_err_t audio_upload_stream(const audio_upload_config_t *config, const audio_upload_source_t *source,
+                              audio_upload_stats_t *stats) {
+    audio_upload_session_t session;
+    esp_err_t err = audio_upload_session_open(config, &session);
+    if (err == ESP_OK) {
+        err = audio_upload_session_send(session, source, stats);
+        audio_upload_session_close(session);
+    }
+    return err;
+}
+
+size_t audio_upload_read_buffer(void *ctx, size_t offset, int16_t *out, size_t count) {
+    memcpy(out, (const int16_t *)ctx + offset, count * sizeof(int16_t));
+    return count;
+}
+
+size_t audio_upload_read_packed(void *ctx, size_t offset, int16_t *out, size_t count) {
+    audio_unpack12(ctx, offset, out, count);
+    return count;
+}
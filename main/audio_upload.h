@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_codec.h"
+
+#define AUDIO_UPLOAD_FRAME_SAMPLES 384 // 768 bytes, a multiple of 3 so base64 rarely carries
+#define AUDIO_UPLOAD_MAX_ATTEMPTS 5    // WAV: transfers tried before giving up
+#define AUDIO_UPLOAD_MAX_RANGES 32     // Sequence ranges one clip can carry
+
+// Body format
+typedef enum {
+    AUDIO_UPLOAD_JSON_BASE64,   // {"audio":"<base64>"}, chunked
+    AUDIO_UPLOAD_WAV,           // Binary RIFF/WAVE, resumable by byte range
+} audio_upload_format_t;
+
+// Where and how to upload
+typedef struct {
+    const char *url;
+    audio_upload_format_t format;
+    audio_codec_t codec;    // Applied per frame; WAV supports PCM16 and mu-law
+    uint32_t sample_rate;   // Written into the WAV header
+    uint16_t channels;      // Interleaved in every clip; a stereo clip makes a stereo WAV. ADPCM is mono only.
+} audio_upload_config_t;
+
+// Random-access reader for the clip being uploaded. Returns samples copied;
+// fewer than asked means the audio is no longer available.
+typedef size_t (*audio_upload_read_fn_t)(void *ctx, size_t offset, int16_t *out, size_t count);
+
+// Samples of the capture stream by sequence number: every sample captured
+// since boot is numbered in order, so the server can place each clip in the
+// stream and stitch clips back together. With several channels each sample
+// of each channel has its own number, in interleaved order.
+typedef struct {
+    uint64_t first;
+    uint32_t count;
+} audio_upload_range_t;
+
+// A clip of raw ADC samples wherever it is stored (RAM snapshot, flash, ...)
+typedef struct {
+    audio_upload_read_fn_t read;
+    void *ctx;
+    size_t samples;
+    const audio_upload_range_t *ranges; // Where the samples sit in the stream, in order; NULL if unknown
+    size_t range_count;                 // At most AUDIO_UPLOAD_MAX_RANGES, covering `samples` in total
+} audio_upload_source_t;
+
+// Result of one upload
+typedef struct {
+    uint64_t bytes_sent;    // HTTP body bytes over all attempts, excluding chunk framing
+    int64_t elapsed_us;     // From first connect to the final response
+    int status_code;
+    uint32_t attempts;      // Transfers started (WAV resumes count separately)
+    uint32_t connections;   // New connections opened; 0 when a kept-alive one was reused
+    int64_t connect_us;     // DNS, TCP connect and TLS handshake of those connections
+    int64_t transfer_us;    // Writing request bodies
+    int64_t encode_us;      // Codec and base64 work, part of transfer_us
+    int64_t response_us;    // Waiting for response headers after the body
+} audio_upload_stats_t;
+
+// A persistent client. The connection is kept alive between uploads and,
+// with CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS, TLS sessions are resumed when
+// it has to be reopened. Not thread safe; use one session per task.
+typedef struct audio_upload_session *audio_upload_session_t;
+
+// Upload the clip on a one-off session. Memory use is a few frames regardless of length. With a
+// codec other than PCM16 the ADC readings are converted to signed PCM and
+// each frame encoded on its own.
+//
+// The sequence ranges go in an "X-Audio-Sequence: 1000-1999,4000-4499"
+// header (first-last, inclusive, like byte ranges) and, for JSON, also in a
+// "sequence" field of the body.
+//
+// JSON: one chunked POST. WAV: PUT with Content-Range. The server answers
+// 308 with "Range: bytes=0-N" for a partial body; after a dropped
+// connection a "Content-Range: bytes */total" query finds the acknowledged
+// offset and only the missing tail is re-read and re-sent.
+esp_err_t audio_upload_stream(const audio_upload_config_t *config, const audio_upload_source_t *source,
+                              audio_upload_stats_t *stats);
+
+// Create a session for `config`. Nothing is connected until the first send.
+// ESP_ERR_NOT_SUPPORTED for ADPCM with more than one channel.
+esp_err_t audio_upload_session_open(const audio_upload_config_t *config, audio_upload_session_t *session);
+
+// Upload one clip as audio_upload_stream() does, over the session's
+// connection. A connection the server closed while idle is reopened once.
+esp_err_t audio_upload_session_send(audio_upload_session_t session, const audio_upload_source_t *source,
+                                    audio_upload_stats_t *stats);
+
+// Close the connection and free the session
+void audio_upload_session_close(audio_upload_session_t session);
+
+// Source reader over a flat sample buffer (ctx is the int16_t array)
+size_t audio_upload_read_buffer(void *ctx, size_t offset, int16_t *out, size_t count);
+
+// Source reader over packed 12-bit samples (ctx is the audio_pack12 buffer)
+size_t audio_upload_read_packed(void *ctx, size_t offset, int16_t *out, size_t count);
@@ -0,0 +1,270 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "audio_uploader.h"
+#include "audio_clip_store.h"
+#include "audio_tasks.h"
+#include "audio_metrics.h"
+#include "clip_log.h"
+
+#define UPLOADER_COPY_SAMPLES 256   // Ring reads per pack pass when snapshotting
+
+// Reader for a clip still in the ring, for the snapshot. The low 32 bits of
+// a sequence number are its ring position.
+typedef struct {
+    const audio_ring_t *ring;
+    const audio_upload_range_t *ranges;     // Parts of the ring read, end to end
+    size_t range_count;
+} uploader_ring_ctx_t;
+
+static const char *TAG = "AudioUploader";
+
+static audio_uploader_config_t s_config;
+static QueueHandle_t s_queue;               // Ids of clips in s_store, oldest first
+static audio_clip_store_t s_store;
+static audio_upload_session_t s_session;    // Shared by all uploads so the connection is reused
+static uint64_t s_next_sequence;            // Submitting task: everything before this has been queued
+
+static size_t uploader_read_ring(void *ctx, size_t offset, int16_t *out, size_t count) {
+    const uploader_ring_ctx_t *rc = ctx;
+    size_t done = 0;
+
+    // Find the range holding `offset`, then read across ranges
+    size_t range = 0;
+    while (range < rc->range_count && offset >= rc->ranges[range].count) {
+        offset -= rc->ranges[range++].count;
+    }
+    while (done < count && range < rc->range_count) {
+        audio_ring_cursor_t cursor = {.pos = (uint32_t)rc->ranges[range].first + offset};
+        size_t want = rc->ranges[range].count - offset;
+        if (want > count - done) {
+            want = count - done;
+        }
+        while (want > 0) {
+            uint32_t expected = cursor.pos;
+            size_t n = audio_ring_read(rc->ring, &cursor, out + done, want);
+            if (n == 0 || cursor.pos - n != expected) {
+                return done; // Overwritten or not yet recorded
+            }
+            done += n;
+            want -= n;
+        }
+        range++;
+        offset = 0;
+    }
+    return done;
+}
+
+// Copy a clip out of the ring into its slabs in the store
+static esp_err_t uploader_snapshot(const uploader_ring_ctx_t *rc, uint32_t id, size_t samples) {
+    int16_t chunk[UPLOADER_COPY_SAMPLES];
+
+    for (size_t done = 0; done < samples;) {
+        size_t n = samples - done < UPLOADER_COPY_SAMPLES ? samples - done : UPLOADER_COPY_SAMPLES;
+        if (uploader_read_ring((void *)rc, done, chunk, n) != n) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (audio_clip_store_write(&s_store, id, done, chunk, n) != n) {
+            return ESP_ERR_NO_MEM; // Evicted already
+        }
+        done += n;
+    }
+    return ESP_OK;
+}
+
+static void uploader_record_metrics(const audio_upload_stats_t *stats, esp_err_t err) {
+    audio_metrics_add(err == ESP_OK ? AUDIO_METRIC_UPLOAD_CLIPS : AUDIO_METRIC_UPLOAD_FAILURES, 1);
+    audio_metrics_add(AUDIO_METRIC_UPLOAD_BYTES, stats->bytes_sent);
+    audio_metrics_add(AUDIO_METRIC_UPLOAD_CONNECTIONS, stats->connections);
+    if (stats->connections > 0) {
+        audio_metrics_record(AUDIO_METRIC_HTTP_CONNECT_US, stats->connect_us / stats->connections);
+    }
+    audio_metrics_record(AUDIO_METRIC_ENCODE_US, stats->encode_us);
+    audio_metrics_record(AUDIO_METRIC_HTTP_TRANSFER_US, stats->transfer_us);
+    audio_metrics_record(AUDIO_METRIC_HTTP_RESPONSE_US, stats->response_us);
+}
+
+// Upload with bounded retries and exponential backoff
+static esp_err_t uploader_send(const audio_upload_source_t *source) {
+    esp_err_t err = ESP_FAIL;
+
+    for (int attempt = 0; attempt < AUDIO_UPLOADER_RETRIES; ++attempt) {
+        if (attempt > 0) {
+            vTaskDelay(pdMS_TO_TICKS(AUDIO_UPLOADER_BACKOFF_MS << (attempt - 1)));
+        }
+        audio_upload_stats_t stats;
+        err = audio_upload_session_send(s_session, source, &stats);
+        uploader_record_metrics(&stats, err);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Uploaded %u samples (%llu bytes in %lld ms: connect %lld, transfer %lld, "
+                     "response %lld, %s)", (unsigned)source->samples, (unsigned long long)stats.bytes_sent,
+                     (long long)(stats.elapsed_us / 1000), (long long)(stats.connect_us / 1000),
+                     (long long)(stats.transfer_us / 1000), (long long)(stats.response_us / 1000),
+                     stats.connections ? "new connection" : "reused");
+            return ESP_OK;
+        }
+        if (err == ESP_ERR_INVALID_STATE) {
+            break; // Audio is gone, retrying cannot help
+        }
+    }
+    return err;
+}
+
+static void uploader_spill(const audio_upload_source_t *source) {
+    if (!s_config.spill_to_flash) {
+        ESP_LOGE(TAG, "Dropping clip of %u samples", (unsigned)source->samples);
+        return;
+    }
+    esp_err_t err = clip_log_append(source);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not store clip in flash: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Clip of %u samples stored in flash for later", (unsigned)source->samples);
+    }
+}
+
+// Retry stored clips, oldest first, while no live clip is waiting
+static void uploader_drain_flash(void) {
+    clip_log_entry_t entry;
+    while (uxQueueMessagesWaiting(s_queue) == 0 && clip_log_peek(&entry)) {
+        audio_upload_range_t range = {.first = entry.sequence, .count = entry.samples};
+        audio_upload_source_t source = {
+            .read = clip_log_read,
+            .ctx = &entry,
+            .samples = entry.samples,
+            .ranges = &range,
+            .range_count = entry.sequence == UINT64_MAX ? 0 : 1,
+        };
+        esp_err_t err = uploader_send(&source);
+        if (err == ESP_ERR_INVALID_STATE) {
+            ESP_LOGE(TAG, "Stored clip %lu is corrupt, discarding", (unsigned long)entry.id);
+        } else if (err != ESP_OK) {
+            break; // Still offline
+        }
+        clip_log_pop();
+    }
+}
+
+// Upload (or spill) a stored clip and free it
+static void uploader_upload_stored(uint32_t id) {
+    audio_clip_store_clip_t clip;
+    audio_clip_store_reader_t reader = {.store = &s_store, .id = id};
+
+    if (!audio_clip_store_get(&s_store, id, &clip)) {
+        ESP_LOGW(TAG, "Clip %lu was dropped for newer clips before it could be uploaded", (unsigned long)id);
+        audio_metrics_add(AUDIO_METRIC_UPLOAD_EVICTIONS, 1);
+        return;
+    }
+    audio_upload_source_t source = {
+        .read = audio_clip_store_read_source,
+        .ctx = &reader,
+        .samples = clip.samples,
+        .ranges = clip.ranges,
+        .range_count = clip.range_count,
+    };
+    if (uploader_send(&source) != ESP_OK) {
+        uploader_spill(&source);
+    }
+    audio_clip_store_free(&s_store, id);
+}
+
+static void uploader_task(void *arg) {
+    uint32_t id;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &id, pdMS_TO_TICKS(AUDIO_UPLOADER_DRAIN_MS)) == pdTRUE) {
+            uploader_upload_stored(id);
+        }
+        if (s_config.spill_to_flash) {
+            uploader_drain_flash();
+        }
+    }
+}
+
+esp_err_t audio_uploader_start(const audio_uploader_config_t *config) {
+    s_config = *config;
+    esp_err_t err = audio_clip_store_init(&s_store, s_config.store_arena, s_config.store_bytes);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = audio_upload_session_open(&s_config.upload, &s_session);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // One entry per clip the store can hold, so a clip always finds room
+    s_queue = xQueueCreate(AUDIO_CLIP_STORE_MAX_CLIPS, sizeof(uint32_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return audio_tasks_create(&s_config.task, uploader_task, NULL, NULL);
+}
+
+esp_err_t audio_uploader_submit(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples) {
+    audio_vad_segment_t whole = {.offset = 0, .count = samples};
+    return audio_uploader_submit_segments(ring, cursor, &whole, 1);
+}
+
+// Sequence number of ring position `pos`. Positions are 32-bit and wrap, so
+// they are taken relative to the last sequence number handed out.
+static uint64_t uploader_sequence(uint32_t pos) {
+    return s_next_sequence + (int32_t)(pos - (uint32_t)s_next_sequence);
+}
+
+esp_err_t audio_uploader_submit_segments(const audio_ring_t *ring, audio_ring_cursor_t cursor,
+                                         const audio_vad_segment_t *segments, size_t segment_count) {
+    audio_upload_range_t ranges[AUDIO_UPLOAD_MAX_RANGES];
+    size_t range_count = 0;
+    size_t samples = 0;
+    uint64_t next = s_next_sequence;
+
+    // Number the segments and drop whatever was queued before, so samples
+    // are sent once and in order however clips overlap. The numbers are
+    // only taken once the clip is queued: a dropped clip leaves no gap, and
+    // its samples go out with the next clip that still covers them.
+    for (size_t i = 0; i < segment_count && range_count < AUDIO_UPLOAD_MAX_RANGES; ++i) {
+        uint64_t first = uploader_sequence(cursor.pos + segments[i].offset);
+        uint64_t end = first + segments[i].count;
+        if (first < next) {
+            first = next;
+        }
+        if (first >= end) {
+            continue;
+        }
+        ranges[range_count++] = (audio_upload_range_t){.first = first, .count = end - first};
+        samples += end - first;
+        next = end;
+    }
+    if (samples == 0) {
+        return ESP_OK;
+    }
+
+    uploader_ring_ctx_t ring_ctx = {
+        .ring = ring,
+        .ranges = ranges,
+        .range_count = range_count,
+    };
+
+    // Flash is the upload task's (core 0): a clip that cannot be queued here
+    // is dropped rather than spilled from the audio core
+    uint32_t id;
+    esp_err_t err = audio_clip_store_alloc(&s_store, samples, ranges, range_count, &id);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Dropping clip of %u samples: larger than the clip store", (unsigned)samples);
+        audio_metrics_add(AUDIO_METRIC_UPLOAD_DROPS, 1);
+        return err;
+    }
+    err = uploader_snapshot(&ring_ctx, id, samples);
+    if (err == ESP_OK && xQueueSend(s_queue, &id, 0) != pdTRUE) {
+        // Queue full of ids whose clips were since dropped
+        ESP_LOGE(TAG, "Dropping clip of %u samples: upload queue full", (unsigned)samples);
+        audio_metrics_add(AUDIO_METRIC_UPLOAD_DROPS, 1);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        audio_clip_store_free(&s_store, id);
+        return err;
+    }
+    s_next_sequence = next;
+    return ESP_OK;
+}
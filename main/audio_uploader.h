@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_ring.h"
+#include "audio_upload.h"
+#include "audio_tasks.h"
+#include "audio_vad.h"
+
+#define AUDIO_UPLOADER_RETRIES 3           // Attempts per clip before spilling to flash
+#define AUDIO_UPLOADER_BACKOFF_MS 1000     // Doubled after each failed attempt
+#define AUDIO_UPLOADER_DRAIN_MS 30000      // How often stored clips are retried when idle
+
+typedef struct {
+    audio_upload_config_t upload;
+    bool spill_to_flash;    // Keep clips in the clip log when their uploads fail (written by the upload task)
+    void *store_arena;      // Holds the clip snapshots waiting for upload (audio_clip_store), e.g. PSRAM
+    size_t store_bytes;
+    audio_task_config_t task;   // Upload task; network and flash work, so core 0
+} audio_uploader_config_t;
+
+// Create the upload task and its clip store and queue
+esp_err_t audio_uploader_start(const audio_uploader_config_t *config);
+
+// Snapshot the clip out of the ring into the clip store and queue it for
+// upload. Never waits on the network or flash or allocates; if the store is
+// full the oldest clips still waiting are dropped to make room. A clip larger
+// than the whole store, or one that finds the queue full, is dropped and
+// counted (AUDIO_METRIC_UPLOAD_DROPS): ESP_ERR_NO_MEM.
+//
+// Ring positions become stream sequence numbers, sent with the clip (see
+// audio_upload.h). Samples queued by an earlier call are left out, so each
+// is uploaded once and in order; those of a dropped clip are not counted as
+// queued. Call from one task only.
+esp_err_t audio_uploader_submit(const audio_ring_t *ring, audio_ring_cursor_t cursor, size_t samples);
+
+// Same, for only the given segments of the clip starting at `cursor`
+// (e.g. the speech found by audio_vad), joined end to end. At most
+// AUDIO_UPLOAD_MAX_RANGES segments are sent.
+esp_err_t audio_uploader_submit_segments(const audio_ring_t *ring, audio_ring_cursor_t cursor,
+                                         const audio_vad_segment_t *segments, size_t segment_count);
@@ -0,0 +1,125 @@
+#include <string.h>
+#include "audio_vad.h"
+
+// Mean square over every channel of one frame, and zero crossings per 256
+// samples of the first channel, read in place
+static void vad_features(const int16_t *samples, size_t count, size_t channels, uint32_t *energy,
+                         uint32_t *zcr) {
+    uint64_t sum = 0;
+    uint32_t crossings = 0;
+    bool negative = samples[0] < 2048;
+
+    for (size_t i = 0; i < count; ++i) {
+        int32_t x = samples[i] - 2048;
+        sum += (uint32_t)(x * x);
+    }
+    for (size_t i = 0; i < count; i += channels) {
+        bool below = samples[i] < 2048;
+        if (below != negative) {
+            negative = below;
+            crossings++;
+        }
+    }
+    *energy = sum / count;
+    *zcr = crossings * 256 * channels / count;
+}
+
+// Extend the last segment, or open a new one with the pre-roll in front.
+// When all segments are used the last one is stretched over the gap.
+static void vad_keep(audio_vad_t *vad, uint32_t offset, uint32_t count) {
+    uint32_t preroll = AUDIO_VAD_PREROLL_SAMPLES * vad->channels;
+    uint32_t start = offset > preroll ? offset - preroll : 0;
+
+    if (vad->segment_count > 0) {
+        audio_vad_segment_t *last = &vad->segments[vad->segment_count - 1];
+        if (start <= last->offset + last->count || vad->segment_count == AUDIO_VAD_MAX_SEGMENTS) {
+            last->count = offset + count - last->offset;
+            return;
+        }
+    }
+    vad->segments[vad->segment_count++] = (audio_vad_segment_t){.offset = start, .count = offset + count - start};
+}
+
+// Slide the minimum window on by one frame and return the noise floor. The
+// window is kept across clips, so a new clip starts with a known floor.
+static uint32_t vad_noise_floor(audio_vad_t *vad, uint32_t energy) {
+    if (energy < vad->block_min) {
+        vad->block_min = energy;
+    }
+    if (++vad->block_frames == AUDIO_VAD_NOISE_BLOCK_FRAMES) {
+        memmove(vad->minima + 1, vad->minima, (AUDIO_VAD_NOISE_BLOCKS - 1) * sizeof(vad->minima[0]));
+        vad->minima[0] = vad->block_min;
+        vad->block_min = UINT32_MAX;
+        vad->block_frames = 0;
+    }
+
+    uint32_t noise = vad->block_min;
+    for (size_t i = 0; i < AUDIO_VAD_NOISE_BLOCKS; ++i) {
+        if (vad->minima[i] < noise) {
+            noise = vad->minima[i];
+        }
+    }
+    return noise > AUDIO_VAD_MIN_NOISE ? noise : AUDIO_VAD_MIN_NOISE;
+}
+
+void audio_vad_init(audio_vad_t *vad, size_t channels) {
+    *vad = (audio_vad_t){.block_min = UINT32_MAX, .channels = channels};
+    for (size_t i = 0; i < AUDIO_VAD_NOISE_BLOCKS; ++i) {
+        vad->minima[i] = UINT32_MAX;
+    }
+}
+
+void audio_vad_begin(audio_vad_t *vad) {
+    vad->hangover = 0;
+    vad->position = 0;
+    vad->frames = 0;
+    vad->speech_frames = 0;
+    vad->segment_count = 0;
+}
+
+bool audio_vad_process(audio_vad_t *vad, const int16_t *samples, size_t count) {
+    uint32_t energy;
+    uint32_t zcr;
+
+    if (count == 0) {
+        return false;
+    }
+    vad_features(samples, count, vad->channels, &energy, &zcr);
+
+    uint64_t noise = vad_noise_floor(vad, energy);
+    bool speech = energy > noise * AUDIO_VAD_SPEECH_RATIO ||
+                  (energy > noise * AUDIO_VAD_FRICATIVE_RATIO && zcr >= AUDIO_VAD_FRICATIVE_ZCR);
+
+    if (speech) {
+        vad->hangover = AUDIO_VAD_HANGOVER_FRAMES;
+        vad->speech_frames++;
+    }
+    bool keep = speech || vad->hangover > 0;
+    if (!speech && vad->hangover > 0) {
+        vad->hangover--;
+    }
+    if (keep) {
+        vad_keep(vad, vad->position, count);
+    }
+    vad->position += count;
+    vad->frames++;
+    return keep;
+}
+
+uint32_t audio_vad_finish(audio_vad_t *vad, uint32_t first, uint32_t end) {
+    size_t kept = 0;
+    uint32_t total = 0;
+
+    for (size_t i = 0; i < vad->segment_count; ++i) {
+        uint32_t start = vad->segments[i].offset;
+        uint32_t stop = start + vad->segments[i].count;
+        start = start > first ? start : first;
+        stop = stop < end ? stop : end;
+        if (start < stop) {
+            vad->segments[kept++] = (audio_vad_segment_t){.offset = start - first, .count = stop - start};
+            total += stop - start;
+        }
+    }
+    vad->segment_count = kept;
+    return total;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Frame-level voice activity detection on 12-bit ADC readings centred at
+// 2048 (capture with dc_block). A frame is speech when its energy is well
+// above the noise floor, or moderately above it with the high zero-crossing
+// rate of fricatives. The noise floor is the quietest frame of the last
+// couple of seconds (minimum statistics), so it follows a steady background
+// even while someone talks over it. Kept frames are collected into segments
+// of the clip, with a little audio before each onset and a hangover after
+// speech so words are not clipped.
+//
+// Interleaved frames of several channels are judged on their energy over
+// all channels and the zero crossings of the first; positions and segments
+// then count samples of all channels, like ring positions.
+
+#define AUDIO_VAD_MAX_SEGMENTS 32       // More are merged into the last one
+#define AUDIO_VAD_PREROLL_SAMPLES 1024  // Kept before an onset, per channel (64 ms at 16kHz)
+#define AUDIO_VAD_HANGOVER_FRAMES 12    // Frames kept after speech (~200 ms of 16 ms frames)
+#define AUDIO_VAD_SPEECH_RATIO 4        // Energy over noise floor for speech (6 dB)
+#define AUDIO_VAD_FRICATIVE_RATIO 2     // ... for high-ZCR frames (3 dB)
+#define AUDIO_VAD_FRICATIVE_ZCR 64      // Zero crossings per 256 samples of one channel
+#define AUDIO_VAD_MIN_NOISE 16          // Noise floor never below this mean square (4 LSB rms)
+#define AUDIO_VAD_NOISE_BLOCKS 4        // Noise floor window, in blocks of ...
+#define AUDIO_VAD_NOISE_BLOCK_FRAMES 32 // ... frames (4 x 0.5 s)
+
+// Part of a clip, in samples from its start
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+} audio_vad_segment_t;
+
+typedef struct {
+    uint32_t minima[AUDIO_VAD_NOISE_BLOCKS];    // Quietest frame energy of each recent block
+    uint32_t block_min;                         // ... and of the block in progress
+    uint32_t block_frames;
+    uint32_t hangover;      // Frames still kept after the last speech frame
+    uint32_t position;      // Samples of the current clip seen so far
+    uint32_t channels;      // Interleaved in each frame
+    uint32_t frames;
+    uint32_t speech_frames;
+    audio_vad_segment_t segments[AUDIO_VAD_MAX_SEGMENTS];
+    size_t segment_count;
+} audio_vad_t;
+
+// `channels` interleaved in every frame passed to process, 1 for mono
+void audio_vad_init(audio_vad_t *vad, size_t channels);
+
+// Start collecting segments for a new clip
+void audio_vad_begin(audio_vad_t *vad);
+
+// Classify the next frame of the clip. Returns true if it is kept.
+bool audio_vad_process(audio_vad_t *vad, const int16_t *samples, size_t count);
+
+// Limit the segments to samples [first, end) of the clip and rebase them on
+// `first`. Returns the number of samples kept.
+uint32_t audio_vad_finish(audio_vad_t *vad, uint32_t first, uint32_t end);
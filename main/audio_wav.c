@@ -0,0 +1,141 @@
+#include <stdbool.h>
+#include <string.h>
+#include "audio_wav.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_MULAW 7
+
+static uint8_t *wav_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *wav_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint16_t wav_get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t wav_get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t *wav_put_tag(uint8_t *p, const char *tag) {
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+size_t audio_wav_header(uint8_t *out, audio_codec_t codec, uint32_t sample_rate, uint16_t channels,
+                        uint32_t data_bytes) {
+    uint16_t format;
+    uint16_t bits;
+
+    switch (codec) {
+    case AUDIO_CODEC_PCM16:
+        format = WAV_FORMAT_PCM;
+        bits = 16;
+        break;
+    case AUDIO_CODEC_ULAW:
+        format = WAV_FORMAT_MULAW;
+        bits = 8;
+        break;
+    default:
+        return 0;
+    }
+
+    // Non-PCM formats need cbSize in fmt and a fact chunk
+    bool extended = format != WAV_FORMAT_PCM;
+    uint32_t fmt_size = extended ? 18 : 16;
+    size_t header_len = 12 + 8 + fmt_size + (extended ? 12 : 0) + 8;
+    uint16_t block_align = channels * bits / 8;
+
+    uint8_t *p = out;
+    p = wav_put_tag(p, "RIFF");
+    p = wav_put_u32(p, header_len - 8 + data_bytes);
+    p = wav_put_tag(p, "WAVE");
+
+    p = wav_put_tag(p, "fmt ");
+    p = wav_put_u32(p, fmt_size);
+    p = wav_put_u16(p, format);
+    p = wav_put_u16(p, channels);
+    p = wav_put_u32(p, sample_rate);
+    p = wav_put_u32(p, sample_rate * block_align);
+    p = wav_put_u16(p, block_align);
+    p = wav_put_u16(p, bits);
+    if (extended) {
+        p = wav_put_u16(p, 0);
+        p = wav_put_tag(p, "fact");
+        p = wav_put_u32(p, 4);
+        p = wav_put_u32(p, data_bytes / block_align);
+    }
+
+    p = wav_put_tag(p, "data");
+    p = wav_put_u32(p, data_bytes);
+    return p - out;
+}
+
+esp_err_t audio_wav_parse(const uint8_t *in, size_t len, audio_wav_info_t *info) {
+    bool have_format = false;
+    size_t pos = 12;
+
+    if (len < 12) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (memcmp(in, "RIFF", 4) != 0 || memcmp(in + 8, "WAVE", 4) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Chunks are an 8-byte tag and size, then the body padded to even length
+    while (pos + 8 <= len) {
+        const uint8_t *chunk = in + pos;
+        uint32_t size = wav_get_u32(chunk + 4);
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_format) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            info->data_offset = pos + 8;
+            info->data_bytes = size;
+            return ESP_OK;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (size < 16) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (pos + 8 + 16 > len) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            uint16_t format = wav_get_u16(chunk + 8);
+            uint16_t bits = wav_get_u16(chunk + 22);
+            info->channels = wav_get_u16(chunk + 10);
+            info->sample_rate = wav_get_u32(chunk + 12);
+            info->block_align = wav_get_u16(chunk + 20);
+            if (format == WAV_FORMAT_PCM && bits == 16) {
+                info->codec = AUDIO_CODEC_PCM16;
+            } else if (format == WAV_FORMAT_MULAW && bits == 8) {
+                info->codec = AUDIO_CODEC_ULAW;
+            } else {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            if (info->channels == 0 || info->sample_rate == 0 || info->block_align != info->channels * bits / 8) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            have_format = true;
+        }
+        // A chunk running past what we have needs more bytes. Checked before
+        // advancing: a bogus size near 4 GB would wrap a 32-bit pos round
+        // to where it was and loop here for ever.
+        if (size > len - pos - 8) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_codec.h"
+
+#define AUDIO_WAV_HEADER_MAX 58
+
+// Build a RIFF/WAVE header for `data_bytes` of audio in the given codec.
+// PCM16 and mu-law are supported. Returns the header length, 0 if the codec
+// has no WAV mapping.
+size_t audio_wav_header(uint8_t *out, audio_codec_t codec, uint32_t sample_rate, uint16_t channels,
+                        uint32_t data_bytes);
+
+// Format of a WAV file, from its header
+typedef struct {
+    audio_codec_t codec;        // PCM16 or mu-law
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t block_align;       // Bytes per sample frame (all channels)
+    uint32_t data_offset;       // Bytes before the first sample
+    uint32_t data_bytes;        // As declared; streaming writers may put 0 or 0xFFFFFFFF
+} audio_wav_info_t;
+
+// Parse the header at the start of a WAV file, of which `len` bytes are at
+// hand. Chunks before "data" other than "fmt " are skipped.
+// ESP_ERR_INVALID_SIZE if more bytes are needed, ESP_ERR_NOT_SUPPORTED for
+// formats other than PCM16 and mu-law, ESP_ERR_INVALID_ARG if it is not a
+// WAV file.
+esp_err_t audio_wav_parse(const uint8_t *in, size_t len, audio_wav_info_t *info);
@@ -0,0 +1,392 @@
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "audio_pack12.h"
+#include "clip_log.h"
+
+// Partition layout: CLIP_LOG_INDEX_SECTORS index sectors used in turn, then
+// a ring of data sectors. Each data sector holds one frame (header + packed
+// 12-bit samples)
+// written in a single page-aligned write. The head only moves forward, so
+// every data sector is erased once per lap of the ring (wear leveling).
+#define CLIP_LOG_SECTOR 4096
+#define CLIP_LOG_INDEX_SECTORS 2
+#define CLIP_LOG_FRAME_MAGIC 0x324D5246u    // "FRM2" (with sequence numbers)
+#define CLIP_LOG_INDEX_MAGIC 0x58444E49u    // "INDX"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // Frame write sequence, +1 per frame ever written
+    uint32_t clip_id;
+    uint32_t clip_samples;  // Whole clip
+    uint32_t first_sample;  // Clip offset of this frame's first sample
+    uint16_t samples;       // Samples in this frame
+    uint16_t reserved;
+    uint64_t sequence;      // Stream sequence number of the clip's first sample, UINT64_MAX if unknown
+    uint32_t crc;           // Header fields above plus the samples
+} clip_frame_header_t;
+
+#define CLIP_LOG_FRAME_BYTES (CLIP_LOG_SECTOR - sizeof(clip_frame_header_t))
+#define CLIP_LOG_FRAME_SAMPLES (CLIP_LOG_FRAME_BYTES * 2 / 3)
+#define CLIP_LOG_COPY_SAMPLES 256   // Source reads per pack pass
+
+// Checkpoint of the ring state, appended to the index on every change.
+// Mounting reads only the index sectors plus frames written after the last
+// checkpoint.
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // Checkpoint sequence
+    uint32_t tail;          // Data sector of the oldest pending frame
+    uint32_t used;          // Data sectors holding pending frames
+    uint32_t next_frame_seq;
+    uint32_t next_clip_id;
+    uint32_t reserved;
+    uint32_t crc;
+} clip_index_record_t;
+
+#define CLIP_LOG_INDEX_SLOTS (CLIP_LOG_SECTOR / sizeof(clip_index_record_t))
+
+static const char *TAG = "ClipLog";
+
+static const esp_partition_t *s_partition;
+static SemaphoreHandle_t s_lock;
+static uint32_t s_data_sectors;
+static uint32_t s_tail;
+static uint32_t s_used;
+static uint32_t s_next_frame_seq;
+static uint32_t s_next_clip_id;
+static uint32_t s_index_seq;
+static uint32_t s_index_sector;
+static uint32_t s_index_slot;       // Next free record in s_index_sector
+
+// One sector of RAM for building frames and caching the last frame read
+static union {
+    uint8_t bytes[CLIP_LOG_SECTOR];
+    struct {
+        clip_frame_header_t header;
+        uint8_t packed[CLIP_LOG_FRAME_BYTES];
+    } frame;
+    clip_index_record_t records[CLIP_LOG_INDEX_SLOTS];
+} s_page;
+static int32_t s_cached_sector = -1;
+
+static uint32_t clip_log_data_offset(uint32_t sector) {
+    return (CLIP_LOG_INDEX_SECTORS + sector) * CLIP_LOG_SECTOR;
+}
+
+static uint32_t clip_log_frames(uint32_t samples) {
+    return (samples + CLIP_LOG_FRAME_SAMPLES - 1) / CLIP_LOG_FRAME_SAMPLES;
+}
+
+static uint32_t clip_log_frame_crc(const clip_frame_header_t *header, const uint8_t *packed) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(clip_frame_header_t, crc));
+    return esp_rom_crc32_le(crc, packed, AUDIO_PACK12_BYTES(header->samples));
+}
+
+static uint32_t clip_log_record_crc(const clip_index_record_t *record) {
+    return esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(clip_index_record_t, crc));
+}
+
+// Load a data sector into s_page and verify it
+static bool clip_log_load_frame(uint32_t sector) {
+    if (s_cached_sector == (int32_t)sector) {
+        return true;
+    }
+    s_cached_sector = -1;
+    if (esp_partition_read(s_partition, clip_log_data_offset(sector), s_page.bytes, CLIP_LOG_SECTOR) != ESP_OK) {
+        return false;
+    }
+    const clip_frame_header_t *header = &s_page.frame.header;
+    if (header->magic != CLIP_LOG_FRAME_MAGIC || header->samples > CLIP_LOG_FRAME_SAMPLES ||
+        header->crc != clip_log_frame_crc(header, s_page.frame.packed)) {
+        return false;
+    }
+    s_cached_sector = sector;
+    return true;
+}
+
+static esp_err_t clip_log_checkpoint(void) {
+    if (s_index_slot == CLIP_LOG_INDEX_SLOTS) {
+        s_index_sector = (s_index_sector + 1) % CLIP_LOG_INDEX_SECTORS;
+        s_index_slot = 0;
+        esp_err_t err = esp_partition_erase_range(s_partition, s_index_sector * CLIP_LOG_SECTOR, CLIP_LOG_SECTOR);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    clip_index_record_t record = {
+        .magic = CLIP_LOG_INDEX_MAGIC,
+        .seq = ++s_index_seq,
+        .tail = s_tail,
+        .used = s_used,
+        .next_frame_seq = s_next_frame_seq,
+        .next_clip_id = s_next_clip_id,
+    };
+    record.crc = clip_log_record_crc(&record);
+    uint32_t offset = s_index_sector * CLIP_LOG_SECTOR + s_index_slot * sizeof(record);
+    s_index_slot++;
+    return esp_partition_write(s_partition, offset, &record, sizeof(record));
+}
+
+// Find the newest valid checkpoint. False if the index is blank or corrupt.
+static bool clip_log_read_index(void) {
+    bool found = false;
+
+    for (uint32_t sector = 0; sector < CLIP_LOG_INDEX_SECTORS; ++sector) {
+        if (esp_partition_read(s_partition, sector * CLIP_LOG_SECTOR, s_page.bytes, CLIP_LOG_SECTOR) != ESP_OK) {
+            continue;
+        }
+        for (uint32_t slot = 0; slot < CLIP_LOG_INDEX_SLOTS; ++slot) {
+            const clip_index_record_t *record = &s_page.records[slot];
+            if (record->magic != CLIP_LOG_INDEX_MAGIC || record->crc != clip_log_record_crc(record) ||
+                record->tail >= s_data_sectors || record->used > s_data_sectors) {
+                break;
+            }
+            if (!found || (int32_t)(record->seq - s_index_seq) > 0) {
+                found = true;
+                s_index_seq = record->seq;
+                s_index_sector = sector;
+                s_index_slot = slot + 1;
+                s_tail = record->tail;
+                s_used = record->used;
+                s_next_frame_seq = record->next_frame_seq;
+                s_next_clip_id = record->next_clip_id;
+            }
+        }
+    }
+    return found;
+}
+
+// Pick up whole clips written after the last checkpoint (reset before the
+// checkpoint landed). Stops at the first frame out of sequence.
+static void clip_log_roll_forward(void) {
+    uint32_t used = s_used;
+    uint32_t frame_seq = s_next_frame_seq;
+    bool advanced = false;
+
+    while (used < s_data_sectors && clip_log_load_frame((s_tail + used) % s_data_sectors)) {
+        const clip_frame_header_t *header = &s_page.frame.header;
+        if (header->seq != frame_seq) {
+            break;
+        }
+        used++;
+        frame_seq++;
+        if (header->first_sample + header->samples == header->clip_samples) {
+            s_used = used;
+            s_next_frame_seq = frame_seq;
+            s_next_clip_id = header->clip_id + 1;
+            advanced = true;
+        }
+    }
+    if (advanced) {
+        clip_log_checkpoint();
+    }
+}
+
+esp_err_t clip_log_init(const char *partition_label) {
+    int64_t start = esp_timer_get_time();
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (s_partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, offline buffering disabled", partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s_partition->size < (CLIP_LOG_INDEX_SECTORS + 2) * CLIP_LOG_SECTOR) {
+        s_partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        s_partition = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    s_data_sectors = s_partition->size / CLIP_LOG_SECTOR - CLIP_LOG_INDEX_SECTORS;
+    s_cached_sector = -1; // Reading the index reuses s_page
+
+    if (!clip_log_read_index()) {
+        ESP_LOGI(TAG, "Formatting '%s'", partition_label);
+        esp_err_t err = esp_partition_erase_range(s_partition, 0, CLIP_LOG_INDEX_SECTORS * CLIP_LOG_SECTOR);
+        if (err != ESP_OK) {
+            s_partition = NULL;
+            return err;
+        }
+        s_tail = 0;
+        s_used = 0;
+        s_next_frame_seq = 1;
+        s_next_clip_id = 1;
+        s_index_seq = 0;
+        s_index_sector = 0;
+        s_index_slot = 0;
+        clip_log_checkpoint();
+    }
+    clip_log_roll_forward();
+
+    ESP_LOGI(TAG, "Mounted in %lld us, %lu/%lu sectors pending", (long long)(esp_timer_get_time() - start),
+             (unsigned long)s_used, (unsigned long)s_data_sectors);
+    return ESP_OK;
+}
+
+// Store samples [first, first + samples) of the source as one clip
+static esp_err_t clip_log_append_clip(const audio_upload_source_t *source, size_t first, uint32_t samples,
+                                      uint64_t sequence) {
+    int16_t chunk[CLIP_LOG_COPY_SAMPLES];
+    uint32_t frames = clip_log_frames(samples);
+    int64_t start = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (frames == 0 || s_used + frames > s_data_sectors) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    uint32_t clip_id = s_next_clip_id;
+    uint32_t used = s_used;
+    uint32_t frame_seq = s_next_frame_seq;
+    s_cached_sector = -1;
+
+    for (uint32_t done = 0; err == ESP_OK && done < samples;) {
+        uint32_t count = samples - done;
+        if (count > CLIP_LOG_FRAME_SAMPLES) {
+            count = CLIP_LOG_FRAME_SAMPLES;
+        }
+        memset(s_page.bytes, 0xFF, sizeof(s_page.bytes));
+        for (uint32_t packed = 0; err == ESP_OK && packed < count;) {
+            uint32_t n = count - packed < CLIP_LOG_COPY_SAMPLES ? count - packed : CLIP_LOG_COPY_SAMPLES;
+            if (source->read(source->ctx, first + done + packed, chunk, n) != n) {
+                err = ESP_ERR_INVALID_STATE;
+            }
+            audio_pack12(s_page.frame.packed, packed, chunk, n);
+            packed += n;
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+
+        clip_frame_header_t *header = &s_page.frame.header;
+        header->magic = CLIP_LOG_FRAME_MAGIC;
+        header->seq = frame_seq;
+        header->clip_id = clip_id;
+        header->clip_samples = samples;
+        header->first_sample = done;
+        header->samples = count;
+        header->reserved = 0xFFFF;
+        header->sequence = sequence;
+        header->crc = clip_log_frame_crc(header, s_page.frame.packed);
+
+        uint32_t offset = clip_log_data_offset((s_tail + used) % s_data_sectors);
+        err = esp_partition_erase_range(s_partition, offset, CLIP_LOG_SECTOR);
+        if (err == ESP_OK) {
+            err = esp_partition_write(s_partition, offset, s_page.bytes, CLIP_LOG_SECTOR);
+        }
+        used++;
+        frame_seq++;
+        done += count;
+    }
+
+    // Commit only complete clips; a partial one is overwritten next time
+    if (err == ESP_OK) {
+        s_used = used;
+        s_next_frame_seq = frame_seq;
+        s_next_clip_id = clip_id + 1;
+        err = clip_log_checkpoint();
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK) {
+        int64_t elapsed = esp_timer_get_time() - start;
+        ESP_LOGI(TAG, "Stored clip %lu: %lu frames in %lld ms (%lld KB/s)", (unsigned long)clip_id,
+                 (unsigned long)frames, (long long)(elapsed / 1000),
+                 (long long)(elapsed > 0 ? (int64_t)frames * CLIP_LOG_SECTOR * 1000 / elapsed : 0));
+    }
+    return err;
+}
+
+esp_err_t clip_log_append(const audio_upload_source_t *source) {
+    if (s_partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (source->range_count == 0) {
+        return clip_log_append_clip(source, 0, source->samples, UINT64_MAX);
+    }
+
+    // Each range is its own clip, so a clip's position in the stream is
+    // one number in its frame headers
+    size_t first = 0;
+    for (size_t i = 0; i < source->range_count; ++i) {
+        esp_err_t err = clip_log_append_clip(source, first, source->ranges[i].count, source->ranges[i].first);
+        if (err != ESP_OK) {
+            return err;
+        }
+        first += source->ranges[i].count;
+    }
+    return ESP_OK;
+}
+
+bool clip_log_peek(clip_log_entry_t *entry) {
+    if (s_partition == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool found = s_used > 0 && clip_log_load_frame(s_tail);
+    if (found) {
+        entry->id = s_page.frame.header.clip_id;
+        entry->samples = s_page.frame.header.clip_samples;
+        entry->sequence = s_page.frame.header.sequence;
+        entry->first_sector = s_tail;
+    }
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+esp_err_t clip_log_pop(void) {
+    if (s_partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_used > 0) {
+        // A corrupt first frame drops just that sector
+        uint32_t frames = clip_log_load_frame(s_tail) ? clip_log_frames(s_page.frame.header.clip_samples) : 1;
+        if (frames > s_used) {
+            frames = s_used;
+        }
+        s_tail = (s_tail + frames) % s_data_sectors;
+        s_used -= frames;
+        err = clip_log_checkpoint();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+size_t clip_log_read(void *ctx, size_t offset, int16_t *out, size_t count) {
+    const clip_log_entry_t *entry = ctx;
+    size_t done = 0;
+
+    if (offset + count > entry->samples) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    while (done < count) {
+        size_t sample = offset + done;
+        uint32_t sector = (entry->first_sector + sample / CLIP_LOG_FRAME_SAMPLES) % s_data_sectors;
+        if (!clip_log_load_frame(sector) || s_page.frame.header.clip_id != entry->id) {
+            break; // Failed CRC or overwritten
+        }
+        size_t in_frame = sample % CLIP_LOG_FRAME_SAMPLES;
+        size_t n = s_page.frame.header.samples - in_frame;
+        if (n > count - done) {
+            n = count - done;
+        }
+        audio_unpack12(s_page.frame.packed, in_frame, out + done, n);
+        done += n;
+    }
+    xSemaphoreGive(s_lock);
+    return done;
+}
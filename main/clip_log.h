@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_upload.h"
+
+// Clips kept in a raw data partition until they are uploaded.
+// The partition table needs a data partition with this label.
+//
+// The partition is an append-only ring of sector-sized frames, each with its
+// own CRC32, so erases spread evenly over the whole partition. A small index
+// of checkpoints at the start of the partition makes mounting read two
+// sectors instead of scanning every frame.
+#define CLIP_LOG_PARTITION_LABEL "clips"
+
+// A stored clip
+typedef struct {
+    uint32_t id;
+    uint32_t samples;
+    uint32_t first_sector;  // Data sector holding the first frame
+    uint64_t sequence;      // Stream sequence number of the first sample, UINT64_MAX if unknown
+} clip_log_entry_t;
+
+// Find the partition and mount the log, formatting it if blank
+esp_err_t clip_log_init(const char *partition_label);
+
+// Copy a whole clip from `source` into flash. ESP_ERR_NO_MEM when full.
+// A clip with several sequence ranges is stored as one clip per range.
+esp_err_t clip_log_append(const audio_upload_source_t *source);
+
+// Oldest clip not yet uploaded; false when the log is empty
+bool clip_log_peek(clip_log_entry_t *entry);
+
+// Mark the oldest clip uploaded
+esp_err_t clip_log_pop(void);
+
+// audio_upload_source_t reader for a stored clip (ctx is the clip_log_entry_t).
+// Stops short at a frame that fails its CRC.
+size_t clip_log_read(void *ctx, size_t offset, int16_t *out, size_t count);
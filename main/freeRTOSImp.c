@@ -5,148 +5,390 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/timers.h"
-#include "driver/gpio.h"
-#include "driver/adc.h"
-#include "driver/dac.h"
+#include "sdkconfig.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
+#include "audio_bench.h"
+#include "audio_hal.h"
+#include "audio_capture.h"
+#include "audio_control.h"
+#include "audio_events.h"
+#include "audio_index.h"
+#include "audio_metrics.h"
+#include "audio_playback.h"
+#include "audio_ring.h"
+#include "audio_stream.h"
+#include "audio_tasks.h"
+#include "audio_uploader.h"
+#include "audio_vad.h"
+#include "clip_log.h"
 
-#define SAMPLE_RATE 16000 // 16kHz
-#define AUDIO_DURATION 20 // 20 seconds
-#define BUFFER_SIZE (SAMPLE_RATE * AUDIO_DURATION)
-#define ADC_CHANNEL ADC1_CHANNEL_0 // GPIO36
-#define DAC_CHANNEL DAC_CHANNEL_1 // DAC_OUT1 on GPIO25
+// Sample rate, channels, buffer memory and upload format come from Kconfig
+// ("Audio replay" in menuconfig; presets in configs/)
+#define SAMPLE_RATE CONFIG_AUDIO_SAMPLE_RATE
+#define AUDIO_DURATION CONFIG_AUDIO_RECORD_SECONDS
+#define CAPTURE_CHANNELS CONFIG_AUDIO_CAPTURE_CHANNELS // Interleaved in the ring; playback plays the first
+#if CONFIG_AUDIO_CAPTURE_STEREO
+#define ADC_CHANNELS {0, 3} // ADC1 channels in scan order: GPIO36, GPIO39
+#else
+#define ADC_CHANNELS {0} // ADC1 channel 0 is GPIO36
+#endif
+#define BUFFER_SIZE (SAMPLE_RATE * AUDIO_DURATION * CAPTURE_CHANNELS) // Samples of all channels
+#define CAPTURE_FRAME_SAMPLES 256 // 16 ms per frame at 16kHz
+#define CAPTURE_QUEUE_DEPTH 8
+#define CAPTURE_OVERSAMPLE CONFIG_AUDIO_CAPTURE_OVERSAMPLE // ADC this much faster, anti-alias filtered down
+#define CAPTURE_DC_BLOCK true // Centre the mic bias so the 8-bit DAC gets the full swing
+#define PLAYBACK_FRAME_SAMPLES 256 // 16 ms DMA buffers, two in flight
+#define PLAYBACK_SPEED AUDIO_PLAYBACK_SPEED_ONE // e.g. AUDIO_PLAYBACK_SPEED_ONE * 3 / 2 to skim
+#define PLAYBACK_TRIM_PEAK 2 // Skip blocks at either end peaking below this index level (16 LSB)
+#define PLAYBACK_STREAM_URL CONFIG_AUDIO_STREAM_URL
+#if CONFIG_AUDIO_BUFFER_PSRAM
+#define BUFFER_CAPS MALLOC_CAP_SPIRAM // Ring and clip store
+#else
+#define BUFFER_CAPS MALLOC_CAP_INTERNAL
+#endif
+#define UPLOAD_STORE_BYTES (CONFIG_AUDIO_UPLOAD_STORE_KB * 1024) // Clips waiting to upload
+#if CONFIG_AUDIO_UPLOAD_TRIM_SILENCE
+#define UPLOAD_TRIM_SILENCE true // Store and upload only the speech the VAD finds
+#else
+#define UPLOAD_TRIM_SILENCE false
+#endif
+#if CONFIG_AUDIO_UPLOAD_WAV
+#define UPLOAD_FORMAT AUDIO_UPLOAD_WAV
+#else
+#define UPLOAD_FORMAT AUDIO_UPLOAD_JSON_BASE64
+#endif
+#if CONFIG_AUDIO_UPLOAD_CODEC_IMA_ADPCM
+#define UPLOAD_CODEC AUDIO_CODEC_IMA_ADPCM
+#elif CONFIG_AUDIO_UPLOAD_CODEC_ULAW
+#define UPLOAD_CODEC AUDIO_CODEC_ULAW
+#else
+#define UPLOAD_CODEC AUDIO_CODEC_PCM16
+#endif
+#define CONTROL_TASK_PRIORITY 20 // Frame reader: CAPTURE_QUEUE_DEPTH frames (128 ms) of slack
+#define PLAYBACK_TASK_PRIORITY 21 // DMA refill: one 16 ms buffer of slack
+#define UPLOAD_TASK_PRIORITY 4 // Below lwIP (18) and Wi-Fi (23) on core 0
+#define STREAM_TASK_PRIORITY 5 // Fetches streamed playback; above uploads, which can wait
+#define METRICS_TASK_PRIORITY 1
+#define METRICS_PERIOD_MS 10000
+#define UPLOAD_URL CONFIG_AUDIO_UPLOAD_URL
 
-// Pin Definitions
-#define RECORD_BUTTON_PIN GPIO_NUM_13
-#define PLAYBACK_BUTTON_PIN GPIO_NUM_33
-#define RECORD_LED_PIN GPIO_NUM_2
-#define PLAYBACK_LED_PIN GPIO_NUM_4
+// Task topology (see audio_tasks.h). Stacks are sized from their high-water
+// marks, which audio_tasks_report logs after each recording and the metrics
+// dump carries; test/host/test_latency.c and test_stream.c measure them on
+// the host (x86-64 frames, no TLS): control 1.9 KB, upload 4.3 KB, stream
+// 3.4 KB, metrics 2.4 KB. Upload and stream keep room for an HTTPS handshake.
+static const audio_task_config_t control_task_config = {
+    .name = "control_task", .stack = 4096, .priority = CONTROL_TASK_PRIORITY, .core = AUDIO_TASKS_CORE_AUDIO,
+};
+static const audio_task_config_t playback_task_config = {
+    .name = "playback_audio_task", .stack = 4096, .priority = PLAYBACK_TASK_PRIORITY, .core = AUDIO_TASKS_CORE_AUDIO,
+};
+static const audio_task_config_t upload_task_config = {
+    .name = "upload_task", .stack = 8192, .priority = UPLOAD_TASK_PRIORITY, .core = AUDIO_TASKS_CORE_NETWORK,
+};
+static const audio_task_config_t stream_task_config = {
+    .name = "stream_task", .stack = 6144, .priority = STREAM_TASK_PRIORITY, .core = AUDIO_TASKS_CORE_NETWORK,
+};
+static const audio_task_config_t metrics_task_config = {
+    .name = "metrics_task", .stack = 4096, .priority = METRICS_TASK_PRIORITY, .core = AUDIO_TASKS_CORE_NETWORK,
+};
+
+// What the playback button plays: the last AUDIO_DURATION seconds
+static const audio_playback_request_t playback_request = {
+    .offset_ms = -AUDIO_DURATION * 1000, .duration_ms = 0, .speed = PLAYBACK_SPEED,
+};
 
 // Global Variables
-static int16_t audio_buffer[BUFFER_SIZE];
-static size_t write_index = 0;
-static bool is_recording = false;
+static audio_ring_t audio_ring; // Written by control_task, read by playback/upload
+static audio_index_t audio_index; // Block summary of audio_ring, same writer
+static TaskHandle_t playback_task_handle;
 static const char *TAG = "AudioReplay";
 
 // Function Prototypes
-void record_audio_task(void *arg);
+void control_task(void *arg);
 void playback_audio_task(void *arg);
-void upload_audio_to_cloud(int16_t *audio_data, size_t size);
 void adc_init();
 void dac_init();
 void gpio_init();
+void buffer_init();
+void upload_init();
+void bench_run();
 
 void app_main() {
-    gpio_init();
-    adc_init();
-    dac_init();
+#if CONFIG_AUDIO_BENCHMARK
+    bench_run();
+    return;
+#endif
+    buffer_init();
+    upload_init();
+    ESP_ERROR_CHECK(audio_metrics_start(&metrics_task_config, METRICS_PERIOD_MS));
 
-    // Create tasks for recording and playback
-    xTaskCreate(record_audio_task, "record_audio_task", 4096, NULL, 5, NULL);
-    xTaskCreate(playback_audio_task, "playback_audio_task", 4096, NULL, 5, NULL);
+    // Create tasks for recording and playback; control_task sets up the
+    // audio drivers so their interrupts land on the audio core
+    ESP_ERROR_CHECK(audio_tasks_create(&playback_task_config, playback_audio_task, NULL, &playback_task_handle));
+    ESP_ERROR_CHECK(audio_tasks_create(&control_task_config, control_task, NULL, NULL));
+}
+
+// Runs in the GPIO ISR: start sampling on the press edge itself rather than
+// when the control task gets round to it
+static void IRAM_ATTR on_button_event(const audio_event_t *event, void *ctx) {
+    if (event->type == AUDIO_EVENT_PRESS && event->button == AUDIO_HAL_BUTTON_RECORD) {
+        audio_capture_start_from_isr(event->timestamp_us);
+    }
 }
 
-// GPIO Initialization
+// GPIO Initialization: buttons raise debounced events, LEDs (pins live in the HAL)
 void gpio_init() {
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << RECORD_BUTTON_PIN) | (1ULL << PLAYBACK_BUTTON_PIN) |
-                        (1ULL << RECORD_LED_PIN) | (1ULL << PLAYBACK_LED_PIN),
-        .mode = GPIO_MODE_INPUT_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
+    ESP_ERROR_CHECK(audio_events_init(on_button_event, NULL));
+}
+
+// Audio Buffer Initialization: the smallest power-of-two ring holding BUFFER_SIZE
+void buffer_init() {
+    uint32_t capacity = 2 * AUDIO_INDEX_BLOCK_SAMPLES;
+    while (capacity < BUFFER_SIZE) {
+        capacity <<= 1;
+    }
+    uint8_t *storage = heap_caps_calloc(1, AUDIO_RING_STORAGE_BYTES(capacity), BUFFER_CAPS);
+    if (storage == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte audio buffer", (unsigned)AUDIO_RING_STORAGE_BYTES(capacity));
+        abort();
+    }
+    ESP_ERROR_CHECK(audio_ring_init(&audio_ring, storage, capacity));
+
+    // The index is small and walked by queries, so it lives in internal RAM
+    uint8_t *index_storage = heap_caps_calloc(1, AUDIO_INDEX_STORAGE_BYTES(capacity), MALLOC_CAP_INTERNAL);
+    if (index_storage == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate audio index");
+        abort();
+    }
+    ESP_ERROR_CHECK(audio_index_init(&audio_index, &audio_ring, index_storage, SAMPLE_RATE * CAPTURE_CHANNELS));
+}
+
+// Upload Initialization: background task with flash store-and-forward
+void upload_init() {
+    void *store = heap_caps_malloc(UPLOAD_STORE_BYTES, BUFFER_CAPS);
+    if (store == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate clip store");
+        abort();
+    }
+    audio_uploader_config_t config = {
+        .upload = {
+            .url = UPLOAD_URL,
+            .format = UPLOAD_FORMAT,
+            .codec = UPLOAD_CODEC,
+            .sample_rate = SAMPLE_RATE,
+            .channels = CAPTURE_CHANNELS,
+        },
+        .spill_to_flash = clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK,
+        .store_arena = store,
+        .store_bytes = UPLOAD_STORE_BYTES,
+        .task = upload_task_config,
     };
-    gpio_config(&io_conf);
+    ESP_ERROR_CHECK(audio_uploader_start(&config));
+}
 
-    // Initialize LEDs as OFF
-    gpio_set_level(RECORD_LED_PIN, 0);
-    gpio_set_level(PLAYBACK_LED_PIN, 0);
+// Benchmark of this configuration (CONFIG_AUDIO_BENCHMARK): one JSON line on
+// stdout, then stop. On the host the process exits so scripts can compare builds.
+void bench_run() {
+    audio_bench_config_t config = {
+        .sample_rate = SAMPLE_RATE,
+        .channels = CAPTURE_CHANNELS,
+        .oversample = CAPTURE_OVERSAMPLE,
+        .codec = UPLOAD_CODEC,
+        .format = UPLOAD_FORMAT,
+        .seconds = AUDIO_DURATION,
+        .buffer_caps = BUFFER_CAPS,
+    };
+    audio_bench_result_t result;
+    ESP_ERROR_CHECK(audio_bench_run(&config, &result));
+    audio_bench_print(&config, &result);
+#if CONFIG_IDF_TARGET_LINUX
+    exit(0);
+#endif
 }
 
-// ADC Initialization
+// ADC Initialization: timer-paced capture into a frame queue
 void adc_init() {
-    adc1_config_width(ADC_WIDTH_BIT_12);
-    adc1_config_channel_atten(ADC_CHANNEL, ADC_ATTEN_DB_11);
+    audio_capture_config_t capture_config = {
+        .sample_rate = SAMPLE_RATE,
+        .frame_samples = CAPTURE_FRAME_SAMPLES,
+        .queue_depth = CAPTURE_QUEUE_DEPTH,
+        .adc_channels = ADC_CHANNELS,
+        .channels = CAPTURE_CHANNELS,
+        .oversample = CAPTURE_OVERSAMPLE,
+        .dc_block = CAPTURE_DC_BLOCK,
+    };
+    ESP_ERROR_CHECK(audio_capture_init(&capture_config));
 }
 
-// DAC Initialization
+// DAC Initialization: DMA playback at exactly SAMPLE_RATE, from the ring or streamed
 void dac_init() {
-    dac_output_enable(DAC_CHANNEL);
+    audio_stream_config_t stream_config = {
+        .playback = {
+            .sample_rate = SAMPLE_RATE,
+            .frame_samples = PLAYBACK_FRAME_SAMPLES,
+            .channels = CAPTURE_CHANNELS,
+        },
+        .task = stream_task_config,
+    };
+    ESP_ERROR_CHECK(audio_playback_init(&stream_config.playback));
+    if (PLAYBACK_STREAM_URL[0] != '\0') {
+        ESP_ERROR_CHECK(audio_stream_init(&stream_config));
+    }
 }
 
-// Task to record audio
-void record_audio_task(void *arg) {
-    while (1) {
-        if (gpio_get_level(RECORD_BUTTON_PIN) == 0) { // Button pressed
-            gpio_set_level(RECORD_LED_PIN, 1);
-            is_recording = true;
-
-            ESP_LOGI(TAG, "Recording started...");
-            while (gpio_get_level(RECORD_BUTTON_PIN) == 0) {
-                int16_t sample = adc1_get_raw(ADC_CHANNEL);
-                audio_buffer[write_index] = sample;
-                write_index = (write_index + 1) % BUFFER_SIZE;
-                vTaskDelay(pdMS_TO_TICKS(1000 / SAMPLE_RATE));
-            }
+// Recording in progress, owned by control_task
+static audio_ring_cursor_t record_cursor;
+static uint32_t record_samples;
+static audio_vad_t record_vad;
+
+static void record_append(const int16_t *frame, size_t count) {
+    audio_ring_write(&audio_ring, frame, count);
+    audio_index_append(&audio_index, frame, count);
+    audio_vad_process(&record_vad, frame, count);
+    record_samples += count;
+}
+
+static void record_begin(int64_t start_us) {
+    // Usually already running, started by the press edge in on_button_event
+    esp_err_t err = audio_capture_start();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(err);
+    }
+    record_cursor = audio_ring_cursor_live(&audio_ring);
+    audio_index_mark(&audio_index, start_us);
+    record_samples = 0;
+    audio_vad_begin(&record_vad);
+    ESP_LOGI(TAG, "Recording started...");
+}
 
-            gpio_set_level(RECORD_LED_PIN, 0);
-            is_recording = false;
+// The clip ends on the sample of the release edge: read until the capture
+// has caught up with it, then hand exactly that much (less silence) to the
+// uploader
+static void record_finish(int64_t stop_us) {
+    static int16_t frame[CAPTURE_FRAME_SAMPLES * CAPTURE_CHANNELS];
+    uint32_t target = audio_capture_samples_until(stop_us);
 
-            ESP_LOGI(TAG, "Recording stopped. Uploading to cloud...");
-            upload_audio_to_cloud(audio_buffer, BUFFER_SIZE);
+    while (record_samples < target) {
+        size_t count = audio_capture_read(frame, pdMS_TO_TICKS(100));
+        if (count == 0) {
+            break;
         }
-        vTaskDelay(pdMS_TO_TICKS(10));
+        record_append(frame, count);
     }
+    audio_capture_stop();
+
+    uint32_t clip = record_samples < target ? record_samples : target;
+    uint32_t first = clip > BUFFER_SIZE ? clip - BUFFER_SIZE : 0; // Keep the last AUDIO_DURATION seconds
+    audio_ring_cursor_t cursor = {.pos = record_cursor.pos + first};
+    uint32_t kept = audio_vad_finish(&record_vad, first, clip);
+    clip -= first;
+    ESP_LOGI(TAG, "Recording stopped (%lu samples, %lu dropped so far, speech in %lu of %lu frames)",
+             (unsigned long)clip, (unsigned long)audio_capture_dropped_samples(),
+             (unsigned long)record_vad.speech_frames, (unsigned long)record_vad.frames);
+
+    // Snapshot only; the upload task does the network work
+    if (!UPLOAD_TRIM_SILENCE) {
+        kept = clip;
+        audio_uploader_submit(&audio_ring, cursor, clip);
+    } else if (kept > 0) {
+        ESP_LOGI(TAG, "Queueing upload of %lu samples in %u segments", (unsigned long)kept,
+                 (unsigned)record_vad.segment_count);
+        audio_uploader_submit_segments(&audio_ring, cursor, record_vad.segments, record_vad.segment_count);
+    } else {
+        ESP_LOGI(TAG, "No speech, nothing to upload");
+    }
+    audio_metrics_add(AUDIO_METRIC_CLIP_SAMPLES, clip);
+    audio_metrics_add(AUDIO_METRIC_CLIP_KEPT_SAMPLES, kept);
+
+    // Worst case covers any upload of the previous clip running meanwhile
+    audio_capture_latency_t latency;
+    audio_capture_latency(&latency, true);
+    ESP_LOGI(TAG, "Frame latency: worst %lu us, mean %lu us over %lu frames", (unsigned long)latency.worst_us,
+             (unsigned long)latency.mean_us, (unsigned long)latency.frames);
+    audio_tasks_report();
 }
 
-// Task to playback audio
-void playback_audio_task(void *arg) {
-    while (1) {
-        if (gpio_get_level(PLAYBACK_BUTTON_PIN) == 0) { // Button pressed
-            gpio_set_level(PLAYBACK_LED_PIN, 1);
+// Task driving recording and playback from button events. Sleeps on the
+// event queue while idle; while recording it moves one frame at a time
+// into the ring and checks for events in between.
+void control_task(void *arg) {
+    static int16_t frame[CAPTURE_FRAME_SAMPLES * CAPTURE_CHANNELS];
+    audio_control_t control;
+    audio_event_t event;
 
-            ESP_LOGI(TAG, "Playing back the last 20 seconds of audio...");
-            for (size_t i = 0; i < BUFFER_SIZE; ++i) {
-                dac_output_voltage(DAC_CHANNEL, audio_buffer[(write_index + i) % BUFFER_SIZE] >> 4);
-                vTaskDelay(pdMS_TO_TICKS(1000 / SAMPLE_RATE));
+    gpio_init();
+    adc_init();
+    dac_init();
+    audio_vad_init(&record_vad, CAPTURE_CHANNELS);
+
+    audio_control_init(&control);
+    while (1) {
+        TickType_t timeout = portMAX_DELAY;
+        if (control.recording) {
+            // Sleeps until the timer has filled a whole frame; nothing on a timeout
+            size_t count = audio_capture_read(frame, pdMS_TO_TICKS(100));
+            if (count > 0) {
+                record_append(frame, count);
             }
+            timeout = 0;
+        }
+        if (!audio_events_wait(&event, timeout)) {
+            continue;
+        }
 
-            gpio_set_level(PLAYBACK_LED_PIN, 0);
+        uint32_t actions = audio_control_handle(&control, &event);
+        if (actions & AUDIO_CONTROL_START_RECORDING) {
+            record_begin(control.record_start_us);
         }
-        vTaskDelay(pdMS_TO_TICKS(10));
+        if (actions & AUDIO_CONTROL_STOP_RECORDING) {
+            record_finish(control.record_stop_us);
+        }
+        if (actions & AUDIO_CONTROL_START_PLAYBACK) {
+            xTaskNotifyGive(playback_task_handle);
+        }
+        audio_hal_led_set(AUDIO_HAL_LED_RECORD, control.recording);
+        audio_hal_led_set(AUDIO_HAL_LED_PLAYBACK, control.playing);
     }
 }
 
-// Function to upload audio to Google Cloud
-void upload_audio_to_cloud(int16_t *audio_data, size_t size) {
-    char *base64_audio = calloc(1, size * 2); // Adjust buffer size as needed
-    size_t out_len = 0;
-
-    // Base64 encode audio
-    esp_base64_encode((const unsigned char *)audio_data, size * sizeof(int16_t), base64_audio, &out_len);
+// Task to playback audio, woken by control_task
+void playback_audio_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    esp_http_client_config_t config = {
-        .url = "https://script.google.com/macros/s/AKfycbyJEgBu_YFu2q3H1gXqBydhXsCowDv1_UZp3jGs2s8dtSWfsW6i6aoGMU4ceR-Xvx02/exec",
-        .method = HTTP_METHOD_POST,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+        if (PLAYBACK_STREAM_URL[0] != '\0') {
+            ESP_LOGI(TAG, "Streaming %s...", PLAYBACK_STREAM_URL);
+            esp_err_t err = audio_stream_play(PLAYBACK_STREAM_URL, NULL);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Streaming cut short: %s", esp_err_to_name(err));
+            }
+            audio_event_t done = {.type = AUDIO_EVENT_PLAYBACK_DONE, .timestamp_us = audio_hal_time_us()};
+            audio_events_post(&done);
+            continue;
+        }
 
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    char json_payload[1024];
-    snprintf(json_payload, sizeof(json_payload), "{\"audio\":\"%s\"}", base64_audio);
-    esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
+        ESP_LOGI(TAG, "Playing back the last %d seconds of audio...", AUDIO_DURATION);
+        // Own cursor, so recording can keep writing while we play
+        audio_ring_cursor_t cursor;
+        uint32_t samples;
+        audio_playback_locate(&audio_ring, &playback_request, &cursor, &samples);
+        audio_index_trim(&audio_index, PLAYBACK_TRIM_PEAK, &cursor, &samples);
+        if (samples == 0) {
+            ESP_LOGI(TAG, "Nothing but silence to play");
+        } else {
+            esp_err_t err = audio_playback_play_speed(&audio_ring, cursor, samples, playback_request.speed);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Playback cut short: %s", esp_err_to_name(err));
+            }
+        }
+        ESP_LOGI(TAG, "Playback done (%lu underruns so far)", (unsigned long)audio_playback_underruns());
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Audio uploaded successfully");
-    } else {
-        ESP_LOGE(TAG, "Failed to upload audio: %s", esp_err_to_name(err));
+        audio_event_t done = {.type = AUDIO_EVENT_PLAYBACK_DONE, .timestamp_us = audio_hal_time_us()};
+        audio_events_post(&done);
     }
-
-    esp_http_client_cleanup(client);
-    free(base64_audio);
 }
-
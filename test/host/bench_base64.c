@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "audio_base64.h"
+#include "audio_upload.h"
+
+// Base64 encoder throughput on the group path this binary's firmware was
+// built with (BASE64_PATH), one JSON line: in upload-frame-sized pieces as
+// the uploader encodes them, and in one large buffer
+
+#define BENCH_BYTES (256u << 20)
+#define BENCH_LARGE (1u << 20)
+
+static double bench_mb_per_s(uint64_t bytes, int64_t us) {
+    return us > 0 ? (double)bytes / us : 0;
+}
+
+int main(void) {
+    const size_t frame = AUDIO_UPLOAD_FRAME_SAMPLES * sizeof(int16_t);
+    uint8_t *in = malloc(BENCH_LARGE);
+    char *out = malloc(AUDIO_BASE64_UPDATE_MAX(BENCH_LARGE) + 4);
+    audio_base64_t b64;
+    size_t sink = 0;
+
+    if (in == NULL || out == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_LARGE; ++i) {
+        in[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    audio_base64_init(&b64);
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_BYTES; done += frame) {
+        sink += audio_base64_update(&b64, in + done % (BENCH_LARGE - frame), frame, out);
+    }
+    sink += audio_base64_finish(&b64, out);
+    int64_t frame_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_BYTES; done += BENCH_LARGE) {
+        sink += audio_base64_update(&b64, in, BENCH_LARGE, out);
+    }
+    sink += audio_base64_finish(&b64, out);
+    int64_t large_us = esp_timer_get_time() - start;
+
+    printf("{\"base64_path\":\"%s\",\"frame_bytes\":%zu,\"frame_mb_per_s\":%.1f,\"large_mb_per_s\":%.1f,"
+           "\"output_bytes\":%zu}\n",
+           BASE64_PATH, frame, bench_mb_per_s(BENCH_BYTES, frame_us), bench_mb_per_s(BENCH_BYTES, large_us), sink);
+    free(in);
+    free(out);
+    return 0;
+}
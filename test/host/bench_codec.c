@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esp_timer.h"
+#include "audio_codec.h"
+#include "audio_upload.h"
+
+// Codec throughput, one JSON line: mu-law and IMA-ADPCM encode and decode
+// in upload-frame-sized pieces, as the uploader and the player call them.
+// MB/s counts the 16-bit PCM side, so the numbers compare with the network
+// and flash rates the codecs save.
+
+#define BENCH_SAMPLES (32u << 20)
+#define BENCH_SIGNAL (1u << 16)     // Samples of test signal, cycled through
+
+static double bench_mb_per_s(uint64_t bytes, int64_t us) {
+    return us > 0 ? (double)bytes / us : 0;
+}
+
+typedef struct {
+    double encode_mb_per_s;
+    double decode_mb_per_s;
+    size_t frame_bytes;
+} bench_result_t;
+
+static bench_result_t bench_codec(audio_codec_t codec, const int16_t *signal, size_t *sink) {
+    const size_t frame = AUDIO_UPLOAD_FRAME_SAMPLES;
+    static uint8_t encoded[BENCH_SIGNAL * 2];
+    static int16_t decoded[AUDIO_UPLOAD_FRAME_SAMPLES];
+    size_t frame_bytes = audio_codec_frame_bytes(codec, frame);
+    size_t frames = BENCH_SIGNAL / frame;
+    audio_codec_state_t state = {0};
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += frame) {
+        size_t f = done / frame % frames;
+        *sink += audio_codec_encode(codec, &state, signal + f * frame, frame, encoded + f * frame_bytes);
+    }
+    int64_t encode_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += frame) {
+        size_t f = done / frame % frames;
+        *sink += audio_codec_decode(codec, encoded + f * frame_bytes, frame, decoded);
+        *sink += (uint16_t)decoded[f % frame];
+    }
+    int64_t decode_us = esp_timer_get_time() - start;
+
+    return (bench_result_t){
+        .encode_mb_per_s = bench_mb_per_s((uint64_t)BENCH_SAMPLES * sizeof(int16_t), encode_us),
+        .decode_mb_per_s = bench_mb_per_s((uint64_t)BENCH_SAMPLES * sizeof(int16_t), decode_us),
+        .frame_bytes = frame_bytes,
+    };
+}
+
+int main(void) {
+    int16_t *signal = malloc(BENCH_SIGNAL * sizeof(int16_t));
+    size_t sink = 0;
+
+    if (signal == NULL) {
+        return 1;
+    }
+    // Two tones and some noise at speech levels: ADPCM's step adapts and
+    // mu-law uses most of its segments
+    uint32_t random = 1;
+    for (size_t i = 0; i < BENCH_SIGNAL; ++i) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        double t = i / 16000.0;
+        signal[i] = (int16_t)(6000 * sin(2 * M_PI * 220 * t) + 2500 * sin(2 * M_PI * 1900 * t) +
+                              (int32_t)(random % 1001) - 500);
+    }
+
+    bench_result_t ulaw = bench_codec(AUDIO_CODEC_ULAW, signal, &sink);
+    bench_result_t adpcm = bench_codec(AUDIO_CODEC_IMA_ADPCM, signal, &sink);
+
+    printf("{\"frame_samples\":%d,\"ulaw_frame_bytes\":%zu,\"ulaw_encode_mb_per_s\":%.1f,"
+           "\"ulaw_decode_mb_per_s\":%.1f,\"adpcm_frame_bytes\":%zu,\"adpcm_encode_mb_per_s\":%.1f,"
+           "\"adpcm_decode_mb_per_s\":%.1f,\"sink\":%zu}\n",
+           AUDIO_UPLOAD_FRAME_SAMPLES, ulaw.frame_bytes, ulaw.encode_mb_per_s, ulaw.decode_mb_per_s,
+           adpcm.frame_bytes, adpcm.encode_mb_per_s, adpcm.decode_mb_per_s, sink);
+    free(signal);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <math.h>
+#include "esp_timer.h"
+#include "audio_dsp.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// DSP throughput on the kernel this binary's firmware was built with
+// (DSP_KERNEL: the folded scalar FIR of the target, or SSE2), one JSON
+// line: decimator time-stamp-counter cycles and nanoseconds per output
+// sample at factors 2 and 4, and resampler throughput at 0.5x, 1x and 2x
+// speed, in millions of output samples per second
+
+#define BENCH_BLOCK 256             // Input samples per call, a capture frame
+#define BENCH_SIGNAL 4096
+#define BENCH_INPUTS (32u << 20)
+
+static int16_t s_signal[BENCH_SIGNAL];
+static int16_t s_out[2 * BENCH_BLOCK + 1];
+
+static uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    double cycles_per_output;
+    double ns_per_output;
+} bench_decimator_t;
+
+static bench_decimator_t bench_decimator(size_t factor, uint64_t *sink) {
+    static audio_dsp_decimator_t decimator;
+    uint64_t outputs = 0;
+
+    audio_dsp_decimator_init(&decimator, factor);
+    int64_t start = esp_timer_get_time();
+    uint64_t cycles = bench_cycles();
+    for (uint32_t done = 0; done < BENCH_INPUTS; done += BENCH_BLOCK) {
+        size_t n = audio_dsp_decimate(&decimator, s_signal + done % BENCH_SIGNAL, BENCH_BLOCK, s_out);
+        *sink += (uint16_t)s_out[n - 1];
+        outputs += n;
+    }
+    cycles = bench_cycles() - cycles;
+    int64_t us = esp_timer_get_time() - start;
+    return (bench_decimator_t){
+        .cycles_per_output = (double)cycles / outputs,
+        .ns_per_output = us * 1000.0 / outputs,
+    };
+}
+
+// Millions of outputs per second at `step`
+static double bench_resampler(uint32_t step, uint64_t *sink) {
+    static audio_dsp_resampler_t resampler;
+    uint64_t outputs = 0;
+
+    audio_dsp_resampler_init(&resampler, step);
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_INPUTS; done += BENCH_BLOCK) {
+        size_t n = audio_dsp_resample(&resampler, s_signal + done % BENCH_SIGNAL, BENCH_BLOCK, s_out);
+        *sink += n > 0 ? (uint16_t)s_out[n - 1] : 0;
+        outputs += n;
+    }
+    int64_t us = esp_timer_get_time() - start;
+    return us > 0 ? (double)outputs / us : 0;
+}
+
+int main(void) {
+    uint64_t sink = 0;
+
+    for (size_t i = 0; i < BENCH_SIGNAL; ++i) {
+        s_signal[i] = (int16_t)(1500 * sin(2 * M_PI * i * 1000 / 32000.0) + 300 * sin(2 * M_PI * i * 7 / 64.0));
+    }
+
+    bench_decimator_t x2 = bench_decimator(2, &sink);
+    bench_decimator_t x4 = bench_decimator(4, &sink);
+    double half = bench_resampler(AUDIO_DSP_RESAMPLE_ONE / 2, &sink);
+    double one = bench_resampler(AUDIO_DSP_RESAMPLE_ONE, &sink);
+    double twice = bench_resampler(AUDIO_DSP_RESAMPLE_ONE * 2, &sink);
+
+    printf("{\"dsp_kernel\":\"%s\",\"decimate_x2_cycles_per_output\":%.1f,\"decimate_x2_ns_per_output\":%.2f,"
+           "\"decimate_x4_cycles_per_output\":%.1f,\"decimate_x4_ns_per_output\":%.2f,"
+           "\"resample_0_5x_msamples_per_s\":%.1f,\"resample_1x_msamples_per_s\":%.1f,"
+           "\"resample_2x_msamples_per_s\":%.1f,\"sink\":%llu}\n",
+           DSP_KERNEL, x2.cycles_per_output, x2.ns_per_output, x4.cycles_per_output, x4.ns_per_output, half, one,
+           twice, (unsigned long long)sink);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "host_flash.h"
+#include "audio_pack12.h"
+#include "clip_log.h"
+
+// 12-bit packing, one JSON line: pack, unpack and one channel of a stereo
+// stride unpacked, in MB/s of 16-bit samples; and what packing buys, as
+// the samples a ring buffer of a given size holds and the samples the clip
+// log fits on the emulated partition (filled until it reports full),
+// against 16-bit storage of the same bytes
+
+#define BENCH_BLOCK 256             // Samples per call, a capture frame
+#define BENCH_BUFFER (1u << 16)     // Samples packed, cycled through
+#define BENCH_SAMPLES (128u << 20)
+#define BENCH_CLIP_SAMPLES 16000    // Clips of one second at 16kHz appended to the log
+
+static double bench_mb_per_s(uint64_t bytes, int64_t us) {
+    return us > 0 ? (double)bytes / us : 0;
+}
+
+static int16_t s_clip[BENCH_CLIP_SAMPLES];
+
+// Samples the clip log holds before it is full
+static uint64_t bench_clip_log_samples(void) {
+    audio_upload_range_t range = {.first = 0, .count = BENCH_CLIP_SAMPLES};
+    audio_upload_source_t source = {
+        .read = audio_upload_read_buffer,
+        .ctx = s_clip,
+        .samples = BENCH_CLIP_SAMPLES,
+        .ranges = &range,
+        .range_count = 1,
+    };
+    uint64_t samples = 0;
+
+    host_flash_reset(true);
+    if (clip_log_init(CLIP_LOG_PARTITION_LABEL) != ESP_OK) {
+        return 0;
+    }
+    for (size_t i = 0; i < BENCH_CLIP_SAMPLES; ++i) {
+        s_clip[i] = (int16_t)((i * 37) & 0xFFF);
+    }
+    while (clip_log_append(&source) == ESP_OK) {
+        samples += BENCH_CLIP_SAMPLES;
+        range.first += BENCH_CLIP_SAMPLES;
+    }
+    return samples;
+}
+
+int main(void) {
+    static int16_t in[BENCH_BLOCK];
+    static int16_t out[BENCH_BLOCK];
+    uint8_t *packed = malloc(AUDIO_PACK12_BYTES(BENCH_BUFFER));
+    uint64_t sink = 0;
+
+    if (packed == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_BLOCK; ++i) {
+        in[i] = (int16_t)((i * 2654435761u >> 20) & 0xFFF);
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += BENCH_BLOCK) {
+        audio_pack12(packed, done % BENCH_BUFFER, in, BENCH_BLOCK);
+    }
+    int64_t pack_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += BENCH_BLOCK) {
+        audio_unpack12(packed, done % BENCH_BUFFER, out, BENCH_BLOCK);
+        sink += (uint16_t)out[done / BENCH_BLOCK % BENCH_BLOCK];
+    }
+    int64_t unpack_us = esp_timer_get_time() - start;
+
+    // One channel of interleaved stereo frames: half the samples come out
+    start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += 2 * BENCH_BLOCK) {
+        audio_unpack12_stride(packed, done % BENCH_BUFFER + 1, 2, out, BENCH_BLOCK);
+        sink += (uint16_t)out[done / BENCH_BLOCK % BENCH_BLOCK];
+    }
+    int64_t stride_us = esp_timer_get_time() - start;
+
+    // The 12-bit ring stores capacity samples in AUDIO_PACK12_BYTES(capacity);
+    // as 16-bit words the same bytes would hold one sample per two
+    size_t ring_bytes = AUDIO_PACK12_BYTES(BENCH_BUFFER);
+    uint64_t log_samples = bench_clip_log_samples();
+    uint64_t log_samples_16 = HOST_FLASH_SIZE / sizeof(int16_t);
+
+    printf("{\"pack_mb_per_s\":%.1f,\"unpack_mb_per_s\":%.1f,\"unpack_stride2_mb_per_s\":%.1f,"
+           "\"ring_bytes\":%zu,\"ring_samples\":%u,\"ring_samples_16bit\":%zu,\"ring_gain\":%.2f,"
+           "\"clip_log_bytes\":%d,\"clip_log_samples\":%llu,\"clip_log_gain\":%.2f,\"sink\":%llu}\n",
+           bench_mb_per_s((uint64_t)BENCH_SAMPLES * 2, pack_us), bench_mb_per_s((uint64_t)BENCH_SAMPLES * 2, unpack_us),
+           bench_mb_per_s((uint64_t)BENCH_SAMPLES, stride_us), ring_bytes, BENCH_BUFFER, ring_bytes / 2,
+           (double)BENCH_BUFFER / (ring_bytes / 2), HOST_FLASH_SIZE, (unsigned long long)log_samples,
+           (double)log_samples / log_samples_16, (unsigned long long)sink);
+    free(packed);
+    return log_samples > 0 ? 0 : 1;
+}
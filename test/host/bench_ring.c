@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "audio_ring.h"
+
+// Ring throughput at the depth this binary was built with, one JSON line:
+// frame writes, frame reads by a cursor that keeps up, and both at once
+// with the write of each frame followed by its read (the record task and
+// the playback task on one core)
+
+#define BENCH_CAPACITY (1u << 18)
+#define BENCH_FRAME 256
+#define BENCH_SAMPLES (64u << 20)
+
+static double bench_msamples_per_s(uint64_t samples, int64_t us) {
+    return us > 0 ? (double)samples / us : 0;
+}
+
+int main(void) {
+    static int16_t frame[BENCH_FRAME];
+    static int16_t out[BENCH_FRAME];
+    audio_ring_t ring;
+    uint8_t *storage = malloc(AUDIO_RING_STORAGE_BYTES(BENCH_CAPACITY));
+    if (storage == NULL || audio_ring_init(&ring, storage, BENCH_CAPACITY) != ESP_OK) {
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_FRAME; ++i) {
+        frame[i] = (int16_t)((i * 37) & 0xFFF);
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += BENCH_FRAME) {
+        audio_ring_write(&ring, frame, BENCH_FRAME);
+    }
+    int64_t write_us = esp_timer_get_time() - start;
+
+    // Reads of the most recent capacity's worth, over and over
+    uint32_t read = 0;
+    start = esp_timer_get_time();
+    while (read < BENCH_SAMPLES) {
+        audio_ring_cursor_t cursor = audio_ring_cursor_last(&ring, BENCH_CAPACITY);
+        size_t got;
+        while ((got = audio_ring_read(&ring, &cursor, out, BENCH_FRAME)) > 0) {
+            read += got;
+        }
+    }
+    int64_t read_us = esp_timer_get_time() - start;
+
+    audio_ring_cursor_t cursor = audio_ring_cursor_live(&ring);
+    start = esp_timer_get_time();
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += BENCH_FRAME) {
+        audio_ring_write(&ring, frame, BENCH_FRAME);
+        audio_ring_read(&ring, &cursor, out, BENCH_FRAME);
+    }
+    int64_t both_us = esp_timer_get_time() - start;
+
+    printf("{\"ring_bits\":%d,\"write_msamples_per_s\":%.1f,\"read_msamples_per_s\":%.1f,"
+           "\"write_read_msamples_per_s\":%.1f,\"write_mb_per_s\":%.1f,\"read_mb_per_s\":%.1f}\n",
+           CONFIG_AUDIO_RING_BITS, bench_msamples_per_s(BENCH_SAMPLES, write_us),
+           bench_msamples_per_s(read, read_us), bench_msamples_per_s(BENCH_SAMPLES, both_us),
+           bench_msamples_per_s(BENCH_SAMPLES * sizeof(int16_t), write_us),
+           bench_msamples_per_s(read * sizeof(int16_t), read_us));
+    free(storage);
+    return 0;
+}
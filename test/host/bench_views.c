@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "audio_ring.h"
+
+// Multi-channel ring throughput at the depth this binary was built with,
+// one JSON line per channel count (1, 2, 4, 8): scans of every channel
+// written as interleaved frames, as capture does, then each channel read
+// back through its view, against reading the frames interleaved and
+// splitting them in a second pass
+
+#define BENCH_CAPACITY (1u << 18)
+#define BENCH_SCANS 256             // Scans per frame written
+#define BENCH_SAMPLES (64u << 20)   // Per pass, all channels
+
+static double bench_msamples_per_s(uint64_t samples, int64_t us) {
+    return us > 0 ? (double)samples / us : 0;
+}
+
+int main(void) {
+    static int16_t frame[BENCH_SCANS * 8];
+    static int16_t out[BENCH_SCANS * 8];
+    static int16_t split[BENCH_SCANS];
+    uint8_t *storage = malloc(AUDIO_RING_STORAGE_BYTES(BENCH_CAPACITY));
+    uint64_t sink = 0;
+
+    if (storage == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_SCANS * 8; ++i) {
+        frame[i] = (int16_t)((i * 2654435761u >> 20) & 0xFFF);
+    }
+
+    for (uint8_t channels = 1; channels <= 8; channels *= 2) {
+        size_t frame_samples = BENCH_SCANS * channels;
+        audio_ring_t ring;
+        if (audio_ring_init(&ring, storage, BENCH_CAPACITY) != ESP_OK) {
+            return 1;
+        }
+
+        int64_t start = esp_timer_get_time();
+        for (uint32_t done = 0; done < BENCH_SAMPLES; done += frame_samples) {
+            audio_ring_write(&ring, frame, frame_samples);
+        }
+        int64_t write_us = esp_timer_get_time() - start;
+
+        // Every channel of the ring's contents through its own view
+        uint64_t read = 0;
+        start = esp_timer_get_time();
+        while (read < BENCH_SAMPLES) {
+            for (uint8_t c = 0; c < channels; ++c) {
+                audio_ring_view_t view = {.ring = &ring, .channels = channels, .channel = c};
+                audio_ring_cursor_t cursor = audio_ring_cursor_last(&ring, BENCH_CAPACITY);
+                size_t got;
+                while ((got = audio_ring_view_read(&view, &cursor, out, BENCH_SCANS)) > 0) {
+                    read += got;
+                    sink += (uint16_t)out[got - 1];
+                }
+            }
+        }
+        int64_t view_us = esp_timer_get_time() - start;
+
+        // The same samples read interleaved, then split channel by channel
+        uint64_t read_split = 0;
+        start = esp_timer_get_time();
+        while (read_split < BENCH_SAMPLES) {
+            audio_ring_cursor_t cursor = audio_ring_cursor_last(&ring, BENCH_CAPACITY);
+            size_t got;
+            while ((got = audio_ring_read(&ring, &cursor, out, frame_samples)) > 0) {
+                for (uint8_t c = 0; c < channels; ++c) {
+                    for (size_t i = 0; i < got / channels; ++i) {
+                        split[i] = out[i * channels + c];
+                    }
+                    sink += (uint16_t)split[got / channels - 1];
+                }
+                read_split += got;
+            }
+        }
+        int64_t split_us = esp_timer_get_time() - start;
+
+        printf("{\"ring_bits\":%d,\"channels\":%u,\"write_msamples_per_s\":%.1f,\"view_read_msamples_per_s\":%.1f,"
+               "\"split_read_msamples_per_s\":%.1f,\"sink\":%llu}\n",
+               CONFIG_AUDIO_RING_BITS, channels, bench_msamples_per_s(BENCH_SAMPLES, write_us),
+               bench_msamples_per_s(read, view_us), bench_msamples_per_s(read_split, split_us),
+               (unsigned long long)sink);
+    }
+    free(storage);
+    return 0;
+}
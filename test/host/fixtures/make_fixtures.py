@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Write the WAV fixtures for test_wav.c with Python's own wave and audioop
+modules, so the firmware's header writer, parser and mu-law coder are
+checked against code they share nothing with. The samples are
+signal(i) = (i * 1237) % 30000 - 15000, as in test_wav.c.
+
+The vad_*.wav fixtures for test_vad.c are synthetic speech over a steady
+background: voiced words (a 140 Hz buzz with harmonics under a syllable
+envelope) and a fricative (high-passed noise), at the times listed below.
+
+    python3 make_fixtures.py   (in this directory)
+"""
+
+import audioop
+import math
+import struct
+import wave
+
+
+def signal(count, sign=1):
+    return [sign * ((i * 1237) % 30000 - 15000) for i in range(count)]
+
+
+def pcm_bytes(samples):
+    return struct.pack(f"<{len(samples)}h", *samples)
+
+
+def chunk(tag, body):
+    return tag + struct.pack("<I", len(body)) + body + (b"\0" if len(body) & 1 else b"")
+
+
+def riff(*chunks):
+    body = b"WAVE" + b"".join(chunks)
+    return b"RIFF" + struct.pack("<I", len(body)) + body
+
+
+# Plain 44-byte header, as nearly every tool writes it
+with wave.open("pcm16_mono_16k.wav", "wb") as out:
+    out.setnchannels(1)
+    out.setsampwidth(2)
+    out.setframerate(16000)
+    out.writeframes(pcm_bytes(signal(1600)))
+
+# Stereo with a LIST chunk and an odd-sized chunk (and its pad byte) before data
+left, right = signal(800), signal(800, -1)
+interleaved = [s for pair in zip(left, right) for s in pair]
+fmt = struct.pack("<HHIIHH", 1, 2, 8000, 8000 * 4, 4, 16)
+info = chunk(b"LIST", b"INFO" + chunk(b"ISFT", b"make_fixtures.py\0"))
+with open("pcm16_stereo_8k_chunks.wav", "wb") as out:
+    out.write(riff(chunk(b"fmt ", fmt), info, chunk(b"junk", b"odd"), chunk(b"data", pcm_bytes(interleaved))))
+
+# mu-law (format 7) with cbSize and a fact chunk, an odd number of samples
+ulaw = audioop.lin2ulaw(pcm_bytes(signal(1001)), 2)
+fmt = struct.pack("<HHIIHHH", 7, 1, 8000, 8000, 1, 8, 0)
+with open("ulaw_mono_8k.wav", "wb") as out:
+    out.write(riff(chunk(b"fmt ", fmt), chunk(b"fact", struct.pack("<I", 1001)), chunk(b"data", ulaw)))
+
+
+class Noise:
+    """xorshift32, so the fixtures do not depend on Python's random"""
+
+    def __init__(self, seed):
+        self.state = seed
+
+    def __call__(self, amplitude):
+        x = self.state
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        self.state = x
+        return x % (2 * amplitude + 1) - amplitude
+
+
+VAD_RATE = 16000
+VAD_BACKGROUND = 128        # Uniform noise, 8 LSB of the 12-bit ADC
+VAD_WORDS = [               # (start s, end s, fricative lead-in s), as test_vad.c expects them
+    (1.0, 1.4, 0.0),
+    (2.2, 2.8, 0.15),
+    (4.0, 4.3, 0.0),
+]
+
+
+def vad_clip(seconds, words):
+    noise = Noise(7)
+    out = []
+    last = 0
+    for i in range(int(seconds * VAD_RATE)):
+        t = i / VAD_RATE
+        x = noise(VAD_BACKGROUND)
+        for start, end, fricative in words:
+            if start <= t < start + fricative:
+                hiss = noise(600)
+                x += hiss - last    # First difference: the energy is up high
+                last = hiss
+            elif start + fricative <= t < end:
+                phase = (t - start - fricative) / (end - start - fricative)
+                envelope = math.sin(math.pi * phase) ** 2
+                buzz = sum(math.sin(2 * math.pi * 140 * k * t) / k for k in range(1, 6))
+                x += int(5000 * envelope * buzz)
+        out.append(max(-32768, min(32767, x)))
+    return out
+
+
+for name, seconds, words in (("vad_words_16k.wav", 6.0, VAD_WORDS), ("vad_background_16k.wav", 3.0, [])):
+    with wave.open(name, "wb") as out:
+        out.setnchannels(1)
+        out.setsampwidth(2)
+        out.setframerate(VAD_RATE)
+        out.writeframes(pcm_bytes(vad_clip(seconds, words)))
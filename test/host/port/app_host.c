@@ -0,0 +1,16 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Entry point for the app itself on the host, as the ESP-IDF linux target
+// has it: app_main on the main task, which then idles while the tasks it
+// created run. A benchmark build (CONFIG_AUDIO_BENCHMARK) exits from
+// app_main once it has printed its line.
+
+void app_main(void);
+
+int main(void) {
+    app_main();
+    while (1) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
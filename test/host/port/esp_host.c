@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "host_flash.h"
+#include "host_heap.h"
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t count, size_t size, uint32_t caps) {
+    (void)caps;
+    return calloc(count, size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    (void)caps;
+    return 4 * 1024 * 1024;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+// Here rather than with the wrappers (heap_host.c), which only tests built
+// to count the heap link: the stand-in network marks its buffers in any test
+static __thread int s_heap_untracked;
+
+void host_heap_untracked_begin(void) {
+    s_heap_untracked++;
+}
+
+void host_heap_untracked_end(void) {
+    s_heap_untracked--;
+}
+
+bool host_heap_untracked(void) {
+    return s_heap_untracked > 0;
+}
+
+// Repeatable from run to run
+uint32_t esp_random(void) {
+    static uint32_t state = 0x2545F491u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint8_t s_flash[HOST_FLASH_SIZE];
+static bool s_flash_present = true;
+static bool s_flash_initialised;
+static bool s_flash_cut_armed;
+static size_t s_flash_budget;           // Bytes left before the cut, when armed
+static bool s_flash_powered = true;
+static host_flash_stats_t s_flash_stats;
+static esp_partition_t s_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = ESP_PARTITION_SUBTYPE_ANY,
+    .address = 0x110000,
+    .size = HOST_FLASH_SIZE,
+    .erase_size = HOST_FLASH_SECTOR,
+};
+
+static void host_flash_init_once(void) {
+    if (!s_flash_initialised) {
+        memset(s_flash, 0xff, sizeof(s_flash));
+        s_flash_initialised = true;
+    }
+}
+
+void host_flash_reset(bool present) {
+    memset(s_flash, 0xff, sizeof(s_flash));
+    s_flash_initialised = true;
+    s_flash_present = present;
+    s_flash_cut_armed = false;
+    s_flash_powered = true;
+    memset(&s_flash_stats, 0, sizeof(s_flash_stats));
+}
+
+void host_flash_cut_after(size_t bytes) {
+    host_flash_init_once();
+    s_flash_cut_armed = true;
+    s_flash_budget = bytes;
+}
+
+void host_flash_power_on(void) {
+    s_flash_cut_armed = false;
+    s_flash_powered = true;
+}
+
+bool host_flash_powered(void) {
+    return s_flash_powered;
+}
+
+uint8_t *host_flash_contents(void) {
+    host_flash_init_once();
+    return s_flash;
+}
+
+void host_flash_stats(host_flash_stats_t *stats) {
+    *stats = s_flash_stats;
+}
+
+// How many of `size` bytes get done before the power goes
+static size_t host_flash_spend(size_t size) {
+    if (!s_flash_cut_armed) {
+        return size;
+    }
+    size_t done = size < s_flash_budget ? size : s_flash_budget;
+    s_flash_budget -= done;
+    if (done < size) {
+        s_flash_powered = false;
+    }
+    return done;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    (void)subtype;
+    host_flash_init_once();
+    if (!s_flash_present || type != ESP_PARTITION_TYPE_DATA) {
+        return NULL;
+    }
+    snprintf(s_partition.label, sizeof(s_partition.label), "%s", label != NULL ? label : "");
+    return &s_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_flash_stats.reads++;
+    memcpy(dst, s_flash + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!s_flash_powered) {
+        return ESP_FAIL;
+    }
+    size_t done = host_flash_spend(size);
+    for (size_t i = 0; i < done; ++i) {
+        s_flash[offset + i] &= ((const uint8_t *)src)[i];
+    }
+    s_flash_stats.writes++;
+    s_flash_stats.bytes_written += done;
+    return done == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % HOST_FLASH_SECTOR != 0 || size % HOST_FLASH_SECTOR != 0 || offset > partition->size ||
+        size > partition->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_flash_powered) {
+        return ESP_FAIL;
+    }
+    size_t done = host_flash_spend(size);
+    memset(s_flash + offset, 0xff, done);
+    s_flash_stats.erases += size / HOST_FLASH_SECTOR;
+    return done == size ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,413 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+// Task threads run on a stack of their configured size plus this, painted
+// with HOST_STACK_PAINT, so uxTaskGetStackHighWaterMark can measure how deep
+// they went. The extra room is for libc (printf alone takes a few KB) and
+// x86-64 frames, which are not the target's.
+#define HOST_STACK_EXTRA (64 * 1024)
+#define HOST_STACK_PAINT 0xA5
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t stack;
+    uint8_t *stack_base;        // Painted thread stack, lowest address; NULL if not created here
+    size_t stack_size;
+    uintptr_t stack_entry;      // Stack pointer as the task function was entered
+    bool deleted;
+    size_t stack_used;          // Measured as it was deleted, before pthread_exit unwinds on its stack
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notifications;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t length;
+    size_t item_size;           // 0 for semaphores
+    size_t head;
+    size_t count;
+    uint8_t *items;
+};
+
+static __thread struct host_task *s_current;
+static struct timespec s_start;
+
+__attribute__((constructor)) static void host_clock_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+static uint64_t host_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - s_start.tv_sec) * 1000000 + (now.tv_nsec - s_start.tv_nsec) / 1000;
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_now_us();
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return host_now_us() / 1000;
+}
+
+static void host_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec host_deadline(TickType_t timeout) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+// Wait on `cond` until `deadline`; false once it has passed. portMAX_DELAY
+// waits for ever.
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t timeout,
+                      const struct timespec *deadline) {
+    if (timeout == 0) {
+        return false;
+    }
+    if (timeout == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static struct host_task *host_task_new(TaskFunction_t fn, void *arg, uint32_t stack) {
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return NULL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    task->stack = stack;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->notified);
+    return task;
+}
+
+// The thread that called main, or one the test started itself, is a task
+// too, so it can take notifications
+static struct host_task *host_task_current(void) {
+    if (s_current == NULL) {
+        s_current = host_task_new(NULL, NULL, 0);
+        s_current->thread = pthread_self();
+    }
+    return s_current;
+}
+
+static void *host_task_run(void *arg) {
+    s_current = arg;
+    s_current->stack_entry = (uintptr_t)__builtin_frame_address(0);
+    s_current->fn(s_current->arg);
+    return NULL;
+}
+
+// Deepest the task has gone below its entry frame, from the lowest byte
+// that is no longer paint
+static size_t host_stack_used(const struct host_task *task) {
+    const uint8_t *p = task->stack_base;
+    while (p < task->stack_base + task->stack_size && *p == HOST_STACK_PAINT) {
+        p++;
+    }
+    return task->stack_entry > (uintptr_t)p ? task->stack_entry - (uintptr_t)p : 0;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle) {
+    (void)name;
+    (void)priority;
+    struct host_task *task = host_task_new(fn, arg, stack);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    if (handle != NULL) {
+        *handle = task;
+    }
+    // Never freed, like the task: its handle stays valid after it is deleted
+    task->stack_size = (stack + HOST_STACK_EXTRA + 4095) & ~(size_t)4095;
+    if (posix_memalign((void **)&task->stack_base, 4096, task->stack_size) != 0) {
+        return pdFAIL;
+    }
+    memset(task->stack_base, HOST_STACK_PAINT, task->stack_size);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack_base, task->stack_size);
+    int err = pthread_create(&task->thread, &attr, host_task_run, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == s_current) {
+        if (s_current != NULL && s_current->stack_base != NULL) {
+            s_current->stack_used = host_stack_used(s_current);
+            s_current->deleted = true;
+        }
+        pthread_exit(NULL); // The handle stays valid; notifications to it are lost
+    }
+    abort();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    struct timespec delay = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000};
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return host_task_current();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    task = task != NULL ? task : host_task_current();
+    if (task->stack_base == NULL) {
+        return task->stack;
+    }
+    size_t used = task->deleted ? task->stack_used : host_stack_used(task);
+    return used < task->stack ? task->stack - used : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+    struct host_task *task = host_task_current();
+    struct timespec deadline = host_deadline(timeout);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notifications == 0 && host_wait(&task->notified, &task->lock, timeout, &deadline)) {
+    }
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notifications++;
+    pthread_cond_broadcast(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    xTaskNotifyGive(task);
+    if (woken != NULL) {
+        *woken = pdTRUE;
+    }
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL || length == 0) {
+        free(queue);
+        return NULL;
+    }
+    queue->items = calloc(length, item_size > 0 ? item_size : 1);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    host_cond_init(&queue->changed);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    struct timespec deadline = host_deadline(timeout);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && host_wait(&queue->changed, &queue->lock, timeout, &deadline)) {
+    }
+    BaseType_t sent = queue->count < queue->length;
+    if (sent) {
+        size_t slot = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + slot * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+    BaseType_t sent = xQueueSend(queue, item, 0);
+    if (woken != NULL && sent) {
+        *woken = pdTRUE;
+    }
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+    struct timespec deadline = host_deadline(timeout);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && host_wait(&queue->changed, &queue->lock, timeout, &deadline)) {
+    }
+    BaseType_t received = queue->count > 0;
+    if (received) {
+        if (queue->item_size > 0) {
+            memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex != NULL) {
+        xSemaphoreGive(mutex);
+    }
+    return mutex;
+}
+
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t size, size_t trigger, uint8_t *storage,
+                                               StaticStreamBuffer_t *buffer) {
+    memset(buffer, 0, sizeof(*buffer));
+    pthread_mutex_init(&buffer->mutex, NULL);
+    host_cond_init(&buffer->changed);
+    buffer->storage = storage;
+    buffer->size = size;
+    buffer->trigger = trigger > 0 ? trigger : 1;
+    return (StreamBufferHandle_t)buffer;
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t handle, const void *data, size_t len, TickType_t timeout) {
+    StaticStreamBuffer_t *buffer = (StaticStreamBuffer_t *)handle;
+    struct timespec deadline = host_deadline(timeout);
+
+    pthread_mutex_lock(&buffer->mutex);
+    while (buffer->size - buffer->used < len && host_wait(&buffer->changed, &buffer->mutex, timeout, &deadline)) {
+    }
+    size_t sent = buffer->size - buffer->used < len ? buffer->size - buffer->used : len;
+    for (size_t i = 0; i < sent; ++i) {
+        buffer->storage[(buffer->head + buffer->used + i) % buffer->size] = ((const uint8_t *)data)[i];
+    }
+    buffer->used += sent;
+    if (sent > 0) {
+        pthread_cond_broadcast(&buffer->changed);
+    }
+    pthread_mutex_unlock(&buffer->mutex);
+    return sent;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t handle, void *data, size_t len, TickType_t timeout) {
+    StaticStreamBuffer_t *buffer = (StaticStreamBuffer_t *)handle;
+    struct timespec deadline = host_deadline(timeout);
+
+    pthread_mutex_lock(&buffer->mutex);
+    if (buffer->used == 0) {
+        while (buffer->used < buffer->trigger && host_wait(&buffer->changed, &buffer->mutex, timeout, &deadline)) {
+        }
+    }
+    size_t received = buffer->used < len ? buffer->used : len;
+    for (size_t i = 0; i < received; ++i) {
+        ((uint8_t *)data)[i] = buffer->storage[(buffer->head + i) % buffer->size];
+    }
+    buffer->head = (buffer->head + received) % buffer->size;
+    buffer->used -= received;
+    if (received > 0) {
+        pthread_cond_broadcast(&buffer->changed);
+    }
+    pthread_mutex_unlock(&buffer->mutex);
+    return received;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t handle) {
+    StaticStreamBuffer_t *buffer = (StaticStreamBuffer_t *)handle;
+    pthread_mutex_lock(&buffer->mutex);
+    size_t used = buffer->used;
+    pthread_mutex_unlock(&buffer->mutex);
+    return used;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t handle) {
+    return xStreamBufferBytesAvailable(handle) == 0;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t handle) {
+    StaticStreamBuffer_t *buffer = (StaticStreamBuffer_t *)handle;
+    pthread_mutex_lock(&buffer->mutex);
+    buffer->head = 0;
+    buffer->used = 0;
+    pthread_cond_broadcast(&buffer->changed);
+    pthread_mutex_unlock(&buffer->mutex);
+    return pdPASS;
+}
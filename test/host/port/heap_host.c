@@ -0,0 +1,135 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "host_heap.h"
+
+// Linked into tests built with host_test(HEAP), with -Wl,--wrap for each of
+// these: calls to malloc from the test, the firmware and the port land here.
+// Blocks counted are kept in a small open-addressed table, so a block freed
+// that was never counted (allocated before tracking, untracked, or by libc
+// itself) is simply not found.
+
+#define HEAP_SLOTS 4096             // Power of two; counted blocks live at once, with room
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+typedef struct {
+    void *ptr;                      // NULL: empty, s_tombstone: deleted
+    size_t size;
+} heap_block_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static heap_block_t s_blocks[HEAP_SLOTS];
+static char s_tombstone_byte;
+static void *const s_tombstone = &s_tombstone_byte;
+static bool s_tracking;
+static host_heap_stats_t s_stats;
+
+static size_t heap_slot(const void *ptr) {
+    return ((uintptr_t)ptr >> 4) * 2654435761u & (HEAP_SLOTS - 1);
+}
+
+// Caller holds s_lock
+static void heap_add(void *ptr, size_t size) {
+    for (size_t i = heap_slot(ptr), n = 0; n < HEAP_SLOTS; i = (i + 1) & (HEAP_SLOTS - 1), ++n) {
+        if (s_blocks[i].ptr == NULL || s_blocks[i].ptr == s_tombstone) {
+            s_blocks[i] = (heap_block_t){.ptr = ptr, .size = size};
+            s_stats.live += size;
+            s_stats.peak = s_stats.live > s_stats.peak ? s_stats.live : s_stats.peak;
+            s_stats.allocations++;
+            return;
+        }
+    }
+    abort();    // More blocks live than the table holds
+}
+
+// Size of the block forgotten, 0 if it was not counted
+static size_t heap_remove(void *ptr) {
+    for (size_t i = heap_slot(ptr), n = 0; n < HEAP_SLOTS; i = (i + 1) & (HEAP_SLOTS - 1), ++n) {
+        if (s_blocks[i].ptr == NULL) {
+            return 0;
+        }
+        if (s_blocks[i].ptr == ptr) {
+            s_stats.live -= s_blocks[i].size;
+            s_blocks[i].ptr = s_tombstone;
+            return s_blocks[i].size;
+        }
+    }
+    return 0;
+}
+
+static void heap_allocated(void *ptr, size_t size) {
+    if (ptr == NULL || host_heap_untracked()) {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_tracking) {
+        heap_add(ptr, size);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static size_t heap_freed(void *ptr) {
+    if (ptr == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&s_lock);
+    size_t size = heap_remove(ptr);
+    pthread_mutex_unlock(&s_lock);
+    return size;
+}
+
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    heap_allocated(ptr, size);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    void *ptr = __real_calloc(count, size);
+    heap_allocated(ptr, count * size);
+    return ptr;
+}
+
+// The old block is forgotten first: once it moves, another thread may be
+// given its address
+void *__wrap_realloc(void *ptr, size_t size) {
+    size_t counted = heap_freed(ptr);
+    void *moved = __real_realloc(ptr, size);
+    if (moved == NULL && size != 0) {
+        if (counted != 0) {
+            pthread_mutex_lock(&s_lock);
+            heap_add(ptr, counted);     // Still there, unchanged
+            pthread_mutex_unlock(&s_lock);
+        }
+        return NULL;
+    }
+    heap_allocated(moved, size);
+    return moved;
+}
+
+void __wrap_free(void *ptr) {
+    heap_freed(ptr);
+    __real_free(ptr);
+}
+
+void host_heap_track(bool on) {
+    pthread_mutex_lock(&s_lock);
+    if (on) {
+        for (size_t i = 0; i < HEAP_SLOTS; ++i) {
+            s_blocks[i].ptr = NULL;
+        }
+        s_stats = (host_heap_stats_t){0};
+    }
+    s_tracking = on;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_heap_stats(host_heap_stats_t *stats) {
+    pthread_mutex_lock(&s_lock);
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
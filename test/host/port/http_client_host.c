@@ -0,0 +1,407 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "esp_http_client.h"
+#include "host_http.h"
+#include "host_heap.h"
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    char *url;
+    esp_http_client_method_t method;
+    host_http_header_t headers[HOST_HTTP_MAX_HEADERS];     // Owned copies
+    size_t header_count;
+    bool connected;             // As far as the client knows
+    bool server_closed;         // The server has closed the connection
+    bool broken;                // The request in progress failed
+    int write_len;              // -1 for a chunked body
+    uint8_t *body;              // Request body as written
+    size_t body_len;
+    size_t body_cap;
+    bool responded;
+    int status;
+    host_http_header_t response_headers[HOST_HTTP_MAX_HEADERS + 1];
+    size_t response_header_count;
+    uint8_t *response;
+    size_t response_len;
+    size_t response_pos;
+    struct timespec next_read;  // When the rate limit allows the next read
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_http_handler_t s_handler;
+static void *s_handler_ctx;
+static host_http_config_t s_config;
+static host_http_stats_t s_stats;
+
+void host_http_serve(host_http_handler_t handler, void *ctx, const host_http_config_t *config) {
+    pthread_mutex_lock(&s_lock);
+    s_handler = handler;
+    s_handler_ctx = ctx;
+    memset(&s_config, 0, sizeof(s_config));
+    if (config != NULL) {
+        s_config = *config;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_http_configure(const host_http_config_t *config) {
+    pthread_mutex_lock(&s_lock);
+    s_config = *config;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_http_stats(host_http_stats_t *stats) {
+    pthread_mutex_lock(&s_lock);
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+const char *host_http_request_header(const host_http_request_t *request, const char *key) {
+    for (size_t i = 0; i < request->header_count; ++i) {
+        if (strcasecmp(request->headers[i].key, key) == 0) {
+            return request->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+static void host_http_sleep_ms(uint32_t ms) {
+    struct timespec delay = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+static void host_http_event(esp_http_client_handle_t client, esp_http_client_event_id_t id, const char *key,
+                            const char *value) {
+    if (client->config.event_handler == NULL) {
+        return;
+    }
+    esp_http_client_event_t event = {
+        .event_id = id,
+        .client = client,
+        .user_data = client->config.user_data,
+        .header_key = (char *)key,
+        .header_value = (char *)value,
+    };
+    client->config.event_handler(&event);
+}
+
+static void host_http_free_headers(host_http_header_t *headers, size_t *count) {
+    for (size_t i = 0; i < *count; ++i) {
+        free((char *)headers[i].key);
+        free((char *)headers[i].value);
+    }
+    *count = 0;
+}
+
+static void host_http_clear_response(esp_http_client_handle_t client) {
+    host_http_free_headers(client->response_headers, &client->response_header_count);
+    free(client->response);
+    client->response = NULL;
+    client->response_len = 0;
+    client->response_pos = 0;
+    client->responded = false;
+}
+
+// Undo chunked framing in place; false if the terminating chunk never came
+static bool host_http_dechunk(uint8_t *body, size_t *len) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < *len) {
+        char *end;
+        unsigned long chunk = strtoul((const char *)body + in, &end, 16);
+        size_t data = (uint8_t *)end - body + 2;
+        if (data > *len || end[0] != '\r' || end[1] != '\n') {
+            break;
+        }
+        if (chunk == 0) {
+            *len = out;
+            return true;
+        }
+        size_t take = chunk < *len - data ? chunk : *len - data;
+        memmove(body + out, body + data, take);
+        out += take;
+        in = data + chunk + 2;
+    }
+    *len = out;
+    return false;
+}
+
+// Hand the request to the handler; a response is only kept if it was complete
+static void host_http_deliver(esp_http_client_handle_t client, bool complete) {
+    size_t len = client->body_len;
+    if (client->write_len < 0) {
+        complete = host_http_dechunk(client->body, &len) && complete;
+    }
+
+    host_http_request_t request = {
+        .method = client->method,
+        .url = client->url,
+        .header_count = client->header_count,
+        .body = client->body,
+        .body_len = len,
+        .complete = complete,
+    };
+    memcpy(request.headers, client->headers, sizeof(request.headers));
+    host_http_response_t response = {.status = 200};
+
+    if (s_handler != NULL) {
+        host_heap_untracked_begin();    // The server's memory
+        s_handler(s_handler_ctx, &request, &response);
+        host_heap_untracked_end();
+    }
+    if (!complete) {
+        return;
+    }
+    client->status = response.status;
+    for (size_t i = 0; i < response.header_count && i < HOST_HTTP_MAX_HEADERS; ++i) {
+        client->response_headers[i].key = strdup(response.headers[i].key);
+        client->response_headers[i].value = strdup(response.headers[i].value);
+        client->response_header_count++;
+    }
+    if (s_config.close_connections) {
+        host_http_header_t *close = &client->response_headers[client->response_header_count++];
+        close->key = strdup("Connection");
+        close->value = strdup("close");
+    }
+    client->response = malloc(response.body_len > 0 ? response.body_len : 1);
+    memcpy(client->response, response.body, response.body_len);
+    client->response_len = response.body_len;
+    client->responded = true;
+    if (s_config.close_connections || s_config.close_silently) {
+        client->server_closed = true;
+    }
+}
+
+// The connection breaks here; the server sees what was sent so far
+static void host_http_drop(esp_http_client_handle_t client) {
+    s_config.drops--;
+    s_stats.drops++;
+    client->broken = true;
+    client->server_closed = true;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->config = *config;
+    client->url = strdup(config->url != NULL ? config->url : "");
+    client->method = config->method;
+    return client;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    host_http_clear_response(client);
+    host_http_free_headers(client->headers, &client->header_count);
+    free(client->body);
+    free(client->url);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+    free(client->url);
+    client->url = strdup(url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+    for (size_t i = 0; i < client->header_count; ++i) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            free((char *)client->headers[i].value);
+            client->headers[i].value = strdup(value);
+            return ESP_OK;
+        }
+    }
+    if (client->header_count == HOST_HTTP_MAX_HEADERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    client->headers[client->header_count].key = strdup(key);
+    client->headers[client->header_count].value = strdup(value);
+    client->header_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key) {
+    for (size_t i = 0; i < client->header_count; ++i) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            free((char *)client->headers[i].key);
+            free((char *)client->headers[i].value);
+            client->headers[i] = client->headers[--client->header_count];
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    host_http_clear_response(client);
+    client->write_len = write_len;
+    client->body_len = 0;
+    client->broken = false;
+    client->status = 0;
+
+    pthread_mutex_lock(&s_lock);
+    if (client->connected && client->server_closed) {
+        // Reusing a connection the server closed: the client only finds out
+        // when it sends or waits for the response
+        client->broken = true;
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;
+    }
+    bool new_connection = !client->connected;
+    if (new_connection && s_config.offline) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_FAIL;
+    }
+    if (new_connection) {
+        s_stats.connections++;
+        client->connected = true;
+        client->server_closed = false;
+    }
+    s_stats.requests++;
+    pthread_mutex_unlock(&s_lock);
+
+    if (new_connection) {
+        host_http_event(client, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len) {
+    if (client->broken || !client->connected) {
+        return -1;
+    }
+    if (client->body_len + len > client->body_cap) {
+        // The whole body as the server receives it; the device only has
+        // what it is writing
+        client->body_cap = (client->body_len + len) * 2;
+        host_heap_untracked_begin();
+        client->body = realloc(client->body, client->body_cap);
+        host_heap_untracked_end();
+    }
+
+    pthread_mutex_lock(&s_lock);
+    size_t limit = s_config.drop_request_after;
+    bool drop = s_config.drops > 0 && limit > 0 && client->body_len + len > limit;
+    size_t take = drop ? (client->body_len < limit ? limit - client->body_len : 0) : (size_t)len;
+    memcpy(client->body + client->body_len, buffer, take);
+    client->body_len += take;
+    if (drop) {
+        host_http_drop(client);
+        host_http_deliver(client, false);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return drop ? -1 : len;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    if (client->broken || !client->connected) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&s_lock);
+    uint32_t latency_ms = s_config.latency_ms;
+    pthread_mutex_unlock(&s_lock);
+    host_http_sleep_ms(latency_ms);
+
+    pthread_mutex_lock(&s_lock);
+    host_http_deliver(client, client->write_len < 0 || client->body_len >= (size_t)client->write_len);
+    pthread_mutex_unlock(&s_lock);
+    if (!client->responded) {
+        client->broken = true;
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &client->next_read);
+
+    for (size_t i = 0; i < client->response_header_count; ++i) {
+        host_http_event(client, HTTP_EVENT_ON_HEADER, client->response_headers[i].key,
+                        client->response_headers[i].value);
+    }
+    return client->response_len;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->response_len;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+    if (client->broken || !client->responded) {
+        return -1;
+    }
+    size_t n = client->response_len - client->response_pos;
+    n = n < (size_t)len ? n : (size_t)len;
+    if (n == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&s_lock);
+    size_t limit = s_config.drop_response_after;
+    uint32_t rate = s_config.bytes_per_second;
+    if (s_config.drops > 0 && limit > 0 && client->response_pos + n > limit) {
+        if (client->response_pos >= limit) {
+            host_http_drop(client);
+            pthread_mutex_unlock(&s_lock);
+            return -1;
+        }
+        n = limit - client->response_pos;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (rate > 0) {
+        uint64_t ns = client->next_read.tv_nsec + (uint64_t)n * 1000000000 / rate;
+        client->next_read.tv_sec += ns / 1000000000;
+        client->next_read.tv_nsec = ns % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &client->next_read, NULL) == EINTR) {
+        }
+    }
+    memcpy(buffer, client->response + client->response_pos, n);
+    client->response_pos += n;
+    return n;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len) {
+    char scratch[512];
+    int total = 0;
+    int n;
+
+    while ((n = esp_http_client_read(client, scratch, sizeof(scratch))) > 0) {
+        total += n;
+    }
+    if (len != NULL) {
+        *len = total;
+    }
+    return n < 0 ? ESP_FAIL : ESP_OK;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+    return client->responded && !client->broken && client->response_pos == client->response_len;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    host_http_clear_response(client);
+    client->connected = false;
+    client->server_closed = false;
+    client->broken = false;
+    return ESP_OK;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdio.h>
+
+// Info and above, like the ESP-IDF default level. Debug lines still compile
+// their arguments.
+#define ESP_HOST_LOG(letter, tag, format, ...) printf(letter " (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                        \
+    do {                                                  \
+        if (0) {                                          \
+            ESP_HOST_LOG("D", tag, format, ##__VA_ARGS__); \
+        }                                                 \
+    } while (0)
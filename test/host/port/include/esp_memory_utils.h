@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+
+// No external RAM on the host
+static inline bool esp_ptr_external_ram(const void *ptr) {
+    (void)ptr;
+    return false;
+}
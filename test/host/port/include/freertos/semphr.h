@@ -0,0 +1,15 @@
+#pragma once
+
+#include "freertos/queue.h"
+
+// Semaphores are queues of empty items, as in FreeRTOS: a mutex starts with
+// its one item in place. Mutexes are not recursive.
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+#define xSemaphoreTake(semaphore, timeout) xQueueReceive((semaphore), NULL, (timeout))
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSendFromISR((semaphore), NULL, (woken))
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_stream_buffer *StreamBufferHandle_t;
+
+// Holds the buffer state, so no allocation is needed
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint8_t *storage;
+    size_t size;
+    size_t trigger;
+    size_t head;
+    size_t used;
+} StaticStreamBuffer_t;
+
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t size, size_t trigger, uint8_t *storage,
+                                               StaticStreamBuffer_t *buffer);
+
+// Waits up to `timeout` for room for all of `data`, then sends what fits
+size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void *data, size_t len, TickType_t timeout);
+
+// Waits up to `timeout` for the trigger level (or `len`, if less), then
+// receives what is there
+size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void *data, size_t len, TickType_t timeout);
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer);
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer);
+BaseType_t xStreamBufferReset(StreamBufferHandle_t buffer);
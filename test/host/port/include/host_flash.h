@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// NOR flash behind esp_partition_*: erases set bytes to 0xff, writes can
+// only clear bits, and writes and erases must stay inside the partition
+// (erases on sector boundaries). Power can be cut partway through a write
+// or erase, to test what survives a reset.
+
+#define HOST_FLASH_SECTOR 4096
+#define HOST_FLASH_SIZE (64 * HOST_FLASH_SECTOR)
+
+// Erase everything, restore power and make the partition (any label) exist
+// or not
+void host_flash_reset(bool present);
+
+// Cut power once `bytes` more bytes have been written or erased: the write
+// or erase in progress stops at that byte and everything after fails with
+// ESP_FAIL until host_flash_power_on
+void host_flash_cut_after(size_t bytes);
+
+// Power back on; the contents stay as the cut left them
+void host_flash_power_on(void);
+
+bool host_flash_powered(void);
+
+// Direct access to the contents, e.g. to flip bits
+uint8_t *host_flash_contents(void);
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases;            // Sectors
+    uint64_t bytes_written;
+} host_flash_stats_t;
+
+void host_flash_stats(host_flash_stats_t *stats);
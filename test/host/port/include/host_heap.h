@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap used by the code under test, for tests built with host_test(HEAP):
+// malloc, calloc, realloc and free are wrapped at link time, and the blocks
+// allocated while tracking is on are counted until freed. Memory that stands
+// in for the other end of the network (the request body as it arrives, and
+// whatever the handler of host_http allocates) is the server's, not the
+// device's, and is not counted. Nor are blocks libc allocates for itself
+// (strdup, stdio).
+
+typedef struct {
+    size_t live;                // Bytes in blocks allocated since tracking began, not yet freed
+    size_t peak;
+    uint32_t allocations;
+} host_heap_stats_t;
+
+// Start counting from nothing, or stop counting new blocks
+void host_heap_track(bool on);
+
+void host_heap_stats(host_heap_stats_t *stats);
+
+// Blocks the calling thread allocates in between are not counted; nests
+void host_heap_untracked_begin(void);
+void host_heap_untracked_end(void);
+bool host_heap_untracked(void);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_http_client.h"
+
+// Stand-in HTTP server behind esp_http_client_*. A test installs a handler
+// that sees each request (method, URL, headers, de-chunked body) and fills
+// in the response. The connection in between can be slowed down, broken
+// partway through a request or response, closed after every response, or
+// refused. One connection per client handle; it stays open across requests
+// until either side closes it, as with keep-alive.
+
+#define HOST_HTTP_MAX_HEADERS 16
+
+typedef struct {
+    const char *key;
+    const char *value;
+} host_http_header_t;
+
+typedef struct {
+    esp_http_client_method_t method;
+    const char *url;
+    host_http_header_t headers[HOST_HTTP_MAX_HEADERS];
+    size_t header_count;
+    const uint8_t *body;
+    size_t body_len;
+    bool complete;              // False if the connection broke while the body was being sent
+} host_http_request_t;
+
+typedef struct {
+    int status;
+    host_http_header_t headers[HOST_HTTP_MAX_HEADERS];   // Copied after the handler returns
+    size_t header_count;
+    const uint8_t *body;        // Copied after the handler returns
+    size_t body_len;
+} host_http_response_t;
+
+// Called once per request, one call at a time. An incomplete request gets
+// no response; the handler only sees what arrived.
+typedef void (*host_http_handler_t)(void *ctx, const host_http_request_t *request, host_http_response_t *response);
+
+typedef struct {
+    uint32_t latency_ms;            // Before each response's headers
+    uint32_t bytes_per_second;      // Response bodies; 0 for no limit
+    uint32_t drop_request_after;    // Break a connection after this many body bytes of a request, while drops last
+    uint32_t drop_response_after;   // Same, for the body of a response
+    uint32_t drops;                 // Breaks left to make
+    bool close_connections;         // Close after every response, and say so with "Connection: close"
+    bool close_silently;            // Close after every response without saying so
+    bool offline;                   // Connecting fails
+} host_http_config_t;
+
+typedef struct {
+    uint32_t connections;       // Accepted
+    uint32_t requests;          // Started, complete or not
+    uint32_t drops;             // Connections broken by drop_*_after
+} host_http_stats_t;
+
+// Install the handler and configuration and clear the stats
+void host_http_serve(host_http_handler_t handler, void *ctx, const host_http_config_t *config);
+
+// Change the configuration while clients are running
+void host_http_configure(const host_http_config_t *config);
+
+void host_http_stats(host_http_stats_t *stats);
+
+// For handlers: a request header, NULL if absent (case-insensitive key)
+const char *host_http_request_header(const host_http_request_t *request, const char *key);
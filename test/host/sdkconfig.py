@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""Resolve main/Kconfig.projbuild into an sdkconfig.h for host builds.
+
+Handles the subset of Kconfig the project uses: menus, choices, bool/int/
+string symbols with or without a prompt, "default X [if expr]", "depends
+on", "range" and help text. Settings come from sdkconfig fragments (later
+ones win) and NAME=value arguments. Symbols the Kconfig does not declare,
+such as ESP-IDF's own, only feed conditions ("depends on SPIRAM") and are
+not written out; one that is set nowhere is n, as in Kconfig.
+
+    sdkconfig.py Kconfig.projbuild out/sdkconfig.h [fragment | CONFIG_X=v]...
+"""
+
+import re
+import sys
+
+
+class Symbol:
+    def __init__(self, name, kind=None):
+        self.name = name
+        self.kind = kind
+        self.prompt = False
+        self.defaults = []      # (value, condition or None)
+        self.depends = []
+        self.range = None
+        self.choice = None
+
+
+class Choice:
+    def __init__(self, name):
+        self.name = name
+        self.defaults = []
+        self.members = []
+
+
+def tokenize(expr):
+    return re.findall(r'&&|\|\||!=|[!()=]|"[^"]*"|[A-Za-z0-9_]+', expr)
+
+
+def evaluate(expr, values):
+    tokens = tokenize(expr)
+    pos = 0
+
+    def value(token):
+        if token.startswith('"'):
+            return token[1:-1]
+        if token in values:
+            return values[token]
+        return token if token in ("y", "n") or token.isdigit() else "n"
+
+    def primary():
+        nonlocal pos
+        token = tokens[pos]
+        pos += 1
+        if token == "!":
+            return "n" if primary() == "y" else "y"
+        if token == "(":
+            result = disjunction()
+            pos += 1
+            return result
+        left = value(token)
+        if pos < len(tokens) and tokens[pos] in ("=", "!="):
+            op = tokens[pos]
+            right = value(tokens[pos + 1])
+            pos += 2
+            return "y" if (left == right) == (op == "=") else "n"
+        return left
+
+    def conjunction():
+        nonlocal pos
+        result = primary()
+        while pos < len(tokens) and tokens[pos] == "&&":
+            pos += 1
+            right = primary()
+            result = "y" if result == "y" and right == "y" else "n"
+        return result
+
+    def disjunction():
+        nonlocal pos
+        result = conjunction()
+        while pos < len(tokens) and tokens[pos] == "||":
+            pos += 1
+            right = conjunction()
+            result = "y" if result == "y" or right == "y" else "n"
+        return result
+
+    return disjunction()
+
+
+def parse_kconfig(path):
+    entries = []
+    current = None
+    choice = None
+    in_help = False
+    help_indent = 0
+
+    for raw in open(path, encoding="utf-8"):
+        line = raw.rstrip("\n")
+        stripped = line.strip()
+        indent = len(line) - len(line.lstrip())
+        if in_help:
+            if not stripped or indent > help_indent:
+                continue
+            in_help = False
+        if not stripped or stripped.startswith("#"):
+            continue
+
+        keyword, _, rest = stripped.partition(" ")
+        rest = rest.strip()
+        if keyword in ("menu", "endmenu", "comment"):
+            current = None
+        elif keyword == "choice":
+            choice = Choice(rest)
+            current = choice
+            entries.append(choice)
+        elif keyword == "endchoice":
+            choice = None
+            current = None
+        elif keyword in ("config", "menuconfig"):
+            current = Symbol(rest)
+            if choice is not None:
+                current.choice = choice
+                choice.members.append(current)
+            else:
+                entries.append(current)
+        elif keyword == "help":
+            in_help = True
+            help_indent = indent
+        elif current is None:
+            raise SystemExit(f"{path}: unexpected '{stripped}'")
+        elif keyword in ("bool", "int", "string", "hex"):
+            current.kind = keyword
+            current.prompt = bool(rest)
+        elif keyword == "prompt":
+            current.prompt = True
+        elif keyword == "default":
+            value, _, condition = rest.partition(" if ")
+            current.defaults.append((value.strip(), condition.strip() or None))
+        elif keyword == "depends":
+            current.depends.append(rest.removeprefix("on").strip())
+        elif keyword == "range":
+            low, high = rest.split()[:2]
+            current.range = (low, high)
+        else:
+            raise SystemExit(f"{path}: unsupported '{keyword}'")
+    return entries
+
+
+def read_settings(args):
+    settings = {}
+    for arg in args:
+        lines = [arg] if arg.startswith("CONFIG_") else open(arg, encoding="utf-8").read().splitlines()
+        for line in lines:
+            line = line.strip()
+            unset = re.match(r"# (CONFIG_\w+) is not set", line)
+            if unset:
+                settings[unset.group(1)[7:]] = "n"
+            elif line.startswith("CONFIG_"):
+                name, _, value = line.partition("=")
+                settings[name[7:]] = value
+    return settings
+
+
+def resolve(entries, settings):
+    declared = set()
+    for entry in entries:
+        declared.add(entry.name)
+        declared.update(m.name for m in getattr(entry, "members", []))
+    external = {name: value for name, value in settings.items() if name not in declared}
+    values = dict(external)
+
+    def visible(symbol):
+        return all(evaluate(d, values) == "y" for d in symbol.depends)
+
+    def first_default(defaults):
+        for value, condition in defaults:
+            if condition is None or evaluate(condition, values) == "y":
+                return value
+        return None
+
+    for entry in entries:
+        if isinstance(entry, Choice):
+            members = [m for m in entry.members if visible(m)]
+            chosen = next((m.name for m in members if settings.get(m.name) == "y"), None)
+            if chosen is None:
+                default = first_default(entry.defaults)
+                chosen = default if default in [m.name for m in members] else members[0].name
+            for member in entry.members:
+                values[member.name] = "y" if member.name == chosen else "n"
+            continue
+
+        if not visible(entry):
+            values[entry.name] = "n" if entry.kind == "bool" else ""
+            continue
+        value = settings.get(entry.name) if entry.prompt else None
+        if value is None:
+            value = first_default(entry.defaults)
+            value = value if value is not None else ("n" if entry.kind == "bool" else "")
+            if entry.kind != "bool" and value in values:
+                value = values[value]
+        if entry.kind == "string" and not value.startswith('"'):
+            value = f'"{value}"'
+        if entry.kind == "int" and entry.range is not None:
+            low, high = (int(values.get(r, r)) for r in entry.range)
+            if not low <= int(value) <= high:
+                raise SystemExit(f"CONFIG_{entry.name}={value} is outside {low}..{high}")
+        values[entry.name] = value
+    return {name: value for name, value in values.items() if name not in external}
+
+
+def main():
+    if len(sys.argv) < 3:
+        raise SystemExit(__doc__)
+    entries = parse_kconfig(sys.argv[1])
+    values = resolve(entries, read_settings(sys.argv[3:]))
+
+    lines = ["// Generated by test/host/sdkconfig.py; do not edit", "#pragma once", ""]
+    for name, value in values.items():
+        if value == "n" or value == "":
+            continue
+        lines.append(f"#define CONFIG_{name} {1 if value == 'y' else value}")
+    lines.append("#define CONFIG_IDF_TARGET_LINUX 1")
+    lines.append("#define CONFIG_IDF_TARGET \"linux\"")
+
+    text = "\n".join(lines) + "\n"
+    try:
+        if open(sys.argv[2], encoding="utf-8").read() == text:
+            return
+    except OSError:
+        pass
+    with open(sys.argv[2], "w", encoding="utf-8") as out:
+        out.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+// Minimal checks for the host tests: a failed CHECK is reported and counted
+// and the test carries on; REQUIRE also returns from the test function.
+// main() runs each test with RUN_TEST and returns TEST_EXIT_CODE().
+
+static int s_test_failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            s_test_failures++;                                              \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                    \
+    do {                                                                                              \
+        long long actual_ = (long long)(actual);                                                      \
+        long long expected_ = (long long)(expected);                                                  \
+        if (actual_ != expected_) {                                                                   \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actual_, expected_); \
+            s_test_failures++;                                                                        \
+        }                                                                                             \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                                        \
+    do {                                                                                               \
+        double actual_ = (double)(actual);                                                             \
+        double expected_ = (double)(expected);                                                         \
+        if (!(actual_ >= expected_ - (tolerance) && actual_ <= expected_ + (tolerance))) {             \
+            printf("%s:%d: %s is %g, expected %g +- %g\n", __FILE__, __LINE__, #actual, actual_, expected_, \
+                   (double)(tolerance));                                                               \
+            s_test_failures++;                                                                         \
+        }                                                                                              \
+    } while (0)
+
+#define REQUIRE(cond)                                                         \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            printf("%s:%d: REQUIRE(%s) failed\n", __FILE__, __LINE__, #cond); \
+            s_test_failures++;                                                \
+            return;                                                           \
+        }                                                                     \
+    } while (0)
+
+#define RUN_TEST(fn)                                                              \
+    do {                                                                          \
+        int failures_ = s_test_failures;                                          \
+        printf("-- %s\n", #fn);                                                   \
+        fn();                                                                     \
+        printf("-- %s %s\n", #fn, s_test_failures == failures_ ? "ok" : "FAILED"); \
+    } while (0)
+
+#define TEST_EXIT_CODE() (printf("%d failure(s)\n", s_test_failures), s_test_failures == 0 ? 0 : 1)
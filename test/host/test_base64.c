@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include "audio_base64.h"
+#include "test.h"
+
+// The streaming encoder against a plain reference, on whichever group path
+// this binary's firmware was built with (BASE64_PATH: the SSSE3 shuffle
+// with the pair table for the tail, or the pair table alone)
+
+#define MAX_LEN 1024
+
+// RFC 4648 one character at a time
+static size_t reference_encode(const uint8_t *in, size_t len, char *out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)in[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= in[i + 2];
+        }
+        out[n++] = alphabet[v >> 18];
+        out[n++] = alphabet[(v >> 12) & 0x3F];
+        out[n++] = i + 1 < len ? alphabet[(v >> 6) & 0x3F] : '=';
+        out[n++] = i + 2 < len ? alphabet[v & 0x3F] : '=';
+    }
+    return n;
+}
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Encodes in pieces of the given sizes (cycled) and finishes
+static size_t encode_in_pieces(const uint8_t *in, size_t len, const size_t *pieces, size_t piece_count, char *out) {
+    audio_base64_t b64;
+    size_t n = 0;
+    audio_base64_init(&b64);
+    for (size_t i = 0, p = 0; i < len; p = (p + 1) % piece_count) {
+        size_t piece = pieces[p] < len - i ? pieces[p] : len - i;
+        n += audio_base64_update(&b64, in + i, piece, out + n);
+        i += piece;
+    }
+    return n + audio_base64_finish(&b64, out + n);
+}
+
+// Every length up to MAX_LEN (so every length mod 3, and every count of
+// groups left over after the 4-group vector loop) from every offset mod 16
+static void test_one_shot(void) {
+    static uint8_t in[MAX_LEN + 16];
+    static char expected[MAX_LEN / 3 * 4 + 8];
+    static char got[MAX_LEN / 3 * 4 + 8];
+    uint32_t random = 5;
+    size_t whole = MAX_LEN + 16;
+    size_t bad = 0;
+
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = (uint8_t)next_random(&random);
+    }
+    for (size_t offset = 0; offset < 16; ++offset) {
+        for (size_t len = 0; len <= MAX_LEN; ++len) {
+            size_t n = reference_encode(in + offset, len, expected);
+            memset(got, '?', sizeof(got));
+            size_t m = encode_in_pieces(in + offset, len, &whole, 1, got);
+            if (m != n || memcmp(got, expected, n) != 0 || got[n] != '?') {
+                if (bad++ < 5) {
+                    printf("offset %zu length %zu: %.*s\n", offset, len, (int)m, got);
+                }
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+// Every byte value in every position of a group
+static void test_all_bytes(void) {
+    uint8_t in[3 * 256];
+    char expected[4 * 256];
+    char got[4 * 256];
+    size_t whole = sizeof(in);
+
+    for (size_t position = 0; position < 3; ++position) {
+        memset(in, 0xA5, sizeof(in));
+        for (size_t v = 0; v < 256; ++v) {
+            in[v * 3 + position] = (uint8_t)v;
+        }
+        reference_encode(in, sizeof(in), expected);
+        CHECK_EQ(encode_in_pieces(in, sizeof(in), &whole, 1, got), sizeof(got));
+        CHECK(memcmp(got, expected, sizeof(got)) == 0);
+    }
+}
+
+// Output does not depend on how the input was split, including splits that
+// leave one or two bytes carried
+static void test_pieces(void) {
+    static uint8_t in[MAX_LEN];
+    static char expected[MAX_LEN / 3 * 4 + 8];
+    static char got[MAX_LEN / 3 * 4 + 8];
+    uint32_t random = 9;
+    size_t bad = 0;
+
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = (uint8_t)next_random(&random);
+    }
+    for (int trial = 0; trial < 2000; ++trial) {
+        size_t len = next_random(&random) % (MAX_LEN + 1);
+        size_t pieces[5];
+        for (size_t p = 0; p < 5; ++p) {
+            pieces[p] = 1 + next_random(&random) % (p < 3 ? 4 : 100);
+        }
+        size_t n = reference_encode(in, len, expected);
+        size_t m = encode_in_pieces(in, len, pieces, 5, got);
+        bad += m != n || memcmp(got, expected, n) != 0;
+    }
+    CHECK_EQ(bad, 0);
+}
+
+// Finish pads the one or two carried bytes and resets the carry
+static void test_finish_padding(void) {
+    const uint8_t in[] = {0xFF, 0xEF, 0x01};
+    audio_base64_t b64;
+    char out[8];
+
+    audio_base64_init(&b64);
+    CHECK_EQ(audio_base64_finish(&b64, out), 0);
+
+    CHECK_EQ(audio_base64_update(&b64, in, 1, out), 0);
+    CHECK_EQ(audio_base64_finish(&b64, out), 4);
+    CHECK(memcmp(out, "/w==", 4) == 0);
+    CHECK_EQ(audio_base64_finish(&b64, out), 0);
+
+    CHECK_EQ(audio_base64_update(&b64, in, 2, out), 0);
+    CHECK_EQ(audio_base64_finish(&b64, out), 4);
+    CHECK(memcmp(out, "/+8=", 4) == 0);
+
+    CHECK_EQ(audio_base64_update(&b64, in, 3, out), 4);
+    CHECK(memcmp(out, "/+8B", 4) == 0);
+    CHECK_EQ(audio_base64_finish(&b64, out), 0);
+}
+
+int main(void) {
+    printf("group path: %s\n", BASE64_PATH);
+    RUN_TEST(test_one_shot);
+    RUN_TEST(test_all_bytes);
+    RUN_TEST(test_pieces);
+    RUN_TEST(test_finish_padding);
+    return TEST_EXIT_CODE();
+}
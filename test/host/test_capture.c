@@ -0,0 +1,213 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "audio_hal.h"
+#include "audio_wav.h"
+#include "audio_capture.h"
+#include "audio_metrics.h"
+#include "test.h"
+
+// Capture against the simulation HAL at real-time speed. The input WAV is a
+// ramp that the ADC reads as 0, 1, ... 4095, 0, ..., so every reading says
+// where in the input it came from: gaps are dropped frames.
+
+#define RATE 8000
+#define FRAME 128
+#define DEPTH 4
+#define FRAME_US (FRAME * 1000000LL / RATE)
+#define RAMP_SAMPLES (RATE * 30)
+#define TIMING_SLACK_US 8000    // Host scheduling, plus the 1 ms tick the simulation runs on
+#define RESYNC UINT32_MAX       // read_frame: take the ramp from wherever the frame starts
+
+static int16_t s_frame[FRAME];
+static uint32_t s_next;         // Ramp reading expected next
+static uint64_t s_delivered;    // Samples read since the last start
+
+static void write_ramp(const char *path) {
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+    size_t header_len = audio_wav_header(header, AUDIO_CODEC_PCM16, RATE, 1, RAMP_SAMPLES * sizeof(int16_t));
+    FILE *out = fopen(path, "wb");
+    fwrite(header, 1, header_len, out);
+    for (uint32_t i = 0; i < RAMP_SAMPLES; ++i) {
+        int16_t pcm = (int16_t)(((int)(i % 4096) - 2048) * 16);   // ADC reading (pcm >> 4) + 2048
+        fwrite(&pcm, sizeof(pcm), 1, out);
+    }
+    fclose(out);
+}
+
+// Read one frame and check it continues the ramp from s_next + skip
+static bool read_frame(uint32_t skip) {
+    if (audio_capture_read(s_frame, pdMS_TO_TICKS(1000)) != FRAME) {
+        return false;
+    }
+    s_next = skip == RESYNC ? (uint32_t)s_frame[0] : (s_next + skip) % 4096;
+    for (size_t i = 0; i < FRAME; ++i) {
+        if (s_frame[i] != (int16_t)s_next) {
+            printf("sample %zu of frame is %d, expected %u\n", i, s_frame[i], (unsigned)s_next);
+            return false;
+        }
+        s_next = (s_next + 1) % 4096;
+    }
+    s_delivered += FRAME;
+    return true;
+}
+
+// What samples_until reports now, against what has been read: at most the
+// frame being filled and the ones queued, never less than what was read
+static void check_samples_until(size_t queued) {
+    int64_t lag = (int64_t)audio_capture_samples_until(audio_hal_time_us()) - (int64_t)s_delivered;
+    int64_t slack = TIMING_SLACK_US * RATE / 1000000;
+    CHECK(lag >= -slack);
+    CHECK(lag < (int64_t)(queued + 1) * FRAME + slack);
+}
+
+// Frames arrive one frame period apart from the start, without drift. The
+// host may wake the reader late for any one frame, so drift is judged by the
+// earliest frame of each ten; no frame comes early or a whole frame late.
+static void test_frame_pacing(void) {
+    REQUIRE(audio_capture_start() == ESP_OK);
+    int64_t start = audio_hal_time_us();
+    s_delivered = 0;
+
+    int64_t worst = 0;
+    int64_t earliest = INT64_MAX;
+    for (int k = 1; k <= 60; ++k) {
+        REQUIRE(read_frame(0));
+        int64_t late = audio_hal_time_us() - start - k * FRAME_US;
+        CHECK(late > -TIMING_SLACK_US);
+        CHECK(late < FRAME_US);
+        earliest = late < earliest ? late : earliest;
+        if (k % 10 == 0) {
+            worst = llabs(earliest) > worst ? llabs(earliest) : worst;
+            earliest = INT64_MAX;
+        }
+        check_samples_until(0);
+    }
+    printf("worst drift %lld us\n", (long long)worst);
+    CHECK(worst < TIMING_SLACK_US);
+    CHECK_EQ(audio_capture_overruns(), 0);
+    REQUIRE(audio_capture_stop() == ESP_OK);
+}
+
+// A reader that stalls loses the frames after the queue fills, not the
+// ones queued; samples_until leaves the dropped samples out
+static void test_overruns(void) {
+    REQUIRE(audio_capture_start() == ESP_OK);
+    s_delivered = 0;
+    REQUIRE(read_frame(RESYNC)); // Stop dropped whatever was queued or half filled
+    uint32_t before = audio_capture_overruns();
+
+    vTaskDelay(pdMS_TO_TICKS(12 * FRAME_US / 1000 + FRAME_US / 2000));
+    uint32_t overruns = audio_capture_overruns() - before;
+    CHECK(overruns >= 12 - DEPTH - 1);
+    CHECK(overruns <= 12 - DEPTH + 1);
+    check_samples_until(DEPTH);
+
+    // The queued frames follow on from the last one read...
+    for (int k = 0; k < DEPTH; ++k) {
+        REQUIRE(read_frame(0));
+    }
+    // ...and the next one is the frame that was being filled when the
+    // stall ended; everything in between was dropped
+    overruns = audio_capture_overruns() - before;
+    REQUIRE(read_frame(overruns * FRAME));
+    CHECK_EQ(audio_capture_dropped_samples() - before * FRAME, overruns * FRAME);
+    check_samples_until(0);
+
+    // Keeping up again: no more drops, and samples_until stays in step
+    for (int k = 0; k < 10; ++k) {
+        REQUIRE(read_frame(0));
+        check_samples_until(0);
+    }
+    CHECK_EQ(audio_capture_overruns() - before, overruns);
+    REQUIRE(audio_capture_stop() == ESP_OK);
+}
+
+// Overruns from an earlier recording do not count against the next one
+static void test_restart_resets_accounting(void) {
+    CHECK(audio_capture_overruns() > 0);
+    REQUIRE(audio_capture_start() == ESP_OK);
+    s_delivered = 0;
+    REQUIRE(read_frame(RESYNC));
+    for (int k = 0; k < 5; ++k) {
+        REQUIRE(read_frame(0));
+        check_samples_until(0);
+    }
+    CHECK_EQ(audio_capture_samples_until(audio_hal_time_us() - 10 * FRAME_US), 0);
+    REQUIRE(audio_capture_stop() == ESP_OK);
+}
+
+// Count and max of the sample jitter histogram, from the metrics JSON
+static void jitter_histogram(unsigned long *count, unsigned long *max) {
+    static char json[4096];
+    const char *h = NULL;
+
+    if (audio_metrics_json(json, sizeof(json)) > 0) {
+        h = strstr(json, "\"sample_jitter_us\":");
+    }
+    if (h == NULL || sscanf(h, "\"sample_jitter_us\":{\"n\":%lu,\"max\":%lu", count, max) != 2) {
+        *count = *max = ULONG_MAX;
+    }
+}
+
+// Jitter is taken once per frame read, not per ISR call, and frames dropped
+// in a stall count as elapsed periods rather than as one long late frame
+static void test_jitter_per_frame(void) {
+    unsigned long count;
+    unsigned long max;
+    jitter_histogram(&count, &max);
+    REQUIRE(count != ULONG_MAX);
+
+    REQUIRE(audio_capture_start() == ESP_OK);
+    REQUIRE(read_frame(RESYNC));
+    for (int k = 0; k < 9; ++k) {
+        REQUIRE(read_frame(0));
+    }
+    uint32_t before = audio_capture_overruns();
+    vTaskDelay(pdMS_TO_TICKS(12 * FRAME_US / 1000));
+    for (int k = 0; k < DEPTH; ++k) {
+        REQUIRE(read_frame(0));
+    }
+    REQUIRE(read_frame((audio_capture_overruns() - before) * FRAME));
+    for (int k = 0; k < 5; ++k) {
+        REQUIRE(read_frame(0));
+    }
+    REQUIRE(audio_capture_stop() == ESP_OK);
+    CHECK(audio_capture_overruns() > before);
+
+    unsigned long after;
+    jitter_histogram(&after, &max);
+    printf("jitter: %lu frames, max %lu us\n", after - count, max);
+    CHECK_EQ(after - count, 10 + DEPTH + 1 + 5 - 1);
+    CHECK(max < FRAME_US);   // A stall counted as one late frame would be several periods
+}
+
+int main(void) {
+    char path[] = "/tmp/test_capture_XXXXXX.wav";
+    close(mkstemps(path, 4));
+    write_ramp(path);
+    setenv("AUDIO_SIM_WAV_IN", path, 1);
+    setenv("AUDIO_SIM_SPEED", "1", 1);
+
+    audio_capture_config_t config = {
+        .sample_rate = RATE,
+        .frame_samples = FRAME,
+        .queue_depth = DEPTH,
+        .channels = 1,
+        .oversample = 1,
+    };
+    if (audio_capture_init(&config) != ESP_OK) {
+        return 1;
+    }
+
+    RUN_TEST(test_frame_pacing);
+    RUN_TEST(test_overruns);
+    RUN_TEST(test_restart_resets_accounting);
+    RUN_TEST(test_jitter_per_frame);
+    remove(path);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,234 @@
+#include <string.h>
+#include "host_flash.h"
+#include "audio_upload.h"
+#include "clip_log.h"
+#include "test.h"
+
+// The clip log on the emulated NOR flash, with the power cut at every point
+// of an append or a pop and the log remounted after, as after a reset
+
+#define CLIP_A_SAMPLES 1000     // One frame
+#define CLIP_B_SAMPLES 7000     // Three frames, the last one partly filled
+#define CLIP_C_SAMPLES 3000
+#define MAX_SAMPLES 7000
+
+static int16_t s_samples[MAX_SAMPLES];
+
+// 12-bit readings that differ per clip, so a frame of the wrong clip shows
+static void fill(uint32_t clip) {
+    for (size_t i = 0; i < MAX_SAMPLES; ++i) {
+        s_samples[i] = (int16_t)((i * 7 + clip * 1111) & 0xFFF);
+    }
+}
+
+static esp_err_t append(uint32_t clip, size_t samples, uint64_t sequence) {
+    audio_upload_range_t range = {.first = sequence, .count = samples};
+    audio_upload_source_t source = {
+        .read = audio_upload_read_buffer,
+        .ctx = s_samples,
+        .samples = samples,
+        .ranges = &range,
+        .range_count = 1,
+    };
+    fill(clip);
+    return clip_log_append(&source);
+}
+
+// The oldest clip is `clip` with all its samples
+static bool oldest_is(uint32_t clip, size_t samples, uint64_t sequence) {
+    static int16_t out[MAX_SAMPLES];
+    clip_log_entry_t entry;
+
+    if (!clip_log_peek(&entry)) {
+        printf("log is empty, expected clip %lu\n", (unsigned long)clip);
+        return false;
+    }
+    if (entry.samples != samples || entry.sequence != sequence) {
+        printf("oldest clip has %lu samples from %llu, expected %zu from %llu\n", (unsigned long)entry.samples,
+               (unsigned long long)entry.sequence, samples, (unsigned long long)sequence);
+        return false;
+    }
+    fill(clip);
+    if (clip_log_read(&entry, 0, out, samples) != samples || memcmp(out, s_samples, samples * 2) != 0) {
+        printf("clip %lu does not read back\n", (unsigned long)clip);
+        return false;
+    }
+    return true;
+}
+
+// Reset with the flash as it is
+static void remount(void) {
+    host_flash_power_on();
+    CHECK_EQ(clip_log_init(CLIP_LOG_PARTITION_LABEL), ESP_OK);
+}
+
+static uint64_t flash_bytes_spent(void) {
+    host_flash_stats_t stats;
+    host_flash_stats(&stats);
+    return stats.bytes_written + (uint64_t)stats.erases * HOST_FLASH_SECTOR;
+}
+
+static void test_remount_keeps_clips(void) {
+    host_flash_reset(true);
+    REQUIRE(clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK);
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+    CHECK_EQ(append(1, CLIP_A_SAMPLES, 100), ESP_OK);
+    CHECK_EQ(append(2, CLIP_B_SAMPLES, 5000), ESP_OK);
+
+    remount();
+    CHECK(oldest_is(1, CLIP_A_SAMPLES, 100));
+    CHECK_EQ(clip_log_pop(), ESP_OK);
+    remount();
+    CHECK(oldest_is(2, CLIP_B_SAMPLES, 5000));
+    CHECK_EQ(clip_log_pop(), ESP_OK);
+    remount();
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+}
+
+// Power cut after every few bytes of appending clip B behind clip A. Clip A
+// always survives. Clip B is lost while its last frame is incomplete and
+// survives from the point where the last frame's data has landed, whether
+// or not the checkpoint after it was written: mounting rolls forward over
+// whole clips. (The tail of the last frame is blank, so it is complete a
+// little before its write ends.) Either way the log takes new clips after.
+static void test_power_cut_during_append(void) {
+    host_flash_reset(true);
+    REQUIRE(clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK);
+    REQUIRE(append(1, CLIP_A_SAMPLES, 100) == ESP_OK);
+    uint64_t before = flash_bytes_spent();
+    REQUIRE(append(2, CLIP_B_SAMPLES, 5000) == ESP_OK);
+    uint64_t total = flash_bytes_spent() - before;
+    uint64_t checkpoint = sizeof(uint32_t) * 8;     // The index record written last
+    uint64_t last_frame = total - checkpoint - HOST_FLASH_SECTOR;   // Where its write starts
+    uint64_t first_kept = UINT64_MAX;
+    uint32_t cuts = 0;
+
+    for (uint64_t cut = 0; cut <= total; ++cuts) {
+        host_flash_reset(true);
+        REQUIRE(clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK);
+        REQUIRE(append(1, CLIP_A_SAMPLES, 100) == ESP_OK);
+        host_flash_cut_after(cut);
+        esp_err_t err = append(2, CLIP_B_SAMPLES, 5000);
+        CHECK_EQ(err == ESP_OK, cut >= total);
+        CHECK_EQ(host_flash_powered(), cut >= total);
+
+        remount();
+        if (!oldest_is(1, CLIP_A_SAMPLES, 100)) {
+            printf("after a cut at byte %llu of %llu\n", (unsigned long long)cut, (unsigned long long)total);
+            CHECK(false);
+            break;
+        }
+        CHECK_EQ(clip_log_pop(), ESP_OK);
+        bool kept = clip_log_peek(&(clip_log_entry_t){0});
+        if (kept && first_kept == UINT64_MAX) {
+            first_kept = cut;
+        }
+        if (kept != (first_kept != UINT64_MAX)) {
+            printf("cut at byte %llu: clip B lost after surviving a cut at %llu\n", (unsigned long long)cut,
+                   (unsigned long long)first_kept);
+            CHECK(false);
+        }
+        if (kept) {
+            CHECK(oldest_is(2, CLIP_B_SAMPLES, 5000));
+        }
+
+        // The log carries on over whatever the cut left
+        CHECK_EQ(append(3, CLIP_C_SAMPLES, 20000), ESP_OK);
+        remount();
+        if (kept) {
+            CHECK(oldest_is(2, CLIP_B_SAMPLES, 5000));
+            CHECK_EQ(clip_log_pop(), ESP_OK);
+        }
+        CHECK(oldest_is(3, CLIP_C_SAMPLES, 20000));
+
+        // Every byte around sector boundaries and the end, a sample elsewhere
+        bool edge = cut % HOST_FLASH_SECTOR < 8 || cut % HOST_FLASH_SECTOR > HOST_FLASH_SECTOR - 8 ||
+                    cut + 2 * checkpoint > total || cut + 1 >= first_kept;
+        uint64_t step = edge ? 1 : 97;
+        if (first_kept == UINT64_MAX && cut + step > last_frame + HOST_FLASH_SECTOR / 2 && step > 1) {
+            step = 7; // Close in on where the last frame becomes complete
+        }
+        cut += step;
+    }
+    printf("%lu cuts over %llu bytes, clip B kept from byte %llu\n", (unsigned long)cuts,
+           (unsigned long long)total, (unsigned long long)first_kept);
+    CHECK(first_kept > last_frame);
+    CHECK(first_kept <= total - checkpoint);
+}
+
+// Power cut while a pop's checkpoint is written: the clip is either still
+// there or gone, and the next one reads back either way
+static void test_power_cut_during_pop(void) {
+    for (size_t cut = 0; cut <= 32; ++cut) {
+        host_flash_reset(true);
+        REQUIRE(clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK);
+        REQUIRE(append(1, CLIP_A_SAMPLES, 100) == ESP_OK);
+        REQUIRE(append(2, CLIP_B_SAMPLES, 5000) == ESP_OK);
+        host_flash_cut_after(cut);
+        clip_log_pop();
+        remount();
+        if (cut < 32) {
+            CHECK(oldest_is(1, CLIP_A_SAMPLES, 100));
+            CHECK_EQ(clip_log_pop(), ESP_OK);
+        }
+        CHECK(oldest_is(2, CLIP_B_SAMPLES, 5000));
+    }
+}
+
+// Many appends and pops: the data ring laps several times and the index
+// moves between its sectors, with a remount now and then and a cut partway
+// through the first frame of some appends. The log stays in step with a
+// plain FIFO of the clips that made it.
+static void test_laps(void) {
+    uint32_t fifo[64];
+    size_t head = 0;
+    size_t tail = 0;
+
+    host_flash_reset(true);
+    REQUIRE(clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK);
+    for (uint32_t clip = 1; clip <= 400; ++clip) {
+        uint64_t sequence = (uint64_t)clip * 10000;
+        if (clip % 37 == 0) {
+            host_flash_cut_after(5000 + clip);  // First frame: erased, half written
+            CHECK(append(clip, CLIP_B_SAMPLES, sequence) != ESP_OK);
+            remount();
+        } else {
+            esp_err_t err = append(clip, CLIP_B_SAMPLES, sequence);
+            if (err == ESP_ERR_NO_MEM) {
+                REQUIRE(head != tail);
+                CHECK(oldest_is(fifo[tail % 64], CLIP_B_SAMPLES, (uint64_t)fifo[tail % 64] * 10000));
+                CHECK_EQ(clip_log_pop(), ESP_OK);
+                tail++;
+                err = append(clip, CLIP_B_SAMPLES, sequence);
+            }
+            REQUIRE(err == ESP_OK);
+            fifo[head++ % 64] = clip;
+        }
+        if (clip % 3 == 0 && head != tail) {
+            CHECK(oldest_is(fifo[tail % 64], CLIP_B_SAMPLES, (uint64_t)fifo[tail % 64] * 10000));
+            CHECK_EQ(clip_log_pop(), ESP_OK);
+            tail++;
+        }
+        if (clip % 50 == 0) {
+            remount();
+        }
+    }
+    for (; head != tail; ++tail) {
+        CHECK(oldest_is(fifo[tail % 64], CLIP_B_SAMPLES, (uint64_t)fifo[tail % 64] * 10000));
+        CHECK_EQ(clip_log_pop(), ESP_OK);
+    }
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+
+    host_flash_stats_t stats;
+    host_flash_stats(&stats);
+    printf("%lu sector erases over %d data sectors\n", (unsigned long)stats.erases,
+           HOST_FLASH_SIZE / HOST_FLASH_SECTOR - 2);
+}
+
+int main(void) {
+    RUN_TEST(test_remount_keeps_clips);
+    RUN_TEST(test_power_cut_during_append);
+    RUN_TEST(test_power_cut_during_pop);
+    RUN_TEST(test_laps);
+    return TEST_EXIT_CODE();
+}
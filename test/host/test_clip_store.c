@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <string.h>
+#include "audio_clip_store.h"
+#include "test.h"
+
+// The slab store: clips cut into the holes other clips left, eviction of
+// the oldest clips (by arena and by clip slot), and a long random churn
+// checked against what each live clip should read back
+
+#define ARENA_SLABS 8
+#define SLAB AUDIO_CLIP_STORE_SLAB_SAMPLES
+#define MAX_SAMPLES (ARENA_SLABS * SLAB)
+#define TABLE_BYTES (AUDIO_CLIP_STORE_MAX_CLIPS * sizeof(audio_clip_store_clip_t))
+
+static uint8_t s_arena[TABLE_BYTES + ARENA_SLABS * AUDIO_CLIP_STORE_SLAB_BYTES];
+static int16_t s_samples[MAX_SAMPLES];
+static int16_t s_out[MAX_SAMPLES];
+static audio_clip_store_t s_store;
+
+static void fill(uint32_t id, size_t samples) {
+    for (size_t i = 0; i < samples; ++i) {
+        s_samples[i] = (int16_t)((i * 13 + id * 977) & 0xFFF);
+    }
+}
+
+// Allocate a clip of `samples` and write its pattern in uneven pieces
+static uint32_t store(size_t samples) {
+    audio_upload_range_t range = {.first = 0, .count = samples};
+    uint32_t id = 0;
+
+    if (audio_clip_store_alloc(&s_store, samples, &range, 1, &id) != ESP_OK) {
+        return 0;
+    }
+    fill(id, samples);
+    for (size_t done = 0; done < samples;) {
+        size_t n = samples - done < 1500 ? samples - done : 1500;
+        CHECK_EQ(audio_clip_store_write(&s_store, id, done, s_samples + done, n), n);
+        done += n;
+    }
+    return id;
+}
+
+// The clip is stored and reads back whole, front to back and from its end
+static bool intact(uint32_t id, size_t samples) {
+    audio_clip_store_clip_t clip;
+
+    if (!audio_clip_store_get(&s_store, id, &clip) || clip.samples != samples) {
+        printf("clip %lu is gone\n", (unsigned long)id);
+        return false;
+    }
+    fill(id, samples);
+    if (audio_clip_store_read(&s_store, id, 0, s_out, samples) != samples ||
+        memcmp(s_out, s_samples, samples * 2) != 0) {
+        printf("clip %lu does not read back\n", (unsigned long)id);
+        return false;
+    }
+    size_t tail = samples > 100 ? 100 : samples;
+    if (audio_clip_store_read(&s_store, id, samples - tail, s_out, tail) != tail ||
+        memcmp(s_out, s_samples + samples - tail, tail * 2) != 0) {
+        printf("clip %lu does not read back from its end\n", (unsigned long)id);
+        return false;
+    }
+    return true;
+}
+
+static bool gone(uint32_t id) {
+    audio_clip_store_clip_t clip;
+    return !audio_clip_store_get(&s_store, id, &clip) && audio_clip_store_read(&s_store, id, 0, s_out, 1) == 0;
+}
+
+static void reset(void) {
+    audio_clip_store_deinit(&s_store);
+    CHECK_EQ(audio_clip_store_init(&s_store, s_arena, sizeof(s_arena)), ESP_OK);
+}
+
+// Freed clips leave holes all over the arena; a clip as large as all of
+// them together still fits, with nothing evicted
+static void test_fragmented_arena(void) {
+    audio_clip_store_stats_t stats;
+
+    reset();
+    uint32_t a = store(SLAB);
+    uint32_t b = store(2 * SLAB);
+    uint32_t c = store(SLAB - 1);
+    uint32_t d = store(SLAB + 1);
+    uint32_t e = store(2 * SLAB);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.slabs_used, ARENA_SLABS);
+    CHECK_EQ(stats.slabs_total, ARENA_SLABS);
+
+    audio_clip_store_free(&s_store, b);
+    audio_clip_store_free(&s_store, d);
+    uint32_t f = store(4 * SLAB - 10);
+    REQUIRE(f != 0);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 0);
+    CHECK_EQ(stats.clips, 4);
+    CHECK_EQ(stats.slabs_used, ARENA_SLABS);
+    CHECK(intact(a, SLAB));
+    CHECK(intact(c, SLAB - 1));
+    CHECK(intact(e, 2 * SLAB));
+    CHECK(intact(f, 4 * SLAB - 10));
+    CHECK(gone(b));
+    CHECK(gone(d));
+}
+
+// A full arena makes room by evicting the oldest clips, as many as it
+// takes and no more; freeing an evicted clip changes nothing
+static void test_eviction_oldest_first(void) {
+    audio_clip_store_stats_t stats;
+
+    reset();
+    uint32_t a = store(SLAB);
+    uint32_t b = store(SLAB);
+    uint32_t c = store(2 * SLAB);
+    uint32_t d = store(4 * SLAB);
+    uint32_t e = store(3 * SLAB);
+    REQUIRE(e != 0);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 3);
+    CHECK(gone(a));
+    CHECK(gone(b));
+    CHECK(gone(c));
+    CHECK(intact(d, 4 * SLAB));
+    CHECK(intact(e, 3 * SLAB));
+
+    // A clip freed out of order is skipped, not counted, when the oldest go
+    audio_clip_store_free(&s_store, a);
+    audio_clip_store_free(&s_store, d);
+    uint32_t f = store(5 * SLAB);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 3);
+    CHECK(intact(e, 3 * SLAB));
+    CHECK(intact(f, 5 * SLAB));
+    uint32_t g = store(1);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 4);
+    CHECK(gone(e));
+    CHECK(intact(f, 5 * SLAB));
+    CHECK(intact(g, 1));
+    CHECK_EQ(stats.slabs_used, 6);
+
+    // Larger than the arena: refused, nothing evicted
+    uint32_t id;
+    audio_upload_range_t range = {.first = 0, .count = MAX_SAMPLES + 1};
+    CHECK_EQ(audio_clip_store_alloc(&s_store, MAX_SAMPLES + 1, &range, 1, &id), ESP_ERR_NO_MEM);
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 4);
+    CHECK(intact(f, 5 * SLAB));
+}
+
+// Out of clip slots with slabs to spare: the oldest clip gives up its slot
+static void test_eviction_by_slot(void) {
+    static uint8_t arena[TABLE_BYTES + (AUDIO_CLIP_STORE_MAX_CLIPS + 1) * AUDIO_CLIP_STORE_SLAB_BYTES];
+    audio_clip_store_stats_t stats;
+    uint32_t ids[AUDIO_CLIP_STORE_MAX_CLIPS + 1];
+
+    audio_clip_store_deinit(&s_store);
+    REQUIRE(audio_clip_store_init(&s_store, arena, sizeof(arena)) == ESP_OK);
+    for (size_t i = 0; i < AUDIO_CLIP_STORE_MAX_CLIPS + 1; ++i) {
+        ids[i] = store(100);
+    }
+    audio_clip_store_stats(&s_store, &stats);
+    CHECK_EQ(stats.evictions, 1);
+    CHECK_EQ(stats.clips, AUDIO_CLIP_STORE_MAX_CLIPS);
+    CHECK_EQ(stats.slabs_used, AUDIO_CLIP_STORE_MAX_CLIPS);
+    CHECK(gone(ids[0]));
+    for (size_t i = 1; i < AUDIO_CLIP_STORE_MAX_CLIPS + 1; ++i) {
+        CHECK(intact(ids[i], 100));
+    }
+}
+
+// Random sizes, frees in random order and eviction, thousands of times:
+// every clip still held reads back, the slab count adds up, and only
+// clips older than every one held can have been evicted
+static void test_churn(void) {
+    struct {
+        uint32_t id;
+        size_t samples;
+    } live[AUDIO_CLIP_STORE_MAX_CLIPS * 2];
+    size_t live_count = 0;
+    uint32_t random = 5;
+    uint32_t freed = 0;
+
+    reset();
+    for (int round = 0; round < 5000; ++round) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        if (random % 3 == 0 && live_count > 0) {
+            size_t at = (random >> 8) % live_count;
+            audio_clip_store_free(&s_store, live[at].id);
+            live[at] = live[--live_count];
+            freed++;
+            continue;
+        }
+        size_t samples = 1 + (random >> 8) % (3 * SLAB);
+        uint32_t id = store(samples);
+        REQUIRE(id != 0);
+        live[live_count].id = id;
+        live[live_count++].samples = samples;
+
+        // Drop the evicted ones; each must be older than every clip left
+        size_t slabs = 0;
+        uint32_t oldest_kept = UINT32_MAX;
+        uint32_t newest_evicted = 0;
+        for (size_t i = 0; i < live_count;) {
+            audio_clip_store_clip_t clip;
+            if (audio_clip_store_get(&s_store, live[i].id, &clip)) {
+                oldest_kept = live[i].id < oldest_kept ? live[i].id : oldest_kept;
+                slabs += (live[i].samples + SLAB - 1) / SLAB;
+                i++;
+            } else {
+                newest_evicted = live[i].id > newest_evicted ? live[i].id : newest_evicted;
+                live[i] = live[--live_count];
+            }
+        }
+        CHECK(newest_evicted < oldest_kept);
+        audio_clip_store_stats_t stats;
+        audio_clip_store_stats(&s_store, &stats);
+        CHECK_EQ(stats.slabs_used, slabs);
+        CHECK_EQ(stats.clips, live_count);
+        if (round % 50 == 0) {
+            for (size_t i = 0; i < live_count; ++i) {
+                CHECK(intact(live[i].id, live[i].samples));
+            }
+        }
+    }
+    audio_clip_store_stats_t stats;
+    audio_clip_store_stats(&s_store, &stats);
+    printf("%lu clips freed, %lu evicted\n", (unsigned long)freed, (unsigned long)stats.evictions);
+    CHECK(stats.evictions > 0);
+}
+
+int main(void) {
+    RUN_TEST(test_fragmented_arena);
+    RUN_TEST(test_eviction_oldest_first);
+    RUN_TEST(test_eviction_by_slot);
+    RUN_TEST(test_churn);
+    audio_clip_store_deinit(&s_store);
+    return TEST_EXIT_CODE();
+}
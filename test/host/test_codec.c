@@ -0,0 +1,157 @@
+#include <math.h>
+#include <string.h>
+#include "audio_codec.h"
+#include "audio_upload.h"
+#include "test.h"
+
+// Encode -> decode round trips of the upload codecs
+
+#define FRAME AUDIO_UPLOAD_FRAME_SAMPLES
+#define SPEECH_FRAMES 40
+
+// Voiced-speech-like test signal: a 140 Hz fundamental with a few
+// harmonics under a slow swell, at 16 kHz
+static void speech_like(int16_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        double t = i / 16000.0;
+        double swell = 0.55 + 0.45 * sin(2 * M_PI * 3 * t);
+        double v = 0.5 * sin(2 * M_PI * 140 * t) + 0.25 * sin(2 * M_PI * 420 * t + 1) +
+                   0.15 * sin(2 * M_PI * 980 * t + 2) + 0.05 * sin(2 * M_PI * 2300 * t);
+        out[i] = (int16_t)lrint(12000 * swell * v);
+    }
+}
+
+static double snr_db(const int16_t *ref, const int16_t *got, size_t count) {
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = 0; i < count; ++i) {
+        signal += (double)ref[i] * ref[i];
+        noise += (double)(ref[i] - got[i]) * (ref[i] - got[i]);
+    }
+    return noise == 0 ? INFINITY : 10 * log10(signal / noise);
+}
+
+// Every 16-bit value comes back within half a mu-law step, which is 1/16
+// of the magnitude at most (G.711 has 16 steps per doubling)
+static void test_ulaw_every_value(void) {
+    uint8_t code;
+    int16_t back;
+    int worst = 0;
+
+    for (int32_t v = -32768; v <= 32767; ++v) {
+        int16_t pcm = (int16_t)v;
+        audio_codec_encode(AUDIO_CODEC_ULAW, NULL, &pcm, 1, &code);
+        audio_codec_decode(AUDIO_CODEC_ULAW, &code, 1, &back);
+        int mag = v < 0 ? -v : v;
+        int error = back - v < 0 ? v - back : back - v;
+        int clipped = mag > 32635 ? mag - 32635 : 0; // G.711 clips above this
+        if (error - clipped > 8 + mag / 32) {
+            if (worst == 0) {
+                printf("%d came back as %d\n", (int)v, back);
+            }
+            worst = error;
+        }
+    }
+    CHECK_EQ(worst, 0);
+}
+
+// Decoding then re-encoding a code gives the code back (0x7F is negative
+// zero, which encodes as positive zero)
+static void test_ulaw_codes_are_fixed_points(void) {
+    for (int c = 0; c < 256; ++c) {
+        uint8_t code = (uint8_t)c;
+        uint8_t again;
+        int16_t pcm;
+        audio_codec_decode(AUDIO_CODEC_ULAW, &code, 1, &pcm);
+        audio_codec_encode(AUDIO_CODEC_ULAW, NULL, &pcm, 1, &again);
+        if (c != 0x7F) {
+            CHECK_EQ(again, code);
+        }
+    }
+}
+
+static void test_ulaw_speech(void) {
+    static int16_t pcm[FRAME * SPEECH_FRAMES];
+    static int16_t back[FRAME * SPEECH_FRAMES];
+    static uint8_t encoded[FRAME * SPEECH_FRAMES];
+
+    speech_like(pcm, FRAME * SPEECH_FRAMES);
+    CHECK_EQ(audio_codec_encode(AUDIO_CODEC_ULAW, NULL, pcm, FRAME * SPEECH_FRAMES, encoded),
+             audio_codec_frame_bytes(AUDIO_CODEC_ULAW, FRAME * SPEECH_FRAMES));
+    audio_codec_decode(AUDIO_CODEC_ULAW, encoded, FRAME * SPEECH_FRAMES, back);
+    double snr = snr_db(pcm, back, FRAME * SPEECH_FRAMES);
+    printf("mu-law SNR %.1f dB\n", snr);
+    CHECK(snr > 30);
+}
+
+// Upload-sized frames, the step size carried from frame to frame as the
+// uploader does. Each frame decodes on its own, so decoding them in reverse
+// order gives the same samples.
+static void test_adpcm_frames(void) {
+    static int16_t pcm[FRAME * SPEECH_FRAMES];
+    static int16_t back[FRAME * SPEECH_FRAMES];
+    static int16_t reversed[FRAME * SPEECH_FRAMES];
+    static uint8_t encoded[SPEECH_FRAMES][AUDIO_CODEC_ADPCM_HEADER_BYTES + FRAME / 2];
+    audio_codec_state_t state = {0};
+
+    speech_like(pcm, FRAME * SPEECH_FRAMES);
+    for (size_t f = 0; f < SPEECH_FRAMES; ++f) {
+        size_t len = audio_codec_encode(AUDIO_CODEC_IMA_ADPCM, &state, pcm + f * FRAME, FRAME, encoded[f]);
+        CHECK_EQ(len, audio_codec_frame_bytes(AUDIO_CODEC_IMA_ADPCM, FRAME));
+        CHECK_EQ((int16_t)(encoded[f][0] | encoded[f][1] << 8), pcm[f * FRAME]); // First sample is exact
+    }
+    for (size_t f = 0; f < SPEECH_FRAMES; ++f) {
+        CHECK_EQ(audio_codec_decode(AUDIO_CODEC_IMA_ADPCM, encoded[f], FRAME, back + f * FRAME), FRAME);
+    }
+    for (size_t f = SPEECH_FRAMES; f-- > 0;) {
+        audio_codec_decode(AUDIO_CODEC_IMA_ADPCM, encoded[f], FRAME, reversed + f * FRAME);
+    }
+    CHECK(memcmp(back, reversed, sizeof(back)) == 0);
+
+    double snr = snr_db(pcm, back, FRAME * SPEECH_FRAMES);
+    printf("IMA ADPCM SNR %.1f dB\n", snr);
+    CHECK(snr > 20);
+}
+
+// Odd lengths: the last sample has a byte of its own
+static void test_adpcm_odd_lengths(void) {
+    int16_t pcm[33];
+    int16_t back[33];
+    uint8_t encoded[AUDIO_CODEC_ADPCM_HEADER_BYTES + 17];
+
+    for (size_t n = 1; n <= 33; ++n) {
+        audio_codec_state_t state = {.step_index = 20};
+        for (size_t i = 0; i < n; ++i) {
+            pcm[i] = (int16_t)(i * 300 - 4000);
+        }
+        size_t len = audio_codec_encode(AUDIO_CODEC_IMA_ADPCM, &state, pcm, n, encoded);
+        CHECK_EQ(len, AUDIO_CODEC_ADPCM_HEADER_BYTES + n / 2);
+        CHECK_EQ(audio_codec_decode(AUDIO_CODEC_IMA_ADPCM, encoded, n, back), n);
+        CHECK_EQ(back[0], pcm[0]);
+        // A slow ramp is tracked closely once the step has adapted
+        for (size_t i = 8; i < n; ++i) {
+            CHECK(back[i] - pcm[i] < 300 && pcm[i] - back[i] < 300);
+        }
+    }
+}
+
+// ADC readings survive the trip to signed PCM and back
+static void test_adc_pcm_conversion(void) {
+    for (int reading = 0; reading < 4096; ++reading) {
+        int16_t sample = (int16_t)reading;
+        audio_codec_adc_to_pcm(&sample, 1);
+        CHECK_EQ(sample, (reading - 2048) * 16);
+        audio_codec_pcm_to_adc(&sample, 1);
+        CHECK_EQ(sample, reading);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_ulaw_every_value);
+    RUN_TEST(test_ulaw_codes_are_fixed_points);
+    RUN_TEST(test_ulaw_speech);
+    RUN_TEST(test_adpcm_frames);
+    RUN_TEST(test_adpcm_odd_lengths);
+    RUN_TEST(test_adc_pcm_conversion);
+    return TEST_EXIT_CODE();
+}
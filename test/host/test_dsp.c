@@ -0,0 +1,249 @@
+#include <math.h>
+#include <string.h>
+#include "audio_dsp.h"
+#include "test.h"
+
+// The fixed-point filters measured with sine tones: the decimator against
+// its stated passband and alias rejection, the resampler against unity DC
+// gain and the timing of its outputs, the DC blocker against its corner and
+// resting level. Built for both FIR kernels (DSP_KERNEL).
+
+#define AMPLITUDE 2000.0    // Near full scale for centred 12-bit readings
+#define SETTLE 1024         // Input samples before measuring
+#define MEASURE 8192
+
+// Amplitude of the tone at `cycles` per sample in `samples`, from a
+// Hann-windowed single-bin DFT, so rounding noise elsewhere is left out
+static double tone_amplitude(const double *samples, size_t count, double cycles) {
+    double re = 0;
+    double im = 0;
+    double window_sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * (double)i / (double)count);
+        re += w * samples[i] * cos(2 * M_PI * cycles * (double)i);
+        im += w * samples[i] * sin(2 * M_PI * cycles * (double)i);
+        window_sum += w;
+    }
+    return 2 * sqrt(re * re + im * im) / window_sum;
+}
+
+// Gain in dB of the decimator for a tone at `cycles` per input sample.
+// Above the output Nyquist it is measured where the tone folds to, as the
+// alias it leaves in the clip.
+static double decimator_gain_db(size_t factor, double cycles) {
+    static audio_dsp_decimator_t decimator;
+    static double outputs[MEASURE];
+    int16_t block[AUDIO_DSP_MAX_BLOCK];
+    size_t count = 0;
+
+    if (audio_dsp_decimator_init(&decimator, factor) != ESP_OK) {
+        return INFINITY;
+    }
+    for (size_t start = 0; start < SETTLE + MEASURE; start += AUDIO_DSP_MAX_BLOCK) {
+        for (size_t i = 0; i < AUDIO_DSP_MAX_BLOCK; ++i) {
+            block[i] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * cycles * (double)(start + i)));
+        }
+        size_t n = audio_dsp_decimate(&decimator, block, AUDIO_DSP_MAX_BLOCK, block);   // In place
+        for (size_t i = 0; i < n && start >= SETTLE; ++i) {
+            outputs[count++] = block[i];
+        }
+    }
+    double folded = fmod(cycles * factor, 1.0);
+    folded = folded > 0.5 ? 1 - folded : folded;
+    return 20 * log10(tone_amplitude(outputs, count, folded) / AMPLITUDE);
+}
+
+// Flat to 0.4 of the output rate; at least 64 dB down from 0.6 of it up to
+// the input Nyquist, the band that folds onto the passband
+static void test_decimator_response(void) {
+    const size_t factors[] = {2, 4};
+
+    for (size_t f = 0; f < 2; ++f) {
+        size_t factor = factors[f];
+        double out_rate = 1.0 / factor;     // In cycles per input sample
+        double ripple = 0;
+        double rejection = INFINITY;
+
+        for (double cycles = 0.01 * out_rate; cycles <= 0.4 * out_rate; cycles += 0.013 * out_rate) {
+            double gain = decimator_gain_db(factor, cycles);
+            ripple = fabs(gain) > ripple ? fabs(gain) : ripple;
+        }
+        for (double cycles = 0.6 * out_rate; cycles < 0.5; cycles += 0.0013) {
+            double gain = decimator_gain_db(factor, cycles);
+            rejection = -gain < rejection ? -gain : rejection;
+        }
+        printf("%s, factor %zu: passband within %.3f dB, aliases %.1f dB down\n", DSP_KERNEL, factor, ripple, rejection);
+        CHECK(ripple < 0.1);
+        CHECK(rejection >= 64);
+    }
+}
+
+// Factor 1 passes samples through untouched
+static void test_decimator_factor_one(void) {
+    audio_dsp_decimator_t decimator;
+    int16_t in[64];
+    int16_t out[64];
+
+    REQUIRE(audio_dsp_decimator_init(&decimator, 1) == ESP_OK);
+    for (size_t i = 0; i < 64; ++i) {
+        in[i] = (int16_t)(i * 61 - 2000);
+    }
+    CHECK_EQ(audio_dsp_decimate(&decimator, in, 64, out), 64);
+    CHECK(memcmp(in, out, sizeof(in)) == 0);
+    CHECK(audio_dsp_decimator_init(&decimator, 3) != ESP_OK);
+}
+
+// Resample `count` samples of `input(i)` in blocks of uneven sizes, then the
+// flush of TAPS / 2 zeros. Returns the outputs.
+static size_t resample(uint32_t step, double (*input)(size_t), size_t count, int16_t *out) {
+    static audio_dsp_resampler_t resampler;
+    const size_t blocks[] = {37, AUDIO_DSP_MAX_BLOCK, 100, 1, 255};
+    int16_t block[AUDIO_DSP_MAX_BLOCK];
+    size_t outputs = 0;
+
+    if (audio_dsp_resampler_init(&resampler, step) != ESP_OK) {
+        return 0;
+    }
+    for (size_t done = 0, b = 0; done < count + AUDIO_DSP_RESAMPLE_TAPS / 2; ++b) {
+        size_t n = blocks[b % 5];
+        n = n < count + AUDIO_DSP_RESAMPLE_TAPS / 2 - done ? n : count + AUDIO_DSP_RESAMPLE_TAPS / 2 - done;
+        for (size_t i = 0; i < n; ++i) {
+            block[i] = done + i < count ? (int16_t)lrint(input(done + i)) : 0;
+        }
+        outputs += audio_dsp_resample(&resampler, block, n, out + outputs);
+        done += n;
+    }
+    return outputs;
+}
+
+#define RESAMPLE_INPUTS 6000
+#define TONE_CYCLES 0.02        // Per input sample: 320 Hz at 16 kHz
+#define TONE_AMPLITUDE 8000.0
+
+static double dc_input(size_t i) {
+    return -1500;
+}
+
+static double tone_input(size_t i) {
+    return TONE_AMPLITUDE * sin(2 * M_PI * TONE_CYCLES * (double)i);
+}
+
+static const uint32_t s_steps[] = {
+    AUDIO_DSP_RESAMPLE_ONE / 2, 45875, AUDIO_DSP_RESAMPLE_ONE, 89784, 2 * AUDIO_DSP_RESAMPLE_ONE,
+};
+
+// Every output count promised, with the flush; a constant comes out exactly
+static void test_resampler_dc(void) {
+    static int16_t out[RESAMPLE_INPUTS * 2 + AUDIO_DSP_MAX_BLOCK];
+
+    for (size_t s = 0; s < sizeof(s_steps) / sizeof(s_steps[0]); ++s) {
+        uint32_t step = s_steps[s];
+        size_t outputs = resample(step, dc_input, RESAMPLE_INPUTS, out);
+        size_t expected = ((uint64_t)RESAMPLE_INPUTS * AUDIO_DSP_RESAMPLE_ONE + step - 1) / step;
+        CHECK_EQ(outputs, expected);
+
+        // Past the start, where the window still holds zeros from before it
+        size_t wrong = 0;
+        for (size_t n = AUDIO_DSP_RESAMPLE_TAPS * 2; n < outputs; ++n) {
+            double at = (double)n * step / AUDIO_DSP_RESAMPLE_ONE;
+            if (at + AUDIO_DSP_RESAMPLE_TAPS / 2 < RESAMPLE_INPUTS && out[n] != -1500) {
+                wrong++;
+            }
+        }
+        CHECK_EQ(wrong, 0);
+    }
+    CHECK(audio_dsp_resampler_init(&(audio_dsp_resampler_t){0}, AUDIO_DSP_RESAMPLE_ONE / 2 - 1) != ESP_OK);
+    CHECK(audio_dsp_resampler_init(&(audio_dsp_resampler_t){0}, 2 * AUDIO_DSP_RESAMPLE_ONE + 1) != ESP_OK);
+}
+
+// Output n is the input at n * step: a tone comes out at its amplitude,
+// shifted by no more than the 1/128-sample phase resolution
+static void test_resampler_phase(void) {
+    static int16_t out[RESAMPLE_INPUTS * 2 + AUDIO_DSP_MAX_BLOCK];
+
+    for (size_t s = 0; s < sizeof(s_steps) / sizeof(s_steps[0]); ++s) {
+        uint32_t step = s_steps[s];
+        size_t outputs = resample(step, tone_input, RESAMPLE_INPUTS, out);
+        double re = 0;
+        double im = 0;
+        double worst = 0;
+        size_t measured = 0;
+
+        for (size_t n = AUDIO_DSP_RESAMPLE_TAPS * 2; n < outputs; ++n) {
+            double at = (double)n * step / AUDIO_DSP_RESAMPLE_ONE;
+            if (at + AUDIO_DSP_RESAMPLE_TAPS > RESAMPLE_INPUTS) {
+                break;
+            }
+            double error = fabs(out[n] - TONE_AMPLITUDE * sin(2 * M_PI * TONE_CYCLES * at));
+            worst = error > worst ? error : worst;
+            re += out[n] * sin(2 * M_PI * TONE_CYCLES * at);
+            im += out[n] * cos(2 * M_PI * TONE_CYCLES * at);
+            measured++;
+        }
+        double gain_db = 20 * log10(2 * sqrt(re * re + im * im) / measured / TONE_AMPLITUDE);
+        double lag = -atan2(im, re) / (2 * M_PI * TONE_CYCLES);    // Input samples
+        printf("%s, step %.3f: gain %.3f dB, lag %.4f samples, worst error %.1f\n", DSP_KERNEL,
+               (double)step / AUDIO_DSP_RESAMPLE_ONE, gain_db, lag, worst);
+        CHECK_NEAR(gain_db, 0, 0.05);
+        CHECK_NEAR(lag, 0, 1.0 / AUDIO_DSP_RESAMPLE_PHASES);
+        // Timing error of a phase step on the steepest slope, plus rounding
+        CHECK(worst < 2 * M_PI * TONE_CYCLES * TONE_AMPLITUDE / AUDIO_DSP_RESAMPLE_PHASES + 4);
+    }
+}
+
+// Gain of the DC blocker for a tone, after it has settled
+static double dc_blocker_gain_db(double cycles, int16_t offset) {
+    audio_dsp_dc_blocker_t blocker;
+    int16_t block[AUDIO_DSP_MAX_BLOCK];
+    double sum = 0;
+    size_t measured = 0;
+    size_t settle = 16 * 1024;      // A few time constants of 256 samples
+
+    audio_dsp_dc_blocker_init(&blocker);
+    for (size_t start = 0; start < settle + MEASURE; start += AUDIO_DSP_MAX_BLOCK) {
+        for (size_t i = 0; i < AUDIO_DSP_MAX_BLOCK; ++i) {
+            block[i] = (int16_t)(offset + lrint(AMPLITUDE / 2 * sin(2 * M_PI * cycles * (double)(start + i))));
+        }
+        audio_dsp_dc_block(&blocker, block, AUDIO_DSP_MAX_BLOCK);
+        if (start < settle) {
+            continue;
+        }
+        for (size_t i = 0; i < AUDIO_DSP_MAX_BLOCK; ++i) {
+            sum += (double)block[i] * block[i];
+        }
+        measured += AUDIO_DSP_MAX_BLOCK;
+    }
+    return 20 * log10(sqrt(sum / measured) / (AMPLITUDE / 2 / sqrt(2)));
+}
+
+// About 10 Hz corner at 16 kHz: voice passes, the bias goes
+static void test_dc_blocker(void) {
+    audio_dsp_dc_blocker_t blocker;
+    int16_t block[AUDIO_DSP_MAX_BLOCK];
+
+    CHECK_NEAR(dc_blocker_gain_db(100.0 / 16000, 300), 0, 0.1);
+    CHECK_NEAR(dc_blocker_gain_db(1000.0 / 16000, -300), 0, 0.05);
+    CHECK_NEAR(dc_blocker_gain_db(10.0 / 16000, 300), -3, 1);
+    CHECK(dc_blocker_gain_db(1.0 / 16000, 0) < -18);
+
+    // A constant bias settles at exactly zero, not a rounding offset
+    audio_dsp_dc_blocker_init(&blocker);
+    for (int pass = 0; pass < 32; ++pass) {
+        for (size_t i = 0; i < AUDIO_DSP_MAX_BLOCK; ++i) {
+            block[i] = i % 2 == 0 && pass == 0 ? 400 : 700;   // Starts off a step from the bias
+        }
+        audio_dsp_dc_block(&blocker, block, AUDIO_DSP_MAX_BLOCK);
+    }
+    for (size_t i = 0; i < AUDIO_DSP_MAX_BLOCK; ++i) {
+        CHECK_EQ(block[i], 0);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_decimator_response);
+    RUN_TEST(test_decimator_factor_one);
+    RUN_TEST(test_resampler_dc);
+    RUN_TEST(test_resampler_phase);
+    RUN_TEST(test_dc_blocker);
+    return TEST_EXIT_CODE();
+}
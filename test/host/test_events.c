@@ -0,0 +1,89 @@
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "audio_events.h"
+#include "audio_control.h"
+#include "test.h"
+
+// The control state machine fed by the debounced event queue, with button
+// edges scripted on the simulation HAL's timeline, bounces included, as
+// the control task would see them
+
+// Times in ms. A record press that bounces; a playback release that
+// bounces; a playback press while playing; a record release followed by
+// a bounce that leaves the button held, so the press is only recovered
+// once the contact has been quiet for the debounce window.
+#define TIMELINE "record:100-103,record:105-107,record:109-400," \
+                 "playback:500-600,playback:605-610," \
+                 "playback:650-700," \
+                 "record:800-1000,record:1010-1300"
+
+typedef struct {
+    audio_event_type_t type;
+    audio_hal_button_t button;
+    uint32_t ms;
+    uint32_t actions;
+} step_t;
+
+static const step_t s_script[] = {
+    {AUDIO_EVENT_PRESS, AUDIO_HAL_BUTTON_RECORD, 100, AUDIO_CONTROL_START_RECORDING},
+    {AUDIO_EVENT_RELEASE, AUDIO_HAL_BUTTON_RECORD, 400, AUDIO_CONTROL_STOP_RECORDING},
+    {AUDIO_EVENT_PRESS, AUDIO_HAL_BUTTON_PLAYBACK, 500, AUDIO_CONTROL_START_PLAYBACK},
+    {AUDIO_EVENT_RELEASE, AUDIO_HAL_BUTTON_PLAYBACK, 600, 0},
+    {AUDIO_EVENT_PRESS, AUDIO_HAL_BUTTON_PLAYBACK, 650, 0},     // Still playing
+    {AUDIO_EVENT_RELEASE, AUDIO_HAL_BUTTON_PLAYBACK, 700, 0},
+    {AUDIO_EVENT_PLAYBACK_DONE, 0, 750, 0},                     // Posted by the test
+    {AUDIO_EVENT_PRESS, AUDIO_HAL_BUTTON_RECORD, 800, AUDIO_CONTROL_START_RECORDING},
+    {AUDIO_EVENT_RELEASE, AUDIO_HAL_BUTTON_RECORD, 1000, AUDIO_CONTROL_STOP_RECORDING},
+    {AUDIO_EVENT_PRESS, AUDIO_HAL_BUTTON_RECORD, 1010, AUDIO_CONTROL_START_RECORDING},
+    {AUDIO_EVENT_RELEASE, AUDIO_HAL_BUTTON_RECORD, 1300, AUDIO_CONTROL_STOP_RECORDING},
+};
+
+static void test_scripted_events(void) {
+    audio_control_t control;
+    audio_event_t event;
+
+    audio_control_init(&control);
+    for (size_t i = 0; i < sizeof(s_script) / sizeof(s_script[0]); ++i) {
+        const step_t *step = &s_script[i];
+        if (step->type == AUDIO_EVENT_PLAYBACK_DONE) {
+            CHECK(control.playing);
+            event = (audio_event_t){.type = AUDIO_EVENT_PLAYBACK_DONE, .timestamp_us = step->ms * 1000};
+            REQUIRE(audio_events_post(&event) == ESP_OK);
+        }
+        if (!audio_events_wait(&event, pdMS_TO_TICKS(2000))) {
+            printf("no event at step %zu\n", i);
+            CHECK(false);
+            return;
+        }
+        CHECK_EQ(event.type, step->type);
+        if (step->type != AUDIO_EVENT_PLAYBACK_DONE) {
+            CHECK_EQ(event.button, step->button);
+        }
+        CHECK_EQ(event.timestamp_us, (int64_t)step->ms * 1000);   // The edge, not when it was seen
+
+        uint32_t actions = audio_control_handle(&control, &event);
+        CHECK_EQ(actions, step->actions);
+        if (actions & AUDIO_CONTROL_START_RECORDING) {
+            CHECK_EQ(control.record_start_us, event.timestamp_us);
+        }
+        if (actions & AUDIO_CONTROL_STOP_RECORDING) {
+            CHECK_EQ(control.record_stop_us, event.timestamp_us);
+        }
+        CHECK_EQ(control.recording, step->type == AUDIO_EVENT_PRESS && step->button == AUDIO_HAL_BUTTON_RECORD);
+    }
+    CHECK(!control.playing);
+
+    // Nothing else: every bounce was swallowed
+    CHECK(!audio_events_wait(&event, pdMS_TO_TICKS(200)));
+}
+
+int main(void) {
+    setenv("AUDIO_SIM_TIMELINE", TIMELINE, 1);
+    setenv("AUDIO_SIM_SPEED", "1", 1);
+    if (audio_events_init(NULL, NULL) != ESP_OK) {
+        return 1;
+    }
+
+    RUN_TEST(test_scripted_events);
+    return TEST_EXIT_CODE();
+}
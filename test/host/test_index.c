@@ -0,0 +1,257 @@
+#include <stdbool.h>
+#include <string.h>
+#include "audio_ring.h"
+#include "audio_index.h"
+#include "test.h"
+
+// The block index fed alongside a small ring. Every block is written at one
+// level (a square wave of that amplitude about mid-scale, so its peak and
+// RMS levels are equal), which lets a test name each block by its level.
+
+#define RATE 16000
+#define CAPACITY 4096                           // 16 blocks
+#define BLOCK AUDIO_INDEX_BLOCK_SAMPLES
+#define BLOCK_US (BLOCK * 1000000LL / RATE)     // 16 ms
+#define LOUD 100
+#define QUIET 2
+
+static uint8_t s_ring_storage[AUDIO_RING_STORAGE_BYTES(CAPACITY)];
+static uint8_t s_index_storage[AUDIO_INDEX_STORAGE_BYTES(CAPACITY)];
+static audio_ring_t s_ring;
+static audio_index_t s_index;
+
+static void reset(void) {
+    REQUIRE(audio_ring_init(&s_ring, s_ring_storage, CAPACITY) == ESP_OK);
+    REQUIRE(audio_index_init(&s_index, &s_ring, s_index_storage, RATE) == ESP_OK);
+}
+
+// `count` samples at `level` into the ring and the index, in frames of
+// 100 so blocks are completed partway through a write
+static void feed(uint8_t level, uint32_t count) {
+    int16_t frame[100];
+    int16_t amplitude = level << AUDIO_INDEX_LEVEL_SHIFT;
+
+    while (count > 0) {
+        size_t n = count < 100 ? count : 100;
+        for (size_t i = 0; i < n; ++i) {
+            frame[i] = 2048 + ((audio_ring_head(&s_ring) + i) & 1 ? amplitude : -amplitude);
+        }
+        audio_ring_write(&s_ring, frame, n);
+        audio_index_append(&s_index, frame, n);
+        count -= n;
+    }
+}
+
+// Seeking by time within a recording, between two recordings, and outside
+// what the ring holds; and the time of a position
+static void test_seek_to_time(void) {
+    const int64_t t0 = 1000000;
+    const int64_t t1 = 5000000;
+    audio_ring_cursor_t cursor;
+    int64_t time_us;
+
+    reset();
+    CHECK(!audio_index_seek(&s_index, t0, &cursor));
+    audio_index_mark(&s_index, t0);
+    feed(QUIET, 4 * BLOCK);
+    audio_index_mark(&s_index, t1);
+    feed(QUIET, 4 * BLOCK);
+
+    CHECK(audio_index_seek(&s_index, t0, &cursor));
+    CHECK_EQ(cursor.pos, 0);
+    CHECK(audio_index_seek(&s_index, t0 + BLOCK_US, &cursor));
+    CHECK_EQ(cursor.pos, BLOCK);
+    CHECK(audio_index_seek(&s_index, t1 + 2 * BLOCK_US + 500, &cursor));
+    CHECK_EQ(cursor.pos, 6 * BLOCK + 500 * RATE / 1000000);
+    // Between the recordings: the start of the later one
+    CHECK(audio_index_seek(&s_index, t0 + 8 * BLOCK_US, &cursor));
+    CHECK_EQ(cursor.pos, 4 * BLOCK);
+    CHECK(!audio_index_seek(&s_index, t0 - 1, &cursor));
+    CHECK(!audio_index_seek(&s_index, t1 + 4 * BLOCK_US, &cursor));
+
+    CHECK(audio_index_time(&s_index, 2 * BLOCK, &time_us));
+    CHECK_EQ(time_us, t0 + 2 * BLOCK_US);
+    CHECK(audio_index_time(&s_index, 5 * BLOCK + 16, &time_us));
+    CHECK_EQ(time_us, t1 + BLOCK_US + 1000);
+}
+
+// The last loud block, however recent, and the window clamped to the ring
+static void test_last_loud(void) {
+    audio_ring_cursor_t cursor;
+
+    reset();
+    feed(QUIET, 3 * BLOCK);
+    CHECK(!audio_index_last_loud(&s_index, LOUD, BLOCK, &cursor));
+    feed(LOUD, BLOCK);
+    feed(QUIET, 2 * BLOCK);
+
+    CHECK(audio_index_last_loud(&s_index, LOUD, 2 * BLOCK, &cursor));
+    CHECK_EQ(cursor.pos, 2 * BLOCK);
+    CHECK(audio_index_last_loud(&s_index, LOUD - 1, 10 * BLOCK, &cursor));
+    CHECK_EQ(cursor.pos, 0);
+    CHECK(!audio_index_last_loud(&s_index, LOUD + 1, BLOCK, &cursor));
+
+    // A loud block still being written is not seen until it completes
+    feed(LOUD + 10, BLOCK - 1);
+    CHECK(!audio_index_last_loud(&s_index, LOUD + 10, BLOCK, &cursor));
+    feed(LOUD + 10, 1);
+    CHECK(audio_index_last_loud(&s_index, LOUD + 10, BLOCK, &cursor));
+    CHECK_EQ(cursor.pos, 6 * BLOCK);
+}
+
+// Quiet blocks trimmed from both ends, partial blocks at the ends of the
+// range kept, the block being written kept, all-quiet ranges emptied
+static void test_trim_bounds(void) {
+    audio_ring_cursor_t cursor;
+    uint32_t samples;
+
+    reset();
+    feed(QUIET, 3 * BLOCK);
+    feed(LOUD, 3 * BLOCK);
+    feed(QUIET, 3 * BLOCK);
+
+    cursor.pos = 100;
+    samples = 8 * BLOCK;
+    audio_index_trim(&s_index, LOUD, &cursor, &samples);
+    CHECK_EQ(cursor.pos, 3 * BLOCK);
+    CHECK_EQ(samples, 3 * BLOCK);
+
+    // Starting and ending inside loud blocks: nothing to trim
+    cursor.pos = 3 * BLOCK + 50;
+    samples = 2 * BLOCK;
+    audio_index_trim(&s_index, LOUD, &cursor, &samples);
+    CHECK_EQ(cursor.pos, 3 * BLOCK + 50);
+    CHECK_EQ(samples, 2 * BLOCK);
+
+    cursor.pos = 0;
+    samples = 3 * BLOCK;
+    audio_index_trim(&s_index, LOUD, &cursor, &samples);
+    CHECK_EQ(samples, 0);
+
+    // Up to the live end: the block in progress is not indexed, so it stays
+    feed(QUIET, 10);
+    cursor.pos = 6 * BLOCK;
+    samples = audio_ring_head(&s_ring) - cursor.pos;
+    audio_index_trim(&s_index, LOUD, &cursor, &samples);
+    CHECK_EQ(cursor.pos, 9 * BLOCK);
+    CHECK_EQ(samples, 10);
+
+    samples = 0;
+    audio_index_trim(&s_index, LOUD, &cursor, &samples);
+    CHECK_EQ(samples, 0);
+}
+
+// Preview points cover equal runs of blocks: the peak of the run and the
+// RMS of its blocks' RMS
+static void test_preview_decimation(void) {
+    audio_index_block_t points[16];
+    audio_ring_cursor_t cursor = {.pos = 0};
+
+    reset();
+    for (uint8_t b = 0; b < 12; ++b) {
+        feed(b % 4 == 0 ? 40 : 10, BLOCK);
+    }
+
+    CHECK_EQ(audio_index_preview(&s_index, cursor, 12 * BLOCK, points, 16), 12);
+    CHECK_EQ(points[4].peak, 40);
+    CHECK_EQ(points[5].rms, 10);
+
+    CHECK_EQ(audio_index_preview(&s_index, cursor, 12 * BLOCK, points, 3), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK_EQ(points[i].peak, 40);
+        CHECK_EQ(points[i].rms, 21);   // Floor of sqrt((1600 + 3 * 100) / 4)
+    }
+
+    // Uneven runs: 12 blocks in 5 points
+    CHECK_EQ(audio_index_preview(&s_index, cursor, 12 * BLOCK, points, 5), 5);
+    CHECK_EQ(points[0].peak, 40);      // Blocks 0-1
+    CHECK_EQ(points[1].peak, 10);      // Blocks 2-3
+    CHECK_EQ(points[1].rms, 10);
+
+    // A range starting partway into a block previews from its start
+    cursor.pos = BLOCK + 10;
+    CHECK_EQ(audio_index_preview(&s_index, cursor, BLOCK, points, 16), 2);
+    CHECK_EQ(audio_index_preview(&s_index, cursor, 0, points, 16), 0);
+}
+
+// Once the ring overwrites indexed blocks they are gone from the index:
+// queries over them fail, count as quiet or preview as silence, and the
+// blocks still in the ring keep their own levels
+static void test_wrap_around(void) {
+    const int64_t t0 = 2000000;
+    const uint32_t written = 3 * CAPACITY + 300;
+    audio_index_block_t block;
+    audio_ring_cursor_t cursor;
+
+    reset();
+    audio_index_mark(&s_index, t0);
+    for (uint32_t b = 0; b < written / BLOCK; ++b) {
+        feed(1 + b % 200, BLOCK);
+    }
+    feed(LOUD, written % BLOCK);
+
+    uint32_t head = audio_ring_head(&s_ring);
+    uint32_t oldest = head - CAPACITY;
+    uint32_t indexed = 0;
+    for (uint32_t pos = 0; pos < head; pos += BLOCK) {
+        bool found = audio_index_block(&s_index, pos, &block);
+        if (pos + BLOCK <= oldest || pos + BLOCK > head) {
+            CHECK(!found);
+        } else if (found) {
+            CHECK_EQ(block.peak, 1 + pos / BLOCK % 200);
+            indexed++;
+        }
+    }
+    // All but the block whose slot is next to be reused
+    CHECK(indexed >= CAPACITY / BLOCK - 2);
+
+    CHECK(!audio_index_seek(&s_index, t0, &cursor));
+    CHECK(audio_index_seek(&s_index, t0 + (int64_t)(oldest + BLOCK) * 1000000 / RATE, &cursor));
+    CHECK_EQ(cursor.pos, oldest + BLOCK);
+
+    CHECK(audio_index_last_loud(&s_index, 1, 2 * CAPACITY, &cursor));
+    CHECK_EQ(cursor.pos, oldest);
+
+    cursor.pos = oldest - 2 * BLOCK;
+    uint32_t samples = 3 * BLOCK;
+    audio_index_trim(&s_index, 1, &cursor, &samples);
+    CHECK(cursor.pos >= oldest);
+
+    audio_index_block_t points[2];
+    cursor.pos = CAPACITY;
+    CHECK_EQ(audio_index_preview(&s_index, cursor, 2 * BLOCK, points, 2), 2);
+    CHECK_EQ(points[0].peak, 0);
+    CHECK_EQ(points[1].rms, 0);
+}
+
+// The index costs a fixed fraction of the ring, whatever its depth
+static void test_memory_overhead(void) {
+    size_t ring_bytes = AUDIO_RING_STORAGE_BYTES(CAPACITY);
+    size_t index_bytes = AUDIO_INDEX_STORAGE_BYTES(CAPACITY);
+
+    printf("%zu index bytes for %zu ring bytes (%.2f%%), %zu bytes of state\n", index_bytes, ring_bytes,
+           100.0 * index_bytes / ring_bytes, sizeof(audio_index_t));
+    CHECK_EQ(index_bytes, CAPACITY / BLOCK * 2);
+    CHECK(index_bytes * 100 <= ring_bytes);
+    CHECK_EQ(AUDIO_INDEX_STORAGE_BYTES(1u << 20) * CAPACITY, index_bytes * (1u << 20));
+
+    // Capacities too small for the index, or a ring that already holds audio
+    audio_ring_t ring;
+    REQUIRE(audio_ring_init(&ring, s_ring_storage, 2 * BLOCK) == ESP_OK);
+    CHECK_EQ(audio_index_init(&s_index, &ring, s_index_storage, RATE), ESP_OK);
+    REQUIRE(audio_ring_init(&ring, s_ring_storage, BLOCK) == ESP_OK);
+    CHECK_EQ(audio_index_init(&s_index, &ring, s_index_storage, RATE), ESP_ERR_INVALID_ARG);
+    reset();
+    feed(QUIET, 1);
+    CHECK_EQ(audio_index_init(&s_index, &s_ring, s_index_storage, RATE), ESP_ERR_INVALID_STATE);
+}
+
+int main(void) {
+    RUN_TEST(test_seek_to_time);
+    RUN_TEST(test_last_loud);
+    RUN_TEST(test_trim_bounds);
+    RUN_TEST(test_preview_decimation);
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_memory_overhead);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "audio_hal.h"
+#include "audio_capture.h"
+#include "audio_clip_store.h"
+#include "audio_index.h"
+#include "audio_metrics.h"
+#include "audio_ring.h"
+#include "audio_tasks.h"
+#include "audio_uploader.h"
+#include "audio_vad.h"
+#include "upload_server.h"
+#include "test.h"
+
+// Capture at real-time speed while clips upload, with the firmware's
+// frame, queue and task settings (main/freeRTOSImp.c): a reader task does
+// what control_task does while recording and submits a clip every second,
+// which the upload task encodes and sends to a slow server meanwhile. The
+// worst frame latency says how much of the queue the uploads cost the
+// reader, and the stack high-water marks what each task needs; the metrics
+// task logs its dump throughout, as it does on the device.
+
+#define RATE 16000
+#define FRAME 256                   // CAPTURE_FRAME_SAMPLES
+#define DEPTH 8                     // CAPTURE_QUEUE_DEPTH
+#define FRAME_US (FRAME * 1000000LL / RATE)
+#define SECONDS 6
+#define CLIP_SAMPLES RATE           // Submitted each second
+#define RING_CAPACITY (1u << 17)
+#define STORE_SLABS (2 * CLIP_SAMPLES / AUDIO_CLIP_STORE_SLAB_SAMPLES + 2)
+#define LATENCY_MAX_US (2 * FRAME_US)   // A quarter of the queue: host scheduling, not uploads
+
+static audio_ring_t s_ring;
+static uint8_t s_ring_storage[AUDIO_RING_STORAGE_BYTES(RING_CAPACITY)];
+static audio_index_t s_index;
+static uint8_t s_index_storage[AUDIO_INDEX_STORAGE_BYTES(RING_CAPACITY)];
+static audio_vad_t s_vad;
+static uint8_t s_store[AUDIO_CLIP_STORE_MAX_CLIPS * sizeof(audio_clip_store_clip_t) +
+                       STORE_SLABS * AUDIO_CLIP_STORE_SLAB_BYTES];
+static upload_server_t s_server;
+static QueueHandle_t s_done;
+
+// As in main/freeRTOSImp.c
+static const audio_task_config_t s_reader_task = {
+    .name = "control_task", .stack = 4096, .priority = 20, .core = AUDIO_TASKS_CORE_AUDIO,
+};
+static const audio_task_config_t s_upload_task = {
+    .name = "upload_task", .stack = 8192, .priority = 4, .core = AUDIO_TASKS_CORE_NETWORK,
+};
+static const audio_task_config_t s_metrics_task = {
+    .name = "metrics_task", .stack = 4096, .priority = 1, .core = AUDIO_TASKS_CORE_NETWORK,
+};
+#define METRICS_PERIOD_MS 500
+
+typedef struct {
+    uint32_t frames;
+    uint32_t submitted;
+    uint32_t failed;
+} reader_result_t;
+
+// control_task while recording: every frame into the ring, the index and
+// the VAD, and the last second handed to the uploader once it is complete
+static void reader_task(void *arg) {
+    static int16_t frame[FRAME];
+    reader_result_t result = {0};
+    audio_ring_cursor_t clip = audio_ring_cursor_live(&s_ring);
+
+    audio_vad_begin(&s_vad);
+    audio_index_mark(&s_index, audio_hal_time_us());
+    while (result.frames < SECONDS * RATE / FRAME) {
+        size_t count = audio_capture_read(frame, pdMS_TO_TICKS(1000));
+        if (count == 0) {
+            break;
+        }
+        audio_ring_write(&s_ring, frame, count);
+        audio_index_append(&s_index, frame, count);
+        audio_vad_process(&s_vad, frame, count);
+        result.frames++;
+
+        if (audio_ring_head(&s_ring) - clip.pos >= CLIP_SAMPLES) {
+            result.failed += audio_uploader_submit(&s_ring, clip, CLIP_SAMPLES) != ESP_OK;
+            result.submitted++;
+            clip.pos += CLIP_SAMPLES;
+        }
+    }
+    xQueueSend(s_done, &result, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static uint32_t stack_min_free(const char *task) {
+    const char *name;
+    uint32_t min_free;
+    for (size_t i = 0; audio_tasks_stack_info(i, &name, &min_free); ++i) {
+        if (strcmp(name, task) == 0) {
+            return min_free;
+        }
+    }
+    return 0;
+}
+
+// No frame is dropped and none waits long, with an upload running for most
+// of the recording; every task stays within its stack
+static void test_latency_during_upload(void) {
+    reader_result_t result;
+    audio_capture_latency_t latency;
+
+    REQUIRE(audio_capture_start() == ESP_OK);
+    audio_capture_latency(&latency, true);
+    uint32_t overruns = audio_capture_overruns();
+    REQUIRE(audio_tasks_create(&s_reader_task, reader_task, NULL, NULL) == ESP_OK);
+    REQUIRE(xQueueReceive(s_done, &result, pdMS_TO_TICKS((SECONDS + 5) * 1000)) == pdTRUE);
+    audio_capture_latency(&latency, true);
+    audio_capture_stop();
+    for (int waited = 0; waited < 10000 && s_server.upload_count < result.submitted; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    uint32_t reader_free = stack_min_free(s_reader_task.name);
+    uint32_t upload_free = stack_min_free(s_upload_task.name);
+    uint32_t metrics_free = stack_min_free(s_metrics_task.name);
+    printf("{\"frames\":%lu,\"uploads\":%zu,\"worst_latency_us\":%lu,\"mean_latency_us\":%lu,"
+           "\"control_task_stack_used\":%lu,\"upload_task_stack_used\":%lu,\"metrics_task_stack_used\":%lu}\n",
+           (unsigned long)latency.frames, s_server.upload_count, (unsigned long)latency.worst_us,
+           (unsigned long)latency.mean_us, (unsigned long)(s_reader_task.stack - reader_free),
+           (unsigned long)(s_upload_task.stack - upload_free),
+           (unsigned long)(s_metrics_task.stack - metrics_free));
+
+    CHECK_EQ(result.frames, SECONDS * RATE / FRAME);
+    CHECK_EQ(latency.frames, result.frames);
+    CHECK_EQ(audio_capture_overruns() - overruns, 0);
+    CHECK(latency.worst_us < LATENCY_MAX_US);
+    CHECK_EQ(result.failed, 0);
+    CHECK_EQ(s_server.upload_count, result.submitted);
+    CHECK(reader_free > 0);
+    CHECK(upload_free > 0);
+    CHECK(metrics_free > 0);
+}
+
+int main(void) {
+    setenv("AUDIO_SIM_SPEED", "1", 1);
+
+    audio_capture_config_t capture = {
+        .sample_rate = RATE,
+        .frame_samples = FRAME,
+        .queue_depth = DEPTH,
+        .channels = 1,
+        .oversample = 1,
+        .dc_block = true,
+    };
+    // Slow enough that each upload takes most of the second before the next
+    host_http_config_t network = {.latency_ms = 600};
+    audio_uploader_config_t uploader = {
+        .upload = {
+            .url = "http://upload.test/clips",
+            .format = AUDIO_UPLOAD_JSON_BASE64,
+            .codec = AUDIO_CODEC_PCM16,
+            .sample_rate = RATE,
+            .channels = 1,
+        },
+        .store_arena = s_store,
+        .store_bytes = sizeof(s_store),
+        .task = s_upload_task,
+    };
+
+    s_done = xQueueCreate(1, sizeof(reader_result_t));
+    audio_vad_init(&s_vad, 1);
+    upload_server_start(&s_server, &network);
+    if (audio_ring_init(&s_ring, s_ring_storage, RING_CAPACITY) != ESP_OK ||
+        audio_index_init(&s_index, &s_ring, s_index_storage, RATE) != ESP_OK ||
+        audio_capture_init(&capture) != ESP_OK || audio_uploader_start(&uploader) != ESP_OK ||
+        audio_metrics_start(&s_metrics_task, METRICS_PERIOD_MS) != ESP_OK) {
+        return 1;
+    }
+
+    RUN_TEST(test_latency_during_upload);
+    upload_server_free(&s_server);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,276 @@
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "audio_metrics.h"
+#include "test.h"
+
+// The metrics registry: updates from several tasks at once are all counted,
+// values land in their log2 buckets, and the JSON dump parses and names
+// every metric. Metrics are process-wide, so each test works from the
+// difference to a snapshot or on metrics the others leave alone.
+
+#define WORKERS 4
+#define UPDATES 200000
+
+static const char *const s_counters[AUDIO_METRIC_COUNTER_COUNT] = {
+    "capture_frames", "capture_overruns", "clip_samples", "clip_kept_samples", "playback_clips", "playback_underruns",
+    "upload_clips", "upload_failures", "upload_connections", "upload_bytes", "upload_evictions",
+    "upload_drops", "stream_rebuffers",
+};
+static const char *const s_histograms[AUDIO_METRIC_HISTOGRAM_COUNT] = {
+    "sample_jitter_us", "frame_latency_us", "encode_us", "http_connect_us", "http_transfer_us", "http_response_us",
+    "stream_start_us",
+};
+
+static char s_json[AUDIO_METRICS_JSON_BYTES];
+
+// Just enough of a JSON parser to say whether the dump is well formed
+static const char *json_value(const char *p);
+
+static const char *json_space(const char *p) {
+    while (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static const char *json_string(const char *p) {
+    if (*p++ != '"') {
+        return NULL;
+    }
+    while (*p != '"') {
+        if (*p == '\0' || (unsigned char)*p < 0x20) {
+            return NULL;
+        }
+        p += *p == '\\' ? 2 : 1;
+    }
+    return p + 1;
+}
+
+static const char *json_number(const char *p) {
+    const char *start = p;
+    if (*p == '-') {
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    return p > start && p[-1] != '-' ? p : NULL;
+}
+
+// Object or array: `close` ends it, members are "key": value when `keys`
+static const char *json_members(const char *p, char close, bool keys) {
+    p = json_space(p + 1);
+    if (*p == close) {
+        return p + 1;
+    }
+    while (p != NULL) {
+        if (keys) {
+            p = json_string(json_space(p));
+            if (p == NULL || *(p = json_space(p)) != ':') {
+                return NULL;
+            }
+            p++;
+        }
+        p = json_value(p);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = json_space(p);
+        if (*p == close) {
+            return p + 1;
+        }
+        if (*p++ != ',') {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static const char *json_value(const char *p) {
+    p = json_space(p);
+    switch (*p) {
+    case '{': return json_members(p, '}', true);
+    case '[': return json_members(p, ']', false);
+    case '"': return json_string(p);
+    default: return json_number(p);
+    }
+}
+
+static bool json_valid(const char *text) {
+    const char *end = json_value(text);
+    return end != NULL && *json_space(end) == '\0';
+}
+
+// Value of "name": in the dump, or -1
+static long long json_counter(const char *name) {
+    char key[64];
+    long long value;
+
+    snprintf(key, sizeof(key), "\"%s\":", name);
+    const char *at = strstr(s_json, key);
+    return at != NULL && sscanf(at + strlen(key), "%lld", &value) == 1 ? value : -1;
+}
+
+// Count and buckets of histogram `name`; returns the number of buckets
+static size_t json_histogram(const char *name, unsigned long *count, unsigned long *max, unsigned long *buckets) {
+    char key[64];
+    int used;
+
+    snprintf(key, sizeof(key), "\"%s\":{\"n\":", name);
+    const char *at = strstr(s_json, key);
+    if (at == NULL || sscanf(at + strlen(key), "%lu,\"max\":%lu,\"b\":[%n", count, max, &used) != 2) {
+        return 0;
+    }
+    at += strlen(key) + used;
+    size_t n = 0;
+    while (n < AUDIO_METRICS_BUCKETS && sscanf(at, "%lu%n", &buckets[n], &used) == 1) {
+        n++;
+        at += used;
+        if (*at++ != ',') {
+            break;
+        }
+    }
+    return n;
+}
+
+static bool dump(void) {
+    size_t len = audio_metrics_json(s_json, sizeof(s_json));
+    return len > 0 && len == strlen(s_json);
+}
+
+static QueueHandle_t s_done;
+
+// Named apart, as the firmware's tasks are: the names are keys of the dump
+static const audio_task_config_t s_workers[WORKERS] = {
+    {.name = "worker0", .stack = 4096, .priority = 5, .core = tskNO_AFFINITY},
+    {.name = "worker1", .stack = 4096, .priority = 5, .core = tskNO_AFFINITY},
+    {.name = "worker2", .stack = 4096, .priority = 5, .core = tskNO_AFFINITY},
+    {.name = "worker3", .stack = 4096, .priority = 5, .core = tskNO_AFFINITY},
+};
+
+static void worker_task(void *arg) {
+    uintptr_t id = (uintptr_t)arg;
+    for (uint32_t i = 0; i < UPDATES; ++i) {
+        audio_metrics_add(AUDIO_METRIC_UPLOAD_BYTES, 3);
+        audio_metrics_add(AUDIO_METRIC_CAPTURE_FRAMES, 1);
+        audio_metrics_record(AUDIO_METRIC_HTTP_RESPONSE_US, i % 1000 + id);
+    }
+    xQueueSend(s_done, &id, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+// Tasks adding to the same counters and histogram at once lose nothing
+static void test_concurrent_updates(void) {
+    unsigned long before;
+    unsigned long max;
+    unsigned long buckets[AUDIO_METRICS_BUCKETS];
+
+    REQUIRE(dump());
+    long long bytes = json_counter("upload_bytes");
+    long long frames = json_counter("capture_frames");
+    json_histogram("http_response_us", &before, &max, buckets);
+
+    s_done = xQueueCreate(WORKERS, sizeof(uintptr_t));
+    for (uintptr_t id = 0; id < WORKERS; ++id) {
+        REQUIRE(audio_tasks_create(&s_workers[id], worker_task, (void *)id, NULL) == ESP_OK);
+    }
+    for (int i = 0; i < WORKERS; ++i) {
+        uintptr_t id;
+        REQUIRE(xQueueReceive(s_done, &id, pdMS_TO_TICKS(10000)) == pdTRUE);
+    }
+
+    unsigned long count;
+    REQUIRE(dump());
+    CHECK_EQ(json_counter("upload_bytes") - bytes, 3LL * WORKERS * UPDATES);
+    CHECK_EQ(json_counter("capture_frames") - frames, (long long)WORKERS * UPDATES);
+    size_t n = json_histogram("http_response_us", &count, &max, buckets);
+    CHECK_EQ(count - before, (unsigned long)WORKERS * UPDATES);
+    CHECK_EQ(max, 999 + WORKERS - 1);
+    CHECK_EQ(n, 11);    // 1002 is in [512, 1024)
+    unsigned long sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += buckets[i];
+    }
+    CHECK_EQ(sum, count);
+}
+
+// Bucket 0 holds zeros, bucket i values in [2^(i-1), 2^i), the last one
+// everything above
+static void test_histogram_buckets(void) {
+    const uint32_t values[] = {0, 1, 2, 3, 4, 7, 8, 1000, 1023, 1024, 1u << 30, UINT32_MAX, UINT32_MAX};
+    const unsigned long expected[AUDIO_METRICS_BUCKETS] = {
+        [0] = 1, [1] = 1, [2] = 2, [3] = 2, [4] = 1, [10] = 2, [11] = 1, [31] = 3,
+    };
+    unsigned long count;
+    unsigned long max;
+    unsigned long buckets[AUDIO_METRICS_BUCKETS];
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        audio_metrics_record(AUDIO_METRIC_STREAM_START_US, values[i]);
+    }
+    REQUIRE(dump());
+    CHECK_EQ(json_histogram("stream_start_us", &count, &max, buckets), AUDIO_METRICS_BUCKETS);
+    CHECK_EQ(count, sizeof(values) / sizeof(values[0]));
+    CHECK_EQ(max, UINT32_MAX);
+    for (size_t i = 0; i < AUDIO_METRICS_BUCKETS; ++i) {
+        if (buckets[i] != expected[i]) {
+            printf("bucket %zu holds %lu, expected %lu\n", i, buckets[i], expected[i]);
+            CHECK(false);
+        }
+    }
+
+    // Buckets are only written up to the last one in use
+    audio_metrics_record(AUDIO_METRIC_HTTP_CONNECT_US, 5);
+    REQUIRE(dump());
+    CHECK_EQ(json_histogram("http_connect_us", &count, &max, buckets), 4);
+}
+
+// The dump parses, and has every counter and histogram; it still fits with
+// every histogram's buckets all in use, and a buffer too small gives 0
+static void test_json(void) {
+    unsigned long count;
+    unsigned long max;
+    unsigned long buckets[AUDIO_METRICS_BUCKETS];
+
+    for (size_t h = 0; h < AUDIO_METRIC_HISTOGRAM_COUNT; ++h) {
+        for (uint32_t bucket = 0; bucket < AUDIO_METRICS_BUCKETS; ++bucket) {
+            audio_metrics_record(h, bucket == 0 ? 0 : 1u << (bucket - 1));
+        }
+    }
+    REQUIRE(dump());
+    printf("%zu bytes: %s\n", strlen(s_json), s_json);
+    CHECK(json_valid(s_json));
+    for (size_t i = 0; i < AUDIO_METRIC_COUNTER_COUNT; ++i) {
+        CHECK(s_counters[i] != NULL && json_counter(s_counters[i]) >= 0);
+    }
+    for (size_t i = 0; i < AUDIO_METRIC_HISTOGRAM_COUNT; ++i) {
+        CHECK(s_histograms[i] != NULL);
+        CHECK_EQ(json_histogram(s_histograms[i], &count, &max, buckets), AUDIO_METRICS_BUCKETS);
+    }
+    CHECK(strstr(s_json, "\"heap_min_free\":{\"internal\":") != NULL);
+    // Measured: each worker has used some of its stack, and not all of it
+    for (int i = 0; i < WORKERS; ++i) {
+        long long free_bytes = json_counter(s_workers[i].name);
+        CHECK(free_bytes > 0 && free_bytes < 4096);
+    }
+
+    // The parser itself turns down what is not JSON
+    CHECK(!json_valid("{\"a\":1,}"));
+    CHECK(!json_valid("{\"a\":[1 2]}"));
+    CHECK(!json_valid("{\"a\":1}}"));
+
+    size_t len = strlen(s_json);
+    char small[AUDIO_METRICS_JSON_BYTES];
+    CHECK_EQ(audio_metrics_json(small, len), 0);
+    CHECK_EQ(audio_metrics_json(small, len + 1), len);
+}
+
+int main(void) {
+    RUN_TEST(test_concurrent_updates);
+    RUN_TEST(test_histogram_buckets);
+    RUN_TEST(test_json);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <string.h>
+#include "audio_pack12.h"
+#include "test.h"
+
+// The 12-bit kernels against a bit-at-a-time model of the layout: sample i
+// is bits 12i .. 12i + 11 of the buffer, least significant first. Every
+// offset parity, count and stride around the pair and group boundaries.
+
+#define MAX_SAMPLES 256
+
+static uint8_t s_packed[AUDIO_PACK12_BYTES(MAX_SAMPLES)];
+static uint8_t s_model[AUDIO_PACK12_BYTES(MAX_SAMPLES)];
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void model_set(uint8_t *packed, size_t index, int16_t value) {
+    for (size_t bit = 0; bit < 12; ++bit) {
+        size_t at = index * 12 + bit;
+        packed[at / 8] = (uint8_t)((packed[at / 8] & ~(1u << at % 8)) | ((value >> bit) & 1) << at % 8);
+    }
+}
+
+static int16_t model_get(const uint8_t *packed, size_t index) {
+    int16_t value = 0;
+    for (size_t bit = 0; bit < 12; ++bit) {
+        size_t at = index * 12 + bit;
+        value |= (int16_t)((packed[at / 8] >> at % 8 & 1) << bit);
+    }
+    return value;
+}
+
+// Fill both buffers with the same noise, so stray writes show
+static void scramble(uint32_t *random) {
+    for (size_t i = 0; i < sizeof(s_packed); ++i) {
+        s_packed[i] = (uint8_t)next_random(random);
+    }
+    memcpy(s_model, s_packed, sizeof(s_packed));
+}
+
+static void test_layout(void) {
+    const int16_t pair[2] = {0xABC, 0x123};
+    uint8_t packed[3] = {0};
+    int16_t out[2];
+
+    audio_pack12(packed, 0, pair, 2);
+    CHECK_EQ(packed[0], 0xBC);
+    CHECK_EQ(packed[1], 0x3A);
+    CHECK_EQ(packed[2], 0x12);
+    audio_unpack12(packed, 0, out, 2);
+    CHECK_EQ(out[0], 0xABC);
+    CHECK_EQ(out[1], 0x123);
+    CHECK_EQ(AUDIO_PACK12_BYTES(1), 2);
+    CHECK_EQ(AUDIO_PACK12_BYTES(2), 3);
+    CHECK_EQ(AUDIO_PACK12_BYTES(5), 8);
+}
+
+// Packing writes exactly the samples' bits, masked to 12, and unpacking
+// gives them back, from any offset
+static void test_pack_unpack_ranges(void) {
+    int16_t in[MAX_SAMPLES];
+    int16_t out[MAX_SAMPLES];
+    uint32_t random = 7;
+
+    for (size_t offset = 0; offset < 6; ++offset) {
+        for (size_t count = 0; count <= 40; ++count) {
+            scramble(&random);
+            for (size_t i = 0; i < count; ++i) {
+                in[i] = (int16_t)next_random(&random); // High bits set too
+                model_set(s_model, offset + i, in[i]);
+            }
+            audio_pack12(s_packed, offset, in, count);
+            if (memcmp(s_packed, s_model, sizeof(s_packed)) != 0) {
+                printf("pack of %zu from %zu\n", count, offset);
+                CHECK(false);
+            }
+
+            memset(out, 0x55, sizeof(out));
+            audio_unpack12(s_packed, offset, out, count);
+            for (size_t i = 0; i < count; ++i) {
+                CHECK_EQ(out[i], in[i] & 0xFFF);
+            }
+            CHECK_EQ(out[count], 0x5555);
+        }
+    }
+}
+
+// One channel out of interleaved frames: odd strides go sample by sample,
+// even ones stay in one half of each pair, from either half
+static void test_unpack_stride(void) {
+    const size_t strides[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 16};
+    int16_t out[MAX_SAMPLES];
+    uint32_t random = 11;
+
+    scramble(&random);
+    for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); ++s) {
+        size_t stride = strides[s];
+        for (size_t offset = 0; offset < stride + 2; ++offset) {
+            size_t max = (MAX_SAMPLES - offset + stride - 1) / stride;
+            for (size_t count = 0; count <= 33 && count <= max; ++count) {
+                memset(out, 0x55, sizeof(out));
+                audio_unpack12_stride(s_packed, offset, stride, out, count);
+                for (size_t i = 0; i < count; ++i) {
+                    if (out[i] != model_get(s_packed, offset + i * stride)) {
+                        printf("stride %zu from %zu, sample %zu of %zu\n", stride, offset, i, count);
+                        CHECK(false);
+                        break;
+                    }
+                }
+                CHECK_EQ(out[count], 0x5555);
+            }
+        }
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_layout);
+    RUN_TEST(test_pack_unpack_ranges);
+    RUN_TEST(test_unpack_stride);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "audio_ring.h"
+#include "test.h"
+
+// The ring at the depth this binary was built with (CONFIG_AUDIO_RING_BITS)
+
+#if CONFIG_AUDIO_RING_BITS == 8
+#define KEPT_BITS 0xFF0     // The ring keeps the top 8 of 12 bits
+#else
+#define KEPT_BITS 0xFFF
+#endif
+
+#define STRESS_CAPACITY 4096
+#define STRESS_US 1000000      // Long enough for the scheduler to preempt copies halfway
+#define STRESS_MAX_WRITE 700
+#define STRESS_MAX_READ 900
+
+// The reading written at position `pos`: a hash of it, so a sample from the
+// wrong lap or a torn pair shows up
+static int16_t sample_at(uint32_t pos) {
+    return (int16_t)(((pos * 2654435761u) >> 20) & KEPT_BITS);
+}
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+typedef struct {
+    audio_ring_t ring;
+    _Atomic bool done;
+} stress_t;
+
+static void *stress_producer(void *arg) {
+    stress_t *s = arg;
+    int16_t block[STRESS_MAX_WRITE];
+    uint32_t random = 1;
+
+    int64_t end = esp_timer_get_time() + STRESS_US;
+    for (uint32_t pos = 0; esp_timer_get_time() < end;) {
+        size_t count = 1 + next_random(&random) % STRESS_MAX_WRITE;
+        for (size_t i = 0; i < count; ++i) {
+            block[i] = sample_at(pos + i);
+        }
+        audio_ring_write(&s->ring, block, count);
+        pos += count;
+        if (next_random(&random) % 8 == 0) {
+            sched_yield();
+        }
+    }
+    atomic_store(&s->done, true);
+    return NULL;
+}
+
+// A producer and a consumer on their own threads, each going at an uneven
+// pace so the consumer keeps up some of the time and is lapped the rest.
+// Every sample read must be the one written at the cursor's position; the
+// only way to miss samples is a reported skip of the cursor. Threads are
+// switched both where they yield and wherever the scheduler preempts them,
+// including halfway through a copy.
+static void test_spsc_stress(void) {
+    static stress_t s;
+    static uint8_t storage[AUDIO_RING_STORAGE_BYTES(STRESS_CAPACITY)];
+    int16_t out[STRESS_MAX_READ];
+    uint32_t random = 7;
+    uint64_t exact = 0;
+    uint64_t skipped = 0;
+    uint32_t skips = 0;
+    uint32_t wrong = 0;
+
+    REQUIRE(audio_ring_init(&s.ring, storage, STRESS_CAPACITY) == ESP_OK);
+    atomic_store(&s.done, false);
+    audio_ring_cursor_t cursor = audio_ring_cursor_live(&s.ring);
+    pthread_t producer;
+    REQUIRE(pthread_create(&producer, NULL, stress_producer, &s) == 0);
+
+    while (1) {
+        bool done = atomic_load(&s.done);
+        uint32_t expected = cursor.pos;
+        size_t got = audio_ring_read(&s.ring, &cursor, out, 1 + next_random(&random) % STRESS_MAX_READ);
+        uint32_t start = cursor.pos - got;
+        if (start != expected) {
+            CHECK(start - expected < 0x80000000u); // Only ever forwards
+            skipped += start - expected;
+            skips++;
+        }
+        for (size_t i = 0; i < got; ++i) {
+            if (out[i] != sample_at(start + i) && wrong++ < 10) {
+                printf("sample %lu is %d, expected %d\n", (unsigned long)(start + i), out[i],
+                       sample_at(start + i));
+            }
+        }
+        exact += got;
+        if (got == 0 && done) {
+            break;
+        }
+        if (next_random(&random) % 16 == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+
+    printf("%llu samples read exactly, %llu skipped in %lu overruns\n", (unsigned long long)exact,
+           (unsigned long long)skipped, (unsigned long)skips);
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(exact + skipped, audio_ring_head(&s.ring));
+    CHECK_EQ(cursor.pos, audio_ring_head(&s.ring));
+    CHECK(exact > 0);
+}
+
+static audio_ring_t s_interrupt_ring;
+static uint32_t s_interrupt_pos;
+static uint32_t s_interrupt_random = 3;
+
+static void interrupt_write(int signal) {
+    int16_t block[STRESS_MAX_WRITE];
+    size_t count = 1 + next_random(&s_interrupt_random) % STRESS_MAX_WRITE;
+    for (size_t i = 0; i < count; ++i) {
+        block[i] = sample_at(s_interrupt_pos + i);
+    }
+    audio_ring_write(&s_interrupt_ring, block, count);
+    s_interrupt_pos += count;
+}
+
+// The producer as an interrupt: a timer signal writes a block wherever the
+// reader happens to be, often halfway through copying the samples being
+// overwritten. Such reads must be retried or skipped, never returned.
+static void test_reader_interrupted_by_producer(void) {
+    static uint8_t storage[AUDIO_RING_STORAGE_BYTES(STRESS_CAPACITY)];
+    int16_t out[STRESS_MAX_READ];
+    uint32_t random = 11;
+    uint64_t exact = 0;
+    uint64_t skipped = 0;
+    uint32_t wrong = 0;
+
+    REQUIRE(audio_ring_init(&s_interrupt_ring, storage, STRESS_CAPACITY) == ESP_OK);
+    audio_ring_cursor_t cursor = audio_ring_cursor_live(&s_interrupt_ring);
+    struct sigaction action = {.sa_handler = interrupt_write};
+    sigaction(SIGALRM, &action, NULL);
+    struct itimerval period = {.it_interval = {.tv_usec = 20}, .it_value = {.tv_usec = 20}};
+    setitimer(ITIMER_REAL, &period, NULL);
+
+    int64_t end = esp_timer_get_time() + STRESS_US;
+    while (esp_timer_get_time() < end) {
+        // Half the time start again at the oldest sample, as a snapshot of
+        // the whole ring does: that is where the producer overwrites
+        if (next_random(&random) % 2 == 0) {
+            cursor = audio_ring_cursor_last(&s_interrupt_ring, STRESS_CAPACITY);
+        }
+        uint32_t expected = cursor.pos;
+        size_t got = audio_ring_read(&s_interrupt_ring, &cursor, out, 1 + next_random(&random) % STRESS_MAX_READ);
+        uint32_t start = cursor.pos - got;
+        skipped += start - expected;
+        for (size_t i = 0; i < got; ++i) {
+            if (out[i] != sample_at(start + i) && wrong++ < 10) {
+                printf("sample %lu is %d, expected %d\n", (unsigned long)(start + i), out[i],
+                       sample_at(start + i));
+            }
+        }
+        exact += got;
+    }
+    struct itimerval off = {0};
+    setitimer(ITIMER_REAL, &off, NULL);
+    signal(SIGALRM, SIG_DFL);
+
+    printf("%llu samples read exactly, %llu skipped, %lu written\n", (unsigned long long)exact,
+           (unsigned long long)skipped, (unsigned long)s_interrupt_pos);
+    CHECK_EQ(wrong, 0);
+    CHECK(exact > 0);
+    CHECK(skipped > 0);
+}
+
+// A cursor that falls more than the capacity behind skips to the oldest
+// kept sample, and counts it
+static void test_lapped_cursor_skips_to_oldest(void) {
+    static uint8_t storage[AUDIO_RING_STORAGE_BYTES(256)];
+    audio_ring_t ring;
+    int16_t block[1000];
+    int16_t out[256];
+
+    REQUIRE(audio_ring_init(&ring, storage, 256) == ESP_OK);
+    audio_ring_cursor_t cursor = audio_ring_cursor_live(&ring);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        block[i] = sample_at(i);
+    }
+    audio_ring_write(&ring, block, 1000);
+
+    CHECK_EQ(audio_ring_available(&ring, &cursor), 256);
+    size_t got = audio_ring_read(&ring, &cursor, out, 256);
+    CHECK_EQ(got, 256);
+    CHECK_EQ(cursor.pos, 1000);
+    for (size_t i = 0; i < got; ++i) {
+        CHECK_EQ(out[i], sample_at(1000 - 256 + i));
+    }
+    CHECK_EQ(audio_ring_read(&ring, &cursor, out, 256), 0);
+}
+
+#define STAGED_CAPACITY 1024
+#define STAGED_MAX_WRITE 700    // Over AUDIO_RING_STAGE_SAMPLES, so copies take several stages
+
+// The staged path (as for PSRAM storage) against the direct one on two
+// rings fed the same frames: storage must end up byte for byte the same,
+// and reads and channel views from every alignment must return the same
+// samples, across the wrap and partial stages at either edge
+static void test_staged_matches_direct(void) {
+    static uint8_t direct_storage[AUDIO_RING_STORAGE_BYTES(STAGED_CAPACITY)];
+    static uint8_t staged_storage[AUDIO_RING_STORAGE_BYTES(STAGED_CAPACITY)];
+    int16_t block[STAGED_MAX_WRITE];
+    int16_t direct_out[STAGED_CAPACITY];
+    int16_t staged_out[STAGED_CAPACITY];
+    uint32_t random = 5;
+    uint32_t compared = 0;
+
+    for (size_t channels = 1; channels <= 8; channels *= 2) {
+        audio_ring_t direct;
+        audio_ring_t staged;
+        memset(direct_storage, 0, sizeof(direct_storage));
+        memset(staged_storage, 0, sizeof(staged_storage));
+        REQUIRE(audio_ring_init(&direct, direct_storage, STAGED_CAPACITY) == ESP_OK);
+        REQUIRE(audio_ring_init(&staged, staged_storage, STAGED_CAPACITY) == ESP_OK);
+        CHECK(!direct.staged);
+        staged.staged = true;
+
+        for (int round = 0; round < 300; ++round) {
+            size_t count = (1 + next_random(&random) % (STAGED_MAX_WRITE / channels)) * channels;
+            uint32_t head = audio_ring_head(&direct);
+            for (size_t i = 0; i < count; ++i) {
+                block[i] = sample_at(head + i);
+            }
+            audio_ring_write(&direct, block, count);
+            audio_ring_write(&staged, block, count);
+            if (memcmp(direct_storage, staged_storage, sizeof(direct_storage)) != 0) {
+                printf("%zu channels: storage differs after writing %zu at %lu\n", channels, count,
+                       (unsigned long)head);
+                CHECK(false);
+                break;
+            }
+
+            // From any frame in the ring, as one stream and as each channel
+            uint32_t kept = audio_ring_head(&direct) < STAGED_CAPACITY ? audio_ring_head(&direct) : STAGED_CAPACITY;
+            uint32_t back = (next_random(&random) % (kept / channels + 1)) * channels;
+            audio_ring_cursor_t from = {.pos = audio_ring_head(&direct) - back};
+            size_t max = 1 + next_random(&random) % STAGED_CAPACITY;
+            audio_ring_cursor_t a = from;
+            audio_ring_cursor_t b = from;
+            size_t got = audio_ring_read(&direct, &a, direct_out, max);
+            CHECK_EQ(audio_ring_read(&staged, &b, staged_out, max), got);
+            CHECK_EQ(b.pos, a.pos);
+            CHECK(memcmp(direct_out, staged_out, got * sizeof(int16_t)) == 0);
+            for (uint8_t channel = 0; channel < channels; ++channel) {
+                audio_ring_view_t direct_view = {.ring = &direct, .channels = channels, .channel = channel};
+                audio_ring_view_t staged_view = {.ring = &staged, .channels = channels, .channel = channel};
+                a = from;
+                b = from;
+                got = audio_ring_view_read(&direct_view, &a, direct_out, max / channels + 1);
+                CHECK_EQ(audio_ring_view_read(&staged_view, &b, staged_out, max / channels + 1), got);
+                CHECK_EQ(b.pos, a.pos);
+                CHECK(memcmp(direct_out, staged_out, got * sizeof(int16_t)) == 0);
+                compared += got;
+            }
+        }
+    }
+    printf("%lu view samples compared\n", (unsigned long)compared);
+}
+
+// Each view of a ring of interleaved frames reads its own channel, from
+// any frame, across the wrap and in reads of any size; a lapped view
+// cursor skips to the oldest whole frame
+static void test_views_deinterleave(void) {
+    static uint8_t storage[AUDIO_RING_STORAGE_BYTES(STAGED_CAPACITY)];
+    int16_t block[STAGED_MAX_WRITE];
+    int16_t out[STAGED_CAPACITY];
+    uint32_t random = 9;
+
+    for (size_t channels = 1; channels <= 8; channels *= 2) {
+        audio_ring_t ring;
+        REQUIRE(audio_ring_init(&ring, storage, STAGED_CAPACITY) == ESP_OK);
+        uint32_t wrong = 0;
+
+        for (int round = 0; round < 200; ++round) {
+            size_t count = (1 + next_random(&random) % (STAGED_MAX_WRITE / channels)) * channels;
+            uint32_t head = audio_ring_head(&ring);
+            for (size_t i = 0; i < count; ++i) {
+                block[i] = sample_at(head + i);
+            }
+            audio_ring_write(&ring, block, count);
+            head += count;
+
+            uint32_t kept = head < STAGED_CAPACITY ? head : STAGED_CAPACITY;
+            uint32_t back = (next_random(&random) % (kept / channels + 1)) * channels;
+            for (uint8_t channel = 0; channel < channels; ++channel) {
+                audio_ring_view_t view = {.ring = &ring, .channels = channels, .channel = channel};
+                audio_ring_cursor_t cursor = {.pos = head - back};
+                size_t frames = 0;
+
+                // In pieces of up to a few frames, to the newest
+                while (1) {
+                    uint32_t from = cursor.pos;
+                    size_t got = audio_ring_view_read(&view, &cursor, out, 1 + next_random(&random) % 7);
+                    if (got == 0) {
+                        break;
+                    }
+                    CHECK_EQ(cursor.pos - from, got * channels);
+                    for (size_t i = 0; i < got; ++i) {
+                        if (out[i] != sample_at(from + i * channels + channel) && wrong++ < 5) {
+                            printf("%zu channels: channel %u of frame at %lu is %d, expected %d\n", channels,
+                                   channel, (unsigned long)(from + i * channels), out[i],
+                                   sample_at(from + i * channels + channel));
+                        }
+                    }
+                    frames += got;
+                }
+                CHECK_EQ(frames, back / channels);
+                CHECK_EQ(cursor.pos, head);
+            }
+        }
+        CHECK_EQ(wrong, 0);
+
+        // Lapped: the view skips to the oldest frame kept, channel intact
+        audio_ring_view_t view = {.ring = &ring, .channels = channels, .channel = channels - 1};
+        audio_ring_cursor_t cursor = audio_ring_cursor_live(&ring);
+        for (int i = 0; i < 3; ++i) {
+            uint32_t head = audio_ring_head(&ring);
+            for (size_t j = 0; j < STAGED_MAX_WRITE / channels * channels; ++j) {
+                block[j] = sample_at(head + j);
+            }
+            audio_ring_write(&ring, block, STAGED_MAX_WRITE / channels * channels);
+        }
+        uint32_t head = audio_ring_head(&ring);
+        size_t got = audio_ring_view_read(&view, &cursor, out, STAGED_CAPACITY);
+        CHECK_EQ(got, STAGED_CAPACITY / channels);
+        CHECK_EQ(cursor.pos, head);
+        uint32_t oldest = head - STAGED_CAPACITY;
+        CHECK_EQ(oldest % channels, 0);
+        for (size_t i = 0; i < got; ++i) {
+            CHECK_EQ(out[i], sample_at(oldest + i * channels + channels - 1));
+        }
+    }
+}
+
+int main(void) {
+    printf("ring depth %d bits\n", CONFIG_AUDIO_RING_BITS);
+    RUN_TEST(test_lapped_cursor_skips_to_oldest);
+    RUN_TEST(test_staged_matches_direct);
+    RUN_TEST(test_views_deinterleave);
+    RUN_TEST(test_spsc_stress);
+    RUN_TEST(test_reader_interrupted_by_producer);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,138 @@
+#include <string.h>
+#include "audio_upload.h"
+#include "upload_server.h"
+#include "test.h"
+
+// Upload sessions against the stand-in server: the connection is opened
+// once and kept for later clips, reopened when the server closes it (said
+// or not), and each upload reports the connection it paid for. The host
+// client has no TLS, so session resumption is left to the target.
+
+#define CLIP_SAMPLES 2000
+#define CLIPS 5
+#define LATENCY_MS 20
+
+static int16_t s_clip[CLIP_SAMPLES];
+static upload_server_t s_server;
+
+static const audio_upload_config_t s_json = {
+    .url = "http://upload.test/clips",
+    .format = AUDIO_UPLOAD_JSON_BASE64,
+    .codec = AUDIO_CODEC_PCM16,
+    .sample_rate = 16000,
+    .channels = 1,
+};
+
+static const audio_upload_config_t s_wav = {
+    .url = "http://upload.test/clips",
+    .format = AUDIO_UPLOAD_WAV,
+    .codec = AUDIO_CODEC_ULAW,
+    .sample_rate = 16000,
+    .channels = 1,
+};
+
+// Send CLIPS clips on one session and return the stats of each
+static void send_clips(const audio_upload_config_t *config, const host_http_config_t *network,
+                       audio_upload_stats_t stats[CLIPS]) {
+    audio_upload_source_t source = {.read = audio_upload_read_buffer, .ctx = s_clip, .samples = CLIP_SAMPLES};
+    audio_upload_session_t session;
+
+    upload_server_start(&s_server, network);
+    REQUIRE(audio_upload_session_open(config, &session) == ESP_OK);
+    for (int i = 0; i < CLIPS; ++i) {
+        CHECK_EQ(audio_upload_session_send(session, &source, &stats[i]), ESP_OK);
+    }
+    audio_upload_session_close(session);
+    CHECK_EQ(upload_server_finished(&s_server, &(const upload_server_upload_t *){NULL}, 1), 1);
+    CHECK_EQ(s_server.upload_count, CLIPS);
+}
+
+// One connection for all the clips; only the first upload pays for it
+static void test_keep_alive(void) {
+    const audio_upload_config_t *configs[] = {&s_json, &s_wav};
+    host_http_config_t network = {.latency_ms = LATENCY_MS};
+
+    for (size_t c = 0; c < 2; ++c) {
+        audio_upload_stats_t stats[CLIPS];
+        host_http_stats_t http;
+
+        send_clips(configs[c], &network, stats);
+        host_http_stats(&http);
+        CHECK_EQ(http.connections, 1);
+        CHECK_EQ(http.requests, CLIPS);
+        for (int i = 0; i < CLIPS; ++i) {
+            CHECK_EQ(stats[i].connections, i == 0);
+            CHECK_EQ(stats[i].attempts, 1);
+            if (i > 0) {
+                CHECK_EQ(stats[i].connect_us, 0);
+            }
+            CHECK(stats[i].response_us >= LATENCY_MS * 1000);
+            CHECK(stats[i].elapsed_us >= stats[i].connect_us + stats[i].transfer_us + stats[i].response_us);
+        }
+    }
+}
+
+// One-off uploads connect every time
+static void test_one_off_reconnects(void) {
+    audio_upload_source_t source = {.read = audio_upload_read_buffer, .ctx = s_clip, .samples = CLIP_SAMPLES};
+    host_http_stats_t http;
+
+    upload_server_start(&s_server, NULL);
+    for (int i = 0; i < CLIPS; ++i) {
+        audio_upload_stats_t stats;
+        CHECK_EQ(audio_upload_stream(&s_json, &source, &stats), ESP_OK);
+        CHECK_EQ(stats.connections, 1);
+    }
+    host_http_stats(&http);
+    CHECK_EQ(http.connections, CLIPS);
+}
+
+// "Connection: close" after every response: the client closes too and
+// the next clip opens a fresh connection without a failed attempt
+static void test_server_says_close(void) {
+    host_http_config_t network = {.close_connections = true};
+    audio_upload_stats_t stats[CLIPS];
+    host_http_stats_t http;
+
+    send_clips(&s_json, &network, stats);
+    host_http_stats(&http);
+    CHECK_EQ(http.connections, CLIPS);
+    CHECK_EQ(http.requests, CLIPS);
+    for (int i = 0; i < CLIPS; ++i) {
+        CHECK_EQ(stats[i].connections, 1);
+        CHECK_EQ(stats[i].attempts, 1);
+    }
+}
+
+// The server drops the idle connection without a word: the next clip finds
+// out on the reused connection, reconnects once and goes through
+static void test_server_closes_silently(void) {
+    const audio_upload_config_t *configs[] = {&s_json, &s_wav};
+    host_http_config_t network = {.close_silently = true};
+
+    for (size_t c = 0; c < 2; ++c) {
+        audio_upload_stats_t stats[CLIPS];
+        host_http_stats_t http;
+
+        send_clips(configs[c], &network, stats);
+        host_http_stats(&http);
+        CHECK_EQ(http.connections, CLIPS);
+        for (int i = 0; i < CLIPS; ++i) {
+            CHECK_EQ(stats[i].connections, 1);
+            CHECK_EQ(stats[i].attempts, i == 0 ? 1 : 2);
+            CHECK_EQ(stats[i].status_code, configs[c] == &s_wav ? 201 : 200);
+        }
+    }
+}
+
+int main(void) {
+    for (size_t i = 0; i < CLIP_SAMPLES; ++i) {
+        s_clip[i] = (int16_t)((i * 37) & 0xFFF);
+    }
+    RUN_TEST(test_keep_alive);
+    RUN_TEST(test_one_off_reconnects);
+    RUN_TEST(test_server_says_close);
+    RUN_TEST(test_server_closes_silently);
+    upload_server_free(&s_server);
+    return TEST_EXIT_CODE();
+}
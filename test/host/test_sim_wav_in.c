@@ -0,0 +1,85 @@
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "audio_hal.h"
+#include "test.h"
+
+// The simulation HAL given an input WAV whose data chunk comes before its
+// fmt chunk: with no channel count to go on it must refuse the file and feed
+// silence, not read frames of zero channels. The input is chosen once per
+// process, hence a test of its own.
+
+#define RATE 8000
+#define FRAME 64
+#define SILENCE 2048    // ADC reading of PCM 0
+
+static int16_t s_frame[FRAME];
+static volatile size_t s_frames;
+
+static bool on_samples(const int16_t *samples, size_t count, void *ctx) {
+    if (s_frames == 0) {
+        memcpy(s_frame, samples, sizeof(s_frame));
+    }
+    s_frames++;
+    return false;
+}
+
+static void put_u32(FILE *out, uint32_t value) {
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+// 16-bit mono PCM of full-scale samples, chunks in the wrong order
+static void write_data_first(const char *path) {
+    const uint8_t fmt[16] = {1, 0, 1, 0, RATE & 0xFF, RATE >> 8, 0, 0, (RATE * 2) & 0xFF, (RATE * 2) >> 8, 0, 0,
+                             2, 0, 16, 0};
+    int16_t pcm[FRAME * 4];
+    FILE *out = fopen(path, "wb");
+
+    for (size_t i = 0; i < FRAME * 4; ++i) {
+        pcm[i] = 32767;
+    }
+    fwrite("RIFF", 1, 4, out);
+    put_u32(out, 4 + 8 + sizeof(pcm) + 8 + sizeof(fmt));
+    fwrite("WAVEdata", 1, 8, out);
+    put_u32(out, sizeof(pcm));
+    fwrite(pcm, 1, sizeof(pcm), out);
+    fwrite("fmt ", 1, 4, out);
+    put_u32(out, sizeof(fmt));
+    fwrite(fmt, 1, sizeof(fmt), out);
+    fclose(out);
+}
+
+static void test_data_before_fmt_is_silence(void) {
+    audio_hal_adc_config_t config = {
+        .sample_rate = RATE,
+        .channels = {0},
+        .channel_count = 1,
+        .frame_samples = FRAME,
+        .on_samples = on_samples,
+    };
+
+    REQUIRE(audio_hal_adc_init(&config) == ESP_OK);
+    REQUIRE(audio_hal_adc_start() == ESP_OK);
+    for (int waited = 0; waited < 1000 && s_frames < 2; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    REQUIRE(audio_hal_adc_stop() == ESP_OK);
+    CHECK(s_frames >= 2);
+    for (size_t i = 0; i < FRAME; ++i) {
+        CHECK_EQ(s_frame[i], SILENCE);
+    }
+}
+
+int main(void) {
+    char path[] = "/tmp/test_sim_wav_in_XXXXXX.wav";
+    close(mkstemps(path, 4));
+    write_data_first(path);
+    setenv("AUDIO_SIM_WAV_IN", path, 1);
+    setenv("AUDIO_SIM_SPEED", "1", 1);
+
+    RUN_TEST(test_data_before_fmt_is_silence);
+    remove(path);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,233 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_http.h"
+#include "audio_wav.h"
+#include "audio_playback.h"
+#include "audio_stream.h"
+#include "test.h"
+
+// Streamed playback through the jitter buffer against a stand-in file
+// server that is slower than the audio, that ignores Range, or both. The
+// DAC output is written to a WAV (AUDIO_SIM_WAV_OUT) and every stream must
+// come out whole: each sample once and in order, whatever the server did.
+
+#define RATE 16000
+#define FRAME 256
+#define CLIP_SAMPLES 24000                  // 1.5 s
+#define CLIP_BYTES (CLIP_SAMPLES * 2)       // PCM16 mono: 32000 bytes per second
+
+typedef struct {
+    bool ignore_range;      // Answer 200 with the whole file
+    uint32_t gets;
+    uint32_t ranged_gets;
+} file_server_t;
+
+static uint8_t s_file[AUDIO_WAV_HEADER_MAX + CLIP_BYTES];
+static size_t s_file_len;
+static uint8_t s_levels[CLIP_SAMPLES];      // What the DAC should play
+static file_server_t s_server;
+static char s_out_path[] = "/tmp/test_stream_XXXXXX.wav";
+static long s_out_len;                      // Output WAV bytes checked so far
+
+// As stream_task in main/freeRTOSImp.c
+static const audio_task_config_t s_task = {
+    .name = "stream",
+    .stack = 6144,
+    .priority = 5,
+    .core = AUDIO_TASKS_CORE_NETWORK,
+};
+
+// A DAC level per sample, from a hash of its position so a sample that is
+// repeated, skipped or out of order shows; the low byte of each sample is
+// noise below the DAC's 8 bits
+static void make_file(void) {
+    s_file_len = audio_wav_header(s_file, AUDIO_CODEC_PCM16, RATE, 1, CLIP_BYTES);
+    for (uint32_t i = 0; i < CLIP_SAMPLES; ++i) {
+        uint32_t h = i * 2654435761u;
+        s_levels[i] = h >> 24;
+        int16_t sample = (int16_t)((s_levels[i] - 128) * 256 + (h >> 8 & 0xFF));
+        s_file[s_file_len++] = (uint8_t)sample;
+        s_file[s_file_len++] = (uint8_t)(sample >> 8);
+    }
+}
+
+static void file_server_handle(void *ctx, const host_http_request_t *request, host_http_response_t *response) {
+    static char content_range[80];
+    file_server_t *server = ctx;
+    const char *range = host_http_request_header(request, "Range");
+    unsigned long long first;
+    unsigned long long last;
+
+    server->gets++;
+    if (server->ignore_range || range == NULL || sscanf(range, "bytes=%llu-%llu", &first, &last) != 2) {
+        response->status = 200;
+        response->body = s_file;
+        response->body_len = s_file_len;
+        return;
+    }
+    server->ranged_gets++;
+    if (first >= s_file_len) {
+        response->status = 416;
+        return;
+    }
+    if (last >= s_file_len) {
+        last = s_file_len - 1;
+    }
+    snprintf(content_range, sizeof(content_range), "bytes %llu-%llu/%zu", first, last, s_file_len);
+    response->status = 206;
+    response->headers[response->header_count++] = (host_http_header_t){"Content-Range", content_range};
+    response->body = s_file + first;
+    response->body_len = last - first + 1;
+}
+
+// Stream the file through `network` and check that the DAC played it all
+static esp_err_t play(const host_http_config_t *network, bool ignore_range, audio_stream_stats_t *stats) {
+    s_server = (file_server_t){.ignore_range = ignore_range};
+    host_http_serve(file_server_handle, &s_server, network);
+    esp_err_t err = audio_stream_play("http://files.test/clip.wav", stats);
+
+    // Drained, so the output WAV holds this stream
+    static int16_t out[CLIP_SAMPLES + 1];
+    FILE *file = fopen(s_out_path, "rb");
+    if (file == NULL || fseek(file, s_out_len, SEEK_SET) != 0) {
+        printf("cannot read %s\n", s_out_path);
+        CHECK(false);
+        return err;
+    }
+    size_t played = fread(out, sizeof(int16_t), CLIP_SAMPLES + 1, file);
+    fclose(file);
+    s_out_len += played * sizeof(int16_t);
+    CHECK_EQ(played, CLIP_SAMPLES);
+    CHECK_EQ(stats->samples, CLIP_SAMPLES);
+    for (size_t i = 0; i < played && i < CLIP_SAMPLES; ++i) {
+        if (out[i] != (s_levels[i] - 128) * 256) {
+            printf("sample %zu of %zu is not the file's\n", i, played);
+            CHECK(false);
+            break;
+        }
+    }
+    printf("%lu GETs (%lu ranged), %llu bytes, started in %lld ms, %lu rebuffers, prefetch %lu, slowest %lld ms\n",
+           (unsigned long)stats->requests, (unsigned long)s_server.ranged_gets, (unsigned long long)stats->bytes,
+           (long long)(stats->start_us / 1000), (unsigned long)stats->rebuffers,
+           (unsigned long)stats->prefetch_samples, (long long)(stats->max_response_us / 1000));
+    return err;
+}
+
+// A fast server: ranged GETs of the first chunk size, no pauses
+static void test_fast_server(void) {
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(NULL, false, &stats), ESP_OK);
+    CHECK_EQ(stats.requests, (s_file_len + AUDIO_STREAM_CHUNK_BYTES - 1) / AUDIO_STREAM_CHUNK_BYTES);
+    CHECK_EQ(s_server.ranged_gets, stats.requests);
+    CHECK_EQ(stats.bytes, s_file_len);
+    CHECK_EQ(stats.rebuffers, 0);
+    CHECK_EQ(stats.underruns, 0);
+    CHECK_EQ(stats.source_rate, RATE);
+}
+
+// Bodies arrive at 3/4 of the playing rate: the buffer runs dry, each
+// pause waits for a deeper prefetch, and nothing is lost or played twice
+static void test_slow_bandwidth(void) {
+    host_http_config_t network = {.bytes_per_second = RATE * 2 * 3 / 4};
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(&network, false, &stats), ESP_OK);
+    CHECK(stats.rebuffers > 0);
+    CHECK(stats.prefetch_samples > RATE * AUDIO_STREAM_START_MS / 1000);
+    CHECK_EQ(stats.bytes, s_file_len);
+}
+
+// Slow responses: output waits for the first one, chunks grow so fewer
+// responses are waited for, and the prefetch covers twice the slowest
+static void test_slow_responses(void) {
+    const uint32_t latency_ms = 150;
+    host_http_config_t network = {.latency_ms = latency_ms};
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(&network, false, &stats), ESP_OK);
+    CHECK(stats.start_us >= latency_ms * 1000);
+    CHECK(stats.max_response_us >= latency_ms * 1000);
+    CHECK(stats.requests < (s_file_len + AUDIO_STREAM_CHUNK_BYTES - 1) / AUDIO_STREAM_CHUNK_BYTES);
+    if (stats.rebuffers > 0) {
+        CHECK(stats.prefetch_samples >= stats.max_response_us * 2 * RATE / 1000000);
+    }
+}
+
+// The server answers every GET with the whole file: one request reads it
+static void test_range_ignored(void) {
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(NULL, true, &stats), ESP_OK);
+    CHECK_EQ(stats.requests, 1);
+    CHECK_EQ(s_server.ranged_gets, 0);
+    CHECK_EQ(stats.bytes, s_file_len);
+    CHECK_EQ(stats.rebuffers, 0);
+}
+
+// Range ignored and the connection broken partway: the retry gets the
+// whole file again, and the part already played is skipped, not replayed
+static void test_range_ignored_broken(void) {
+    host_http_config_t network = {.drop_response_after = CLIP_BYTES / 3, .drops = 1};
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(&network, true, &stats), ESP_OK);
+    CHECK_EQ(stats.requests, 2);
+    CHECK_EQ(stats.bytes, s_file_len + CLIP_BYTES / 3);
+}
+
+// Slow and ignoring Range: one long response played as it arrives
+static void test_range_ignored_slow(void) {
+    host_http_config_t network = {.latency_ms = 100, .bytes_per_second = RATE * 2 * 3 / 4};
+    audio_stream_stats_t stats;
+
+    CHECK_EQ(play(&network, true, &stats), ESP_OK);
+    CHECK_EQ(stats.requests, 1);
+    CHECK(stats.rebuffers > 0);
+    CHECK(stats.start_us >= 100 * 1000);
+}
+
+// After every kind of fetch above, the fetch task has not gone past its stack
+static void test_stack_high_water(void) {
+    const char *name;
+    uint32_t min_free = 0;
+    for (size_t i = 0; audio_tasks_stack_info(i, &name, &min_free); ++i) {
+        if (strcmp(name, s_task.name) == 0) {
+            break;
+        }
+    }
+    printf("stream task used %lu of %lu stack bytes\n", (unsigned long)(s_task.stack - min_free),
+           (unsigned long)s_task.stack);
+    CHECK(min_free > 0);
+}
+
+int main(void) {
+    close(mkstemps(s_out_path, 4));
+    setenv("AUDIO_SIM_WAV_OUT", s_out_path, 1);
+    setenv("AUDIO_SIM_SPEED", "1", 1);
+    make_file();
+
+    audio_stream_config_t config = {
+        .playback = {.sample_rate = RATE, .frame_samples = FRAME, .channels = 1},
+        .task = s_task,
+    };
+    if (audio_playback_init(&config.playback) != ESP_OK || audio_stream_init(&config) != ESP_OK) {
+        return 1;
+    }
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+    s_out_len = audio_wav_header(header, AUDIO_CODEC_PCM16, RATE, 1, 0);
+
+    RUN_TEST(test_fast_server);
+    RUN_TEST(test_slow_bandwidth);
+    RUN_TEST(test_slow_responses);
+    RUN_TEST(test_range_ignored);
+    RUN_TEST(test_range_ignored_broken);
+    RUN_TEST(test_range_ignored_slow);
+    RUN_TEST(test_stack_high_water);
+    unlink(s_out_path);
+    return TEST_EXIT_CODE();
+}
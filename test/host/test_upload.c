@@ -0,0 +1,345 @@
+#include <string.h>
+#include "audio_codec.h"
+#include "audio_ring.h"
+#include "audio_upload.h"
+#include "audio_wav.h"
+#include "host_heap.h"
+#include "upload_server.h"
+#include "test.h"
+
+// Clips streamed from the ring to the stand-in server: JSON bodies that
+// decode to the clip in its codec, WAV uploads that lose their connection
+// partway through the body and resume from where the server says it is,
+// and the heap an upload needs, which does not grow with the clip
+
+#define RATE 16000
+#define CLIP_SAMPLES 5000       // Not a multiple of the frame, so the last frame is short
+#define LONG_SECONDS 64         // Longest clip of test_memory_flat
+#define RING_CAPACITY (1u << 20)
+
+static uint8_t s_ring_storage[AUDIO_RING_STORAGE_BYTES(RING_CAPACITY)];
+static audio_ring_t s_ring;
+static audio_ring_cursor_t s_clip;      // The last CLIP_SAMPLES written
+static upload_server_t s_server;
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// ADC readings with no pattern, so a sample or byte resent at the wrong
+// place changes the file
+static void fill_ring(void) {
+    static int16_t block[RATE];
+    uint32_t random = 17;
+
+    REQUIRE(audio_ring_init(&s_ring, s_ring_storage, RING_CAPACITY) == ESP_OK);
+    for (uint32_t second = 0; second < LONG_SECONDS; ++second) {
+        for (size_t i = 0; i < RATE; ++i) {
+            block[i] = (int16_t)(next_random(&random) & 0xFFF);
+        }
+        audio_ring_write(&s_ring, block, RATE);
+    }
+    s_clip = audio_ring_cursor_last(&s_ring, CLIP_SAMPLES);
+}
+
+// `count` ring samples from `pos`, read back at whatever depth the ring keeps
+static void ring_samples(uint32_t pos, int16_t *out, size_t count) {
+    audio_ring_cursor_t cursor = {.pos = pos};
+    REQUIRE(audio_ring_read(&s_ring, &cursor, out, count) == count);
+}
+
+// Upload `samples` of the ring from `cursor`
+static size_t read_ring(void *ctx, size_t offset, int16_t *out, size_t count) {
+    ring_samples(*(const uint32_t *)ctx + offset, out, count);
+    return count;
+}
+
+static esp_err_t stream(const audio_upload_config_t *config, audio_ring_cursor_t cursor, size_t samples,
+                        audio_upload_stats_t *stats) {
+    audio_upload_source_t source = {.read = read_ring, .ctx = &cursor.pos, .samples = samples};
+    return audio_upload_stream(config, &source, stats);
+}
+
+// The bytes an upload should carry: the ring's samples from `pos`, coded a
+// frame at a time as the upload codes them. JSON PCM16 sends the ADC
+// readings as they are; everything else is coded from signed PCM.
+static size_t expected_raw(audio_codec_t codec, bool wav, uint32_t pos, size_t samples, uint8_t *out) {
+    int16_t frame[AUDIO_UPLOAD_FRAME_SAMPLES];
+    audio_codec_state_t state = {0};
+    size_t len = 0;
+
+    for (size_t done = 0; done < samples;) {
+        size_t count = samples - done < AUDIO_UPLOAD_FRAME_SAMPLES ? samples - done : AUDIO_UPLOAD_FRAME_SAMPLES;
+        ring_samples(pos + done, frame, count);
+        if (codec == AUDIO_CODEC_PCM16 && !wav) {
+            memcpy(out + len, frame, count * sizeof(int16_t));
+            len += count * sizeof(int16_t);
+        } else {
+            audio_codec_adc_to_pcm(frame, count);
+            len += audio_codec_encode(codec, &state, frame, count, out + len);
+        }
+        done += count;
+    }
+    return len;
+}
+
+// The file a perfect WAV upload of the clip would produce
+static size_t expected_wav(audio_codec_t codec, uint16_t channels, uint8_t *out) {
+    size_t data_bytes = audio_codec_frame_bytes(codec, CLIP_SAMPLES);
+    size_t len = audio_wav_header(out, codec, RATE, channels, data_bytes);
+    return len + expected_raw(codec, true, s_clip.pos, CLIP_SAMPLES, out + len);
+}
+
+static int base64_value(uint8_t c) {
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const char *at = c != '\0' ? strchr(alphabet, c) : NULL;
+    return at != NULL ? (int)(at - alphabet) : -1;
+}
+
+// Whether the upload is {"audio":"<base64>"} of the `samples` ring samples
+// from `pos` in `codec`
+static bool json_matches(const upload_server_upload_t *upload, audio_codec_t codec, uint32_t pos, size_t samples) {
+    static const char prefix[] = "{\"audio\":\"";
+    static const char suffix[] = "\"}";
+    static uint8_t raw[LONG_SECONDS * RATE * sizeof(int16_t)];
+    size_t raw_len = expected_raw(codec, false, pos, samples, raw);
+    size_t encoded_len = (raw_len + 2) / 3 * 4;
+
+    if (strcmp(upload->codec, audio_codec_name(codec)) != 0) {
+        printf("codec %s, expected %s\n", upload->codec, audio_codec_name(codec));
+        return false;
+    }
+    if (upload->len != sizeof(prefix) - 1 + encoded_len + sizeof(suffix) - 1 ||
+        memcmp(upload->data, prefix, sizeof(prefix) - 1) != 0 ||
+        memcmp(upload->data + upload->len - (sizeof(suffix) - 1), suffix, sizeof(suffix) - 1) != 0) {
+        printf("body of %zu bytes is not the JSON for %zu bytes\n", upload->len, raw_len);
+        return false;
+    }
+    const uint8_t *in = upload->data + sizeof(prefix) - 1;
+    for (size_t i = 0; i < raw_len; i += 3, in += 4) {
+        int v[4];
+        for (int k = 0; k < 4; ++k) {
+            v[k] = in[k] == '=' ? 0 : base64_value(in[k]);
+        }
+        uint32_t group = (uint32_t)v[0] << 18 | v[1] << 12 | v[2] << 6 | v[3];
+        uint8_t decoded[3] = {group >> 16, group >> 8 & 0xFF, group & 0xFF};
+        size_t n = raw_len - i < 3 ? raw_len - i : 3;
+        if (v[0] < 0 || v[1] < 0 || v[2] < 0 || v[3] < 0 || memcmp(decoded, raw + i, n) != 0) {
+            printf("body differs at byte %zu\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Clips whose length is not a multiple of the frame, in every codec. IMA
+// ADPCM frames are not a multiple of three bytes, so the base64 carry runs
+// from frame to frame and reaches the end.
+static void test_json_body(void) {
+    const audio_codec_t codecs[] = {AUDIO_CODEC_PCM16, AUDIO_CODEC_ULAW, AUDIO_CODEC_IMA_ADPCM};
+    const size_t lengths[] = {AUDIO_UPLOAD_FRAME_SAMPLES, 5000, 5001, 1};
+    audio_upload_stats_t stats;
+    const upload_server_upload_t *upload;
+
+    for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); ++c) {
+        audio_upload_config_t config = {
+            .url = "http://upload.test/clips",
+            .format = AUDIO_UPLOAD_JSON_BASE64,
+            .codec = codecs[c],
+            .sample_rate = RATE,
+            .channels = 1,
+        };
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+            audio_ring_cursor_t cursor = audio_ring_cursor_last(&s_ring, lengths[i]);
+            upload_server_start(&s_server, NULL);
+            CHECK_EQ(stream(&config, cursor, lengths[i], &stats), ESP_OK);
+            CHECK_EQ(stats.status_code, 200);
+            REQUIRE(upload_server_finished(&s_server, &upload, 1) == 1);
+            CHECK_EQ(stats.bytes_sent, upload->len);
+            CHECK(json_matches(upload, codecs[c], cursor.pos, lengths[i]));
+        }
+    }
+}
+
+typedef struct {
+    audio_codec_t codec;
+    uint16_t channels;
+    uint32_t drop_after;        // Request body bytes before each break
+    uint32_t drops;
+} resume_case_t;
+
+// Upload the clip once through a connection that breaks `drops` times; the
+// server must end up with exactly the file, having received each byte once
+static void run_resume(const resume_case_t *c, uint64_t *bytes_received) {
+    static uint8_t expected[AUDIO_WAV_HEADER_MAX + CLIP_SAMPLES * 2];
+    size_t expected_len = expected_wav(c->codec, c->channels, expected);
+    host_http_config_t network = {.drop_request_after = c->drop_after, .drops = c->drops};
+    audio_upload_config_t config = {
+        .url = "http://upload.test/clips",
+        .format = AUDIO_UPLOAD_WAV,
+        .codec = c->codec,
+        .sample_rate = RATE,
+        .channels = c->channels,
+    };
+    audio_upload_stats_t stats;
+
+    upload_server_start(&s_server, &network);
+    esp_err_t err = stream(&config, s_clip, CLIP_SAMPLES, &stats);
+    CHECK_EQ(err, ESP_OK);
+    CHECK_EQ(stats.status_code, 201);
+
+    const upload_server_upload_t *upload;
+    REQUIRE(upload_server_finished(&s_server, &upload, 1) == 1);
+    CHECK_EQ(upload->len, expected_len);
+    if (upload->len == expected_len && memcmp(upload->data, expected, expected_len) != 0) {
+        size_t at = 0;
+        while (upload->data[at] == expected[at]) {
+            at++;
+        }
+        printf("file differs from byte %zu\n", at);
+        CHECK(false);
+    }
+    host_http_stats_t http;
+    host_http_stats(&http);
+    CHECK_EQ(http.drops, c->drops);
+    CHECK_EQ(stats.attempts, c->drops + 1);
+    *bytes_received = s_server.bytes_received;
+}
+
+// Breaks at odd byte counts land mid-sample for PCM16 (and, with two
+// channels, mid-frame): the resumed body starts with the second byte of
+// the sample, re-encoded from the ring
+static void test_resume_mid_sample(void) {
+    const resume_case_t cases[] = {
+        {AUDIO_CODEC_PCM16, 1, 1001, 3},
+        {AUDIO_CODEC_PCM16, 2, 3333, 2},
+        {AUDIO_CODEC_PCM16, 1, 768 + 44 + 1, 1},   // Just past the first frame
+        {AUDIO_CODEC_ULAW, 1, 999, 4},
+        {AUDIO_CODEC_ULAW, 2, 1500, 2},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        uint64_t received;
+        printf("%s, %u channel(s), break every %lu bytes\n", audio_codec_name(cases[i].codec),
+               (unsigned)cases[i].channels, (unsigned long)cases[i].drop_after);
+        run_resume(&cases[i], &received);
+        // Only the missing tail is resent
+        CHECK_EQ(received, s_server.uploads[0].total);
+    }
+}
+
+// A break inside the header resumes inside the header
+static void test_resume_in_header(void) {
+    const resume_case_t pcm = {AUDIO_CODEC_PCM16, 1, 21, 1};
+    const resume_case_t ulaw = {AUDIO_CODEC_ULAW, 1, 50, 2};
+    uint64_t received;
+
+    run_resume(&pcm, &received);
+    CHECK_EQ(received, s_server.uploads[0].total);
+    run_resume(&ulaw, &received);
+    CHECK_EQ(received, s_server.uploads[0].total);
+}
+
+// A server that keeps only whole blocks of what arrived: the client resumes
+// at the block boundary and resends the rest
+static void test_resume_at_server_boundary(void) {
+    const resume_case_t c = {AUDIO_CODEC_PCM16, 1, 2001, 2};
+    uint64_t received;
+
+    s_server.keep_multiple = 512;
+    run_resume(&c, &received);
+    s_server.keep_multiple = 0;
+    CHECK(received > s_server.uploads[0].total);
+}
+
+// A server that says nothing about what it kept gets the whole file again
+static void test_resume_without_range(void) {
+    const resume_case_t c = {AUDIO_CODEC_PCM16, 1, 3001, 1};
+    uint64_t received;
+
+    s_server.ignore_range = true;
+    run_resume(&c, &received);
+    s_server.ignore_range = false;
+    CHECK_EQ(received, s_server.uploads[0].total + 3001);
+}
+
+// More breaks than attempts: the upload gives up
+static void test_gives_up(void) {
+    host_http_config_t network = {.drop_request_after = 100, .drops = AUDIO_UPLOAD_MAX_ATTEMPTS};
+    audio_upload_config_t config = {
+        .url = "http://upload.test/clips",
+        .format = AUDIO_UPLOAD_WAV,
+        .codec = AUDIO_CODEC_PCM16,
+        .sample_rate = RATE,
+        .channels = 1,
+    };
+    audio_upload_stats_t stats;
+    const upload_server_upload_t *upload;
+
+    upload_server_start(&s_server, &network);
+    CHECK_EQ(stream(&config, s_clip, CLIP_SAMPLES, &stats), ESP_ERR_TIMEOUT);
+    CHECK_EQ(stats.attempts, AUDIO_UPLOAD_MAX_ATTEMPTS);
+    CHECK_EQ(upload_server_finished(&s_server, &upload, 1), 0);
+    CHECK_EQ(s_server.uploads[0].len, AUDIO_UPLOAD_MAX_ATTEMPTS * 100);
+}
+
+// Upload `seconds` from the ring and report the heap the upload used at its
+// peak, and its rate over the unthrottled stand-in network
+static size_t run_measured(audio_upload_format_t format, uint32_t seconds) {
+    audio_upload_config_t config = {
+        .url = "http://upload.test/clips",
+        .format = format,
+        .codec = AUDIO_CODEC_PCM16,
+        .sample_rate = RATE,
+        .channels = 1,
+    };
+    audio_ring_cursor_t cursor = audio_ring_cursor_last(&s_ring, seconds * RATE);
+    audio_upload_stats_t stats;
+    host_heap_stats_t heap;
+
+    upload_server_start(&s_server, NULL);
+    host_heap_track(true);
+    CHECK_EQ(stream(&config, cursor, seconds * RATE, &stats), ESP_OK);
+    host_heap_track(false);
+    host_heap_stats(&heap);
+
+    const upload_server_upload_t *upload;
+    CHECK_EQ(upload_server_finished(&s_server, &upload, 1), 1);
+    CHECK_EQ(heap.live, 0);
+    printf("{\"format\":\"%s\",\"seconds\":%lu,\"bytes\":%llu,\"peak_heap\":%zu,\"allocations\":%lu,"
+           "\"bytes_per_s\":%.0f}\n",
+           format == AUDIO_UPLOAD_WAV ? "wav" : "json", (unsigned long)seconds, (unsigned long long)stats.bytes_sent,
+           heap.peak, (unsigned long)heap.allocations,
+           stats.elapsed_us > 0 ? stats.bytes_sent * 1e6 / stats.elapsed_us : 0);
+    return heap.peak;
+}
+
+// The upload encodes and sends a frame at a time, so the heap it needs is
+// the same for a one-second clip as for a minute: nothing holds the clip
+static void test_memory_flat(void) {
+    const audio_upload_format_t formats[] = {AUDIO_UPLOAD_WAV, AUDIO_UPLOAD_JSON_BASE64};
+
+    for (size_t f = 0; f < 2; ++f) {
+        size_t one = run_measured(formats[f], 1);
+        size_t eight = run_measured(formats[f], 8);
+        size_t longest = run_measured(formats[f], LONG_SECONDS);
+        CHECK(one > 0);
+        CHECK_EQ(eight, one);
+        CHECK_EQ(longest, one);
+    }
+}
+
+int main(void) {
+    fill_ring();
+    RUN_TEST(test_json_body);
+    RUN_TEST(test_resume_mid_sample);
+    RUN_TEST(test_resume_in_header);
+    RUN_TEST(test_resume_at_server_boundary);
+    RUN_TEST(test_resume_without_range);
+    RUN_TEST(test_gives_up);
+    RUN_TEST(test_memory_flat);
+    upload_server_free(&s_server);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "host_flash.h"
+#include "audio_clip_store.h"
+#include "audio_metrics.h"
+#include "audio_ring.h"
+#include "audio_uploader.h"
+#include "clip_log.h"
+#include "upload_server.h"
+#include "test.h"
+
+// The uploader behind a small clip store, with the upload task held up by a
+// slow server while clips are submitted as the control task would
+
+#define RING_CAPACITY (1u << 16)
+#define STORE_SLABS 4
+#define SUBMIT_MAX_US 20000     // A submit copies and packs the clip, nothing more
+
+static audio_ring_t s_ring;
+static uint8_t s_ring_storage[AUDIO_RING_STORAGE_BYTES(RING_CAPACITY)];
+static uint8_t s_store[AUDIO_CLIP_STORE_MAX_CLIPS * sizeof(audio_clip_store_clip_t) +
+                       STORE_SLABS * AUDIO_CLIP_STORE_SLAB_BYTES];
+static upload_server_t s_server;
+static const audio_task_config_t s_task = {
+    .name = "upload",
+    .stack = 16384,
+    .priority = 5,
+    .core = AUDIO_TASKS_CORE_NETWORK,
+};
+
+static uint32_t metric(const char *name) {
+    static char json[AUDIO_METRICS_JSON_BYTES];
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\":", name);
+    audio_metrics_json(json, sizeof(json));
+    const char *at = strstr(json, key);
+    return at != NULL ? strtoul(at + strlen(key), NULL, 10) : 0;
+}
+
+// Record `count` samples into the ring; returns the cursor at the first
+static audio_ring_cursor_t record(size_t count) {
+    int16_t block[256];
+    audio_ring_cursor_t start = audio_ring_cursor_live(&s_ring);
+    for (size_t done = 0; done < count;) {
+        size_t n = count - done < 256 ? count - done : 256;
+        for (size_t i = 0; i < n; ++i) {
+            block[i] = (int16_t)((start.pos + done + i) & 0xFFF);
+        }
+        audio_ring_write(&s_ring, block, n);
+        done += n;
+    }
+    return start;
+}
+
+// Submit as the control task does, checking that it neither touched flash
+// nor took long
+static esp_err_t submit(audio_ring_cursor_t cursor, size_t samples) {
+    host_flash_stats_t before;
+    host_flash_stats_t after;
+    host_flash_stats(&before);
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = audio_uploader_submit(&s_ring, cursor, samples);
+    int64_t us = esp_timer_get_time() - start;
+    host_flash_stats(&after);
+    CHECK_EQ(after.writes - before.writes, 0);
+    CHECK_EQ(after.erases - before.erases, 0);
+    CHECK(us < SUBMIT_MAX_US);
+    return err;
+}
+
+static bool wait_for(uint32_t (*done)(void), uint32_t target, uint32_t timeout_ms) {
+    for (uint32_t waited = 0; waited < timeout_ms; waited += 10) {
+        if (done() >= target) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return done() >= target;
+}
+
+static uint32_t handled_clips(void) {
+    return metric("upload_clips") + metric("upload_evictions");
+}
+
+// A clip larger than the whole store is dropped and counted by submit, not
+// written to flash from the submitting core
+static void test_oversized_clip_dropped(void) {
+    size_t samples = (STORE_SLABS + 1) * AUDIO_CLIP_STORE_SLAB_SAMPLES;
+    audio_ring_cursor_t cursor = record(samples);
+    uint32_t drops = metric("upload_drops");
+
+    CHECK_EQ(submit(cursor, samples), ESP_ERR_NO_MEM);
+    CHECK_EQ(metric("upload_drops"), drops + 1);
+    vTaskDelay(pdMS_TO_TICKS(200));
+    CHECK_EQ(s_server.upload_count, 0);
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+}
+
+// With the upload task stuck on a slow response, submits keep going: old
+// clips are evicted from the store, and once the queue is full of their
+// ids new clips are dropped and counted. Every clip is accounted for.
+static void test_queue_full_dropped(void) {
+    const size_t samples = 1000;
+    const uint32_t clips = AUDIO_CLIP_STORE_MAX_CLIPS + 8;
+    host_http_config_t slow = {.latency_ms = 1500};
+    host_http_config_t fast = {0};
+    uint32_t drops = metric("upload_drops");
+    uint32_t handled = handled_clips();
+    uint32_t failed = 0;
+
+    host_http_configure(&slow);
+    for (uint32_t i = 0; i < clips; ++i) {
+        audio_ring_cursor_t cursor = record(samples);
+        failed += submit(cursor, samples) != ESP_OK;
+        if (i == 0) {
+            vTaskDelay(pdMS_TO_TICKS(100)); // Upload task takes it and waits for the server
+        }
+    }
+    host_http_configure(&fast);
+
+    uint32_t dropped = metric("upload_drops") - drops;
+    printf("%lu clips submitted, %lu dropped at submit\n", (unsigned long)clips, (unsigned long)dropped);
+    CHECK(dropped > 0);
+    CHECK_EQ(failed, dropped);
+    CHECK(wait_for(handled_clips, handled + clips - dropped, 10000));
+    CHECK_EQ(handled_clips() - handled, clips - dropped);
+    CHECK(metric("upload_evictions") > 0);
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+}
+
+static bool seen(uint64_t n) {
+    return (s_server.seen[n / 8] >> (n % 8)) & 1;
+}
+
+// Each recording submits a clip reaching back over audio already sent, as
+// when the last few seconds of the ring are submitted: only the new samples
+// go out. One clip is a VAD clip of three segments, and one is spilled to
+// the flash log when its uploads fail and drained from there later. The
+// server sees every new sample once and no sample twice.
+static void test_no_resend_across_recordings(void) {
+    host_http_config_t network = {0};
+    uint32_t handled = handled_clips();
+    uint32_t clips = 0;
+    uint64_t expected = 0;
+
+    upload_server_start(&s_server, &network);
+    audio_ring_cursor_t first = record(3000);
+    CHECK_EQ(submit(first, 3000), ESP_OK);
+    clips++;
+    expected += 3000;
+    CHECK(wait_for(handled_clips, handled + clips, 10000));     // Recordings come apart
+
+    // Reaches 1000 samples back into the first recording; then the same again
+    audio_ring_cursor_t second = record(2000);
+    audio_ring_cursor_t back = {.pos = second.pos - 1000};
+    CHECK_EQ(submit(back, 3000), ESP_OK);
+    clips++;
+    expected += 2000;
+    CHECK_EQ(submit(back, 3000), ESP_OK);
+    CHECK(wait_for(handled_clips, handled + clips, 10000));
+
+    // Speech segments, the first one starting in audio already sent
+    audio_ring_cursor_t third = record(6000);
+    const audio_vad_segment_t segments[] = {{0, 800}, {2500, 1000}, {4500, 2000}};
+    audio_ring_cursor_t before = {.pos = third.pos - 500};
+    CHECK_EQ(audio_uploader_submit_segments(&s_ring, before, segments, 3), ESP_OK);
+    clips++;
+    expected += 300 + 1000 + 2000;
+    CHECK(wait_for(handled_clips, handled + clips, 10000));
+
+    // The server fails this one until it is in the flash log; it goes out
+    // from there once the server is back, prompted by the next clip, which
+    // reaches back over it
+    uint32_t failures = metric("upload_failures");
+    s_server.fail_status = 503;
+    audio_ring_cursor_t fourth = record(1500);
+    CHECK_EQ(submit(fourth, 1500), ESP_OK);
+    expected += 1500;
+    for (int waited = 0; waited < 10000 && !clip_log_peek(&(clip_log_entry_t){0}); waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    CHECK(clip_log_peek(&(clip_log_entry_t){0}));
+    CHECK(metric("upload_failures") >= failures + AUDIO_UPLOADER_RETRIES);
+    s_server.fail_status = 0;
+    audio_ring_cursor_t fifth = record(700);
+    CHECK_EQ(submit((audio_ring_cursor_t){.pos = fourth.pos}, 2200), ESP_OK);
+    clips++;
+    expected += 700;
+    for (int waited = 0; waited < 20000 && s_server.sequence_count < expected; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    printf("%llu sample numbers received in %zu uploads\n", (unsigned long long)s_server.sequence_count,
+           s_server.upload_count);
+    CHECK_EQ(s_server.sequence_count, expected);
+    CHECK_EQ(s_server.duplicates, 0);
+    CHECK(!clip_log_peek(&(clip_log_entry_t){0}));
+
+    // Exactly the new samples: nothing before the first recording, each
+    // segment and the audio between them only where it was kept
+    CHECK(!seen(first.pos - 1));
+    for (uint32_t i = 0; i < 5000; ++i) {
+        CHECK(seen(first.pos + i));
+    }
+    for (uint32_t i = 0; i < 6000; ++i) {
+        bool kept = i < 300 || (i >= 2000 && i < 3000) || (i >= 4000 && i < 6000);
+        if (seen(third.pos + i) != kept) {
+            printf("sample %lu of the third recording: %s\n", (unsigned long)i, kept ? "missing" : "unexpected");
+            CHECK(false);
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < 2200; ++i) {
+        CHECK(seen(fourth.pos + i));
+    }
+    CHECK(!seen(fifth.pos + 700));
+}
+
+// A dropped clip takes no sequence numbers: the next clip reaching back
+// over the same audio sends it, numbered without a gap
+static void test_dropped_clip_leaves_no_gap(void) {
+    size_t samples = (STORE_SLABS + 1) * AUDIO_CLIP_STORE_SLAB_SAMPLES;
+    size_t kept = STORE_SLABS * AUDIO_CLIP_STORE_SLAB_SAMPLES;
+    uint32_t handled = handled_clips();
+
+    upload_server_start(&s_server, NULL);
+    audio_ring_cursor_t cursor = record(samples);
+    CHECK_EQ(submit(cursor, samples), ESP_ERR_NO_MEM);
+    audio_ring_cursor_t tail = {.pos = cursor.pos + samples - kept};
+    CHECK_EQ(submit(tail, kept), ESP_OK);
+    CHECK(wait_for(handled_clips, handled + 1, 10000));
+
+    CHECK_EQ(s_server.sequence_count, kept);
+    CHECK_EQ(s_server.duplicates, 0);
+    CHECK(!seen(tail.pos - 1));
+    CHECK(seen(tail.pos));
+    CHECK(seen(tail.pos + kept - 1));
+}
+
+int main(void) {
+    audio_uploader_config_t config = {
+        .upload = {
+            .url = "http://upload.test/clips",
+            .format = AUDIO_UPLOAD_JSON_BASE64,
+            .codec = AUDIO_CODEC_PCM16,
+            .sample_rate = 16000,
+            .channels = 1,
+        },
+        .store_arena = s_store,
+        .store_bytes = sizeof(s_store),
+        .task = s_task,
+    };
+
+    host_flash_reset(true);
+    config.spill_to_flash = clip_log_init(CLIP_LOG_PARTITION_LABEL) == ESP_OK;
+    if (!config.spill_to_flash || audio_ring_init(&s_ring, s_ring_storage, RING_CAPACITY) != ESP_OK) {
+        return 1;
+    }
+    upload_server_start(&s_server, NULL);
+    if (audio_uploader_start(&config) != ESP_OK) {
+        return 1;
+    }
+
+    RUN_TEST(test_oversized_clip_dropped);
+    RUN_TEST(test_queue_full_dropped);
+    RUN_TEST(test_no_resend_across_recordings);
+    RUN_TEST(test_dropped_clip_leaves_no_gap);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,295 @@
+#include <stdbool.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "audio_codec.h"
+#include "audio_wav.h"
+#include "audio_vad.h"
+#include "test.h"
+
+// Segment boundaries from scripted clips: each character of a script is one
+// frame, '.' quiet background, 'S' a loud tone, 'f' a quieter hiss with the
+// zero crossings of a fricative, 'h' the same hiss level with few crossings.
+// Every segment should start AUDIO_VAD_PREROLL_SAMPLES before its first
+// speech frame and end AUDIO_VAD_HANGOVER_FRAMES after its last.
+
+#define FRAME 256
+#define PREROLL_FRAMES (AUDIO_VAD_PREROLL_SAMPLES / FRAME)
+#define HANGOVER AUDIO_VAD_HANGOVER_FRAMES
+#define MAX_CHANNELS 2
+
+static uint32_t s_random = 3;
+
+static int16_t noise(int16_t amplitude) {
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return (int16_t)((int32_t)(s_random % (2 * amplitude + 1)) - amplitude);
+}
+
+static void make_frame(char kind, size_t channels, int16_t *frame) {
+    for (size_t i = 0; i < FRAME * channels; ++i) {
+        size_t t = i / channels;
+        int16_t x = noise(3);
+        if (kind == 'S') {
+            x += (int16_t)((t / 8) % 2 ? 400 : -400);   // 1 kHz square at 16 kHz
+        } else if (kind == 'f') {
+            x += (int16_t)(t % 2 ? 6 : -6);             // Crosses zero every sample
+        } else if (kind == 'h') {
+            x += (int16_t)((t / 64) % 2 ? 6 : -6);      // Same energy, 4 crossings
+        }
+        frame[i] = (int16_t)(2048 + x);
+    }
+}
+
+// Run a warmed-up detector over the script as one clip; returns the frames kept
+static size_t run(audio_vad_t *vad, size_t channels, const char *script) {
+    int16_t frame[FRAME * MAX_CHANNELS];
+    size_t kept = 0;
+
+    audio_vad_init(vad, channels);
+    for (int i = 0; i < AUDIO_VAD_NOISE_BLOCKS * AUDIO_VAD_NOISE_BLOCK_FRAMES; ++i) {
+        make_frame('.', channels, frame);
+        audio_vad_process(vad, frame, FRAME * channels);   // Learns the background
+    }
+    audio_vad_begin(vad);
+    for (const char *c = script; *c != '\0'; ++c) {
+        make_frame(*c, channels, frame);
+        kept += audio_vad_process(vad, frame, FRAME * channels);
+    }
+    return kept;
+}
+
+// Script of `quiet` background frames, then runs of `speech` frames and
+// gaps of `gap` frames, `runs` times, then `tail` background frames
+static const char *script(size_t quiet, size_t runs, size_t speech, size_t gap, size_t tail) {
+    static char text[1024];
+    size_t len = 0;
+
+    memset(text, '.', quiet);
+    len += quiet;
+    for (size_t r = 0; r < runs; ++r) {
+        if (r > 0) {
+            memset(text + len, '.', gap);
+            len += gap;
+        }
+        memset(text + len, 'S', speech);
+        len += speech;
+    }
+    memset(text + len, '.', tail);
+    len += tail;
+    text[len] = '\0';
+    return text;
+}
+
+static void check_segment(const audio_vad_t *vad, size_t index, size_t first_frame, size_t end_frame,
+                          size_t channels) {
+    if (index >= vad->segment_count) {
+        printf("no segment %zu\n", index);
+        CHECK(false);
+        return;
+    }
+    CHECK_EQ(vad->segments[index].offset, first_frame * FRAME * channels);
+    CHECK_EQ(vad->segments[index].count, (end_frame - first_frame) * FRAME * channels);
+}
+
+// One word: pre-roll before the onset, hangover after the last speech frame
+static void test_one_segment(void) {
+    audio_vad_t vad;
+
+    CHECK_EQ(run(&vad, 1, script(20, 1, 10, 0, 30)), 10 + HANGOVER);
+    CHECK_EQ(vad.segment_count, 1);
+    CHECK_EQ(vad.speech_frames, 10);
+    check_segment(&vad, 0, 20 - PREROLL_FRAMES, 30 + HANGOVER, 1);
+}
+
+// Speech from the first frame: the pre-roll stops at the clip start. Speech
+// to the last frame: the segment ends with the clip.
+static void test_clip_edges(void) {
+    audio_vad_t vad;
+
+    run(&vad, 1, script(1, 1, 5, 0, 20));
+    CHECK_EQ(vad.segment_count, 1);
+    check_segment(&vad, 0, 0, 6 + HANGOVER, 1);
+
+    run(&vad, 1, script(30, 1, 5, 0, 4));
+    CHECK_EQ(vad.segment_count, 1);
+    check_segment(&vad, 0, 30 - PREROLL_FRAMES, 39, 1);
+}
+
+// Two words merge when the second's pre-roll reaches back into the first's
+// hangover, and stay apart one frame later
+static void test_gap_merging(void) {
+    audio_vad_t vad;
+    size_t merge_gap = HANGOVER + PREROLL_FRAMES;
+
+    run(&vad, 1, script(20, 2, 6, merge_gap, 40));
+    CHECK_EQ(vad.segment_count, 1);
+    check_segment(&vad, 0, 20 - PREROLL_FRAMES, 20 + 6 + merge_gap + 6 + HANGOVER, 1);
+
+    run(&vad, 1, script(20, 2, 6, merge_gap + 1, 40));
+    CHECK_EQ(vad.segment_count, 2);
+    check_segment(&vad, 0, 20 - PREROLL_FRAMES, 26 + HANGOVER, 1);
+    size_t second = 26 + merge_gap + 1;
+    check_segment(&vad, 1, second - PREROLL_FRAMES, second + 6 + HANGOVER, 1);
+}
+
+// Past AUDIO_VAD_MAX_SEGMENTS the last segment stretches over the rest
+static void test_segment_limit(void) {
+    audio_vad_t vad;
+    size_t gap = HANGOVER + PREROLL_FRAMES + 4;
+    size_t runs = AUDIO_VAD_MAX_SEGMENTS + 3;
+
+    run(&vad, 1, script(20, runs, 2, gap, 20));
+    CHECK_EQ(vad.segment_count, AUDIO_VAD_MAX_SEGMENTS);
+    size_t last_start = 20 + (AUDIO_VAD_MAX_SEGMENTS - 1) * (2 + gap);
+    size_t end = 20 + runs * 2 + (runs - 1) * gap + HANGOVER;
+    check_segment(&vad, AUDIO_VAD_MAX_SEGMENTS - 1, last_start - PREROLL_FRAMES, end, 1);
+}
+
+// A hiss a little above the background counts as speech with a fricative's
+// zero crossings, not without them
+static void test_fricatives(void) {
+    audio_vad_t vad;
+
+    run(&vad, 1, "....................ffffff..............................");
+    CHECK_EQ(vad.speech_frames, 6);
+    CHECK_EQ(vad.segment_count, 1);
+    check_segment(&vad, 0, 20 - PREROLL_FRAMES, 26 + HANGOVER, 1);
+
+    run(&vad, 1, "....................hhhhhh..............................");
+    CHECK_EQ(vad.speech_frames, 0);
+    CHECK_EQ(vad.segment_count, 0);
+}
+
+// Positions count samples of every channel, pre-roll included
+static void test_two_channels(void) {
+    audio_vad_t vad;
+
+    run(&vad, 2, script(20, 1, 10, 0, 30));
+    CHECK_EQ(vad.segment_count, 1);
+    check_segment(&vad, 0, 20 - PREROLL_FRAMES, 30 + HANGOVER, 2);
+}
+
+// finish() keeps the part of each segment inside [first, end), rebased
+static void test_finish_trims(void) {
+    audio_vad_t vad;
+
+    run(&vad, 1, script(20, 2, 6, HANGOVER + PREROLL_FRAMES + 10, 40));
+    REQUIRE(vad.segment_count == 2);
+    audio_vad_segment_t a = vad.segments[0];
+    audio_vad_segment_t b = vad.segments[1];
+
+    // Cut into the first segment and through the second
+    uint32_t first = a.offset + 100;
+    uint32_t end = b.offset + 300;
+    CHECK_EQ(audio_vad_finish(&vad, first, end), a.count - 100 + 300);
+    CHECK_EQ(vad.segment_count, 2);
+    CHECK_EQ(vad.segments[0].offset, 0);
+    CHECK_EQ(vad.segments[0].count, a.count - 100);
+    CHECK_EQ(vad.segments[1].offset, b.offset - first);
+    CHECK_EQ(vad.segments[1].count, 300);
+
+    // A window with no speech in it keeps nothing
+    run(&vad, 1, script(20, 1, 6, 0, 60));
+    uint32_t after = vad.segments[0].offset + vad.segments[0].count;
+    CHECK_EQ(audio_vad_finish(&vad, after, after + 10 * FRAME), 0);
+    CHECK_EQ(vad.segment_count, 0);
+}
+
+// Synthetic speech from fixtures/ (make_fixtures.py): the words each come
+// out as one segment that covers them, and the clip uploads as the kept
+// fraction of its samples
+typedef struct {
+    float start;
+    float end;
+} fixture_word_t;
+
+typedef struct {
+    const char *name;
+    size_t word_count;
+    fixture_word_t words[4];    // As make_fixtures.py placed them (VAD_WORDS)
+    float min_kept;             // Fraction of the clip kept
+    float max_kept;
+} fixture_case_t;
+
+static int16_t *load_fixture(const char *name, size_t *count) {
+    char path[512];
+    static uint8_t bytes[1 << 18];
+
+    snprintf(path, sizeof(path), "%s/%s", FIXTURES_DIR, name);
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        printf("cannot open %s\n", path);
+        return NULL;
+    }
+    size_t len = fread(bytes, 1, sizeof(bytes), in);
+    fclose(in);
+
+    audio_wav_info_t info;
+    if (audio_wav_parse(bytes, len, &info) != ESP_OK || info.codec != AUDIO_CODEC_PCM16 || info.channels != 1 ||
+        info.sample_rate != 16000 || info.data_offset + info.data_bytes > len) {
+        printf("%s is not the 16 kHz mono PCM16 make_fixtures.py writes\n", name);
+        return NULL;
+    }
+    *count = info.data_bytes / sizeof(int16_t);
+    int16_t *samples = malloc(info.data_bytes);
+    memcpy(samples, bytes + info.data_offset, info.data_bytes);
+    audio_codec_pcm_to_adc(samples, *count);
+    return samples;
+}
+
+static void run_fixture(const fixture_case_t *c) {
+    const int passes = 20;      // For the timing
+    audio_vad_t vad;
+    size_t count;
+    int16_t *samples = load_fixture(c->name, &count);
+    REQUIRE(samples != NULL);
+
+    int64_t start = esp_timer_get_time();
+    for (int pass = 0; pass < passes; ++pass) {
+        audio_vad_init(&vad, 1);
+        audio_vad_begin(&vad);
+        for (size_t i = 0; i + FRAME <= count; i += FRAME) {
+            audio_vad_process(&vad, samples + i, FRAME);
+        }
+    }
+    double ns_per_frame = (esp_timer_get_time() - start) * 1000.0 / (passes * vad.frames);
+    uint32_t kept = audio_vad_finish(&vad, 0, count);
+    free(samples);
+
+    printf("%s: %zu segment(s), %lu of %zu samples kept, upload %.1f%% smaller, %.0f ns per frame\n", c->name,
+           vad.segment_count, (unsigned long)kept, count, 100.0 * (count - kept) / count, ns_per_frame);
+    CHECK_EQ(vad.segment_count, c->word_count);
+    for (size_t w = 0; w < c->word_count && w < vad.segment_count; ++w) {
+        uint32_t first = c->words[w].start * 16000;
+        uint32_t end = c->words[w].end * 16000;
+        CHECK(vad.segments[w].offset <= first);
+        CHECK(vad.segments[w].offset + vad.segments[w].count >= end);
+        // No more than the pre-roll, a frame either side and the hangover
+        CHECK(vad.segments[w].count <= end - first + AUDIO_VAD_PREROLL_SAMPLES + (HANGOVER + 2) * FRAME);
+    }
+    CHECK((float)kept / count >= c->min_kept);
+    CHECK((float)kept / count <= c->max_kept);
+}
+
+static void test_fixtures(void) {
+    const fixture_case_t cases[] = {
+        {"vad_words_16k.wav", 3, {{1.0f, 1.4f}, {2.2f, 2.8f}, {4.0f, 4.3f}}, 0.30f, 0.40f},
+        {"vad_background_16k.wav", 0, {{0, 0}}, 0, 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        run_fixture(&cases[i]);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_one_segment);
+    RUN_TEST(test_clip_edges);
+    RUN_TEST(test_gap_merging);
+    RUN_TEST(test_segment_limit);
+    RUN_TEST(test_fricatives);
+    RUN_TEST(test_two_channels);
+    RUN_TEST(test_finish_trims);
+    RUN_TEST(test_fixtures);
+    return TEST_EXIT_CODE();
+}
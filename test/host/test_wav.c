@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_codec.h"
+#include "audio_wav.h"
+#include "test.h"
+
+// audio_wav_header and audio_wav_parse against files written by other
+// software (fixtures/, see make_fixtures.py) and against each other
+
+typedef struct {
+    uint8_t *bytes;
+    size_t len;
+} fixture_t;
+
+static fixture_t load(const char *name) {
+    char path[512];
+    fixture_t f = {0};
+    snprintf(path, sizeof(path), "%s/%s", FIXTURES_DIR, name);
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        printf("cannot open %s\n", path);
+        return f;
+    }
+    fseek(in, 0, SEEK_END);
+    f.len = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    f.bytes = malloc(f.len);
+    if (fread(f.bytes, 1, f.len, in) != f.len) {
+        f.len = 0;
+    }
+    fclose(in);
+    return f;
+}
+
+// The samples make_fixtures.py wrote
+static int16_t signal_at(size_t i) {
+    return (int16_t)((i * 1237) % 30000 - 15000);
+}
+
+static int16_t get_s16(const uint8_t *p) {
+    return (int16_t)(p[0] | p[1] << 8);
+}
+
+// Every prefix shorter than the header asks for more; any longer one parses
+static void check_prefixes(const fixture_t *f, const audio_wav_info_t *expected) {
+    for (size_t len = 0; len < expected->data_offset; ++len) {
+        audio_wav_info_t info;
+        if (audio_wav_parse(f->bytes, len, &info) != ESP_ERR_INVALID_SIZE) {
+            printf("prefix of %zu bytes\n", len);
+            CHECK(len >= expected->data_offset);
+            return;
+        }
+    }
+    for (size_t len = expected->data_offset; len <= f->len; len += 97) {
+        audio_wav_info_t info;
+        CHECK(audio_wav_parse(f->bytes, len, &info) == ESP_OK);
+        CHECK(memcmp(&info, expected, sizeof(info)) == 0);
+    }
+}
+
+// Python's wave module writes the same 44 bytes the firmware does
+static void test_pcm16_mono(void) {
+    fixture_t f = load("pcm16_mono_16k.wav");
+    audio_wav_info_t info;
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+
+    REQUIRE(f.len > 0);
+    REQUIRE(audio_wav_parse(f.bytes, f.len, &info) == ESP_OK);
+    CHECK_EQ(info.codec, AUDIO_CODEC_PCM16);
+    CHECK_EQ(info.sample_rate, 16000);
+    CHECK_EQ(info.channels, 1);
+    CHECK_EQ(info.block_align, 2);
+    CHECK_EQ(info.data_offset, 44);
+    CHECK_EQ(info.data_bytes, 1600 * 2);
+    for (size_t i = 0; i < 1600; ++i) {
+        CHECK_EQ(get_s16(f.bytes + info.data_offset + 2 * i), signal_at(i));
+    }
+
+    size_t len = audio_wav_header(header, AUDIO_CODEC_PCM16, 16000, 1, 1600 * 2);
+    CHECK_EQ(len, 44);
+    CHECK(memcmp(header, f.bytes, 44) == 0);
+    check_prefixes(&f, &info);
+    free(f.bytes);
+}
+
+// LIST and odd-sized chunks before the data are skipped, pad byte included
+static void test_pcm16_stereo_with_chunks(void) {
+    fixture_t f = load("pcm16_stereo_8k_chunks.wav");
+    audio_wav_info_t info;
+
+    REQUIRE(f.len > 0);
+    REQUIRE(audio_wav_parse(f.bytes, f.len, &info) == ESP_OK);
+    CHECK_EQ(info.codec, AUDIO_CODEC_PCM16);
+    CHECK_EQ(info.sample_rate, 8000);
+    CHECK_EQ(info.channels, 2);
+    CHECK_EQ(info.block_align, 4);
+    CHECK_EQ(info.data_offset, 94);
+    CHECK_EQ(info.data_bytes, 800 * 4);
+    for (size_t i = 0; i < 800; ++i) {
+        CHECK_EQ(get_s16(f.bytes + info.data_offset + 4 * i), signal_at(i));
+        CHECK_EQ(get_s16(f.bytes + info.data_offset + 4 * i + 2), -signal_at(i));
+    }
+    check_prefixes(&f, &info);
+    free(f.bytes);
+}
+
+// The firmware's mu-law encoder agrees with Python's audioop. audioop drops
+// the low two bits first (the Sun reference encoder works on 14-bit
+// values), which floors negative samples, so a negative sample right at a
+// step boundary may land on the next code out; anything else is exact.
+static void test_ulaw(void) {
+    fixture_t f = load("ulaw_mono_8k.wav");
+    audio_wav_info_t info;
+
+    REQUIRE(f.len > 0);
+    REQUIRE(audio_wav_parse(f.bytes, f.len, &info) == ESP_OK);
+    CHECK_EQ(info.codec, AUDIO_CODEC_ULAW);
+    CHECK_EQ(info.sample_rate, 8000);
+    CHECK_EQ(info.channels, 1);
+    CHECK_EQ(info.block_align, 1);
+    CHECK_EQ(info.data_bytes, 1001);
+    CHECK_EQ(info.data_offset + info.data_bytes + 1, f.len); // Odd data, padded
+
+    size_t boundary = 0;
+    for (size_t i = 0; i < 1001; ++i) {
+        int16_t pcm = signal_at(i);
+        uint8_t code;
+        uint8_t theirs = f.bytes[info.data_offset + i];
+        audio_codec_encode(AUDIO_CODEC_ULAW, NULL, &pcm, 1, &code);
+        if (code != theirs) {
+            // Codes are inverted, so one step further from zero is one lower
+            CHECK(pcm < 0 && theirs == code - 1);
+            boundary++;
+        }
+    }
+    CHECK(boundary < 1001 / 50);
+
+    // Same layout as the firmware's own mu-law header
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+    size_t len = audio_wav_header(header, AUDIO_CODEC_ULAW, 8000, 1, 1001);
+    CHECK_EQ(len, info.data_offset);
+    CHECK(memcmp(header + 8, f.bytes + 8, len - 8) == 0);
+    check_prefixes(&f, &info);
+    free(f.bytes);
+}
+
+// Whatever audio_wav_header writes, audio_wav_parse reads back
+static void test_header_round_trip(void) {
+    const audio_codec_t codecs[] = {AUDIO_CODEC_PCM16, AUDIO_CODEC_ULAW};
+    const uint32_t rates[] = {8000, 11025, 16000, 44100, 48000};
+    uint8_t header[AUDIO_WAV_HEADER_MAX];
+
+    for (size_t c = 0; c < 2; ++c) {
+        for (size_t r = 0; r < 5; ++r) {
+            for (uint16_t channels = 1; channels <= 4; ++channels) {
+                uint16_t block = channels * (codecs[c] == AUDIO_CODEC_PCM16 ? 2 : 1);
+                uint32_t data = 12345 * block;
+                size_t len = audio_wav_header(header, codecs[c], rates[r], channels, data);
+                audio_wav_info_t info;
+                REQUIRE(len > 0 && len <= AUDIO_WAV_HEADER_MAX);
+                REQUIRE(audio_wav_parse(header, len, &info) == ESP_OK);
+                CHECK_EQ(info.codec, codecs[c]);
+                CHECK_EQ(info.sample_rate, rates[r]);
+                CHECK_EQ(info.channels, channels);
+                CHECK_EQ(info.block_align, block);
+                CHECK_EQ(info.data_offset, len);
+                CHECK_EQ(info.data_bytes, data);
+                CHECK_EQ(header[4] | header[5] << 8 | header[6] << 16 | (uint32_t)header[7] << 24, len - 8 + data);
+            }
+        }
+    }
+    CHECK_EQ(audio_wav_header(header, AUDIO_CODEC_IMA_ADPCM, 16000, 1, 100), 0);
+}
+
+static void test_rejects(void) {
+    fixture_t f = load("pcm16_mono_16k.wav");
+    audio_wav_info_t info;
+    REQUIRE(f.len > 0);
+
+    memcpy(f.bytes, "RIFX", 4);
+    CHECK(audio_wav_parse(f.bytes, f.len, &info) == ESP_ERR_INVALID_ARG);
+    memcpy(f.bytes, "RIFF", 4);
+
+    f.bytes[20] = 3; // IEEE float
+    CHECK(audio_wav_parse(f.bytes, f.len, &info) == ESP_ERR_NOT_SUPPORTED);
+    f.bytes[20] = 1;
+
+    // data before fmt
+    uint8_t swapped[64];
+    memcpy(swapped, f.bytes, 12);
+    memcpy(swapped + 12, f.bytes + 36, 8);
+    memcpy(swapped + 20, f.bytes + 12, 24);
+    CHECK(audio_wav_parse(swapped, sizeof(swapped), &info) == ESP_ERR_INVALID_ARG);
+    free(f.bytes);
+}
+
+// A chunk claiming nearly 4 GB, before or after fmt, asks for more bytes
+// (a streamed header then gives up at its limit) and never moves the parse
+// back: on the ESP32 the advance past it would wrap a 32-bit size_t
+static void test_huge_chunk(void) {
+    const uint32_t sizes[] = {0xFFFFFFF8u, 0xFFFFFFF7u, 0xFFFFFFFFu, 0x80000000u};
+    fixture_t f = load("pcm16_mono_16k.wav");
+    uint8_t bytes[128];
+    audio_wav_info_t info;
+    REQUIRE(f.len >= 44);
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (int after_fmt = 0; after_fmt < 2; ++after_fmt) {
+            size_t at = after_fmt ? 36 : 12;
+            memcpy(bytes, f.bytes, at);
+            memcpy(bytes + at, "junk", 4);
+            bytes[at + 4] = (uint8_t)sizes[i];
+            bytes[at + 5] = (uint8_t)(sizes[i] >> 8);
+            bytes[at + 6] = (uint8_t)(sizes[i] >> 16);
+            bytes[at + 7] = (uint8_t)(sizes[i] >> 24);
+            memcpy(bytes + at + 8, f.bytes + at, sizeof(bytes) - at - 8);
+            for (size_t len = at + 8; len <= sizeof(bytes); ++len) {
+                CHECK(audio_wav_parse(bytes, len, &info) == ESP_ERR_INVALID_SIZE);
+            }
+        }
+    }
+    free(f.bytes);
+}
+
+int main(void) {
+    RUN_TEST(test_pcm16_mono);
+    RUN_TEST(test_pcm16_stereo_with_chunks);
+    RUN_TEST(test_ulaw);
+    RUN_TEST(test_header_round_trip);
+    RUN_TEST(test_rejects);
+    RUN_TEST(test_huge_chunk);
+    return TEST_EXIT_CODE();
+}
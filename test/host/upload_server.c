@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upload_server.h"
+
+static upload_server_upload_t *upload_server_find(upload_server_t *server, const char *id) {
+    for (size_t i = 0; i < server->upload_count; ++i) {
+        if (!server->uploads[i].done && strcmp(server->uploads[i].id, id) == 0) {
+            return &server->uploads[i];
+        }
+    }
+    return NULL;
+}
+
+static upload_server_upload_t *upload_server_add(upload_server_t *server, const host_http_request_t *request,
+                                                 const char *id) {
+    if (server->upload_count == UPLOAD_SERVER_MAX_UPLOADS) {
+        return NULL;
+    }
+    upload_server_upload_t *upload = &server->uploads[server->upload_count++];
+    memset(upload, 0, sizeof(*upload));
+    const char *codec = host_http_request_header(request, "X-Audio-Codec");
+    const char *sequence = host_http_request_header(request, "X-Audio-Sequence");
+    snprintf(upload->id, sizeof(upload->id), "%s", id);
+    snprintf(upload->codec, sizeof(upload->codec), "%s", codec != NULL ? codec : "");
+    snprintf(upload->sequence, sizeof(upload->sequence), "%s", sequence != NULL ? sequence : "");
+    return upload;
+}
+
+// Mark the numbers of "first-last,first-last" as seen, counting repeats
+static void upload_server_mark_sequence(upload_server_t *server, const char *sequence) {
+    const char *p = sequence;
+    while (*p != '\0') {
+        char *end;
+        unsigned long long first = strtoull(p, &end, 10);
+        unsigned long long last = *end == '-' ? strtoull(end + 1, &end, 10) : first;
+        for (unsigned long long n = first; n <= last; ++n) {
+            server->sequence_count++;
+            if (n >= UPLOAD_SERVER_MAX_SEQUENCE) {
+                continue;
+            }
+            uint8_t bit = 1u << (n % 8);
+            server->duplicates += (server->seen[n / 8] & bit) != 0;
+            server->seen[n / 8] |= bit;
+        }
+        p = *end == ',' ? end + 1 : end;
+        if (p == end && *p != '\0') {
+            break; // Malformed
+        }
+    }
+}
+
+static void upload_server_finish(upload_server_t *server, upload_server_upload_t *upload) {
+    upload->done = true;
+    upload_server_mark_sequence(server, upload->sequence);
+}
+
+static void upload_server_range(upload_server_t *server, const upload_server_upload_t *upload,
+                                host_http_response_t *response, char *buffer, size_t size) {
+    response->status = 308;
+    if (!server->ignore_range && upload->len > 0) {
+        snprintf(buffer, size, "bytes=0-%zu", upload->len - 1);
+        response->headers[response->header_count++] = (host_http_header_t){"Range", buffer};
+    }
+}
+
+static void upload_server_put(upload_server_t *server, const host_http_request_t *request,
+                              host_http_response_t *response) {
+    static char range[48];
+    const char *id = host_http_request_header(request, "X-Upload-Id");
+    const char *content_range = host_http_request_header(request, "Content-Range");
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    unsigned long long total = 0;
+
+    if (id == NULL || content_range == NULL) {
+        response->status = 400;
+        return;
+    }
+    upload_server_upload_t *upload = upload_server_find(server, id);
+    bool query = sscanf(content_range, "bytes */%llu", &total) == 1;
+    if (!query && sscanf(content_range, "bytes %llu-%llu/%llu", &first, &last, &total) != 3) {
+        response->status = 400;
+        return;
+    }
+    if (query) {
+        server->queries++;
+        if (upload == NULL) {
+            // Never heard of it: either finished already or nothing arrived
+            for (size_t i = server->upload_count; i-- > 0;) {
+                if (strcmp(server->uploads[i].id, id) == 0) {
+                    response->status = 201;
+                    return;
+                }
+            }
+            response->status = 308;
+            return;
+        }
+        upload_server_range(server, upload, response, range, sizeof(range));
+        return;
+    }
+
+    server->puts++;
+    if (upload == NULL) {
+        upload = upload_server_add(server, request, id);
+        if (upload == NULL) {
+            response->status = 507;
+            return;
+        }
+        upload->data = malloc(total);
+        upload->total = total;
+    }
+    if (first > upload->len || total != upload->total) {
+        response->status = 416; // A gap; the client has to ask where to resume
+        return;
+    }
+
+    size_t len = upload->len;
+    size_t take = request->body_len;
+    if (first + take > total) {
+        take = total - first;
+    }
+    memcpy(upload->data + first, request->body, take);
+    if (first + take > len) {
+        len = first + take;
+    }
+    if (!request->complete && server->keep_multiple > 1) {
+        len -= len % server->keep_multiple;
+    }
+    upload->len = len;
+
+    if (upload->len == upload->total) {
+        upload_server_finish(server, upload);
+        response->status = 201;
+    } else {
+        upload_server_range(server, upload, response, range, sizeof(range));
+    }
+}
+
+static void upload_server_handle(void *ctx, const host_http_request_t *request, host_http_response_t *response) {
+    upload_server_t *server = ctx;
+
+    server->bytes_received += request->body_len;
+    if (server->fail_status != 0) {
+        response->status = server->fail_status;
+        return;
+    }
+    if (request->method == HTTP_METHOD_PUT) {
+        upload_server_put(server, request, response);
+        return;
+    }
+    server->posts++;
+    if (!request->complete) {
+        return;
+    }
+    upload_server_upload_t *upload = upload_server_add(server, request, "");
+    if (upload == NULL) {
+        response->status = 507;
+        return;
+    }
+    upload->data = malloc(request->body_len > 0 ? request->body_len : 1);
+    memcpy(upload->data, request->body, request->body_len);
+    upload->len = request->body_len;
+    upload->total = request->body_len;
+    upload_server_finish(server, upload);
+    response->status = 200;
+}
+
+void upload_server_start(upload_server_t *server, const host_http_config_t *config) {
+    upload_server_free(server);
+    server->upload_count = 0;
+    server->puts = 0;
+    server->queries = 0;
+    server->posts = 0;
+    server->bytes_received = 0;
+    server->sequence_count = 0;
+    server->duplicates = 0;
+    server->seen = calloc(UPLOAD_SERVER_MAX_SEQUENCE / 8, 1);
+    host_http_serve(upload_server_handle, server, config);
+}
+
+void upload_server_free(upload_server_t *server) {
+    host_http_serve(NULL, NULL, NULL);
+    for (size_t i = 0; i < server->upload_count; ++i) {
+        free(server->uploads[i].data);
+        server->uploads[i].data = NULL;
+    }
+    server->upload_count = 0;
+    free(server->seen);
+    server->seen = NULL;
+}
+
+size_t upload_server_finished(const upload_server_t *server, const upload_server_upload_t **out, size_t max) {
+    size_t n = 0;
+    for (size_t i = 0; i < server->upload_count && n < max; ++i) {
+        if (server->uploads[i].done) {
+            out[n++] = &server->uploads[i];
+        }
+    }
+    return n;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "host_http.h"
+
+// An upload endpoint for the host tests, served through host_http: it takes
+// JSON POSTs and resumable WAV PUTs the way audio_upload sends them, keeps
+// every finished upload and checks the sequence numbers they carry.
+//
+// WAV: a PUT with "Content-Range: bytes first-last/total" appends what
+// arrived, complete or not, when it starts at or before the end of what the
+// server holds; a "bytes */total" query asks how much that is. Unfinished
+// uploads get 308 and "Range: bytes=0-N".
+
+#define UPLOAD_SERVER_MAX_UPLOADS 64
+#define UPLOAD_SERVER_MAX_SEQUENCE (1u << 22)   // Sequence numbers tracked for duplicates
+
+typedef struct {
+    char id[16];                // X-Upload-Id; empty for a POST
+    char codec[16];             // X-Audio-Codec
+    char sequence[1400];        // X-Audio-Sequence
+    uint8_t *data;              // WAV file or JSON body
+    size_t len;
+    size_t total;               // WAV: from Content-Range
+    bool done;
+} upload_server_upload_t;
+
+typedef struct {
+    size_t keep_multiple;       // WAV: only keep whole multiples of this many bytes; 0 or 1 for any
+    bool ignore_range;          // WAV: answer 308 without saying how much arrived
+    int fail_status;            // Answer every request with this status instead, while non-zero
+
+    upload_server_upload_t uploads[UPLOAD_SERVER_MAX_UPLOADS];
+    size_t upload_count;
+    uint32_t puts;
+    uint32_t queries;
+    uint32_t posts;
+    uint64_t bytes_received;    // Request body bytes, complete requests or not
+    uint64_t sequence_count;    // Sequence numbers in finished uploads
+    uint64_t duplicates;        // Sequence numbers seen in more than one finished upload
+    uint8_t *seen;              // Bitmap of UPLOAD_SERVER_MAX_SEQUENCE numbers
+} upload_server_t;
+
+// Clear the uploads and counters (the options set above are kept) and
+// install the server behind host_http with `config` (NULL for a perfect
+// network)
+void upload_server_start(upload_server_t *server, const host_http_config_t *config);
+
+void upload_server_free(upload_server_t *server);
+
+// Finished uploads, in the order they finished
+size_t upload_server_finished(const upload_server_t *server, const upload_server_upload_t **out, size_t max);